@@ -0,0 +1,247 @@
+//***************************************************************************************
+// AssetIndex.cpp
+//***************************************************************************************
+
+#include "AssetIndex.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	// Mips past D3D12_REQ_MIP_LEVELS cannot be in a valid file.
+	const uint32_t MaxMipCount = 15;
+
+	// offset + count * stride + bytes <= limit, without wrapping.
+	bool FitsWithin(uint64_t offset, uint64_t count, uint64_t stride, uint64_t bytes, uint64_t limit)
+	{
+		if(offset > limit || bytes > limit - offset)
+			return false;
+		return count == 0 || stride <= (limit - offset - bytes) / count;
+	}
+
+	// Everything but the hash itself, so damage to the counts is caught as well.
+	uint64_t ContentHash(const uint8_t* file, size_t size)
+	{
+		uint64_t hash = AssetIndex::Hash(file, offsetof(AssetIndex::FileHeader, ContentHash));
+		return AssetIndex::Hash(file + sizeof(AssetIndex::FileHeader), size - sizeof(AssetIndex::FileHeader), hash);
+	}
+}
+
+DDS::Image AssetIndex::Entry::AsImage()const
+{
+	DDS::Image image;
+	image.Dimension = Dimension;
+	image.Width = Width;
+	image.Height = Height;
+	image.Depth = Depth;
+	image.MipCount = Mips.size();
+	image.ArraySize = ArraySize;
+	image.Format = Format;
+	image.IsCubeMap = IsCubeMap;
+	return image;
+}
+
+std::vector<uint64_t> AssetIndex::Entry::MipBytes()const
+{
+	std::vector<uint64_t> bytes(Mips.size());
+	for(size_t m = 0; m < Mips.size(); ++m)
+		bytes[m] = Mips[m].Bytes * ArraySize;
+	return bytes;
+}
+
+uint32_t AssetIndex::Entry::SkipMip(size_t maxsize)const
+{
+	if(Mips.size() <= 1 || maxsize == 0)
+		return 0;
+
+	uint32_t skip = 0;
+	for(uint32_t m = 0; m < (uint32_t)Mips.size(); ++m)
+	{
+		size_t w = std::max<size_t>((size_t)Width >> m, 1);
+		size_t h = std::max<size_t>((size_t)Height >> m, 1);
+		size_t d = std::max<size_t>((size_t)Depth >> m, 1);
+		if(w > maxsize || h > maxsize || d > maxsize)
+			skip++;
+	}
+	return skip;
+}
+
+uint64_t AssetIndex::Hash(const uint8_t* data, size_t size, uint64_t hash)
+{
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+DDS::Status AssetIndex::Describe(const std::string& name, const uint8_t* data, size_t size, Entry& entry)
+{
+	DDS::Image image;
+	DDS::Status status = DDS::ParseHeader(data, size, image);
+	if(status != DDS::Status::Ok)
+		return status;
+
+	DDS::SubresourceLayout layout;
+	status = DDS::GetSubresources(image, 0, layout);
+	if(status != DDS::Status::Ok)
+		return status;
+
+	entry = Entry();
+	entry.Name = name;
+	entry.FileSize = size;
+	entry.ContentHash = Hash(data, size);
+	entry.Dimension = image.Dimension;
+	entry.Width = (uint32_t)image.Width;
+	entry.Height = (uint32_t)image.Height;
+	entry.Depth = (uint32_t)image.Depth;
+	entry.ArraySize = (uint32_t)image.ArraySize;
+	entry.Format = image.Format;
+	entry.IsCubeMap = image.IsCubeMap;
+
+	// Subresources run mip by mip within each slice; the first slice's give the layout.
+	for(size_t m = 0; m < image.MipCount; ++m)
+	{
+		const DDS::Subresource& sub = layout.Subresources[m];
+
+		MipRecord mip = {};
+		mip.Offset = (uint64_t)((const uint8_t*)sub.Data - data);
+		mip.Bytes = (uint64_t)sub.SlicePitch * std::max<size_t>(image.Depth >> m, 1);
+		mip.RowPitch = (uint32_t)sub.RowPitch;
+		entry.Mips.push_back(mip);
+		entry.SliceStride += mip.Bytes;
+	}
+
+	return DDS::Status::Ok;
+}
+
+std::vector<uint8_t> AssetIndex::Write(const std::vector<Entry>& entries)
+{
+	FileHeader header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.TextureCount = (uint32_t)entries.size();
+	for(const Entry& entry : entries)
+	{
+		header.MipCount += (uint32_t)entry.Mips.size();
+		header.NameBytes += (uint32_t)entry.Name.size();
+	}
+
+	std::vector<uint8_t> file(sizeof(FileHeader) + header.TextureCount * sizeof(TextureRecord) +
+		header.MipCount * sizeof(MipRecord) + header.NameBytes);
+
+	uint8_t* textures = file.data() + sizeof(FileHeader);
+	uint8_t* mips = textures + header.TextureCount * sizeof(TextureRecord);
+	uint8_t* names = mips + header.MipCount * sizeof(MipRecord);
+
+	uint32_t firstMip = 0;
+	uint32_t nameOffset = 0;
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		const Entry& entry = entries[i];
+
+		TextureRecord record = {};
+		record.FileSize = entry.FileSize;
+		record.ContentHash = entry.ContentHash;
+		record.SliceStride = entry.SliceStride;
+		record.NameOffset = nameOffset;
+		record.NameLength = (uint32_t)entry.Name.size();
+		record.Format = entry.Format;
+		record.Dimension = entry.Dimension;
+		record.Width = entry.Width;
+		record.Height = entry.Height;
+		record.Depth = entry.Depth;
+		record.MipCount = (uint32_t)entry.Mips.size();
+		record.ArraySize = entry.ArraySize;
+		record.IsCubeMap = entry.IsCubeMap ? 1 : 0;
+		record.FirstMip = firstMip;
+		memcpy(textures + i * sizeof(TextureRecord), &record, sizeof(record));
+
+		memcpy(mips + firstMip * sizeof(MipRecord), entry.Mips.data(), entry.Mips.size() * sizeof(MipRecord));
+		memcpy(names + nameOffset, entry.Name.data(), entry.Name.size());
+		firstMip += record.MipCount;
+		nameOffset += record.NameLength;
+	}
+
+	memcpy(file.data(), &header, sizeof(header));
+	header.ContentHash = ContentHash(file.data(), file.size());
+	memcpy(file.data(), &header, sizeof(header));
+
+	return file;
+}
+
+bool AssetIndex::Read(const uint8_t* data, size_t size)
+{
+	mEntries.clear();
+
+	FileHeader header;
+	if(size < sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+
+	if(header.Magic != Magic || header.Version != Version)
+		return false;
+
+	// Sized in 64 bits so huge counts cannot wrap around to the file's size.
+	uint64_t expected = sizeof(FileHeader) + (uint64_t)header.TextureCount * sizeof(TextureRecord) +
+		(uint64_t)header.MipCount * sizeof(MipRecord) + header.NameBytes;
+	if(expected != size || ContentHash(data, size) != header.ContentHash)
+		return false;
+
+	const uint8_t* textures = data + sizeof(FileHeader);
+	const uint8_t* mips = textures + (size_t)header.TextureCount * sizeof(TextureRecord);
+	const char* names = reinterpret_cast<const char*>(mips + (size_t)header.MipCount * sizeof(MipRecord));
+
+	std::vector<Entry> entries(header.TextureCount);
+	for(uint32_t i = 0; i < header.TextureCount; ++i)
+	{
+		TextureRecord record;
+		memcpy(&record, textures + i * sizeof(TextureRecord), sizeof(record));
+
+		bool dimensionValid = record.Dimension == DDS::DimensionTexture1D ||
+			record.Dimension == DDS::DimensionTexture2D || record.Dimension == DDS::DimensionTexture3D;
+		if(!dimensionValid || record.MipCount == 0 || record.MipCount > MaxMipCount || record.ArraySize == 0 ||
+		   record.Width == 0 || record.Height == 0 || record.Depth == 0 ||
+		   DDS::BitsPerPixel((DXGI_FORMAT)record.Format) == 0 ||
+		   (uint64_t)record.FirstMip + record.MipCount > header.MipCount ||
+		   (uint64_t)record.NameOffset + record.NameLength > header.NameBytes)
+			return false;
+
+		Entry& entry = entries[i];
+		entry.Name.assign(names + record.NameOffset, record.NameLength);
+		entry.FileSize = record.FileSize;
+		entry.ContentHash = record.ContentHash;
+		entry.SliceStride = record.SliceStride;
+		entry.Dimension = record.Dimension;
+		entry.Width = record.Width;
+		entry.Height = record.Height;
+		entry.Depth = record.Depth;
+		entry.ArraySize = record.ArraySize;
+		entry.Format = (DXGI_FORMAT)record.Format;
+		entry.IsCubeMap = record.IsCubeMap != 0;
+
+		// Every slice of every mip must lie inside the file it describes.
+		entry.Mips.resize(record.MipCount);
+		memcpy(entry.Mips.data(), mips + (size_t)record.FirstMip * sizeof(MipRecord), record.MipCount * sizeof(MipRecord));
+		for(const MipRecord& mip : entry.Mips)
+		{
+			if(!FitsWithin(mip.Offset, record.ArraySize - 1, record.SliceStride, mip.Bytes, record.FileSize))
+				return false;
+		}
+	}
+
+	mEntries = std::move(entries);
+	return true;
+}
+
+const AssetIndex::Entry* AssetIndex::Find(const std::string& name)const
+{
+	for(const Entry& entry : mEntries)
+	{
+		if(entry.Name == name)
+			return &entry;
+	}
+	return nullptr;
+}
@@ -0,0 +1,127 @@
+//***************************************************************************************
+// AssetIndex.h
+//
+// One binary file describing every DDS texture under a directory: its format, size, mip
+// and array counts, the byte offset and size of each mip within the file, and a hash of
+// the file's contents.  The app reads it at startup to group textures into arrays and
+// budget their mips without opening the files themselves; a file whose size no longer
+// matches its entry is looked at directly instead.
+//
+// Tools/AssetIndexer.cpp writes the index on Linux and fuzzes DDS::ParseHeader, and
+// HeadlessBench -benchindex checks a fresh index against the files it describes.
+//
+// Layout, little endian: a FileHeader, TextureCount TextureRecords, MipCount
+// MipRecords, then NameBytes of names, each without a terminator.  ContentHash in the
+// header covers every other byte, so a truncated or damaged index is rejected whole.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/DDSFile.h"
+#include <string>
+
+class AssetIndex
+{
+public:
+	static const uint32_t Magic = 0x58444941; // "AIDX"
+	static const uint32_t Version = 1;
+
+#pragma pack(push,1)
+	struct FileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t TextureCount;
+		uint32_t MipCount;
+		uint32_t NameBytes;
+		uint32_t Reserved;
+		uint64_t ContentHash;
+	};
+
+	struct TextureRecord
+	{
+		uint64_t FileSize;
+		uint64_t ContentHash;
+
+		// Bytes from the start of one array slice's mips to the next one's.
+		uint64_t SliceStride;
+
+		uint32_t NameOffset;
+		uint32_t NameLength;
+		uint32_t Format;
+		uint32_t Dimension;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;
+		uint32_t MipCount;
+		uint32_t ArraySize;
+		uint32_t IsCubeMap;
+
+		// MipCount records from here describe the first slice.
+		uint32_t FirstMip;
+		uint32_t Reserved;
+	};
+
+	struct MipRecord
+	{
+		// From the start of the file.
+		uint64_t Offset;
+
+		// All depth slices of the mip.
+		uint64_t Bytes;
+		uint32_t RowPitch;
+		uint32_t Reserved;
+	};
+#pragma pack(pop)
+
+	// A texture as described by the index.
+	struct Entry
+	{
+		std::string Name;
+		uint64_t FileSize = 0;
+		uint64_t ContentHash = 0;
+		uint64_t SliceStride = 0;
+
+		uint32_t Dimension = DDS::DimensionUnknown;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t Depth = 0;
+		uint32_t ArraySize = 0;
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		bool IsCubeMap = false;
+
+		std::vector<MipRecord> Mips;
+
+		// The header fields as ParseHeader would give them, with no bytes behind them:
+		// enough for TexturePacker::ArrayGroups, not for GetSubresources.
+		DDS::Image AsImage()const;
+
+		// Bytes of each mip, all array slices together, most detailed first, as
+		// TextureResidency::Add takes them.
+		std::vector<uint64_t> MipBytes()const;
+
+		// The mip GetSubresources starts at for maxsize.
+		uint32_t SkipMip(size_t maxsize)const;
+	};
+
+	// FNV-1a, 64 bit.
+	static uint64_t Hash(const uint8_t* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+	// Parses the file's header and lays out its mips as GetSubresources would read them.
+	static DDS::Status Describe(const std::string& name, const uint8_t* data, size_t size, Entry& entry);
+
+	// An index file holding entries, in order.
+	static std::vector<uint8_t> Write(const std::vector<Entry>& entries);
+
+	// Replaces the entries with those of an index file.  Returns false, leaving the
+	// index empty, if the file is not a whole, consistent index of this version.
+	bool Read(const uint8_t* data, size_t size);
+
+	// nullptr if name is not indexed.
+	const Entry* Find(const std::string& name)const;
+
+	const std::vector<Entry>& Entries()const { return mEntries; }
+
+private:
+	std::vector<Entry> mEntries;
+};
@@ -0,0 +1,33 @@
+//***************************************************************************************
+// BenchReport.cpp
+//***************************************************************************************
+
+#include "BenchReport.h"
+#include <cstdarg>
+#include <cstdio>
+
+BenchReport::BenchReport(const char* name)
+	: mText(std::string(name) + "\n")
+{
+}
+
+void BenchReport::Line(const char* label, const char* format, ...)
+{
+	char line[512];
+	int written = snprintf(line, sizeof(line), "  %-14s ", label);
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line + written, sizeof(line) - written, format, args);
+	va_end(args);
+
+	mText += line;
+	mText += "\n";
+}
+
+std::string BenchReport::Finish(uint32_t& errors)
+{
+	Line("failures", "%u", mFailures);
+	errors += mFailures;
+	return mText;
+}
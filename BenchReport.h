@@ -0,0 +1,49 @@
+//***************************************************************************************
+// BenchReport.h
+//
+// What the HeadlessBench reports share: the clock they time with, and BenchReport,
+// which counts a report's failures and lines up its values in one column so that every
+// -bench flag prints the same way and ends with its failure count.
+//***************************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+inline double ElapsedMs(BenchClock::time_point start, BenchClock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+class BenchReport
+{
+public:
+	// Starts the report with a line naming it, the flag without its dash.
+	explicit BenchReport(const char* name);
+
+	// Counts count more failures.
+	void Fail(uint32_t count = 1) { mFailures += count; }
+	uint32_t Failures()const { return mFailures; }
+
+	// Appends "  label" padded to the value column, then the formatted value.  Each
+	// call is one line; the newline is added.
+	void Line(const char* label, const char* format, ...);
+
+	// Appends text as it is, for output that is not one value per line.
+	void Append(const std::string& text) { mText += text; }
+
+	// The report so far, for a report that checks nothing.
+	const std::string& Text()const { return mText; }
+
+	// Ends the report with its failure count, adds that count to errors and returns the
+	// report.
+	std::string Finish(uint32_t& errors);
+
+private:
+	std::string mText;
+	uint32_t mFailures = 0;
+};
@@ -0,0 +1,61 @@
+//***************************************************************************************
+// BindlessTable.cpp
+//***************************************************************************************
+
+#include "BindlessTable.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+BindlessTable::BindlessTable(uint32_t capacity) :
+	mStates(capacity, SlotState::Free)
+{
+	// Ascending order already satisfies the heap property.
+	mFree.reserve(capacity);
+	for(uint32_t slot = 0; slot < capacity; ++slot)
+		mFree.push_back(slot);
+}
+
+uint32_t BindlessTable::Allocate()
+{
+	if(mFree.empty())
+		return InvalidSlot;
+
+	std::pop_heap(mFree.begin(), mFree.end(), std::greater<uint32_t>());
+	uint32_t slot = mFree.back();
+	mFree.pop_back();
+
+	mStates[slot] = SlotState::Allocated;
+	mAllocated++;
+	mHighWater = std::max<uint32_t>(mHighWater, mAllocated);
+
+	return slot;
+}
+
+void BindlessTable::Free(uint32_t slot, uint64_t fenceValue)
+{
+	assert(slot < mStates.size() && mStates[slot] == SlotState::Allocated);
+
+	mStates[slot] = SlotState::Pending;
+	mAllocated--;
+	mPending.push_back({ fenceValue, slot });
+}
+
+uint32_t BindlessTable::Retire(uint64_t completedValue)
+{
+	// Freed in roughly fence order, but not strictly, so every entry is checked.
+	auto retired = std::stable_partition(mPending.begin(), mPending.end(),
+		[completedValue](const Pending& pending) { return pending.FenceValue > completedValue; });
+
+	uint32_t count = 0;
+	for(auto it = retired; it != mPending.end(); ++it)
+	{
+		mStates[it->Slot] = SlotState::Free;
+		mFree.push_back(it->Slot);
+		std::push_heap(mFree.begin(), mFree.end(), std::greater<uint32_t>());
+		count++;
+	}
+	mPending.erase(retired, mPending.end());
+
+	return count;
+}
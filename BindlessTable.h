@@ -0,0 +1,71 @@
+//***************************************************************************************
+// BindlessTable.h
+//
+// Hands out the slots of the one SRV table every texture is bound through.  The table
+// is bound once per command list; a draw reaches its textures through the indices in
+// its material's record in the material buffer, so nothing texture related changes
+// between draws.
+//
+// A slot given back may still be read by frames in flight, so Free takes the fence
+// value of the last frame that can sample it and the slot only returns to use once
+// Retire sees that value complete.  Nothing here touches a device: the app writes the
+// descriptors, and HeadlessBench -benchbindless drives the same code.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class BindlessTable
+{
+public:
+	static const uint32_t InvalidSlot = UINT32_MAX;
+
+	explicit BindlessTable(uint32_t capacity);
+	BindlessTable(const BindlessTable& rhs) = delete;
+	BindlessTable& operator=(const BindlessTable& rhs) = delete;
+
+	// Returns the lowest free slot, so slots allocated in order on an empty table count
+	// up from 0.  Returns InvalidSlot if every slot is in use or waiting on a fence.
+	uint32_t Allocate();
+
+	// Gives slot back once fenceValue completes.
+	void Free(uint32_t slot, uint64_t fenceValue);
+
+	// Returns the slots whose fence value has completed to the free list.  Returns the
+	// number returned.
+	uint32_t Retire(uint64_t completedValue);
+
+	bool IsAllocated(uint32_t slot)const { return mStates[slot] == SlotState::Allocated; }
+
+	uint32_t Capacity()const { return (uint32_t)mStates.size(); }
+	uint32_t AllocatedCount()const { return mAllocated; }
+	uint32_t PendingCount()const { return (uint32_t)mPending.size(); }
+
+	// Most slots allocated at once, to size the table.
+	uint32_t HighWater()const { return mHighWater; }
+
+private:
+	enum class SlotState : uint8_t
+	{
+		Free = 0,
+		Allocated,
+		Pending
+	};
+
+	struct Pending
+	{
+		uint64_t FenceValue;
+		uint32_t Slot;
+	};
+
+	std::vector<SlotState> mStates;
+
+	// Min-heap of the free slots.
+	std::vector<uint32_t> mFree;
+	std::vector<Pending> mPending;
+
+	uint32_t mAllocated = 0;
+	uint32_t mHighWater = 0;
+};
@@ -0,0 +1,780 @@
+//***************************************************************************************
+// BlockCompress.cpp
+//***************************************************************************************
+
+#include "BlockCompress.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define BLOCKCOMPRESS_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define BLOCKCOMPRESS_SSE2 0
+#endif
+
+namespace
+{
+	// Header flags WriteDDS writes.  See DDS.h in the 'Texconv' sample.
+	const uint32_t DDSD_CAPS = 0x1;
+	const uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDSD_LINEARSIZE = 0x80000;
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+	bool gUseSimd = BLOCKCOMPRESS_SSE2 != 0;
+
+	// The weight of endpoint 0 for each BC1 index in four colour mode.
+	const float gBC1Weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	uint16_t Pack565(const float c[3])
+	{
+		int r = (int)(std::min<float>(std::max<float>(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		int g = (int)(std::min<float>(std::max<float>(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+		int b = (int)(std::min<float>(std::max<float>(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void Unpack565(uint16_t c, uint8_t rgb[3])
+	{
+		uint32_t r = (c >> 11) & 31;
+		uint32_t g = (c >> 5) & 63;
+		uint32_t b = c & 31;
+		rgb[0] = (uint8_t)((r << 3) | (r >> 2));
+		rgb[1] = (uint8_t)((g << 2) | (g >> 4));
+		rgb[2] = (uint8_t)((b << 3) | (b >> 2));
+	}
+
+	// The four colour palette of endpoints c0 and c1, alpha left 0.
+	void BC1Palette(uint16_t c0, uint16_t c1, uint8_t palette[4][4])
+	{
+		memset(palette, 0, 16);
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for(int i = 0; i < 3; ++i)
+		{
+			palette[2][i] = (uint8_t)((2 * palette[0][i] + palette[1][i]) / 3);
+			palette[3][i] = (uint8_t)((palette[0][i] + 2 * palette[1][i]) / 3);
+		}
+	}
+
+	// The eight value palette of endpoints a0 and a1.  Six values and 0 and 255 when a0
+	// is not above a1.
+	void BC4Palette(uint8_t a0, uint8_t a1, uint8_t palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if(a0 > a1)
+		{
+			for(int i = 2; i < 8; ++i)
+				palette[i] = (uint8_t)(((8 - i) * a0 + (i - 1) * a1) / 7);
+		}
+		else
+		{
+			for(int i = 2; i < 6; ++i)
+				palette[i] = (uint8_t)(((6 - i) * a0 + (i - 1) * a1) / 5);
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	// Picks the nearest palette colour for each texel, lowest index on ties, and returns
+	// the summed squared error.  Alpha is ignored.
+	uint32_t PickBC1IndicesScalar(const uint8_t rgba[64], const uint8_t palette[4][4], uint8_t indices[16])
+	{
+		uint32_t error = 0;
+		for(int t = 0; t < 16; ++t)
+		{
+			const uint8_t* texel = rgba + 4 * t;
+
+			uint32_t best = UINT_MAX;
+			for(int p = 0; p < 4; ++p)
+			{
+				int dr = texel[0] - palette[p][0];
+				int dg = texel[1] - palette[p][1];
+				int db = texel[2] - palette[p][2];
+				uint32_t d = (uint32_t)(dr * dr + dg * dg + db * db);
+				if(d < best)
+				{
+					best = d;
+					indices[t] = (uint8_t)p;
+				}
+			}
+			error += best;
+		}
+		return error;
+	}
+
+	uint32_t PickBC4IndicesScalar(const uint8_t values[16], const uint8_t palette[8], uint8_t indices[16])
+	{
+		uint32_t error = 0;
+		for(int t = 0; t < 16; ++t)
+		{
+			uint32_t best = UINT_MAX;
+			for(int p = 0; p < 8; ++p)
+			{
+				uint32_t d = (uint32_t)std::abs(values[t] - palette[p]);
+				if(d < best)
+				{
+					best = d;
+					indices[t] = (uint8_t)p;
+				}
+			}
+			error += best * best;
+		}
+		return error;
+	}
+
+#if BLOCKCOMPRESS_SSE2
+	// Four texels at a time: squared distances from 16 bit differences with madd.
+	uint32_t PickBC1IndicesSse2(const uint8_t rgba[64], const uint8_t palette[4][4], uint8_t indices[16])
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+
+		__m128i colors[4];
+		for(int p = 0; p < 4; ++p)
+			colors[p] = _mm_setr_epi16(palette[p][0], palette[p][1], palette[p][2], 0, palette[p][0], palette[p][1], palette[p][2], 0);
+
+		uint32_t error = 0;
+		for(int g = 0; g < 4; ++g)
+		{
+			__m128i texels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(rgba + 16 * g)), rgbMask);
+			__m128i lo = _mm_unpacklo_epi8(texels, zero);
+			__m128i hi = _mm_unpackhi_epi8(texels, zero);
+
+			__m128i best = _mm_setzero_si128();
+			__m128i index = _mm_setzero_si128();
+			for(int p = 0; p < 4; ++p)
+			{
+				// r*r + g*g and b*b per texel, then summed into lanes 0 and 2 of each half.
+				__m128i dl = _mm_sub_epi16(lo, colors[p]);
+				__m128i dh = _mm_sub_epi16(hi, colors[p]);
+				dl = _mm_madd_epi16(dl, dl);
+				dh = _mm_madd_epi16(dh, dh);
+				dl = _mm_add_epi32(dl, _mm_shuffle_epi32(dl, _MM_SHUFFLE(2, 3, 0, 1)));
+				dh = _mm_add_epi32(dh, _mm_shuffle_epi32(dh, _MM_SHUFFLE(2, 3, 0, 1)));
+				__m128i d = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(dl), _mm_castsi128_ps(dh), _MM_SHUFFLE(2, 0, 2, 0)));
+
+				if(p == 0)
+				{
+					best = d;
+					continue;
+				}
+
+				__m128i closer = _mm_cmplt_epi32(d, best);
+				best = _mm_or_si128(_mm_and_si128(closer, d), _mm_andnot_si128(closer, best));
+				index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, index));
+			}
+
+			alignas(16) uint32_t bestOut[4];
+			alignas(16) uint32_t indexOut[4];
+			_mm_store_si128((__m128i*)bestOut, best);
+			_mm_store_si128((__m128i*)indexOut, index);
+			for(int i = 0; i < 4; ++i)
+			{
+				indices[4 * g + i] = (uint8_t)indexOut[i];
+				error += bestOut[i];
+			}
+		}
+		return error;
+	}
+
+	// All 16 values at once as unsigned bytes.
+	uint32_t PickBC4IndicesSse2(const uint8_t values[16], const uint8_t palette[8], uint8_t indices[16])
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)values);
+
+		__m128i best = _mm_set1_epi8((char)0xFF);
+		__m128i index = _mm_setzero_si128();
+		for(int p = 0; p < 8; ++p)
+		{
+			__m128i pv = _mm_set1_epi8((char)palette[p]);
+			__m128i d = _mm_or_si128(_mm_subs_epu8(v, pv), _mm_subs_epu8(pv, v));
+
+			// d < best, unsigned: d <= best and not equal.
+			__m128i notAbove = _mm_cmpeq_epi8(_mm_max_epu8(d, best), best);
+			__m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(d, best), notAbove);
+			if(p == 0)
+				closer = _mm_set1_epi8((char)0xFF);
+
+			best = _mm_min_epu8(d, best);
+			index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char)p)), _mm_andnot_si128(closer, index));
+		}
+
+		alignas(16) uint8_t bestOut[16];
+		_mm_store_si128((__m128i*)bestOut, best);
+		_mm_storeu_si128((__m128i*)indices, index);
+
+		uint32_t error = 0;
+		for(int t = 0; t < 16; ++t)
+			error += (uint32_t)bestOut[t] * bestOut[t];
+		return error;
+	}
+#endif
+
+	uint32_t PickBC1Indices(const uint8_t rgba[64], const uint8_t palette[4][4], uint8_t indices[16])
+	{
+#if BLOCKCOMPRESS_SSE2
+		if(gUseSimd)
+			return PickBC1IndicesSse2(rgba, palette, indices);
+#endif
+		return PickBC1IndicesScalar(rgba, palette, indices);
+	}
+
+	uint32_t PickBC4Indices(const uint8_t values[16], const uint8_t palette[8], uint8_t indices[16])
+	{
+#if BLOCKCOMPRESS_SSE2
+		if(gUseSimd)
+			return PickBC4IndicesSse2(values, palette, indices);
+#endif
+		return PickBC4IndicesScalar(values, palette, indices);
+	}
+
+	// Endpoints quantized to 565 and the indices and error they give.
+	struct BC1Fit
+	{
+		uint16_t C0;
+		uint16_t C1;
+		uint8_t Indices[16];
+		uint32_t Error;
+	};
+
+	void EvaluateBC1(const uint8_t rgba[64], const float e0[3], const float e1[3], BC1Fit& fit)
+	{
+		fit.C0 = Pack565(e0);
+		fit.C1 = Pack565(e1);
+
+		uint8_t palette[4][4];
+		BC1Palette(fit.C0, fit.C1, palette);
+		fit.Error = PickBC1Indices(rgba, palette, fit.Indices);
+	}
+
+	// Endpoints at the ends of the texels' spread along the principal axis of their
+	// colours, pulled in by a sixteenth of the range, which the palette rarely reaches.
+	void PrincipalEndpoints(const uint8_t rgba[64], float e0[3], float e1[3])
+	{
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for(int t = 0; t < 16; ++t)
+		{
+			for(int i = 0; i < 3; ++i)
+				mean[i] += rgba[4 * t + i];
+		}
+		for(int i = 0; i < 3; ++i)
+			mean[i] /= 16.0f;
+
+		// Upper triangle of the covariance: rr, rg, rb, gg, gb, bb.
+		float cov[6] = {};
+		for(int t = 0; t < 16; ++t)
+		{
+			float r = rgba[4 * t + 0] - mean[0];
+			float g = rgba[4 * t + 1] - mean[1];
+			float b = rgba[4 * t + 2] - mean[2];
+			cov[0] += r * r;
+			cov[1] += r * g;
+			cov[2] += r * b;
+			cov[3] += g * g;
+			cov[4] += g * b;
+			cov[5] += b * b;
+		}
+
+		// Power iteration converges quickly on the dominant axis.
+		float axis[3] = { 1.0f, 1.0f, 1.0f };
+		for(int iteration = 0; iteration < 6; ++iteration)
+		{
+			float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			float length = std::max<float>(std::max<float>(fabsf(x), fabsf(y)), fabsf(z));
+			if(length < 1e-6f)
+				break;
+
+			axis[0] = x / length;
+			axis[1] = y / length;
+			axis[2] = z / length;
+		}
+
+		float minDot = FLT_MAX;
+		float maxDot = -FLT_MAX;
+		for(int t = 0; t < 16; ++t)
+		{
+			float dot = (rgba[4 * t + 0] - mean[0]) * axis[0] + (rgba[4 * t + 1] - mean[1]) * axis[1] +
+				(rgba[4 * t + 2] - mean[2]) * axis[2];
+			minDot = std::min<float>(minDot, dot);
+			maxDot = std::max<float>(maxDot, dot);
+		}
+
+		float lengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		float inset = (maxDot - minDot) / 16.0f;
+		for(int i = 0; i < 3; ++i)
+		{
+			e0[i] = mean[i] + (maxDot - inset) * axis[i] / lengthSq;
+			e1[i] = mean[i] + (minDot + inset) * axis[i] / lengthSq;
+		}
+	}
+
+	// The endpoints that best fit the texels in the least squares sense, given which
+	// palette entry each texel uses.  Returns false if the indices leave them free.
+	bool LeastSquaresEndpoints(const uint8_t rgba[64], const uint8_t indices[16], float e0[3], float e1[3])
+	{
+		float aa = 0.0f;
+		float bb = 0.0f;
+		float ab = 0.0f;
+		float ax[3] = { 0.0f, 0.0f, 0.0f };
+		float bx[3] = { 0.0f, 0.0f, 0.0f };
+		for(int t = 0; t < 16; ++t)
+		{
+			float a = gBC1Weights[indices[t]];
+			float b = 1.0f - a;
+			aa += a * a;
+			bb += b * b;
+			ab += a * b;
+			for(int i = 0; i < 3; ++i)
+			{
+				ax[i] += a * rgba[4 * t + i];
+				bx[i] += b * rgba[4 * t + i];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if(fabsf(det) < 1e-6f)
+			return false;
+
+		for(int i = 0; i < 3; ++i)
+		{
+			e0[i] = (ax[i] * bb - bx[i] * ab) / det;
+			e1[i] = (bx[i] * aa - ax[i] * ab) / det;
+		}
+		return true;
+	}
+
+	void WriteBC1(const BC1Fit& fit, uint8_t block[8])
+	{
+		uint16_t c0 = fit.C0;
+		uint16_t c1 = fit.C1;
+		uint32_t bits = 0;
+
+		// Four colour mode needs c0 above c1.  Swapping the endpoints swaps indices 0 and
+		// 1, and 2 and 3.  Equal endpoints would select three colour mode, whose index 3
+		// is transparent black, so every texel takes index 0.
+		if(c0 != c1)
+		{
+			bool swap = c0 < c1;
+			if(swap)
+				std::swap(c0, c1);
+
+			for(int t = 0; t < 16; ++t)
+				bits |= (uint32_t)(swap ? fit.Indices[t] ^ 1 : fit.Indices[t]) << (2 * t);
+		}
+
+		block[0] = (uint8_t)(c0 & 0xFF);
+		block[1] = (uint8_t)(c0 >> 8);
+		block[2] = (uint8_t)(c1 & 0xFF);
+		block[3] = (uint8_t)(c1 >> 8);
+		block[4] = (uint8_t)(bits & 0xFF);
+		block[5] = (uint8_t)((bits >> 8) & 0xFF);
+		block[6] = (uint8_t)((bits >> 16) & 0xFF);
+		block[7] = (uint8_t)(bits >> 24);
+	}
+
+	float SrgbToLinear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float LinearToSrgb(float c)
+	{
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	// Gamma encoded bytes to linear light, built once.
+	struct LinearTable
+	{
+		float Values[256];
+
+		LinearTable()
+		{
+			for(int i = 0; i < 256; ++i)
+				Values[i] = SrgbToLinear(i / 255.0f);
+		}
+	};
+
+	uint8_t ToByte(float unorm)
+	{
+		return (uint8_t)(std::min<float>(std::max<float>(unorm, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	// One texel of a block, repeating the surface's last row and column past its edge.
+	const uint8_t* Texel(const BlockCompress::Surface& surface, uint32_t x, uint32_t y)
+	{
+		x = std::min<uint32_t>(x, surface.Width - 1);
+		y = std::min<uint32_t>(y, surface.Height - 1);
+		return surface.Texels.data() + 4 * ((size_t)y * surface.Width + x);
+	}
+}
+
+size_t BlockCompress::BlockBytes(Format format)
+{
+	return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+}
+
+DXGI_FORMAT BlockCompress::DxgiFormat(Format format, bool srgb)
+{
+	switch(format)
+	{
+	case Format::BC1:
+		return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	case Format::BC3:
+		return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	case Format::BC4:
+		return DXGI_FORMAT_BC4_UNORM;
+	case Format::BC5:
+		return DXGI_FORMAT_BC5_UNORM;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+size_t BlockCompress::MipBytes(Format format, uint32_t width, uint32_t height)
+{
+	size_t blocksWide = std::max<size_t>(1, ((size_t)width + 3) / 4);
+	size_t blocksHigh = std::max<size_t>(1, ((size_t)height + 3) / 4);
+	return blocksWide * blocksHigh * BlockBytes(format);
+}
+
+void BlockCompress::UseSimd(bool enable)
+{
+	gUseSimd = enable && BLOCKCOMPRESS_SSE2 != 0;
+}
+
+bool BlockCompress::SimdAvailable()
+{
+	return BLOCKCOMPRESS_SSE2 != 0;
+}
+
+void BlockCompress::EncodeBC1(const uint8_t rgba[64], uint8_t block[8])
+{
+	float e0[3];
+	float e1[3];
+	PrincipalEndpoints(rgba, e0, e1);
+
+	BC1Fit best;
+	EvaluateBC1(rgba, e0, e1, best);
+
+	// One refinement usually settles it; keep it only if it helps after quantizing.
+	if(best.Error > 0 && LeastSquaresEndpoints(rgba, best.Indices, e0, e1))
+	{
+		BC1Fit refined;
+		EvaluateBC1(rgba, e0, e1, refined);
+		if(refined.Error < best.Error)
+			best = refined;
+	}
+
+	WriteBC1(best, block);
+}
+
+void BlockCompress::EncodeBC4(const uint8_t values[16], uint8_t block[8])
+{
+	uint8_t lo = 255;
+	uint8_t hi = 0;
+	for(int t = 0; t < 16; ++t)
+	{
+		lo = std::min<uint8_t>(lo, values[t]);
+		hi = std::max<uint8_t>(hi, values[t]);
+	}
+
+	// Eight value mode between the extremes; a flat block needs no indices.
+	uint8_t palette[8];
+	uint8_t indices[16] = {};
+	BC4Palette(hi, lo, palette);
+	if(hi != lo)
+		PickBC4Indices(values, palette, indices);
+
+	uint64_t bits = 0;
+	for(int t = 0; t < 16; ++t)
+		bits |= (uint64_t)indices[t] << (3 * t);
+
+	block[0] = hi;
+	block[1] = lo;
+	for(int i = 0; i < 6; ++i)
+		block[2 + i] = (uint8_t)((bits >> (8 * i)) & 0xFF);
+}
+
+void BlockCompress::DecodeBC1(const uint8_t block[8], uint8_t rgba[64])
+{
+	uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+
+	uint8_t palette[4][4];
+	BC1Palette(c0, c1, palette);
+	for(int p = 0; p < 4; ++p)
+		palette[p][3] = 255;
+
+	// Three colour mode: the midpoint, then transparent black.
+	if(c0 <= c1)
+	{
+		for(int i = 0; i < 3; ++i)
+		{
+			palette[2][i] = (uint8_t)((palette[0][i] + palette[1][i]) / 2);
+			palette[3][i] = 0;
+		}
+		palette[3][3] = 0;
+	}
+
+	uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+	for(int t = 0; t < 16; ++t)
+		memcpy(rgba + 4 * t, palette[(bits >> (2 * t)) & 3], 4);
+}
+
+void BlockCompress::DecodeBC4(const uint8_t block[8], uint8_t values[16])
+{
+	uint8_t palette[8];
+	BC4Palette(block[0], block[1], palette);
+
+	uint64_t bits = 0;
+	for(int i = 0; i < 6; ++i)
+		bits |= (uint64_t)block[2 + i] << (8 * i);
+
+	for(int t = 0; t < 16; ++t)
+		values[t] = palette[(bits >> (3 * t)) & 7];
+}
+
+void BlockCompress::CompressRows(const Surface& surface, Format format, uint32_t firstRow, uint32_t rowCount, uint8_t* out)
+{
+	assert(surface.Width > 0 && surface.Height > 0);
+
+	uint32_t blocksWide = (surface.Width + 3) / 4;
+	size_t blockBytes = BlockBytes(format);
+
+	uint8_t rgba[64];
+	uint8_t channel[16];
+	for(uint32_t by = firstRow; by < firstRow + rowCount; ++by)
+	{
+		for(uint32_t bx = 0; bx < blocksWide; ++bx)
+		{
+			for(uint32_t t = 0; t < 16; ++t)
+				memcpy(rgba + 4 * t, Texel(surface, 4 * bx + t % 4, 4 * by + t / 4), 4);
+
+			uint8_t* block = out + ((size_t)by * blocksWide + bx) * blockBytes;
+			switch(format)
+			{
+			case Format::BC1:
+				EncodeBC1(rgba, block);
+				break;
+
+			case Format::BC3:
+				for(int t = 0; t < 16; ++t)
+					channel[t] = rgba[4 * t + 3];
+				EncodeBC4(channel, block);
+				EncodeBC1(rgba, block + 8);
+				break;
+
+			case Format::BC4:
+			case Format::BC5:
+				for(int t = 0; t < 16; ++t)
+					channel[t] = rgba[4 * t + 0];
+				EncodeBC4(channel, block);
+
+				if(format == Format::BC5)
+				{
+					for(int t = 0; t < 16; ++t)
+						channel[t] = rgba[4 * t + 1];
+					EncodeBC4(channel, block + 8);
+				}
+				break;
+			}
+		}
+	}
+}
+
+void BlockCompress::Decompress(const uint8_t* data, uint32_t width, uint32_t height, Format format, Surface& surface)
+{
+	surface.Width = width;
+	surface.Height = height;
+	surface.Texels.assign((size_t)width * height * 4, 0);
+
+	uint32_t blocksWide = (width + 3) / 4;
+	uint32_t blocksHigh = (height + 3) / 4;
+	size_t blockBytes = BlockBytes(format);
+
+	uint8_t rgba[64];
+	uint8_t channel[16];
+	for(uint32_t by = 0; by < blocksHigh; ++by)
+	{
+		for(uint32_t bx = 0; bx < blocksWide; ++bx)
+		{
+			const uint8_t* block = data + ((size_t)by * blocksWide + bx) * blockBytes;
+			switch(format)
+			{
+			case Format::BC1:
+				DecodeBC1(block, rgba);
+				break;
+
+			case Format::BC3:
+				DecodeBC1(block + 8, rgba);
+				DecodeBC4(block, channel);
+				for(int t = 0; t < 16; ++t)
+					rgba[4 * t + 3] = channel[t];
+				break;
+
+			case Format::BC4:
+			case Format::BC5:
+				memset(rgba, 0, sizeof(rgba));
+				DecodeBC4(block, channel);
+				for(int t = 0; t < 16; ++t)
+				{
+					rgba[4 * t + 0] = channel[t];
+					rgba[4 * t + 3] = 255;
+				}
+
+				if(format == Format::BC5)
+				{
+					DecodeBC4(block + 8, channel);
+					for(int t = 0; t < 16; ++t)
+						rgba[4 * t + 1] = channel[t];
+				}
+				break;
+			}
+
+			for(uint32_t t = 0; t < 16; ++t)
+			{
+				uint32_t x = 4 * bx + t % 4;
+				uint32_t y = 4 * by + t / 4;
+				if(x < width && y < height)
+					memcpy(surface.Texels.data() + 4 * ((size_t)y * width + x), rgba + 4 * t, 4);
+			}
+		}
+	}
+}
+
+BlockCompress::Surface BlockCompress::DownsampleBox(const Surface& src, MipFilter filter)
+{
+	static const LinearTable toLinear;
+
+	Surface dst;
+	dst.Width = std::max<uint32_t>(src.Width / 2, 1);
+	dst.Height = std::max<uint32_t>(src.Height / 2, 1);
+	dst.Texels.resize((size_t)dst.Width * dst.Height * 4);
+
+	for(uint32_t y = 0; y < dst.Height; ++y)
+	{
+		for(uint32_t x = 0; x < dst.Width; ++x)
+		{
+			const uint8_t* texels[4] =
+			{
+				Texel(src, 2 * x, 2 * y), Texel(src, 2 * x + 1, 2 * y),
+				Texel(src, 2 * x, 2 * y + 1), Texel(src, 2 * x + 1, 2 * y + 1)
+			};
+
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for(const uint8_t* texel : texels)
+			{
+				for(int i = 0; i < 3; ++i)
+				{
+					if(filter == MipFilter::Srgb)
+						sum[i] += toLinear.Values[texel[i]];
+					else if(filter == MipFilter::NormalMap)
+						sum[i] += texel[i] / 255.0f * 2.0f - 1.0f;
+					else
+						sum[i] += texel[i] / 255.0f;
+				}
+				sum[3] += texel[3] / 255.0f;
+			}
+
+			uint8_t* out = dst.Texels.data() + 4 * ((size_t)y * dst.Width + x);
+			if(filter == MipFilter::Srgb)
+			{
+				for(int i = 0; i < 3; ++i)
+					out[i] = ToByte(LinearToSrgb(sum[i] / 4.0f));
+			}
+			else if(filter == MipFilter::NormalMap)
+			{
+				// Averaged normals shorten where the surface bends; a zero sum keeps its value.
+				float length = sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+				float scale = length > 1e-6f ? 1.0f / length : 0.25f;
+				for(int i = 0; i < 3; ++i)
+					out[i] = ToByte(sum[i] * scale * 0.5f + 0.5f);
+			}
+			else
+			{
+				for(int i = 0; i < 3; ++i)
+					out[i] = ToByte(sum[i] / 4.0f);
+			}
+			out[3] = ToByte(sum[3] / 4.0f);
+		}
+	}
+
+	return dst;
+}
+
+uint32_t BlockCompress::MipCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1;
+	for(uint32_t size = std::max<uint32_t>(width, height); size > 1; size /= 2)
+		count++;
+	return count;
+}
+
+std::vector<uint8_t> BlockCompress::WriteDDS(Format format, bool srgb, uint32_t width, uint32_t height,
+	const std::vector<std::vector<uint8_t>>& mips)
+{
+	assert(!mips.empty());
+
+	DDS_HEADER header = {};
+	header.size = sizeof(DDS_HEADER);
+	header.flags = DDSD_CAPS | DDS_HEIGHT | DDS_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.height = height;
+	header.width = width;
+	header.pitchOrLinearSize = (uint32_t)mips[0].size();
+	header.depth = 1;
+	header.mipMapCount = (uint32_t)mips.size();
+	header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+	header.ddspf.flags = DDS_FOURCC;
+	header.caps = DDSCAPS_TEXTURE | (mips.size() > 1 ? DDSCAPS_MIPMAP | DDSCAPS_COMPLEX : 0);
+
+	// The FOURCCs GetDXGIFormat maps back to these formats.
+	static const uint32_t fourCCs[] =
+	{
+		MAKEFOURCC('D', 'X', 'T', '1'),
+		MAKEFOURCC('D', 'X', 'T', '5'),
+		MAKEFOURCC('B', 'C', '4', 'U'),
+		MAKEFOURCC('A', 'T', 'I', '2')
+	};
+
+	bool dx10 = DxgiFormat(format, srgb) != DxgiFormat(format, false);
+	header.ddspf.fourCC = dx10 ? MAKEFOURCC('D', 'X', '1', '0') : fourCCs[(int)format];
+
+	DDS_HEADER_DXT10 extension = {};
+	extension.dxgiFormat = DxgiFormat(format, srgb);
+	extension.resourceDimension = DDS::DimensionTexture2D;
+	extension.arraySize = 1;
+
+	size_t size = sizeof(uint32_t) + sizeof(header) + (dx10 ? sizeof(extension) : 0);
+	for(const std::vector<uint8_t>& mip : mips)
+		size += mip.size();
+
+	std::vector<uint8_t> file(size);
+	uint8_t* out = file.data();
+	memcpy(out, &DDS_MAGIC, sizeof(uint32_t));
+	out += sizeof(uint32_t);
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	if(dx10)
+	{
+		memcpy(out, &extension, sizeof(extension));
+		out += sizeof(extension);
+	}
+
+	for(const std::vector<uint8_t>& mip : mips)
+	{
+		memcpy(out, mip.data(), mip.size());
+		out += mip.size();
+	}
+
+	return file;
+}
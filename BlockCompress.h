@@ -0,0 +1,86 @@
+//***************************************************************************************
+// BlockCompress.h
+//
+// Encodes RGBA8 images into the BC1, BC3, BC4 and BC5 block formats and writes them out
+// as DDS files that DDSTextureLoader and DDS::ParseHeader read back.  Each 4x4 block is
+// fitted along the principal axis of its colours, then its endpoints are refined once
+// by least squares against the indices picked.  Index selection, the inner loop, has an
+// SSE2 path and a scalar one that give the same blocks.
+//
+// Nothing here touches a device or a thread: CompressRows encodes a band of block rows,
+// so callers split a mip between workers.  Tools/TextureCompressor.cpp is the command
+// line front end, and HeadlessBench -benchbc checks both paths.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/DDSFile.h"
+
+namespace BlockCompress
+{
+	enum class Format
+	{
+		BC1 = 0,	// RGB, 4 bits per texel.
+		BC3,		// RGB as BC1 plus alpha as BC4, 8 bits per texel.
+		BC4,		// Red only, 4 bits per texel.
+		BC5			// Red and green as two BC4 blocks, 8 bits per texel.  For normal maps.
+	};
+
+	// How DownsampleBox averages a texel's channels.
+	enum class MipFilter
+	{
+		Srgb = 0,	// Colour stored gamma encoded: RGB averaged in linear light.
+		Linear,		// Data averaged as stored.
+		NormalMap	// XYZ in RGB, averaged and renormalized.
+	};
+
+	// Rows of Width RGBA8 texels, packed.
+	struct Surface
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		std::vector<uint8_t> Texels;
+	};
+
+	size_t BlockBytes(Format format);
+	DXGI_FORMAT DxgiFormat(Format format, bool srgb);
+
+	// Bytes of a width by height mip, rounded up to whole blocks.
+	size_t MipBytes(Format format, uint32_t width, uint32_t height);
+
+	// Turns the SSE2 path off, for comparing against the scalar one.  On by default where
+	// the compiler targets SSE2.
+	void UseSimd(bool enable);
+	bool SimdAvailable();
+
+	// Encodes one block from 16 RGBA8 texels in row order.  BC1 ignores alpha and always
+	// uses the four colour mode.
+	void EncodeBC1(const uint8_t rgba[64], uint8_t block[8]);
+
+	// Encodes one block from 16 single channel values in row order.
+	void EncodeBC4(const uint8_t values[16], uint8_t block[8]);
+
+	void DecodeBC1(const uint8_t block[8], uint8_t rgba[64]);
+	void DecodeBC4(const uint8_t block[8], uint8_t values[16]);
+
+	// Encodes block rows [firstRow, firstRow + rowCount) of surface into out, which holds
+	// the whole mip as MipBytes gives it.  Texels past the right or bottom edge repeat
+	// the edge.  Bands that do not overlap can be encoded at the same time.
+	void CompressRows(const Surface& surface, Format format, uint32_t firstRow, uint32_t rowCount, uint8_t* out);
+
+	// Decodes a mip back to RGBA8.  Channels a format does not store come back as 0,
+	// alpha as 255.
+	void Decompress(const uint8_t* data, uint32_t width, uint32_t height, Format format, Surface& surface);
+
+	// The next mip down: each texel the average of up to 2x2 texels of src.
+	Surface DownsampleBox(const Surface& src, MipFilter filter);
+
+	// Number of mips down to 1x1.
+	uint32_t MipCount(uint32_t width, uint32_t height);
+
+	// A whole DDS file holding mips, most detailed first, each already compressed.
+	// Written with a legacy FOURCC header, or with the DX10 extension for sRGB formats,
+	// which have no FOURCC.
+	std::vector<uint8_t> WriteDDS(Format format, bool srgb, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& mips);
+}
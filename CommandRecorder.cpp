@@ -0,0 +1,394 @@
+//***************************************************************************************
+// CommandRecorder.cpp
+//***************************************************************************************
+
+#include "CommandRecorder.h"
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+	struct RootTablePacket
+	{
+		UINT RootIndex;
+		D3D12_GPU_DESCRIPTOR_HANDLE Handle;
+	};
+
+	struct RootViewPacket
+	{
+		UINT RootIndex;
+		D3D12_GPU_VIRTUAL_ADDRESS Address;
+	};
+
+	struct RootConstantPacket
+	{
+		UINT RootIndex;
+		UINT Value;
+		UINT DestOffset;
+	};
+
+	struct DrawPacket
+	{
+		UINT IndexCount;
+		UINT InstanceCount;
+		UINT StartIndex;
+		INT BaseVertex;
+		UINT StartInstance;
+	};
+
+	size_t AlignUp(size_t size, size_t alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+template<typename T>
+void CommandRecorder::Write(CommandType type, const T& payload)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Packets are copied as raw bytes.");
+
+	const size_t payloadOffset = AlignUp(sizeof(PacketHeader), alignof(T));
+	const size_t packetSize = AlignUp(payloadOffset + sizeof(T), PacketAlignment);
+
+	size_t offset = mBuffer.size();
+	mBuffer.resize(offset + packetSize);
+
+	PacketHeader header = { type, (uint16_t)packetSize };
+	std::memcpy(&mBuffer[offset], &header, sizeof(header));
+	std::memcpy(&mBuffer[offset + payloadOffset], &payload, sizeof(T));
+
+	mCommandCount++;
+}
+
+void CommandRecorder::Reset()
+{
+	mBuffer.clear();
+	mCommandCount = 0;
+}
+
+void CommandRecorder::SetPipelineState(ID3D12PipelineState* pso)
+{
+	Write(CommandType::SetPipelineState, pso);
+}
+
+void CommandRecorder::IASetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	Write(CommandType::SetVertexBuffer, view);
+}
+
+void CommandRecorder::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	Write(CommandType::SetIndexBuffer, view);
+}
+
+void CommandRecorder::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+	Write(CommandType::SetPrimitiveTopology, topology);
+}
+
+void CommandRecorder::SetGraphicsRootDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+	Write(CommandType::SetRootDescriptorTable, RootTablePacket{ rootIndex, handle });
+}
+
+void CommandRecorder::SetGraphicsRootConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	Write(CommandType::SetRootConstantBufferView, RootViewPacket{ rootIndex, address });
+}
+
+void CommandRecorder::SetGraphicsRootShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	Write(CommandType::SetRootShaderResourceView, RootViewPacket{ rootIndex, address });
+}
+
+void CommandRecorder::SetGraphicsRoot32BitConstant(UINT rootIndex, UINT value, UINT destOffset)
+{
+	Write(CommandType::SetRoot32BitConstant, RootConstantPacket{ rootIndex, value, destOffset });
+}
+
+void CommandRecorder::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex,
+	INT baseVertex, UINT startInstance)
+{
+	Write(CommandType::DrawIndexedInstanced, DrawPacket{ indexCount, instanceCount, startIndex, baseVertex, startInstance });
+}
+
+void CommandRecorder::Replay(CommandBackend& backend)const
+{
+	const uint8_t* p = mBuffer.data();
+	const uint8_t* end = p + mBuffer.size();
+
+	while(p < end)
+	{
+		PacketHeader header;
+		std::memcpy(&header, p, sizeof(header));
+
+		// Payloads were written at their natural alignment after the header.
+		auto payload = [p](size_t alignment) { return p + AlignUp(sizeof(PacketHeader), alignment); };
+
+		switch(header.Type)
+		{
+		case CommandType::SetPipelineState:
+		{
+			ID3D12PipelineState* pso;
+			std::memcpy(&pso, payload(alignof(ID3D12PipelineState*)), sizeof(pso));
+			backend.SetPipelineState(pso);
+			break;
+		}
+		case CommandType::SetVertexBuffer:
+		{
+			D3D12_VERTEX_BUFFER_VIEW view;
+			std::memcpy(&view, payload(alignof(D3D12_VERTEX_BUFFER_VIEW)), sizeof(view));
+			backend.IASetVertexBuffer(view);
+			break;
+		}
+		case CommandType::SetIndexBuffer:
+		{
+			D3D12_INDEX_BUFFER_VIEW view;
+			std::memcpy(&view, payload(alignof(D3D12_INDEX_BUFFER_VIEW)), sizeof(view));
+			backend.IASetIndexBuffer(view);
+			break;
+		}
+		case CommandType::SetPrimitiveTopology:
+		{
+			D3D12_PRIMITIVE_TOPOLOGY topology;
+			std::memcpy(&topology, payload(alignof(D3D12_PRIMITIVE_TOPOLOGY)), sizeof(topology));
+			backend.IASetPrimitiveTopology(topology);
+			break;
+		}
+		case CommandType::SetRootDescriptorTable:
+		{
+			RootTablePacket packet;
+			std::memcpy(&packet, payload(alignof(RootTablePacket)), sizeof(packet));
+			backend.SetGraphicsRootDescriptorTable(packet.RootIndex, packet.Handle);
+			break;
+		}
+		case CommandType::SetRootConstantBufferView:
+		case CommandType::SetRootShaderResourceView:
+		{
+			RootViewPacket packet;
+			std::memcpy(&packet, payload(alignof(RootViewPacket)), sizeof(packet));
+			if(header.Type == CommandType::SetRootConstantBufferView)
+				backend.SetGraphicsRootConstantBufferView(packet.RootIndex, packet.Address);
+			else
+				backend.SetGraphicsRootShaderResourceView(packet.RootIndex, packet.Address);
+			break;
+		}
+		case CommandType::SetRoot32BitConstant:
+		{
+			RootConstantPacket packet;
+			std::memcpy(&packet, payload(alignof(RootConstantPacket)), sizeof(packet));
+			backend.SetGraphicsRoot32BitConstant(packet.RootIndex, packet.Value, packet.DestOffset);
+			break;
+		}
+		case CommandType::DrawIndexedInstanced:
+		{
+			DrawPacket packet;
+			std::memcpy(&packet, payload(alignof(DrawPacket)), sizeof(packet));
+			backend.DrawIndexedInstanced(packet.IndexCount, packet.InstanceCount, packet.StartIndex,
+				packet.BaseVertex, packet.StartInstance);
+			break;
+		}
+		default:
+			assert(false && "Unknown command packet.");
+			return;
+		}
+
+		p += header.Size;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// D3D12CommandBackend
+//---------------------------------------------------------------------------------------
+
+void D3D12CommandBackend::SetPipelineState(ID3D12PipelineState* pso)
+{
+	mCmdList->SetPipelineState(pso);
+}
+
+void D3D12CommandBackend::IASetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	mCmdList->IASetVertexBuffers(0, 1, &view);
+}
+
+void D3D12CommandBackend::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	mCmdList->IASetIndexBuffer(&view);
+}
+
+void D3D12CommandBackend::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+	mCmdList->IASetPrimitiveTopology(topology);
+}
+
+void D3D12CommandBackend::SetGraphicsRootDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+	mCmdList->SetGraphicsRootDescriptorTable(rootIndex, handle);
+}
+
+void D3D12CommandBackend::SetGraphicsRootConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	mCmdList->SetGraphicsRootConstantBufferView(rootIndex, address);
+}
+
+void D3D12CommandBackend::SetGraphicsRootShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	mCmdList->SetGraphicsRootShaderResourceView(rootIndex, address);
+}
+
+void D3D12CommandBackend::SetGraphicsRoot32BitConstant(UINT rootIndex, UINT value, UINT destOffset)
+{
+	mCmdList->SetGraphicsRoot32BitConstant(rootIndex, value, destOffset);
+}
+
+void D3D12CommandBackend::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex,
+	INT baseVertex, UINT startInstance)
+{
+	mCmdList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+//---------------------------------------------------------------------------------------
+// ValidatingCommandBackend
+//---------------------------------------------------------------------------------------
+
+void ValidatingCommandBackend::Reset()
+{
+	for(auto& count : mCounts)
+		count = 0;
+
+	mInstances = 0;
+	mRedundant = 0;
+	mDrawHash = 14695981039346656037ull;
+	mErrors = 0;
+	mFirstError.clear();
+
+	ResetState();
+}
+
+void ValidatingCommandBackend::ResetState()
+{
+	mPSO = nullptr;
+	mVertexBufferSet = false;
+	mIndexBufferSet = false;
+	mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+}
+
+void ValidatingCommandBackend::Error(const char* message)
+{
+	if(mErrors++ == 0)
+		mFirstError = message;
+}
+
+void ValidatingCommandBackend::CheckRootIndex(UINT rootIndex)
+{
+	if(rootIndex >= mRootParameterCount)
+		Error("Root parameter index out of range.");
+}
+
+void ValidatingCommandBackend::SetPipelineState(ID3D12PipelineState* pso)
+{
+	mCounts[(int)CommandType::SetPipelineState]++;
+
+	if(pso == nullptr)
+		Error("Null pipeline state.");
+
+	if(pso == mPSO)
+		mRedundant++;
+
+	mPSO = pso;
+}
+
+void ValidatingCommandBackend::IASetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+	mCounts[(int)CommandType::SetVertexBuffer]++;
+
+	if(view.StrideInBytes == 0)
+		Error("Vertex buffer view has no stride.");
+
+	if(mVertexBufferSet && std::memcmp(&view, &mVertexBuffer, sizeof(view)) == 0)
+		mRedundant++;
+
+	mVertexBuffer = view;
+	mVertexBufferSet = true;
+}
+
+void ValidatingCommandBackend::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+	mCounts[(int)CommandType::SetIndexBuffer]++;
+
+	if(view.Format != DXGI_FORMAT_R16_UINT && view.Format != DXGI_FORMAT_R32_UINT)
+		Error("Index buffer format must be R16_UINT or R32_UINT.");
+
+	if(mIndexBufferSet && std::memcmp(&view, &mIndexBuffer, sizeof(view)) == 0)
+		mRedundant++;
+
+	mIndexBuffer = view;
+	mIndexBufferSet = true;
+}
+
+void ValidatingCommandBackend::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+	mCounts[(int)CommandType::SetPrimitiveTopology]++;
+
+	if(topology == mTopology)
+		mRedundant++;
+
+	mTopology = topology;
+}
+
+void ValidatingCommandBackend::SetGraphicsRootDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+	mCounts[(int)CommandType::SetRootDescriptorTable]++;
+	CheckRootIndex(rootIndex);
+}
+
+void ValidatingCommandBackend::SetGraphicsRootConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	mCounts[(int)CommandType::SetRootConstantBufferView]++;
+	CheckRootIndex(rootIndex);
+
+	if(address % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT != 0)
+		Error("Constant buffer view address is not 256-byte aligned.");
+}
+
+void ValidatingCommandBackend::SetGraphicsRootShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	mCounts[(int)CommandType::SetRootShaderResourceView]++;
+	CheckRootIndex(rootIndex);
+
+	if(address % 4 != 0)
+		Error("Shader resource view address is not 4-byte aligned.");
+}
+
+void ValidatingCommandBackend::SetGraphicsRoot32BitConstant(UINT rootIndex, UINT value, UINT destOffset)
+{
+	mCounts[(int)CommandType::SetRoot32BitConstant]++;
+	CheckRootIndex(rootIndex);
+}
+
+void ValidatingCommandBackend::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex,
+	INT baseVertex, UINT startInstance)
+{
+	mCounts[(int)CommandType::DrawIndexedInstanced]++;
+	mInstances += instanceCount;
+
+	if(mPSO == nullptr)
+		Error("Draw without a pipeline state.");
+
+	if(!mVertexBufferSet || !mIndexBufferSet)
+		Error("Draw without vertex and index buffers.");
+
+	if(mTopology == D3D_PRIMITIVE_TOPOLOGY_UNDEFINED)
+		Error("Draw without a primitive topology.");
+
+	if(indexCount == 0 || instanceCount == 0)
+		Error("Empty draw.");
+
+	// FNV-1a over the draw arguments and the PSO they were drawn with.
+	const UINT64 values[] = { (UINT64)(uintptr_t)mPSO, indexCount, instanceCount, startIndex, (UINT64)(INT64)baseVertex, startInstance };
+	for(UINT64 v : values)
+	{
+		mDrawHash ^= v;
+		mDrawHash *= 1099511628211ull;
+	}
+}
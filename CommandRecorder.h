@@ -0,0 +1,164 @@
+//***************************************************************************************
+// CommandRecorder.h
+//
+// Records the graphics commands the app issues per draw as compact packets in one linear
+// buffer, and replays them into a CommandBackend.  The D3D12 backend forwards each packet
+// to an ID3D12GraphicsCommandList; the validating backend only counts and checks them, so
+// the CPU side of draw submission can be measured without a GPU (see HeadlessBench).
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/d3dUtil.h"
+
+enum class CommandType : uint16_t
+{
+	SetPipelineState = 0,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	SetPrimitiveTopology,
+	SetRootDescriptorTable,
+	SetRootConstantBufferView,
+	SetRootShaderResourceView,
+	SetRoot32BitConstant,
+	DrawIndexedInstanced,
+	Count
+};
+
+// Receives replayed commands.  The methods mirror the ID3D12GraphicsCommandList calls
+// they stand for.
+class CommandBackend
+{
+public:
+	virtual ~CommandBackend() = default;
+
+	virtual void SetPipelineState(ID3D12PipelineState* pso) = 0;
+	virtual void IASetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view) = 0;
+	virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view) = 0;
+	virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) = 0;
+	virtual void SetGraphicsRootDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle) = 0;
+	virtual void SetGraphicsRootConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+	virtual void SetGraphicsRootShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address) = 0;
+	virtual void SetGraphicsRoot32BitConstant(UINT rootIndex, UINT value, UINT destOffset) = 0;
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex,
+		INT baseVertex, UINT startInstance) = 0;
+};
+
+class CommandRecorder
+{
+public:
+	// Drops the recorded commands but keeps the buffer's memory.
+	void Reset();
+
+	void SetPipelineState(ID3D12PipelineState* pso);
+	void IASetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view);
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view);
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+	void SetGraphicsRootDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle);
+	void SetGraphicsRootConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address);
+	void SetGraphicsRootShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address);
+	void SetGraphicsRoot32BitConstant(UINT rootIndex, UINT value, UINT destOffset);
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex,
+		INT baseVertex, UINT startInstance);
+
+	// Plays the commands back in recording order.
+	void Replay(CommandBackend& backend)const;
+
+	UINT CommandCount()const { return mCommandCount; }
+	size_t ByteSize()const { return mBuffer.size(); }
+
+private:
+	// Every packet starts with a header and is padded to PacketAlignment bytes.
+	struct PacketHeader
+	{
+		CommandType Type;
+		uint16_t Size;
+	};
+
+	static const size_t PacketAlignment = 8;
+
+	template<typename T>
+	void Write(CommandType type, const T& payload);
+
+	std::vector<uint8_t> mBuffer;
+	UINT mCommandCount = 0;
+};
+
+// Forwards replayed commands to a D3D12 command list.
+class D3D12CommandBackend : public CommandBackend
+{
+public:
+	explicit D3D12CommandBackend(ID3D12GraphicsCommandList* cmdList) : mCmdList(cmdList) {}
+
+	virtual void SetPipelineState(ID3D12PipelineState* pso)override;
+	virtual void IASetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)override;
+	virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)override;
+	virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)override;
+	virtual void SetGraphicsRootDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)override;
+	virtual void SetGraphicsRootConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override;
+	virtual void SetGraphicsRootShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override;
+	virtual void SetGraphicsRoot32BitConstant(UINT rootIndex, UINT value, UINT destOffset)override;
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex,
+		INT baseVertex, UINT startInstance)override;
+
+private:
+	ID3D12GraphicsCommandList* mCmdList = nullptr;
+};
+
+// Counts replayed commands and checks them against the rules the D3D12 debug layer
+// would enforce at draw time, without touching a device.
+class ValidatingCommandBackend : public CommandBackend
+{
+public:
+	explicit ValidatingCommandBackend(UINT rootParameterCount) : mRootParameterCount(rootParameterCount) {}
+
+	// Clears the counters and the bound state.
+	void Reset();
+
+	// Clears only the bound state, as moving on to the next command list would.
+	void ResetState();
+
+	virtual void SetPipelineState(ID3D12PipelineState* pso)override;
+	virtual void IASetVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& view)override;
+	virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)override;
+	virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)override;
+	virtual void SetGraphicsRootDescriptorTable(UINT rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE handle)override;
+	virtual void SetGraphicsRootConstantBufferView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override;
+	virtual void SetGraphicsRootShaderResourceView(UINT rootIndex, D3D12_GPU_VIRTUAL_ADDRESS address)override;
+	virtual void SetGraphicsRoot32BitConstant(UINT rootIndex, UINT value, UINT destOffset)override;
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex,
+		INT baseVertex, UINT startInstance)override;
+
+	UINT Count(CommandType type)const { return mCounts[(int)type]; }
+	UINT64 InstanceCount()const { return mInstances; }
+
+	// Commands that set state to the value it already had.
+	UINT RedundantCount()const { return mRedundant; }
+
+	// Order-dependent hash of every draw and the PSO it used.  Equal hashes mean two
+	// command streams issued the same draws in the same order.
+	UINT64 DrawHash()const { return mDrawHash; }
+
+	UINT ErrorCount()const { return mErrors; }
+	const std::string& FirstError()const { return mFirstError; }
+
+private:
+	void Error(const char* message);
+	void CheckRootIndex(UINT rootIndex);
+
+	UINT mRootParameterCount = 0;
+
+	UINT mCounts[(int)CommandType::Count] = {};
+	UINT64 mInstances = 0;
+	UINT mRedundant = 0;
+	UINT64 mDrawHash = 14695981039346656037ull;
+	UINT mErrors = 0;
+	std::string mFirstError;
+
+	ID3D12PipelineState* mPSO = nullptr;
+	bool mVertexBufferSet = false;
+	bool mIndexBufferSet = false;
+	D3D12_VERTEX_BUFFER_VIEW mVertexBuffer = {};
+	D3D12_INDEX_BUFFER_VIEW mIndexBuffer = {};
+	D3D12_PRIMITIVE_TOPOLOGY mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+};
@@ -0,0 +1,219 @@
+//--------------------------------------------------------------------------------------
+// File: DDSFile.h
+//
+// DDS header parsing and surface layout, split out of DDSTextureLoader so they need no
+// Direct3D device and no Windows headers beyond dxgiformat.h.  ParseHeader and
+// GetSubresources work in place on the bytes of the file, so a texture opened with
+// MappedFile goes from the page cache to the upload heap without a copy in between.
+//
+// Builds on Linux as well, with dxgiformat.h from the DirectX-Headers package.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <dxgiformat.h>
+
+//--------------------------------------------------------------------------------------
+// Macros
+//--------------------------------------------------------------------------------------
+#ifndef MAKEFOURCC
+    #define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#endif /* defined(MAKEFOURCC) */
+
+//--------------------------------------------------------------------------------------
+// DDS file structure definitions
+//
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
+//--------------------------------------------------------------------------------------
+#pragma pack(push,1)
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+struct DDS_PIXELFORMAT
+{
+    uint32_t    size;
+    uint32_t    flags;
+    uint32_t    fourCC;
+    uint32_t    RGBBitCount;
+    uint32_t    RBitMask;
+    uint32_t    GBitMask;
+    uint32_t    BBitMask;
+    uint32_t    ABitMask;
+};
+
+#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+#define DDS_RGB         0x00000040  // DDPF_RGB
+#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+
+#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+
+#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
+
+#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+#define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                               DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                               DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
+
+#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+enum DDS_MISC_FLAGS2
+{
+    DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
+};
+
+struct DDS_HEADER
+{
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitchOrLinearSize;
+    uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+    uint32_t        mipMapCount;
+    uint32_t        reserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    uint32_t        caps;
+    uint32_t        caps2;
+    uint32_t        caps3;
+    uint32_t        caps4;
+    uint32_t        reserved2;
+};
+
+struct DDS_HEADER_DXT10
+{
+    DXGI_FORMAT     dxgiFormat;
+    uint32_t        resourceDimension;
+    uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+    uint32_t        arraySize;
+    uint32_t        miscFlags2;
+};
+
+#pragma pack(pop)
+
+namespace DDS
+{
+	enum class Status
+	{
+		Ok = 0,
+		InvalidData,	// Not a DDS file, or its header contradicts itself.
+		NotSupported,	// A valid file this loader or the hardware limits cannot take.
+		EndOfFile		// The header promises more surface data than the file holds.
+	};
+
+	// The values of D3D12_RESOURCE_DIMENSION, which the DX10 header extension also uses.
+	enum Dimension : uint32_t
+	{
+		DimensionUnknown = 0,
+		DimensionTexture1D = 2,
+		DimensionTexture2D = 3,
+		DimensionTexture3D = 4
+	};
+
+	// A validated header.  Header and BitData point into the bytes given to ParseHeader,
+	// which must outlive the image.
+	struct Image
+	{
+		const DDS_HEADER* Header = nullptr;
+
+		uint32_t Dimension = DimensionUnknown;
+		size_t Width = 0;
+		size_t Height = 0;
+		size_t Depth = 0;
+		size_t MipCount = 0;
+		size_t ArraySize = 0;	// Six per cube.
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		bool IsCubeMap = false;
+
+		const uint8_t* BitData = nullptr;
+		size_t BitSize = 0;
+	};
+
+	// Mirrors D3D12_SUBRESOURCE_DATA.
+	struct Subresource
+	{
+		const void* Data;
+		size_t RowPitch;
+		size_t SlicePitch;
+	};
+
+	// The subresources to upload, mip-major within each array slice, after dropping the
+	// mips larger than maxsize.  Width, Height, Depth and MipCount describe what is left.
+	struct SubresourceLayout
+	{
+		std::vector<Subresource> Subresources;
+		size_t Width = 0;
+		size_t Height = 0;
+		size_t Depth = 0;
+		size_t MipCount = 0;
+		size_t SkipMip = 0;
+	};
+
+	// Validates the magic number, the header and the DX10 extension if there is one,
+	// and bounds the sizes by the D3D12 hardware limits.
+	Status ParseHeader(const uint8_t* data, size_t size, Image& image);
+
+	// Points each subresource at its bytes in image.BitData.  Nothing is copied.
+	Status GetSubresources(const Image& image, size_t maxsize, SubresourceLayout& layout);
+
+	size_t BitsPerPixel( DXGI_FORMAT fmt );
+
+	void GetSurfaceInfo( size_t width,
+	                     size_t height,
+	                     DXGI_FORMAT fmt,
+	                     size_t* outNumBytes,
+	                     size_t* outRowBytes,
+	                     size_t* outNumRows );
+
+	DXGI_FORMAT GetDXGIFormat( const DDS_PIXELFORMAT& ddpf );
+
+	// A whole file mapped read-only: a file mapping view on Windows, mmap elsewhere.
+	// Pages are read in by the OS as they are touched instead of up front into a heap
+	// buffer.  Unmapped on Close or destruction.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile& rhs) = delete;
+		MappedFile& operator=(const MappedFile& rhs) = delete;
+		~MappedFile() { Close(); }
+
+		// Returns false if the file cannot be opened or mapped, with the reason left in
+		// GetLastError or errno.  Empty files cannot be mapped and fail too.
+#ifdef _WIN32
+		bool Open(const wchar_t* fileName);
+#else
+		bool Open(const char* fileName);
+#endif
+		void Close();
+
+		const uint8_t* Data()const { return mData; }
+		size_t Size()const { return mSize; }
+
+	private:
+		const uint8_t* mData = nullptr;
+		size_t mSize = 0;
+	};
+}
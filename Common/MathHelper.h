@@ -78,6 +78,35 @@ public:
         return DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, A));
 	}
 
+	// Inverse of a rotation plus a translation, such as a view matrix.  The rotation
+	// inverts by transposing; the translation is rotated back and negated.
+    static DirectX::XMMATRIX InverseRigid(DirectX::CXMMATRIX M)
+	{
+        DirectX::XMMATRIX R = M;
+        R.r[3] = DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+        R = DirectX::XMMatrixTranspose(R);
+
+        DirectX::XMVECTOR t = DirectX::XMVector3TransformNormal(DirectX::XMVectorNegate(M.r[3]), R);
+        R.r[3] = DirectX::XMVectorSetW(t, 1.0f);
+        return R;
+	}
+
+	// Inverse of a perspective projection as built by XMMatrixPerspectiveFovLH.  Only
+	// four entries of such a matrix are not 0 or 1, so the inverse is written directly.
+    static DirectX::XMMATRIX InversePerspective(DirectX::CXMMATRIX P)
+	{
+        float a = DirectX::XMVectorGetX(P.r[0]);
+        float b = DirectX::XMVectorGetY(P.r[1]);
+        float c = DirectX::XMVectorGetZ(P.r[2]);
+        float d = DirectX::XMVectorGetZ(P.r[3]);
+
+        return DirectX::XMMATRIX(
+            1.0f / a, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f / b, 0.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f / d,
+            0.0f, 0.0f, 1.0f, -c / d);
+	}
+
     static DirectX::XMFLOAT4X4 Identity4x4()
     {
         static DirectX::XMFLOAT4X4 I(
@@ -0,0 +1,89 @@
+//***************************************************************************************
+// NameTable.h
+//
+// Named resources stored in a dense vector.  A name is interned once, when the resource
+// is added or looked up at load time, and turned into a typed ID that is an index into
+// the vector; from then on lookups are array indexing.  Each resource type has its own
+// ID type, so a material ID cannot be used to index the geometries.
+//***************************************************************************************
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Index of a resource in a NameTable.  Tag only gives each resource type its own ID
+// type; it is never defined.
+template<typename Tag>
+struct TypedId
+{
+	static const uint32_t InvalidIndex = UINT32_MAX;
+
+	uint32_t Index = InvalidIndex;
+
+	TypedId() = default;
+	explicit TypedId(uint32_t index) : Index(index) {}
+
+	bool IsValid()const { return Index != InvalidIndex; }
+	bool operator==(TypedId rhs)const { return Index == rhs.Index; }
+	bool operator!=(TypedId rhs)const { return Index != rhs.Index; }
+};
+
+template<typename T, typename Tag>
+class NameTable
+{
+public:
+	typedef TypedId<Tag> Id;
+
+	// Adds value under name, or replaces the value already there.  Either way the
+	// name keeps its ID.  name may live inside value; it is read before value moves.
+	Id Add(const std::string& name, const T& value) { return Insert(name, T(value)); }
+	Id Add(const std::string& name, T&& value) { return Insert(name, std::move(value)); }
+
+	// Returns an invalid ID if nothing is named name.
+	Id Find(const std::string& name)const
+	{
+		auto it = mIds.find(name);
+		return it != mIds.end() ? it->second : Id();
+	}
+
+	T& operator[](Id id) { assert(id.Index < mValues.size()); return mValues[id.Index]; }
+	const T& operator[](Id id)const { assert(id.Index < mValues.size()); return mValues[id.Index]; }
+
+	// Load time lookup by name; the name must exist.
+	T& Get(const std::string& name) { Id id = Find(name); assert(id.IsValid() && "No resource with this name."); return mValues[id.Index]; }
+	const T& Get(const std::string& name)const { Id id = Find(name); assert(id.IsValid() && "No resource with this name."); return mValues[id.Index]; }
+
+	const std::string& GetName(Id id)const { return mNames[id.Index]; }
+	uint32_t Count()const { return (uint32_t)mValues.size(); }
+
+	// Iterates the values in ID order.
+	typename std::vector<T>::iterator begin() { return mValues.begin(); }
+	typename std::vector<T>::iterator end() { return mValues.end(); }
+	typename std::vector<T>::const_iterator begin()const { return mValues.begin(); }
+	typename std::vector<T>::const_iterator end()const { return mValues.end(); }
+
+private:
+	Id Insert(const std::string& name, T&& value)
+	{
+		auto it = mIds.find(name);
+		if(it != mIds.end())
+		{
+			mValues[it->second.Index] = std::move(value);
+			return it->second;
+		}
+
+		Id id((uint32_t)mValues.size());
+		mIds.emplace(name, id);
+		mNames.push_back(name);
+		mValues.push_back(std::move(value));
+		return id;
+	}
+
+	std::vector<T> mValues;
+	std::vector<std::string> mNames;
+	std::unordered_map<std::string, Id> mIds;
+};
@@ -55,6 +55,23 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Copies only byteSize bytes of data, starting byteOffset bytes into the element,
+    // for elements of which just a part has changed.
+    void CopyData(int elementIndex, const T& data, UINT byteOffset, UINT byteSize)
+    {
+        assert(byteOffset + byteSize <= sizeof(T));
+        memcpy(&mMappedData[elementIndex*mElementByteSize + byteOffset],
+            reinterpret_cast<const BYTE*>(&data) + byteOffset, byteSize);
+    }
+
+    // Copies count tightly packed elements at once.  Not for constant buffers, whose
+    // elements are padded to 256 bytes.
+    void CopyData(int firstElement, const T* data, UINT count)
+    {
+        assert(!mIsConstantBuffer);
+        memcpy(&mMappedData[firstElement*mElementByteSize], data, count*sizeof(T));
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
@@ -595,7 +595,8 @@ void D3DApp::CalculateFrameStats()
 
         wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            mRenderStatsText;
 
         SetWindowText(mhMainWnd, windowText.c_str());
 		
@@ -28,8 +28,9 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "NameTable.h"
 
-extern const int gNumFrameResources;
+extern int gNumFrameResources;
 
 inline void d3dSetDebugName(IDXGIObject* obj, const char* name)
 {
@@ -157,6 +158,9 @@ struct SubmeshGeometry
 	DirectX::BoundingBox Bounds;
 };
 
+struct SubmeshTag;
+typedef TypedId<SubmeshTag> SubmeshId;
+
 struct MeshGeometry
 {
 	// Give it a name so we can look it up by name.
@@ -170,6 +174,11 @@ struct MeshGeometry
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferGPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
 
+	// Where the vertices and indices start in their buffers, which other meshes may
+	// share.
+	UINT64 VertexBufferOffset = 0;
+	UINT64 IndexBufferOffset = 0;
+
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
 
@@ -181,13 +190,13 @@ struct MeshGeometry
 
 	// A MeshGeometry may store multiple geometries in one vertex/index buffer.
 	// Use this container to define the Submesh geometries so we can draw
-	// the Submeshes individually.
-	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
+	// the Submeshes individually.  Resolve names to SubmeshIds once at load time.
+	NameTable<SubmeshGeometry, SubmeshTag> DrawArgs;
 
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
-		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
+		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress() + VertexBufferOffset;
 		vbv.StrideInBytes = VertexByteStride;
 		vbv.SizeInBytes = VertexBufferByteSize;
 
@@ -197,19 +206,29 @@ struct MeshGeometry
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
 	{
 		D3D12_INDEX_BUFFER_VIEW ibv;
-		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
+		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress() + IndexBufferOffset;
 		ibv.Format = IndexFormat;
 		ibv.SizeInBytes = IndexBufferByteSize;
 
 		return ibv;
 	}
 
+	// Set by whatever reads the vertices or indices back on the CPU, such as picking
+	// or collision against triangles.  Otherwise the copies are dropped after loading.
+	bool KeepCpuCopies = false;
+
 	// We can free this memory after we finish upload to the GPU.
 	void DisposeUploaders()
 	{
 		VertexBufferUploader = nullptr;
 		IndexBufferUploader = nullptr;
 	}
+
+	void DisposeCpuCopies()
+	{
+		VertexBufferCPU = nullptr;
+		IndexBufferCPU = nullptr;
+	}
 };
 
 struct Light
@@ -244,8 +263,10 @@ struct Material
 	// Index into constant buffer corresponding to this material.
 	int MatCBIndex = -1;
 
-	// Index into SRV heap for diffuse texture.
+	// Index into SRV heap for diffuse texture, and its slice when several materials'
+	// textures share an array.
 	int DiffuseSrvHeapIndex = -1;
+	UINT DiffuseSlice = 0;
 
 	// Index into SRV heap for normal texture.
 	int NormalSrvHeapIndex = -1;
@@ -274,6 +295,16 @@ struct Texture
 	Microsoft::WRL::ComPtr<ID3D12Resource> UploadHeap = nullptr;
 };
 
+// IDs of the resources the app keeps in NameTables.
+struct GeometryTag;
+struct MaterialTag;
+struct TextureTag;
+struct ShaderTag;
+typedef TypedId<GeometryTag> GeometryId;
+typedef TypedId<MaterialTag> MaterialId;
+typedef TypedId<TextureTag> TextureId;
+typedef TypedId<ShaderTag> ShaderId;
+
 #ifndef ThrowIfFailed
 #define ThrowIfFailed(x)                                              \
 {                                                                     \
@@ -0,0 +1,37 @@
+//***************************************************************************************
+// D3D12FenceSource.cpp
+//***************************************************************************************
+
+#include "D3D12FenceSource.h"
+#include <chrono>
+
+D3D12FenceSource::D3D12FenceSource(ID3D12Fence* fence)
+	: mFence(fence)
+{
+	mEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+	if(mEvent == nullptr)
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+}
+
+D3D12FenceSource::~D3D12FenceSource()
+{
+	if(mEvent != nullptr)
+		CloseHandle(mEvent);
+}
+
+uint64_t D3D12FenceSource::GetCompletedValue()
+{
+	return mFence->GetCompletedValue();
+}
+
+double D3D12FenceSource::WaitForValue(uint64_t value)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// The event is auto-reset, so it is ready for the next wait once this one returns.
+	ThrowIfFailed(mFence->SetEventOnCompletion(value, mEvent));
+	WaitForSingleObject(mEvent, INFINITE);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
@@ -0,0 +1,27 @@
+//***************************************************************************************
+// D3D12FenceSource.h
+//
+// FenceSource over an ID3D12Fence.  The wait event is created once and reused, rather
+// than created and destroyed every time the CPU has to wait.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/d3dUtil.h"
+#include "FramePacer.h"
+
+class D3D12FenceSource : public FenceSource
+{
+public:
+	explicit D3D12FenceSource(ID3D12Fence* fence);
+	D3D12FenceSource(const D3D12FenceSource& rhs) = delete;
+	D3D12FenceSource& operator=(const D3D12FenceSource& rhs) = delete;
+	~D3D12FenceSource();
+
+	virtual uint64_t GetCompletedValue()override;
+	virtual double WaitForValue(uint64_t value)override;
+
+private:
+	ID3D12Fence* mFence = nullptr;
+	HANDLE mEvent = nullptr;
+};
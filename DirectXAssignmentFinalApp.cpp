@@ -8,7 +8,29 @@
 #include "Common/UploadBuffer.h"
 #include "Common/GeometryGenerator.h"
 #include "FrameResource.h"
+#include "RenderItem.h"
+#include "FrustumCuller.h"
+#include "SceneBVH.h"
+#include "RenderView.h"
+#include "LightManager.h"
+#include "ShaderCache.h"
+#include "PipelineRegistry.h"
+#include "ResourceTracker.h"
+#include "BindlessTable.h"
+#include "HeadlessBench.h"
+#include "D3D12FenceSource.h"
+#include "TaskGraph.h"
+#include "TextureResidency.h"
+#include "TextureStreamer.h"
+#include "TexturePacker.h"
+#include "AssetIndex.h"
+#include "ResourceHeaps.h"
+#include "GeometryUploadBatcher.h"
 #include "Waves.h"
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <ppl.h>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -17,50 +39,24 @@ using namespace DirectX::PackedVector;
 #pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "D3D12.lib")
 
-const int gNumFrameResources = 3;
+// Depth of the frame resource ring.  Set from the command line (-frames N) before the
+// app is created, and fixed from then on.
+int gNumFrameResources = 3;
 
-// Lightweight structure stores parameters to draw a shape.  This will
-// vary from app-to-app.
-struct RenderItem
-{
-	RenderItem() = default;
-
-    // World matrix of the shape that describes the object's local space
-    // relative to the world space, which defines the position, orientation,
-    // and scale of the object in the world.
-    XMFLOAT4X4 World = MathHelper::Identity4x4();
-
-	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
-
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify obect data we should set
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
+// Upload memory for streamed textures, and how much of it one frame may fill.
+const UINT64 TextureStagingSize = 8 * 1024 * 1024;
+const UINT64 TextureUploadBudget = 4 * 1024 * 1024;
 
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
-	UINT ObjCBIndex = -1;
+// Video memory the streamed textures' mips may take (-texbudget MB overrides it), and
+// the size below which a texture's mips are loaded first and always kept.
+const UINT64 DefaultTextureBudget = 32 * 1024 * 1024;
+const UINT TextureTailSize = 64;
 
-	Material* Mat = nullptr;
-	MeshGeometry* Geo = nullptr;
-
-    // Primitive topology.
-    D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-
-    // DrawIndexedInstanced parameters.
-    UINT IndexCount = 0;
-    UINT StartIndexLocation = 0;
-    int BaseVertexLocation = 0;
-};
-
-	enum class RenderLayer : int
-	{
-		Opaque = 0,
-		Transparent,
-		AlphaTested,
-		AlphaTestedTreeSprites,
-		Count
-	};
+// Heaps the static meshes and the textures are placed in, and the pages of upload
+// memory their load-time copies are staged in.
+const UINT64 BufferHeapSize = 16 * 1024 * 1024;
+const UINT64 TextureHeapSize = 32 * 1024 * 1024;
+const UINT64 LoadUploadPageSize = 4 * 1024 * 1024;
 
 class DirectXAssignmentFinalApp : public D3DApp
 {
@@ -72,6 +68,16 @@ public:
 
     virtual bool Initialize()override;
 
+	// Waits for a free frame resource before sampling input rather than after, so the
+	// input drives a frame that starts right away.  Trades throughput for latency.
+	void SetLowLatency(bool lowLatency) { mLowLatency = lowLatency; }
+
+	// Splits the window between the main view and a second, overhead view.
+	void SetSplitScreen(bool splitScreen) { mSplitScreen = splitScreen; }
+
+	// Video memory the streamed textures' mips may take.
+	void SetTextureBudget(UINT64 bytes) { mTextureResidency.SetBudget(bytes); }
+
 private:
     virtual void OnResize()override;
     virtual void Update(const GameTimer& gt)override;
@@ -84,12 +90,29 @@ private:
     void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
-	void UpdateObjectCBs(const GameTimer& gt);
+	void UpdateInstanceData(const GameTimer& gt);
 	void UpdateMaterialCBs(const GameTimer& gt);
-	void UpdateMainPassCB(const GameTimer& gt);
+	void UpdatePassCBs(const GameTimer& gt);
+	void UpdateSceneLights(const GameTimer& gt);
+	void UpdateLightClusters(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void StepWaves(float dt, float totalTime);
+	void CullViews(const GameTimer& gt);
+	void Pick(int sx, int sy);
+	void WaitForFrameResource();
+	void PumpTextureStreaming();
+	void UpdateTextureResidency();
+	void TrackLoadedResources(UINT64 uploadFence);
+	void DropCpuCopies();
+	UINT64 ResourceBytes(ID3D12Resource* resource)const;
+	void BuildUpdateGraph();
 
 	void LoadTextures();
+	void LoadStaticTexture(Texture* tex);
+	const AssetIndex::Entry* FindIndexedTexture(const std::wstring& filename)const;
+	std::vector<std::vector<UINT>> PackTextureArrays(const std::vector<std::wstring>& filenames,
+		std::vector<std::wstring>& arrayFiles);
+	std::string PackedMemberStamp(const std::vector<std::wstring>& filenames, const std::vector<UINT>& members)const;
     void BuildRootSignature();
 	void BuildDescriptorHeaps();
     void BuildShadersAndInputLayouts();
@@ -98,11 +121,19 @@ private:
 	void BuildBoxGeometry();
 	void BuildSkullGeometry();
 	void BuildTreeSpritesGeometry();
+	void UploadStaticGeometry();
     void BuildPSOs();
+	void FinishPSOs();
     void BuildFrameResources();
     void BuildMaterials();
     void BuildRenderItems();
-    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void BuildSceneLights();
+	void BuildRenderViews();
+    void SetDrawState(ID3D12GraphicsCommandList* cmdList, const RenderView& view);
+    void DrawRenderItems(RenderView& view, UINT firstWorkerList);
+
+	// The first view is the one driven by input.
+	Camera& MainCamera() { return mViews[0]->Cam; }
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
@@ -115,17 +146,102 @@ private:
     FrameResource* mCurrFrameResource = nullptr;
     int mCurrFrameResourceIndex = 0;
 
+	// Picks the frame resource to use and waits for the GPU to release it.
+	FramePacer mFramePacer;
+	std::unique_ptr<D3D12FenceSource> mFenceSource;
+	bool mLowLatency = false;
+
+	// The per-frame update stages and their dependencies; see BuildUpdateGraph.
+	TaskGraph mUpdateGraph;
+
+	// Steps the wave simulation for the next frame while Draw records this one.
+	concurrency::task_group mWavesStep;
+
     UINT mCbvSrvDescriptorSize = 0;
 
     ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
-	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
-	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
-	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
-	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
-	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	// Declared ahead of the resources placed in them.  The upload arena only holds pages
+	// while the initialization commands are recorded.
+	std::unique_ptr<ResourceHeapPool> mBufferHeaps;
+	std::unique_ptr<ResourceHeapPool> mTextureHeaps;
+	std::unique_ptr<UploadArena> mLoadUploads;
+
+	// The vertices and indices of every static mesh; see UploadStaticGeometry.
+	ComPtr<ID3D12Resource> mStaticGeometry;
+
+	NameTable<std::unique_ptr<MeshGeometry>, GeometryTag> mGeometries;
+	NameTable<std::unique_ptr<Material>, MaterialTag> mMaterials;
+	NameTable<std::unique_ptr<Texture>, TextureTag> mTextures;
+	NameTable<ComPtr<ID3DBlob>, ShaderTag> mShaders;
+
+	// Memory held, by category, and upload heaps and replaced texture chains waiting
+	// for the GPU to finish with them.
+	ResourceTracker mResources;
+
+	// A streamed texture.  Its materials sample the placeholder until its first chain
+	// arrives, then the texture table slot that holds its current chain: first the slot
+	// of its ID, then one from mTextureTable for each reload.  Chains are reloaded with
+	// more or fewer mips as mTextureResidency decides; see UpdateTextureResidency.
+	struct StreamedTextureState
+	{
+		TextureId Id;
+		std::vector<Material*> Materials;
+
+		// Size of the file's most detailed mip, known from the asset index or once a chain
+		// has arrived.
+		UINT Width = 0;
+		UINT Height = 0;
+		UINT MipCount = 0;
+		uint32_t Residency = UINT32_MAX;
+
+		// Most detailed mip of the chain in Texture::Resource.
+		UINT LoadedMip = 0;
+		PlacedAllocation Allocation;
+		UINT Srv = 0;
+		bool Loading = true;
+		bool Failed = false;
+
+		// Frames up to this fence value may still sample the previous slot.
+		UINT64 SwapFence = 0;
+	};
+
+	// The staging buffer stays mapped while the streamer writes to it, so it is
+	// declared first and destroyed last.
+	ComPtr<ID3D12Resource> mTextureStaging;
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+	std::vector<StreamedTextureState> mStreamedTextures;
+	TextureResidency mTextureResidency{ DefaultTextureBudget };
+
+	// Textures/AssetIndex.bin, if there is one; see FindIndexedTexture.
+	AssetIndex mAssetIndex;
+
+	// Index into mStreamedTextures of each streamer request, and of each material's
+	// texture by MatCBIndex (-1 for none).
+	std::vector<UINT> mRequestTextures;
+	std::vector<int> mMaterialTextures;
+
+	// The texture, and its slice, that each texture ID is sampled from: itself, or the
+	// array it was packed into.  See PackTextureArrays.
+	struct TextureSlice
+	{
+		UINT Texture;
+		UINT Slice;
+	};
+	std::vector<TextureSlice> mTextureSlices;
+
+	TextureId mPlaceholderTexture;
+
+	// Slots of the one SRV table every texture is bound through: one per texture ID,
+	// and room for the reloaded chains of the streamed textures.
+	std::unique_ptr<BindlessTable> mTextureTable;
+
+	// Resolved once by BuildMaterials for the per-frame material animation.
+	MaterialId mWaterMaterial;
+	PipelineRegistry mPipelines;
+	PsoHandle mLayerPsoHandles[(int)RenderLayer::Count] = {};
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mStdInputLayout;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mTreeSpriteInputLayout;
@@ -138,9 +254,40 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+	// Hierarchy over the world bounds of mAllRitems; item i is mAllRitems[i].
+	SceneBVH mSceneBVH;
+
+	RenderItem* mPickedRitem = nullptr;
+
+	// The views drawn each frame, each with its own camera, visible set, draws and
+	// pass constants.  View i uses pass slot i.
+	std::vector<std::unique_ptr<RenderView>> mViews;
+	bool mSplitScreen = false;
+
+	// PSO of each render layer, indexed by RenderLayer.
+	ID3D12PipelineState* mLayerPSOs[(int)RenderLayer::Count] = {};
+
+	// Draw commands are recorded in chunks on worker threads, then replayed into the
+	// workers' command lists.  Each view has mDrawWorkerCount lists of its own.
+	UINT mDrawWorkerCount = 1;
+
 	std::unique_ptr<Waves> mWaves;
 
+	// Time and scene blocks shared by every view; each view fills its own view block.
     PassConstants mMainPassCB;
+	bool mSceneLightsChanged = false;
+
+	// All lights in the scene.  Directional lights are copied into mMainPassCB; point
+	// and spot lights are shaded through the light clusters, and their buffer is
+	// re-uploaded while mLocalLightsDirty counts down, as with NumFramesDirty.
+	static const UINT MaxLocalLights = 1024;
+	LightManager mLightManager{ MaxLocalLights };
+	UINT64 mDirectionalLightsVersion = 0;
+	UINT64 mLocalLightsVersion = 0;
+	int mLocalLightsDirty = 0;
+
+	// Pass constant bytes written by the last UpdatePassCBs.
+	UINT mPassBytesUploaded = 0;
 
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
@@ -150,8 +297,6 @@ private:
     float mPhi = XM_PIDIV2 - 0.1f;
     float mRadius = 50.0f;*/
 
-	Camera mCamera;
-
     POINT mLastMousePos;
 };
 
@@ -163,9 +308,48 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+    // Headless runs measure draw submission without creating a window or device.
+    int exitCode = 0;
+    if(HeadlessBench::RunFromCommandLine(cmdLine, exitCode))
+        return exitCode;
+
+    // -frames N sets the frame resource ring depth; -lowlatency waits before input;
+    // -splitscreen adds a second view; -texbudget MB caps the streamed textures' mips.
+    bool lowLatency = false;
+    bool splitScreen = false;
+    UINT64 textureBudget = DefaultTextureBudget;
+    std::istringstream args(cmdLine != nullptr ? cmdLine : "");
+    std::string arg;
+    while(args >> arg)
+    {
+        if(arg == "-frames")
+        {
+            int depth = 0;
+            if(args >> depth)
+                gNumFrameResources = std::max<int>(1, std::min<int>(depth, 8));
+        }
+        else if(arg == "-lowlatency")
+        {
+            lowLatency = true;
+        }
+        else if(arg == "-splitscreen")
+        {
+            splitScreen = true;
+        }
+        else if(arg == "-texbudget")
+        {
+            UINT64 megabytes = 0;
+            if(args >> megabytes)
+                textureBudget = megabytes * 1024 * 1024;
+        }
+    }
+
     try
     {
         DirectXAssignmentFinalApp theApp(hInstance);
+        theApp.SetLowLatency(lowLatency);
+        theApp.SetSplitScreen(splitScreen);
+        theApp.SetTextureBudget(textureBudget);
         if(!theApp.Initialize())
             return 0;
 
@@ -179,12 +363,14 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 }
 
 DirectXAssignmentFinalApp::DirectXAssignmentFinalApp(HINSTANCE hInstance)
-    : D3DApp(hInstance)
+    : D3DApp(hInstance), mFramePacer(gNumFrameResources)
 {
 }
 
 DirectXAssignmentFinalApp::~DirectXAssignmentFinalApp()
 {
+	mWavesStep.wait();
+
     if(md3dDevice != nullptr)
         FlushCommandQueue();
 }
@@ -194,6 +380,8 @@ bool DirectXAssignmentFinalApp::Initialize()
     if(!D3DApp::Initialize())
         return false;
 
+	mFenceSource = std::make_unique<D3D12FenceSource>(mFence.Get());
+
     // Reset the command list to prep for initialization commands.
     ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
@@ -201,32 +389,54 @@ bool DirectXAssignmentFinalApp::Initialize()
 	// so we have to query this information.
     mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-	mCamera.SetPosition(0.0f, 22.0f, -60.0f);
+	// One draw recording worker per core, capped where per-list overhead starts to win.
+	mDrawWorkerCount = std::max<UINT>(1, std::min<UINT>(std::thread::hardware_concurrency(), 8));
 
     mWaves = std::make_unique<Waves>(128, 128, 5.0f, 0.03f, 4.0f, 0.2f);
 
+	// Tier 1 heaps hold buffers or textures, not both.
+	mBufferHeaps = std::make_unique<ResourceHeapPool>(md3dDevice.Get(), D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, BufferHeapSize);
+	mTextureHeaps = std::make_unique<ResourceHeapPool>(md3dDevice.Get(), D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES, TextureHeapSize);
+	mLoadUploads = std::make_unique<UploadArena>(md3dDevice.Get(), LoadUploadPageSize);
+
 	LoadTextures();
     BuildRootSignature();
 	BuildDescriptorHeaps();
     BuildShadersAndInputLayouts();
+    BuildPSOs();
     BuildLandGeometry();
     BuildWavesGeometry();
 	BuildBoxGeometry();
 	BuildSkullGeometry();
 	BuildTreeSpritesGeometry();
+	UploadStaticGeometry();
 	BuildMaterials();
     BuildRenderItems();
+	BuildSceneLights();
+	BuildRenderViews();
     BuildFrameResources();
-    BuildPSOs();
+	BuildUpdateGraph();
+	FinishPSOs();
 
     // Execute the initialization commands.
     ThrowIfFailed(mCommandList->Close());
     ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
     mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 
+	// The copies just submitted complete with the fence value FlushCommandQueue signals.
+	TrackLoadedResources(mCurrentFence + 1);
+
     // Wait until initialization is complete.
     FlushCommandQueue();
 
+	// Nothing needs the load-time copies any more.
+	std::string report = "Memory after loading:\n" + mResources.Report() +
+		mBufferHeaps->Report("buffer heaps") + mTextureHeaps->Report("texture heaps");
+	DropCpuCopies();
+	mResources.Retire(mFence->GetCompletedValue());
+	report += "Memory once the load-time copies are released:\n" + mResources.Report();
+	::OutputDebugStringA(report.c_str());
+
     return true;
 }
 
@@ -238,33 +448,224 @@ void DirectXAssignmentFinalApp::OnResize()
 	/*
     XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
     XMStoreFloat4x4(&mProj, P);*/
-	mCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+	for(auto& view : mViews)
+		view->Resize(mClientWidth, mClientHeight);
 }
 
 void DirectXAssignmentFinalApp::Update(const GameTimer& gt)
 {
+	if(mLowLatency)
+		WaitForFrameResource();
+
     OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	UpdateSceneLights(gt);
+
+	if(!mLowLatency)
+		WaitForFrameResource();
+
+	mUpdateGraph.Run();
+
+	std::wostringstream pacing;
+	pacing.precision(2);
+	pacing << std::fixed << L"   cpu wait: " << mFramePacer.AverageWaitMs() << L" ms ("
+		<< (int)(100.0 * mFramePacer.WaitedFraction()) << L"% of frames, ring " << mFramePacer.Depth() << L")"
+		<< L"   pass bytes: " << mPassBytesUploaded
+		<< L"   light refs: " << mViews[0]->Clusters.GetLightIndices().size()
+		<< L"   texture MB: " << mTextureResidency.UsedBytes() / (1024.0 * 1024.0)
+		<< L"/" << mTextureResidency.Budget() / (1024.0 * 1024.0)
+		<< L"   memory MB: " << mResources.TotalBytes() / (1024.0 * 1024.0);
+	mRenderStatsText += pacing.str();
+}
 
-    // Cycle through the circular frame resource array.
-    mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
+void DirectXAssignmentFinalApp::BuildUpdateGraph()
+{
+	// gt is always mTimer, so the stages read it directly.  Stages without a declared
+	// dependency touch disjoint data and may run at the same time.
+	auto cull = mUpdateGraph.Add("cull", [this]() { CullViews(mTimer); });
+	auto animate = mUpdateGraph.Add("animateMaterials", [this]() { AnimateMaterials(mTimer); });
+
+	mUpdateGraph.Add("instanceData", [this]() { UpdateInstanceData(mTimer); }, { cull });
+	mUpdateGraph.Add("materialCBs", [this]() { UpdateMaterialCBs(mTimer); }, { animate });
+	mUpdateGraph.Add("passCB", [this]() { UpdatePassCBs(mTimer); });
+	mUpdateGraph.Add("lightClusters", [this]() { UpdateLightClusters(mTimer); }, { cull });
+	mUpdateGraph.Add("waves", [this]() { UpdateWaves(mTimer); });
+}
+
+void DirectXAssignmentFinalApp::WaitForFrameResource()
+{
+    // Cycle through the circular frame resource array.  If the GPU has not finished
+    // processing the commands of the next frame resource, this waits until it has.
+    mCurrFrameResourceIndex = mFramePacer.BeginFrame(*mFenceSource);
     mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
+}
 
-    // Has the GPU finished processing the commands of the current frame resource?
-    // If not, wait until the GPU has completed commands up to this fence point.
-    if(mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
-    {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
-    }
+void DirectXAssignmentFinalApp::UpdateTextureResidency()
+{
+	// Each visible item asks for the mip with about a texel per pixel across it.
+	for(auto& view : mViews)
+	{
+		XMVECTOR eye = view->Cam.GetPosition();
+		float pixelsPerUnit = view->Viewport.Height / (2.0f * tanf(0.5f * view->Cam.GetFovY()));
+
+		for(UINT i : view->VisibleItems)
+		{
+			const RenderItem* ri = mAllRitems[i].get();
+			int t = mMaterialTextures[ri->Mat->MatCBIndex];
+			if(t < 0 || mStreamedTextures[t].Residency == UINT32_MAX)
+				continue;
+
+			const StreamedTextureState& state = mStreamedTextures[t];
+			float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&ri->Bounds.Extents)));
+			float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&ri->Bounds.Center) - eye)) - radius;
+			distance = std::max<float>(distance, view->Cam.GetNearZ());
+
+			// Both the item's and the material's texture transforms tile the texture.
+			float texScale = std::max<float>(fabsf(ri->TexTransform._11), fabsf(ri->TexTransform._22)) *
+				std::max<float>(fabsf(ri->Mat->MatTransform._11), fabsf(ri->Mat->MatTransform._22));
+			float pixelsAcross = 2.0f * radius / distance * pixelsPerUnit;
+			mTextureResidency.Demand(state.Residency,
+				TextureResidency::DemandedMip(state.Width * texScale, pixelsAcross, state.MipCount));
+		}
+	}
+
+	mTextureResidency.Update(mCurrentFence + 1);
+
+	UINT64 completed = mFence->GetCompletedValue();
+
+	// Reload the chains that differ from what the residency settled on.  A texture
+	// holds at most two slots, so a reload waits for the frames still sampling the
+	// previous one.
+	for(size_t i = 0; i < mStreamedTextures.size(); ++i)
+	{
+		StreamedTextureState& state = mStreamedTextures[i];
+		if(state.Residency == UINT32_MAX || state.Loading || state.Failed || state.SwapFence > completed)
+			continue;
+
+		UINT mip = mTextureResidency.ResidentMip(state.Residency);
+		if(mip == state.LoadedMip)
+			continue;
+
+		size_t maxsize = std::max<size_t>(std::max<UINT>(state.Width >> mip, state.Height >> mip), 1);
+		mTextureStreamer->Request(mTextures[state.Id]->Filename, maxsize);
+		mRequestTextures.push_back((UINT)i);
+		state.Loading = true;
+	}
+}
 
-	AnimateMaterials(gt);
-	UpdateObjectCBs(gt);
-	UpdateMaterialCBs(gt);
-	UpdateMainPassCB(gt);
-    UpdateWaves(gt);
+void DirectXAssignmentFinalApp::PumpTextureStreaming()
+{
+	// Records the copies into mCommandList, which runs before this frame's draws, so a
+	// texture can be sampled the frame it arrives.
+	auto upload = [this](const StreamedTexture& streamed)
+	{
+		UINT index = mRequestTextures[streamed.Request];
+		StreamedTextureState& state = mStreamedTextures[index];
+		Texture* tex = mTextures[state.Id].get();
+		state.Loading = false;
+
+		if(streamed.Status != DDS::Status::Ok)
+		{
+			// Its materials keep the placeholder, or the chain they have.
+			std::string message = "Could not load " + tex->Name + "; keeping what is bound.\n";
+			::OutputDebugStringA(message.c_str());
+			state.Failed = true;
+			return;
+		}
+
+		// The first chain holds the tail the residency never drops.  An indexed texture
+		// joined the residency before it arrived.
+		bool first = tex->Resource == nullptr;
+		if(state.Residency == UINT32_MAX)
+		{
+			state.Width = streamed.Width << streamed.SkipMip;
+			state.Height = streamed.Height << streamed.SkipMip;
+			state.MipCount = streamed.MipCount + streamed.SkipMip;
+
+			std::vector<uint64_t> mipBytes(state.MipCount);
+			for(UINT m = 0; m < state.MipCount; ++m)
+			{
+				size_t numBytes = 0;
+				DDS::GetSurfaceInfo(std::max<UINT>(state.Width >> m, 1), std::max<UINT>(state.Height >> m, 1),
+					streamed.Format, &numBytes, nullptr, nullptr);
+				mipBytes[m] = (uint64_t)numBytes * std::max<UINT>(streamed.Depth >> m, 1) * streamed.ArraySize;
+			}
+			state.Residency = mTextureResidency.Add(mipBytes, streamed.SkipMip);
+		}
+
+		if(!first)
+		{
+			// This frame's material buffer was written before the chain arrived, so the
+			// frames up to and including this one sample the old chain and its slot.
+			mResources.ReleaseAfter(mCurrentFence + 1, tex->Resource, MemoryCategory::Textures, ResourceBytes(tex->Resource.Get()));
+			mTextureHeaps->Free(state.Allocation, mCurrentFence + 1);
+
+			UINT srv = mTextureTable->Allocate();
+			assert(srv != BindlessTable::InvalidSlot);
+			mTextureTable->Free(state.Srv, mCurrentFence + 1);
+			state.Srv = srv;
+			state.SwapFence = mCurrentFence + 1;
+		}
+		state.LoadedMip = streamed.SkipMip;
+
+		D3D12_RESOURCE_DESC texDesc = {};
+		texDesc.Dimension = (D3D12_RESOURCE_DIMENSION)streamed.Dimension;
+		texDesc.Width = streamed.Width;
+		texDesc.Height = streamed.Height;
+		texDesc.DepthOrArraySize = (UINT16)(streamed.Dimension == DDS::DimensionTexture3D ? streamed.Depth : streamed.ArraySize);
+		texDesc.MipLevels = (UINT16)streamed.MipCount;
+		texDesc.Format = streamed.Format;
+		texDesc.SampleDesc.Count = 1;
+		texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+		state.Allocation = mTextureHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_COPY_DEST, tex->Resource);
+		mResources.Track(MemoryCategory::Textures, ResourceBytes(tex->Resource.Get()));
+
+		for(UINT s = 0; s < (UINT)streamed.Subresources.size(); ++s)
+		{
+			const StagedSubresource& staged = streamed.Subresources[s];
+
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+			footprint.Offset = staged.Offset;
+			footprint.Footprint.Format = streamed.Format;
+			footprint.Footprint.Width = staged.Width;
+			footprint.Footprint.Height = staged.Height;
+			footprint.Footprint.Depth = staged.Depth;
+			footprint.Footprint.RowPitch = staged.RowPitch;
+
+			CD3DX12_TEXTURE_COPY_LOCATION dst(tex->Resource.Get(), s);
+			CD3DX12_TEXTURE_COPY_LOCATION src(mTextureStaging.Get(), footprint);
+			mCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+		}
+
+		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(tex->Resource.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = streamed.Format;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = -1;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = streamed.ArraySize;
+
+		md3dDevice->CreateShaderResourceView(tex->Resource.Get(), &srvDesc,
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
+				state.Srv, mCbvSrvDescriptorSize));
+
+		// The shaders read the slot from the material buffer, so every frame resource's
+		// copy needs the update.
+		for(Material* mat : state.Materials)
+		{
+			mat->DiffuseSrvHeapIndex = state.Srv;
+			mat->NumFramesDirty = gNumFrameResources;
+		}
+	};
+
+	// This frame's commands signal mCurrentFence + 1 once they complete.
+	mTextureStreamer->Pump(mFence->GetCompletedValue(), mCurrentFence + 1, TextureUploadBudget, upload);
 }
 
 void DirectXAssignmentFinalApp::Draw(const GameTimer& gt)
@@ -277,7 +678,17 @@ void DirectXAssignmentFinalApp::Draw(const GameTimer& gt)
 
     // A command list can be reset after it has been added to the command queue via ExecuteCommandList.
     // Reusing the command list reuses memory.
-    ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
+    ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mLayerPSOs[(int)RenderLayer::Opaque]));
+
+	// Frees the upload heaps, texture chains, their heap ranges and table slots the GPU
+	// is done with.
+	mResources.Retire(mFence->GetCompletedValue());
+	mTextureTable->Retire(mFence->GetCompletedValue());
+	mTextureHeaps->Retire(mFence->GetCompletedValue());
+
+	UpdateTextureResidency();
+	if(!mTextureStreamer->IsIdle())
+		PumpTextureStreaming();
 
     mCommandList->RSSetViewports(1, &mScreenViewport);
     mCommandList->RSSetScissorRects(1, &mScissorRect);
@@ -292,45 +703,49 @@ void DirectXAssignmentFinalApp::Draw(const GameTimer& gt)
     mCommandList->ClearRenderTargetView(CurrentBackBufferView(), (float*)&clearColor, 0, nullptr);
     mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-    // Specify the buffers we are going to render to.
-    mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
-
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-
-	auto passCB = mCurrFrameResource->PassCB->Resource();
-	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
-
-    DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+    // Done recording the clears; the draws go to the workers' command lists.
+    ThrowIfFailed(mCommandList->Close());
 
-	mCommandList->SetPipelineState(mPSOs["alphaTested"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTested]);
+	// This frame's wave solution is already in its vertex buffer, so the next step can
+	// run while the draws are recorded.  UpdateWaves waits for it next frame.
+	// The timer ticks again before the step may finish, so pass its values in.
+	float dt = gt.DeltaTime();
+	float totalTime = gt.TotalTime();
+	mWavesStep.run([this, dt, totalTime]() { StepWaves(dt, totalTime); });
 
-	mCommandList->SetPipelineState(mPSOs["treeSprites"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites]);
+	// Each view's sorted list runs through the layers in order and switches PSO as it
+	// goes.  View v records into worker lists [v*mDrawWorkerCount, (v+1)*mDrawWorkerCount).
+	for(size_t v = 0; v < mViews.size(); ++v)
+		DrawRenderItems(*mViews[v], (UINT)v * mDrawWorkerCount);
 
-	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
-	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
+	auto endCmdList = mCurrFrameResource->EndCmdList;
+	ThrowIfFailed(mCurrFrameResource->EndCmdListAlloc->Reset());
+	ThrowIfFailed(endCmdList->Reset(mCurrFrameResource->EndCmdListAlloc.Get(), nullptr));
 
     // Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+	endCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 
-    // Done recording commands.
-    ThrowIfFailed(mCommandList->Close());
+    ThrowIfFailed(endCmdList->Close());
 
-    // Add the command list to the queue for execution.
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+    // Submit the clears, every view's chunks in draw order and the final transition at once.
+    std::vector<ID3D12CommandList*> cmdsLists;
+    cmdsLists.push_back(mCommandList.Get());
+    for(size_t v = 0; v < mViews.size(); ++v)
+    {
+        for(UINT i = 0; i < mViews[v]->Recorder.ChunkCount(); ++i)
+            cmdsLists.push_back(mCurrFrameResource->WorkerCmdLists[v * mDrawWorkerCount + i].Get());
+    }
+    cmdsLists.push_back(endCmdList.Get());
+
+    mCommandQueue->ExecuteCommandLists((UINT)cmdsLists.size(), cmdsLists.data());
 
     // Swap the back and front buffers
     ThrowIfFailed(mSwapChain->Present(0, 0));
 	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
     // Advance the fence value to mark commands up to this fence point.
-    mCurrFrameResource->Fence = ++mCurrentFence;
+    mFramePacer.EndFrame(++mCurrentFence);
 
     // Add an instruction to the command queue to set a new fence point.
     // Because we are on the GPU timeline, the new fence point won't be
@@ -343,6 +758,9 @@ void DirectXAssignmentFinalApp::OnMouseDown(WPARAM btnState, int x, int y)
     mLastMousePos.x = x;
     mLastMousePos.y = y;
 
+	if((btnState & MK_RBUTTON) != 0)
+		Pick(x, y);
+
     SetCapture(mhMainWnd);
 }
 
@@ -366,8 +784,8 @@ void DirectXAssignmentFinalApp::OnMouseMove(WPARAM btnState, int x, int y)
         // Restrict the angle mPhi.
         mPhi = MathHelper::Clamp(mPhi, 0.1f, MathHelper::Pi - 0.1f);*/
 
-		mCamera.Pitch(dy);
-		mCamera.RotateY(dx);
+		MainCamera().Pitch(dy);
+		MainCamera().RotateY(dx);
     }
    /* else if((btnState & MK_RBUTTON) != 0)
     {
@@ -392,30 +810,30 @@ void DirectXAssignmentFinalApp::OnKeyboardInput(const GameTimer& gt)
 	const float dt = gt.DeltaTime();
 
 	if (GetAsyncKeyState('W') & 0x8000)
-		mCamera.Walk(20.0f*dt);
+		MainCamera().Walk(20.0f*dt);
 
 	if (GetAsyncKeyState('S') & 0x8000)
-		mCamera.Walk(-20.0f*dt);
+		MainCamera().Walk(-20.0f*dt);
 
 	if (GetAsyncKeyState('A') & 0x8000)
-		mCamera.Strafe(-20.0f*dt);
+		MainCamera().Strafe(-20.0f*dt);
 
 	if (GetAsyncKeyState('D') & 0x8000)
-		mCamera.Strafe(20.0f*dt);
+		MainCamera().Strafe(20.0f*dt);
 
 	if (GetAsyncKeyState('Q') & 0x8000)
 	{
 		float dr = XMConvertToRadians(0.5f*static_cast<float>(80.0f * dt));
-		mCamera.Roll(dr);
+		MainCamera().Roll(dr);
 	}
 
 	if (GetAsyncKeyState('E') & 0x8000)
 	{
 		float dr = XMConvertToRadians(0.5f*static_cast<float>(-80.0f * dt));
-		mCamera.Roll(dr);
+		MainCamera().Roll(dr);
 	}
 
-	mCamera.UpdateViewMatrix();
+	MainCamera().UpdateViewMatrix();
 
 }
 
@@ -434,12 +852,81 @@ void DirectXAssignmentFinalApp::UpdateCamera(const GameTimer& gt)
 
 	XMMATRIX view = XMMatrixLookAtLH(pos, target, up);
 	XMStoreFloat4x4(&mView, view);*/
+
+	// The update stages read the views' cameras concurrently, so settle them first.
+	for(auto& view : mViews)
+		view->Cam.UpdateViewMatrix();
+}
+
+void DirectXAssignmentFinalApp::CullViews(const GameTimer& gt)
+{
+	// Every view is culled in the same walk over the shared hierarchy.
+	const FrustumCuller* frustums[SceneBVH::MaxQueryViews];
+	for(size_t v = 0; v < mViews.size(); ++v)
+	{
+		RenderView& view = *mViews[v];
+		view.Frustum.SetFrustum(view.Cam.GetView(), view.Cam.GetProj());
+		frustums[v] = &view.Frustum;
+	}
+
+	std::vector<std::vector<UINT>> found(mViews.size());
+	mSceneBVH.QueryFrustums(frustums, (UINT)mViews.size(), found.data());
+
+	for(size_t v = 0; v < mViews.size(); ++v)
+	{
+		RenderView& view = *mViews[v];
+		view.VisibleItems.swap(found[v]);
+
+		for(auto& layer : view.VisibleLayers)
+			layer.clear();
+
+		for(UINT i : view.VisibleItems)
+		{
+			RenderItem* ri = mAllRitems[i].get();
+			view.VisibleLayers[(int)ri->Layer].push_back(ri);
+		}
+
+		view.Stats.Visible = (UINT)view.VisibleItems.size();
+		view.Stats.Culled = (UINT)mAllRitems.size() - view.Stats.Visible;
+	}
+
+	const CullStats& mainStats = mViews[0]->Stats;
+	mRenderStatsText = L"   visible: " + std::to_wstring(mainStats.Visible) +
+		L"   culled: " + std::to_wstring(mainStats.Culled);
+
+	if(mViews.size() > 1)
+		mRenderStatsText += L"   views: " + std::to_wstring(mViews.size());
+
+	if(mPickedRitem != nullptr)
+		mRenderStatsText += L"   picked: " + std::to_wstring(mPickedRitem->ObjCBIndex);
+}
+
+void DirectXAssignmentFinalApp::Pick(int sx, int sy)
+{
+	// Picking goes through the main view, which may cover only part of the window.
+	const D3D12_VIEWPORT& viewport = mViews[0]->Viewport;
+	XMFLOAT4X4 P = MainCamera().GetProj4x4f();
+
+	// Compute picking ray in view space.
+	float vx = (+2.0f*(sx - viewport.TopLeftX) / viewport.Width - 1.0f) / P(0, 0);
+	float vy = (-2.0f*(sy - viewport.TopLeftY) / viewport.Height + 1.0f) / P(1, 1);
+
+	// Transform the ray to world space.
+	XMMATRIX V = MainCamera().GetView();
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
+
+	XMVECTOR rayOrigin = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), invView);
+	XMVECTOR rayDir = XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView));
+
+	UINT item = 0;
+	float dist = 0.0f;
+	mPickedRitem = mSceneBVH.Raycast(rayOrigin, rayDir, item, dist) ? mAllRitems[item].get() : nullptr;
 }
 
 void DirectXAssignmentFinalApp::AnimateMaterials(const GameTimer& gt)
 {
 	// Scroll the water material texture coordinates.
-	auto waterMat = mMaterials["water"].get();
+	auto waterMat = mMaterials[mWaterMaterial].get();
 
 	float& tu = waterMat->MatTransform(3, 0);
 	float& tv = waterMat->MatTransform(3, 1);
@@ -460,49 +947,67 @@ void DirectXAssignmentFinalApp::AnimateMaterials(const GameTimer& gt)
 	waterMat->NumFramesDirty = gNumFrameResources;
 }
 
-void DirectXAssignmentFinalApp::UpdateObjectCBs(const GameTimer& gt)
+void DirectXAssignmentFinalApp::UpdateInstanceData(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for(auto& e : mAllRitems)
+	// The set of visible items changes with the camera, so the instance buffer is
+	// rewritten every frame rather than tracked with dirty flags.  Each view owns its
+	// own range of the buffer, so the views are batched side by side.
+	auto currInstanceBuffer = mCurrFrameResource->InstanceBuffer.get();
+	concurrency::parallel_for(size_t(0), mViews.size(), [&](size_t v)
 	{
-		// Only update the cbuffer data if the constants have changed.
-		// This needs to be tracked per frame resource.
-		if(e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+		RenderView& view = *mViews[v];
+		view.Batcher.Build(view.VisibleLayers);
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+		const auto& instances = view.Batcher.GetInstances();
+		for(size_t i = 0; i < instances.size(); ++i)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&instances[i]->World);
+			XMMATRIX texTransform = XMLoadFloat4x4(&instances[i]->TexTransform);
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+			InstanceData data;
+			XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
+			XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
+			currInstanceBuffer->CopyData(view.InstanceBase + (int)i, data);
 		}
+
+		view.Sorter.Sort(view.Batcher, view.Cam.GetView(), view.Cam.GetFarZ());
+	});
+
+	// Draw runs after Update, so the state change count is the previous frame's.
+	UINT draws = 0;
+	UINT stateChanges = 0;
+	for(auto& view : mViews)
+	{
+		draws += view->Batcher.DrawCount();
+		stateChanges += view->StateChanges;
 	}
+
+	mRenderStatsText += L"   draws: " + std::to_wstring(draws) +
+		L"   state changes: " + std::to_wstring(stateChanges);
 }
 
 void DirectXAssignmentFinalApp::UpdateMaterialCBs(const GameTimer& gt)
 {
-	auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
-	for(auto& e : mMaterials)
+	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
+	for(auto& m : mMaterials)
 	{
 		// Only update the cbuffer data if the constants have changed.  If the cbuffer
 		// data changes, it needs to be updated for each FrameResource.
-		Material* mat = e.second.get();
+		Material* mat = m.get();
 		if(mat->NumFramesDirty > 0)
 		{
 			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
 
-			MaterialConstants matConstants;
-			matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matConstants.FresnelR0 = mat->FresnelR0;
-			matConstants.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matConstants.MatTransform, XMMatrixTranspose(matTransform));
+			MaterialData matData;
+			matData.DiffuseAlbedo = mat->DiffuseAlbedo;
+			matData.FresnelR0 = mat->FresnelR0;
+			matData.Roughness = mat->Roughness;
+			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+			matData.DiffuseSlice = mat->DiffuseSlice;
 
-			currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
+			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
 
 			// Next FrameResource need to be updated too.
 			mat->NumFramesDirty--;
@@ -510,109 +1015,157 @@ void DirectXAssignmentFinalApp::UpdateMaterialCBs(const GameTimer& gt)
 	}
 }
 
-void DirectXAssignmentFinalApp::UpdateMainPassCB(const GameTimer& gt)
+void DirectXAssignmentFinalApp::UpdatePassCBs(const GameTimer& gt)
 {
-	/*XMMATRIX view = XMLoadFloat4x4(&mView);
-	XMMATRIX proj = XMLoadFloat4x4(&mProj);*/
-
-	XMMATRIX view = mCamera.GetView();
-	XMMATRIX proj = mCamera.GetProj();
-
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
-
-	XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view));
-	XMStoreFloat4x4(&mMainPassCB.InvView, XMMatrixTranspose(invView));
-	XMStoreFloat4x4(&mMainPassCB.Proj, XMMatrixTranspose(proj));
-	XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
-	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
-	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
-	mMainPassCB.EyePosW = mCamera.GetPosition3f();
-	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
-	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
-	mMainPassCB.NearZ = 1.0f;
-	mMainPassCB.FarZ = 1000.0f;
+	// The time and scene blocks are shared by all views.  Time stays put while the
+	// timer is paused.
+	bool timeChanged = mMainPassCB.TotalTime != gt.TotalTime() || mMainPassCB.DeltaTime != gt.DeltaTime();
 	mMainPassCB.TotalTime = gt.TotalTime();
 	mMainPassCB.DeltaTime = gt.DeltaTime();
 
-	mMainPassCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
+	bool sceneChanged = mSceneLightsChanged;
+	mSceneLightsChanged = false;
 
-	//inner castle light
-	mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
-	mMainPassCB.Lights[0].Strength = { 0.6f, 0.6f, 0.6f };
-	//mMainPassCB.Lights[0].Strength = { 0.0f, 0.0f, 0.0f };
+	auto currPassCB = mCurrFrameResource->PassCB.get();
+	mPassBytesUploaded = 0;
 
-	//Directional Light
-	mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
-	mMainPassCB.Lights[1].Strength = { 0.3f, 0.3f, 0.3f };
-	//mMainPassCB.Lights[1].Strength = { 0.0f, 0.0f, 0.0f };
+	for(auto& v : mViews)
+	{
+		RenderView& view = *v;
 
+		XMFLOAT4X4 view4x4 = view.Cam.GetView4x4f();
+		XMFLOAT4X4 proj4x4 = view.Cam.GetProj4x4f();
 
-	//Directional Light  Red
-	mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
-	mMainPassCB.Lights[2].Strength = { 1.0f, -0.5f, -0.55f };
-	//mMainPassCB.Lights[2].Strength = { 0.0f, -0.0f, -0.0f };
+		// The view block only changes when the camera moves or the window is resized.
+		if(memcmp(&view4x4, &view.PassViewMatrix, sizeof(XMFLOAT4X4)) != 0 ||
+		   memcmp(&proj4x4, &view.PassProjMatrix, sizeof(XMFLOAT4X4)) != 0 ||
+		   mClientWidth != view.PassWidth || mClientHeight != view.PassHeight)
+		{
+			view.PassViewMatrix = view4x4;
+			view.PassProjMatrix = proj4x4;
+			view.PassWidth = mClientWidth;
+			view.PassHeight = mClientHeight;
+
+			XMMATRIX viewMatrix = XMLoadFloat4x4(&view4x4);
+			XMMATRIX proj = XMLoadFloat4x4(&proj4x4);
+
+			// The view is a rotation plus a translation and the projection a plain
+			// perspective, so both invert in closed form; (V*P)^-1 = P^-1 * V^-1.
+			XMMATRIX viewProj = XMMatrixMultiply(viewMatrix, proj);
+			XMMATRIX invView = MathHelper::InverseRigid(viewMatrix);
+			XMMATRIX invProj = MathHelper::InversePerspective(proj);
+			XMMATRIX invViewProj = XMMatrixMultiply(invProj, invView);
+
+			PassConstants& pass = view.Pass;
+			XMStoreFloat4x4(&pass.View, XMMatrixTranspose(viewMatrix));
+			XMStoreFloat4x4(&pass.InvView, XMMatrixTranspose(invView));
+			XMStoreFloat4x4(&pass.Proj, XMMatrixTranspose(proj));
+			XMStoreFloat4x4(&pass.InvProj, XMMatrixTranspose(invProj));
+			XMStoreFloat4x4(&pass.ViewProj, XMMatrixTranspose(viewProj));
+			XMStoreFloat4x4(&pass.InvViewProj, XMMatrixTranspose(invViewProj));
+			pass.EyePosW = view.Cam.GetPosition3f();
+			pass.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
+			pass.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
+			pass.NearZ = view.Cam.GetNearZ();
+			pass.FarZ = view.Cam.GetFarZ();
+
+			view.PassBlockDirty[(int)PassBlock::View] = gNumFrameResources;
+		}
 
+		if(timeChanged)
+			view.PassBlockDirty[(int)PassBlock::Time] = gNumFrameResources;
 
-	//Point light //blue Skull
-	mMainPassCB.Lights[3].Position = { 0.0f, 29.5f, -2.0f };
-	mMainPassCB.Lights[3].FalloffStart = 0.0f;
-	mMainPassCB.Lights[3].Strength = { 0.0f, 0.0f, 4.0f };
-	//mMainPassCB.Lights[3].Strength = { 0.0f, 0.0f, 0.0f };
-	mMainPassCB.Lights[3].FalloffEnd = 10.f;
+		if(sceneChanged)
+			view.PassBlockDirty[(int)PassBlock::Scene] = gNumFrameResources;
 
-	//Point light Sun
-	mMainPassCB.Lights[4].Position = { -20.7f, 50.0f, 30.0 };
-	mMainPassCB.Lights[4].FalloffStart = 0.0f;
-	mMainPassCB.Lights[4].Strength = { 0.93f*2.f, 0.99f*2.f, 4.f };
-	//mMainPassCB.Lights[4].Strength = { 0.0f, 0.0f, 0.f };
-	mMainPassCB.Lights[4].FalloffEnd = 10.f;
-
-	////5
-	mMainPassCB.Lights[5].Position = { 5.0f, 14.5f, 8.0f };
-	mMainPassCB.Lights[5].FalloffStart = 0.0f;
-	mMainPassCB.Lights[5].Strength = { 0.0f, 0.0f, 4.0f };
-	mMainPassCB.Lights[5].FalloffEnd = 10.f;
+		// Only upload the blocks this frame resource has not seen yet.
+		for(int i = 0; i < (int)PassBlock::Count; ++i)
+		{
+			if(view.PassBlockDirty[i] > 0)
+			{
+				const PassConstants& source = (PassBlock)i == PassBlock::View ? view.Pass : mMainPassCB;
+				PassBlockRange range = GetPassBlockRange((PassBlock)i);
+				currPassCB->CopyData(view.PassIndex, source, range.Offset, range.Size);
+				mPassBytesUploaded += range.Size;
+
+				// Next FrameResource need to be updated too.
+				view.PassBlockDirty[i]--;
+			}
+		}
+	}
+}
 
-	//
-	////Spot light On Left Tower Front
-	mMainPassCB.Lights[5].FalloffStart = 0.0f;
-	mMainPassCB.Lights[5].Strength = { 2.0f, 2.0f, 2.0f };
-	//mMainPassCB.Lights[5].Strength = { 0.0f, 0.0f, 0.0f };
-	mMainPassCB.Lights[5].FalloffEnd = 10.f;
-	mMainPassCB.Lights[5].Direction = { -26.0f, 0.0f, -75.0f };
-	mMainPassCB.Lights[5].SpotPower = 0.8f;
-	mMainPassCB.Lights[5].Position = { -3.f, 17.0f, -17.f };
+void DirectXAssignmentFinalApp::UpdateSceneLights(const GameTimer& gt)
+{
+	// Lights may have been created, changed or removed since the last frame.  This runs
+	// before the update graph, so the stages see a settled light set.
+	if(mLightManager.DirectionalVersion() != mDirectionalLightsVersion)
+	{
+		mDirectionalLightsVersion = mLightManager.DirectionalVersion();
 
-	////Spot light On right Tower 
-	mMainPassCB.Lights[6].FalloffStart = 0.0f;
-	mMainPassCB.Lights[6].Strength = { 1.3f, 1.3f, 1.3f };
-	//mMainPassCB.Lights[6].Strength = { 0.0f, 0.0f, 0.0f };
-	mMainPassCB.Lights[6].FalloffEnd = 10.f;
-	mMainPassCB.Lights[6].Direction = { 15.0f, 0.0f, -17.0f };
-	mMainPassCB.Lights[6].SpotPower = 1.0f;
-	mMainPassCB.Lights[6].Position = { 7.0f, 17.0f, 0.f };
+		const auto& directional = mLightManager.GetDirectionalLights();
+		for(UINT i = 0; i < LightManager::MaxDirectionalLights; ++i)
+		{
+			Light off;
+			off.Strength = { 0.0f, 0.0f, 0.0f };
+			mMainPassCB.Lights[i] = i < directional.size() ? directional[i] : off;
+		}
 
-	////Spot light On Left Tower
-	mMainPassCB.Lights[7].FalloffStart = 0.0f;
-	mMainPassCB.Lights[7].Strength = { 1.3f, 1.3f, 1.3f };
-	//mMainPassCB.Lights[7].Strength = { 0.0f, 0.0f, 0.0f };
-	mMainPassCB.Lights[7].FalloffEnd = 10.f;
-	mMainPassCB.Lights[7].Direction = { -15.0f, 0.0f, -17.0f };
-	mMainPassCB.Lights[7].SpotPower = 1.0f;
-	mMainPassCB.Lights[7].Position = { -7.0f, 17.0f, 0.f };
+		mSceneLightsChanged = true;
+	}
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
+	if(mLightManager.LocalVersion() != mLocalLightsVersion)
+	{
+		mLocalLightsVersion = mLightManager.LocalVersion();
+		mLocalLightsDirty = gNumFrameResources;
+		mLightManager.UpdateGrid();
+	}
 }
 
-void DirectXAssignmentFinalApp::UpdateWaves(const GameTimer& gt)
+void DirectXAssignmentFinalApp::UpdateLightClusters(const GameTimer& gt)
+{
+	const auto& localLights = mLightManager.GetLocalLights();
+
+	auto currFrame = mCurrFrameResource;
+	if(mLocalLightsDirty > 0 && !localLights.empty())
+	{
+		currFrame->LocalLights->CopyData(0, localLights.data(), (UINT)localLights.size());
+
+		// Next FrameResource need to be updated too.
+		mLocalLightsDirty--;
+	}
+
+	// The clusters are cut from each view's frustum, so every view bins the lights
+	// itself, and again whenever its camera moves; in practice, every frame.  Only the
+	// lights the grid finds in the view's frustum (set by the cull stage) are binned.
+	concurrency::parallel_for(size_t(0), mViews.size(), [&](size_t v)
+	{
+		RenderView& view = *mViews[v];
+		LightClusterer& clusters = view.Clusters;
+
+		view.LightCandidates.clear();
+		mLightManager.QueryFrustum(view.Frustum, view.LightCandidates);
+
+		clusters.SetProjection(view.Cam.GetFovY(), view.Cam.GetAspect(), view.Cam.GetNearZ(), view.Cam.GetFarZ());
+		clusters.Build(localLights, view.LightCandidates, view.Cam.GetView4x4f());
+
+		const auto& ranges = clusters.GetRanges();
+		const auto& indices = clusters.GetLightIndices();
+		currFrame->ClusterRanges->CopyData(view.PassIndex * LightClusterer::ClusterCount,
+			ranges.data(), (UINT)ranges.size());
+		if(!indices.empty())
+		{
+			currFrame->ClusterLightIndices->CopyData(view.PassIndex * LightClusterer::MaxLightIndices,
+				indices.data(), (UINT)indices.size());
+		}
+	});
+}
+
+void DirectXAssignmentFinalApp::StepWaves(float dt, float totalTime)
 {
 	// Every quarter second, generate a random wave.
 	static float t_base = 0.0f;
-	if((mTimer.TotalTime() - t_base) >= 0.25f)
+	if((totalTime - t_base) >= 0.25f)
 	{
 		t_base += 0.25f;
 
@@ -625,7 +1178,13 @@ void DirectXAssignmentFinalApp::UpdateWaves(const GameTimer& gt)
 	}
 
 	// Update the wave simulation.
-	mWaves->Update(gt.DeltaTime());
+	mWaves->Update(dt);
+}
+
+void DirectXAssignmentFinalApp::UpdateWaves(const GameTimer& gt)
+{
+	// The step launched by the previous Draw must be done before its solution is read.
+	mWavesStep.wait();
 
 	// Update the wave vertex buffer with the new solution.
 	auto currWavesVB = mCurrFrameResource->WavesVB.get();
@@ -650,107 +1209,373 @@ void DirectXAssignmentFinalApp::UpdateWaves(const GameTimer& gt)
 
 void DirectXAssignmentFinalApp::LoadTextures()
 {
-	auto grassTex = std::make_unique<Texture>();
-	grassTex->Name = "grassTex";
-	grassTex->Filename = L"Textures/grass.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), grassTex->Filename.c_str(),
-		grassTex->Resource, grassTex->UploadHeap));
-
-	auto waterTex = std::make_unique<Texture>();
-	waterTex->Name = "waterTex";
-	waterTex->Filename = L"Textures/water1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), waterTex->Filename.c_str(),
-		waterTex->Resource, waterTex->UploadHeap));
-
-	auto fenceTex = std::make_unique<Texture>();
-	fenceTex->Name = "fenceTex";
-	fenceTex->Filename = L"Textures/mossy.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), fenceTex->Filename.c_str(),
-		fenceTex->Resource, fenceTex->UploadHeap));
-
-	auto bricksTex = std::make_unique<Texture>();
-	bricksTex->Name = "bricksTex";
-	bricksTex->Filename = L"Textures/bricks3.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), bricksTex->Filename.c_str(),
-		bricksTex->Resource, bricksTex->UploadHeap));
-
-	auto iceTex = std::make_unique<Texture>();
-	iceTex->Name = "iceTex";
-	iceTex->Filename = L"Textures/ice.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), iceTex->Filename.c_str(),
-		iceTex->Resource, iceTex->UploadHeap));
-
-	auto stoneTex = std::make_unique<Texture>();
-	stoneTex->Name = "stoneTex";
-	stoneTex->Filename = L"Textures/stone.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), stoneTex->Filename.c_str(),
-		stoneTex->Resource, stoneTex->UploadHeap));
-
-	auto pyramidTex = std::make_unique<Texture>();
-	pyramidTex->Name = "pyramidTex";
-	pyramidTex->Filename = L"Textures/pyramid.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), pyramidTex->Filename.c_str(),
-		pyramidTex->Resource, pyramidTex->UploadHeap));
-
-	auto sunTex = std::make_unique<Texture>();//777
-	sunTex->Name = "sunTex";
-	sunTex->Filename = L"Textures/sun.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), sunTex->Filename.c_str(),
-		sunTex->Resource, sunTex->UploadHeap));
-
-	auto mossyTex = std::make_unique<Texture>();
-	mossyTex->Name = "mossyTex";
-	mossyTex->Filename = L"Textures/mossy.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), mossyTex->Filename.c_str(),
-		mossyTex->Resource, mossyTex->UploadHeap));
-
-	auto treeArrayTex = std::make_unique<Texture>();
-	treeArrayTex->Name = "treeArrayTex";
-	treeArrayTex->Filename = L"Textures/treeArray2.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), treeArrayTex->Filename.c_str(),
-		treeArrayTex->Resource, treeArrayTex->UploadHeap));
-
-
-	mTextures[grassTex->Name] = std::move(grassTex);
-	mTextures[waterTex->Name] = std::move(waterTex);
-	mTextures[fenceTex->Name] = std::move(fenceTex);
-	mTextures[bricksTex->Name] = std::move(bricksTex);
-	mTextures[iceTex->Name] = std::move(iceTex);
-	mTextures[stoneTex->Name] = std::move(stoneTex);
-	mTextures[pyramidTex->Name] = std::move(pyramidTex);
-	mTextures[sunTex->Name] = std::move(sunTex);
-	mTextures[mossyTex->Name] = std::move(mossyTex);
-	mTextures[treeArrayTex->Name] = std::move(treeArrayTex);
+	// The scene's textures stream in over the first frames, their small mips first; see
+	// PumpTextureStreaming.  They are added first so each one's ID is also its SRV slot.
+	struct StreamedFile
+	{
+		const char* Name;
+		const wchar_t* Filename;
+	};
+	const StreamedFile streamedFiles[] =
+	{
+		{ "grassTex", L"Textures/grass.dds" },
+		{ "waterTex", L"Textures/water1.dds" },
+		{ "fenceTex", L"Textures/mossy.dds" },
+		{ "bricksTex", L"Textures/bricks3.dds" },
+		{ "iceTex", L"Textures/ice.dds" },
+		{ "stoneTex", L"Textures/stone.dds" },
+		{ "pyramidTex", L"Textures/pyramid.dds" },
+		{ "sunTex", L"Textures/sun.dds" },
+		{ "mossyTex", L"Textures/mossy.dds" },
+		{ "treeArrayTex", L"Textures/treeArray2.dds" },
+	};
+
+	// Persistently mapped, like the frame resources' upload buffers.
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(TextureStagingSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mTextureStaging)));
+
+	uint8_t* staging = nullptr;
+	ThrowIfFailed(mTextureStaging->Map(0, nullptr, reinterpret_cast<void**>(&staging)));
+	mTextureStreamer = std::make_unique<TextureStreamer>(staging, TextureStagingSize);
+
+	// Tools/AssetIndexer.cpp writes the index.  Without one, every file is opened to read
+	// its header, as before.
+	DDS::MappedFile indexFile;
+	if(indexFile.Open(L"Textures/AssetIndex.bin"))
+		mAssetIndex.Read(indexFile.Data(), indexFile.Size());
+
+	// indexed describes one of slices identical slices of the texture, if the index has it.
+	auto stream = [this](std::unique_ptr<Texture> tex, const AssetIndex::Entry* indexed, UINT slices)
+	{
+		mTextureStreamer->Request(tex->Filename, TextureTailSize);
+		mRequestTextures.push_back((UINT)mStreamedTextures.size());
+
+		// Joins the residency now, so the frames before it arrives already ask for mips.
+		StreamedTextureState state;
+		if(indexed != nullptr)
+		{
+			std::vector<uint64_t> mipBytes = indexed->MipBytes();
+			for(uint64_t& bytes : mipBytes)
+				bytes *= slices;
+
+			state.Width = indexed->Width;
+			state.Height = indexed->Height;
+			state.MipCount = (UINT)indexed->Mips.size();
+			state.Residency = mTextureResidency.Add(mipBytes, indexed->SkipMip(TextureTailSize));
+		}
+
+		state.Id = mTextures.Add(tex->Name, std::move(tex));
+		mStreamedTextures.push_back(state);
+		mTextureSlices.push_back({ state.Id.Index, 0 });
+	};
+
+	// Textures that can share an array stream as one, so their materials share a
+	// descriptor table.  The others stream from their own files.
+	std::vector<std::wstring> filenames;
+	for(const StreamedFile& file : streamedFiles)
+		filenames.push_back(file.Filename);
+
+	std::vector<std::wstring> arrayFiles;
+	std::vector<std::vector<UINT>> arrays = PackTextureArrays(filenames, arrayFiles);
+
+	std::vector<uint8_t> packed(filenames.size(), 0);
+	for(const std::vector<UINT>& members : arrays)
+	{
+		for(UINT i : members)
+			packed[i] = 1;
+	}
+
+	for(UINT i = 0; i < (UINT)filenames.size(); ++i)
+	{
+		auto tex = std::make_unique<Texture>();
+		tex->Name = streamedFiles[i].Name;
+		tex->Filename = streamedFiles[i].Filename;
+
+		if(!packed[i])
+		{
+			stream(std::move(tex), FindIndexedTexture(streamedFiles[i].Filename), 1);
+			continue;
+		}
+
+		// Keeps its ID, for the materials that name it, but never gets a resource.
+		TextureId id = mTextures.Add(tex->Name, std::move(tex));
+		mTextureSlices.push_back({ id.Index, 0 });
+	}
+
+	for(size_t a = 0; a < arrays.size(); ++a)
+	{
+		auto tex = std::make_unique<Texture>();
+		tex->Name = "packedTex" + std::to_string(a);
+		tex->Filename = arrayFiles[a];
+		stream(std::move(tex), FindIndexedTexture(filenames[arrays[a][0]]), (UINT)arrays[a].size());
+
+		for(UINT s = 0; s < (UINT)arrays[a].size(); ++s)
+			mTextureSlices[arrays[a][s]] = { mStreamedTextures.back().Id.Index, s };
+	}
+
+	// Loaded now, with the initialization commands, and bound until the others arrive.
+	auto whiteTex = std::make_unique<Texture>();
+	whiteTex->Name = "whiteTex";
+	whiteTex->Filename = L"Textures/white1x1.dds";
+	LoadStaticTexture(whiteTex.get());
+
+	mPlaceholderTexture = mTextures.Add(whiteTex->Name, std::move(whiteTex));
+	mTextureSlices.push_back({ mPlaceholderTexture.Index, 0 });
+
+	// On an empty table slots come out in order, so each texture's slot is its ID.  A
+	// reload may arrive before the slot it replaces has been retired, so each streamed
+	// texture gets room for two more.
+	mTextureTable = std::make_unique<BindlessTable>(mTextures.Count() + 2 * (UINT)mStreamedTextures.size());
+	for(UINT i = 0; i < mTextures.Count(); ++i)
+		mTextureTable->Allocate();
+	for(StreamedTextureState& state : mStreamedTextures)
+		state.Srv = state.Id.Index;
+}
+
+void DirectXAssignmentFinalApp::LoadStaticTexture(Texture* tex)
+{
+	// Placed in the texture heaps and copied from the load-time upload arena with the
+	// initialization commands.
+	DDS::MappedFile file;
+	HRESULT hr = file.Open(tex->Filename.c_str()) ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+	ThrowIfFailed(hr);
+
+	DDS::Image image;
+	DDS::SubresourceLayout layout;
+	DDS::Status status = DDS::ParseHeader(file.Data(), file.Size(), image);
+	if(status == DDS::Status::Ok)
+		status = DDS::GetSubresources(image, 0, layout);
+	hr = status == DDS::Status::Ok ? S_OK : HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+	ThrowIfFailed(hr);
+
+	D3D12_RESOURCE_DESC texDesc = {};
+	texDesc.Dimension = (D3D12_RESOURCE_DIMENSION)image.Dimension;
+	texDesc.Width = layout.Width;
+	texDesc.Height = (UINT)layout.Height;
+	texDesc.DepthOrArraySize = (UINT16)(image.Dimension == DDS::DimensionTexture3D ? layout.Depth : image.ArraySize);
+	texDesc.MipLevels = (UINT16)layout.MipCount;
+	texDesc.Format = image.Format;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	// Never freed, so the allocation is not kept.
+	mTextureHeaps->CreateResource(texDesc, D3D12_RESOURCE_STATE_COPY_DEST, tex->Resource);
+
+	UINT subresourceCount = (UINT)layout.Subresources.size();
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(subresourceCount);
+	std::vector<UINT> rowCounts(subresourceCount);
+	std::vector<UINT64> rowBytes(subresourceCount);
+	UINT64 totalBytes = 0;
+	md3dDevice->GetCopyableFootprints(&texDesc, 0, subresourceCount, 0,
+		footprints.data(), rowCounts.data(), rowBytes.data(), &totalBytes);
+
+	UploadArena::Region staging = mLoadUploads->Allocate(totalBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	for(UINT s = 0; s < subresourceCount; ++s)
+	{
+		const DDS::Subresource& source = layout.Subresources[s];
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = footprints[s];
+		for(UINT z = 0; z < footprint.Footprint.Depth; ++z)
+		{
+			for(UINT row = 0; row < rowCounts[s]; ++row)
+			{
+				memcpy(staging.Data + footprint.Offset + (z * rowCounts[s] + row) * (UINT64)footprint.Footprint.RowPitch,
+					(const uint8_t*)source.Data + z * source.SlicePitch + row * source.RowPitch, (size_t)rowBytes[s]);
+			}
+		}
+
+		footprint.Offset += staging.Offset;
+		CD3DX12_TEXTURE_COPY_LOCATION dst(tex->Resource.Get(), s);
+		CD3DX12_TEXTURE_COPY_LOCATION src(staging.Resource, footprint);
+		mCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+
+	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(tex->Resource.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+}
+
+const AssetIndex::Entry* DirectXAssignmentFinalApp::FindIndexedTexture(const std::wstring& filename)const
+{
+	// The index names files by the paths the app uses, which are ASCII.
+	std::string name;
+	for(wchar_t c : filename)
+		name.push_back(c == L'\\' ? '/' : (char)c);
+
+	const AssetIndex::Entry* entry = mAssetIndex.Find(name);
+	if(entry == nullptr)
+		return nullptr;
+
+	// A file edited since the index was written is read directly.  Comparing sizes
+	// catches most edits without reading the file to hash it.
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if(!GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &attributes) ||
+	   (((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow) != entry->FileSize)
+		return nullptr;
+
+	return entry;
+}
+
+std::vector<std::vector<UINT>> DirectXAssignmentFinalApp::PackTextureArrays(const std::vector<std::wstring>& filenames,
+	std::vector<std::wstring>& arrayFiles)
+{
+	// Only the headers are read here, from the asset index where it has them.  A file
+	// that will not open or parse is left for the streamer to report, and a file named
+	// twice is only considered once.
+	std::vector<std::unique_ptr<DDS::MappedFile>> files;
+	std::vector<DDS::Image> images;
+	std::vector<UINT> fileIndices;
+	for(UINT i = 0; i < (UINT)filenames.size(); ++i)
+	{
+		if(std::find(filenames.begin(), filenames.begin() + i, filenames[i]) != filenames.begin() + i)
+			continue;
+
+		if(const AssetIndex::Entry* entry = FindIndexedTexture(filenames[i]))
+		{
+			images.push_back(entry->AsImage());
+			fileIndices.push_back(i);
+			continue;
+		}
+
+		auto file = std::make_unique<DDS::MappedFile>();
+		DDS::Image image;
+		if(!file->Open(filenames[i].c_str()) ||
+		   DDS::ParseHeader(file->Data(), file->Size(), image) != DDS::Status::Ok)
+			continue;
+
+		files.push_back(std::move(file));
+		images.push_back(image);
+		fileIndices.push_back(i);
+	}
+
+	std::vector<std::vector<UINT>> arrays;
+	CreateDirectoryW(L"Textures/Packed", nullptr);
+
+	for(const std::vector<uint32_t>& group : TexturePacker::ArrayGroups(images))
+	{
+		// Named after its members, and packed again whenever one of them has changed
+		// size or been written since, as recorded in the stamp file beside it.
+		std::wstring arrayFile = L"Textures/Packed/";
+		std::vector<DDS::Image> slices;
+		std::vector<UINT> members;
+		for(uint32_t g : group)
+		{
+			const std::wstring& filename = filenames[fileIndices[g]];
+			size_t start = filename.find_last_of(L"/\\") + 1;
+			size_t end = filename.find_last_of(L'.');
+			arrayFile += (members.empty() ? L"" : L"+") + filename.substr(start, end - start);
+
+			slices.push_back(images[g]);
+			members.push_back(fileIndices[g]);
+		}
+		arrayFile += L".dds";
+
+		std::wstring stampFile = arrayFile + L".stamp";
+		std::string stamp = PackedMemberStamp(filenames, members);
+		std::string packedStamp;
+		{
+			std::ifstream in(stampFile, std::ios::binary);
+			packedStamp.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+
+		if(stamp.empty() || packedStamp != stamp || GetFileAttributesW(arrayFile.c_str()) == INVALID_FILE_ATTRIBUTES)
+		{
+			// Indexed members are only opened now that their bytes are needed.
+			bool opened = true;
+			for(size_t s = 0; s < slices.size() && opened; ++s)
+			{
+				if(slices[s].BitData != nullptr)
+					continue;
+
+				auto file = std::make_unique<DDS::MappedFile>();
+				opened = file->Open(filenames[members[s]].c_str()) &&
+					DDS::ParseHeader(file->Data(), file->Size(), slices[s]) == DDS::Status::Ok;
+				files.push_back(std::move(file));
+			}
+
+			std::vector<uint8_t> bytes;
+			if(!opened || TexturePacker::PackArray(slices, bytes) != DDS::Status::Ok)
+				continue;
+
+			std::ofstream out(arrayFile, std::ios::binary);
+			out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+			out.close();
+			if(!out)
+			{
+				// The members stream from their own files instead.
+				DeleteFileW(arrayFile.c_str());
+				DeleteFileW(stampFile.c_str());
+				continue;
+			}
+
+			// Written after the array, so an array cut short by a crash never carries a
+			// stamp that matches its members.  Without one it is simply packed again.
+			std::ofstream stampOut(stampFile, std::ios::binary);
+			stampOut.write(stamp.data(), stamp.size());
+			stampOut.close();
+			if(!stampOut)
+				DeleteFileW(stampFile.c_str());
+		}
+
+		arrays.push_back(members);
+		arrayFiles.push_back(arrayFile);
+	}
+
+	return arrays;
+}
+
+std::string DirectXAssignmentFinalApp::PackedMemberStamp(const std::vector<std::wstring>& filenames,
+	const std::vector<UINT>& members)const
+{
+	// Each member's size and last write time, in slice order.  Empty if one of them
+	// cannot be looked at, which never matches a stamp on disk.
+	std::string stamp;
+	for(UINT m : members)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if(!GetFileAttributesExW(filenames[m].c_str(), GetFileExInfoStandard, &attributes))
+			return std::string();
+
+		char line[64];
+		snprintf(line, sizeof(line), "%llu %08lx%08lx\n",
+			((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow,
+			attributes.ftLastWriteTime.dwHighDateTime, attributes.ftLastWriteTime.dwLowDateTime);
+		stamp += line;
+	}
+	return stamp;
 }
 
 void DirectXAssignmentFinalApp::BuildRootSignature()
 {
+	// Every texture, bound once per command list.
 	CD3DX12_DESCRIPTOR_RANGE texTable;
-	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, mTextureTable->Capacity(), 0);
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[RootParameterCount];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
-    slotRootParameter[1].InitAsConstantBufferView(0);
+    slotRootParameter[1].InitAsShaderResourceView(0, 1);
     slotRootParameter[2].InitAsConstantBufferView(1);
-    slotRootParameter[3].InitAsConstantBufferView(2);
+
+	// The material buffer, and the index of the draw's material in it.
+    slotRootParameter[3].InitAsShaderResourceView(4, 1);
+    slotRootParameter[7].InitAsConstants(1, 2);
+
+	// Clustered lights: the light list, the cluster ranges and the light indices.
+    slotRootParameter[4].InitAsShaderResourceView(1, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+    slotRootParameter[5].InitAsShaderResourceView(2, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+    slotRootParameter[6].InitAsShaderResourceView(3, 1, D3D12_SHADER_VISIBILITY_PIXEL);
 
 	auto staticSamplers = GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(RootParameterCount, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -776,100 +1601,50 @@ void DirectXAssignmentFinalApp::BuildRootSignature()
 void DirectXAssignmentFinalApp::BuildDescriptorHeaps()
 {
 	//
-	// Create the SRV heap.
+	// Create the SRV heap, which is the whole texture table.  Every view is an array
+	// view, as the shaders declare them.
 	//
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 9;
+	srvHeapDesc.NumDescriptors = mTextureTable->Capacity();
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
 
 	//
-	// Fill out the heap with actual descriptors.
+	// Fill out the placeholder descriptors.  The streamed textures' slots are written
+	// by PumpTextureStreaming as each one arrives.
 	//
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	auto grassTex = mTextures["grassTex"]->Resource;
-	auto waterTex = mTextures["waterTex"]->Resource;
-	auto fenceTex = mTextures["fenceTex"]->Resource;
-	auto bricksTex = mTextures["bricksTex"]->Resource;
-	auto iceTex = mTextures["iceTex"]->Resource;
-	auto stoneTex = mTextures["stoneTex"]->Resource;
-	auto pyramidTex = mTextures["pyramidTex"]->Resource;;
-	auto sunTex = mTextures["sunTex"]->Resource;
-	auto mossyTex = mTextures["mossyTex"]->Resource;
-	auto treeArrayTex = mTextures["treeArrayTex"]->Resource;
-
-	// srv 0
+	auto placeholderTex = mTextures[mPlaceholderTexture]->Resource;
+
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = grassTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = -1;
-	md3dDevice->CreateShaderResourceView(grassTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	// srv 1
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = waterTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(waterTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	// srv 2
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = fenceTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	// srv 3
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = bricksTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(bricksTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	// srv4
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = iceTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(iceTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	// srv 5
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = stoneTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(stoneTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	// srv 6
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = pyramidTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(pyramidTex.Get(), &srvDesc, hDescriptor);
-	
-	//suntex
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = sunTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(sunTex.Get(), &srvDesc, hDescriptor);
-
-	//mossyTex
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	srvDesc.Format = mossyTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(mossyTex.Get(), &srvDesc, hDescriptor);
-
-	auto desc = treeArrayTex->GetDesc();
+	srvDesc.Format = placeholderTex->GetDesc().Format;
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
-	srvDesc.Format = treeArrayTex->GetDesc().Format;
 	srvDesc.Texture2DArray.MostDetailedMip = 0;
 	srvDesc.Texture2DArray.MipLevels = -1;
 	srvDesc.Texture2DArray.FirstArraySlice = 0;
-	srvDesc.Texture2DArray.ArraySize = treeArrayTex->GetDesc().DepthOrArraySize;
-	md3dDevice->CreateShaderResourceView(treeArrayTex.Get(), &srvDesc, hDescriptor);
+	srvDesc.Texture2DArray.ArraySize = placeholderTex->GetDesc().DepthOrArraySize;
+	md3dDevice->CreateShaderResourceView(placeholderTex.Get(), &srvDesc,
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
+			mPlaceholderTexture.Index, mCbvSrvDescriptorSize));
 }
 
 void DirectXAssignmentFinalApp::BuildShadersAndInputLayouts()
 {
+	// The pixel shader's cluster grid must match the one the lights are binned into,
+	// and its texture table the root signature's.
+	const std::string textureSlots = std::to_string(mTextureTable->Capacity());
+	const std::string clusterX = std::to_string(LightClusterer::ClusterX);
+	const std::string clusterY = std::to_string(LightClusterer::ClusterY);
+	const std::string clusterZ = std::to_string(LightClusterer::ClusterZ);
+
 	const D3D_SHADER_MACRO defines[] =
 	{
 		"FOG", "1",
+		"CLUSTER_X", clusterX.c_str(),
+		"CLUSTER_Y", clusterY.c_str(),
+		"CLUSTER_Z", clusterZ.c_str(),
+		"TEXTURE_SLOTS", textureSlots.c_str(),
 		NULL, NULL
 	};
 
@@ -877,16 +1652,30 @@ void DirectXAssignmentFinalApp::BuildShadersAndInputLayouts()
 	{
 		"FOG", "1",
 		"ALPHA_TEST", "1",
+		"CLUSTER_X", clusterX.c_str(),
+		"CLUSTER_Y", clusterY.c_str(),
+		"CLUSTER_Z", clusterZ.c_str(),
+		"TEXTURE_SLOTS", textureSlots.c_str(),
 		NULL, NULL
 	};
 
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_0");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", defines, "PS", "ps_5_0");
-	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_0");
+	// Permutations already compiled by an earlier run are loaded from disk.  Shader
+	// model 5.1 for indexing the texture table.
+	ShaderCache cache(L"ShaderCache");
+	cache.Add("standardVS", L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
+	cache.Add("opaquePS", L"Shaders\\Default.hlsl", defines, "PS", "ps_5_1");
+	cache.Add("alphaTestedPS", L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_1");
+
+	cache.Add("treeSpriteVS", L"Shaders\\TreeSprite.hlsl", nullptr, "VS", "vs_5_1");
+	cache.Add("treeSpriteGS", L"Shaders\\TreeSprite.hlsl", nullptr, "GS", "gs_5_1");
+	cache.Add("treeSpritePS", L"Shaders\\TreeSprite.hlsl", alphaTestDefines, "PS", "ps_5_1");
 
-	mShaders["treeSpriteVS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", nullptr, "VS", "vs_5_0");
-	mShaders["treeSpriteGS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", nullptr, "GS", "gs_5_0");
-	mShaders["treeSpritePS"] = d3dUtil::CompileShader(L"Shaders\\TreeSprite.hlsl", alphaTestDefines, "PS", "ps_5_0");
+	cache.Build();
+	cache.Export(mShaders);
+
+	std::string summary = "Shaders: " + std::to_string(cache.HitCount()) + " cached, " +
+		std::to_string(cache.MissCount()) + " compiled in " + std::to_string(cache.BuildMs()) + " ms\n";
+	OutputDebugStringA(summary.c_str());
 
     mStdInputLayout =
     {
@@ -937,12 +1726,6 @@ void DirectXAssignmentFinalApp::BuildLandGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -953,9 +1736,11 @@ void DirectXAssignmentFinalApp::BuildLandGeometry()
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
-	geo->DrawArgs["grid"] = submesh;
+	BoundingBox::CreateFromPoints(submesh.Bounds, vertices.size(), &vertices[0].Pos, sizeof(Vertex));
 
-	mGeometries["landGeo"] = std::move(geo);
+	geo->DrawArgs.Add("grid", submesh);
+
+	mGeometries.Add("landGeo", std::move(geo));
 }
 
 void DirectXAssignmentFinalApp::BuildWavesGeometry()
@@ -996,9 +1781,6 @@ void DirectXAssignmentFinalApp::BuildWavesGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -1009,9 +1791,14 @@ void DirectXAssignmentFinalApp::BuildWavesGeometry()
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
-	geo->DrawArgs["grid"] = submesh;
+	// The vertices are simulated on the CPU each frame, so bound the flat grid plus
+	// some headroom for the wave heights.
+	submesh.Bounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	submesh.Bounds.Extents = XMFLOAT3(0.5f*mWaves->Width(), 5.0f, 0.5f*mWaves->Depth());
+
+	geo->DrawArgs.Add("grid", submesh);
 
-	mGeometries["waterGeo"] = std::move(geo);
+	mGeometries.Add("waterGeo", std::move(geo));
 }
 
 void DirectXAssignmentFinalApp::BuildBoxGeometry()
@@ -1156,12 +1943,6 @@ void DirectXAssignmentFinalApp::BuildBoxGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -1254,19 +2035,32 @@ void DirectXAssignmentFinalApp::BuildBoxGeometry()
 	triangleRectSqrSubmesh.StartIndexLocation = triangleRectSqrIndexOffset;
 	triangleRectSqrSubmesh.BaseVertexLocation = triangleRectSqrVertexOffset;
 
-	geo->DrawArgs["box"] = boxSubmesh;
-	geo->DrawArgs["grid"] = gridSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
-	geo->DrawArgs["cylinder"] = cylinderSubmesh;
-	geo->DrawArgs["diamond"] = diamondSubmesh; ///////////// //8
-	geo->DrawArgs["pyramid"] = pyramidSubmesh;
-	geo->DrawArgs["rhombo"] = rhomboSubmesh;
-	geo->DrawArgs["prism"] = prismSubmesh;
-	geo->DrawArgs["hexagon"] = hexagonSubmesh;
-	geo->DrawArgs["triangleEq"] = triangleEqSubmesh;
-	geo->DrawArgs["triangleRectSqr"] = triangleRectSqrSubmesh;
-
-	mGeometries[geo->Name] = std::move(geo);
+	// Bound each submesh by the vertices it covers in the concatenated vertex buffer.
+	BoundingBox::CreateFromPoints(boxSubmesh.Bounds, box.Vertices.size(), &vertices[boxVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(gridSubmesh.Bounds, grid.Vertices.size(), &vertices[gridVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(sphereSubmesh.Bounds, sphere.Vertices.size(), &vertices[sphereVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(cylinderSubmesh.Bounds, cylinder.Vertices.size(), &vertices[cylinderVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(diamondSubmesh.Bounds, diamond.Vertices.size(), &vertices[diamondVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(pyramidSubmesh.Bounds, pyramid.Vertices.size(), &vertices[pyramidVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(rhomboSubmesh.Bounds, rhombo.Vertices.size(), &vertices[rhomboVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(prismSubmesh.Bounds, prism.Vertices.size(), &vertices[prismVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(hexagonSubmesh.Bounds, hexagon.Vertices.size(), &vertices[hexagonVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(triangleEqSubmesh.Bounds, triangleEq.Vertices.size(), &vertices[triangleEqVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(triangleRectSqrSubmesh.Bounds, triangleRectSqr.Vertices.size(), &vertices[triangleRectSqrVertexOffset].Pos, sizeof(Vertex));
+
+	geo->DrawArgs.Add("box", boxSubmesh);
+	geo->DrawArgs.Add("grid", gridSubmesh);
+	geo->DrawArgs.Add("sphere", sphereSubmesh);
+	geo->DrawArgs.Add("cylinder", cylinderSubmesh);
+	geo->DrawArgs.Add("diamond", diamondSubmesh); ///////////// //8
+	geo->DrawArgs.Add("pyramid", pyramidSubmesh);
+	geo->DrawArgs.Add("rhombo", rhomboSubmesh);
+	geo->DrawArgs.Add("prism", prismSubmesh);
+	geo->DrawArgs.Add("hexagon", hexagonSubmesh);
+	geo->DrawArgs.Add("triangleEq", triangleEqSubmesh);
+	geo->DrawArgs.Add("triangleRectSqr", triangleRectSqrSubmesh);
+
+	mGeometries.Add(geo->Name, std::move(geo));
 }
 
 void DirectXAssignmentFinalApp::BuildSkullGeometry()
@@ -1323,12 +2117,6 @@ void DirectXAssignmentFinalApp::BuildSkullGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
@@ -1339,9 +2127,11 @@ void DirectXAssignmentFinalApp::BuildSkullGeometry()
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
-	geo->DrawArgs["skull"] = submesh;
+	BoundingBox::CreateFromPoints(submesh.Bounds, vertices.size(), &vertices[0].Pos, sizeof(Vertex));
+
+	geo->DrawArgs.Add("skull", submesh);
 
-	mGeometries[geo->Name] = std::move(geo);
+	mGeometries.Add(geo->Name, std::move(geo));
 }
 
 
@@ -1413,12 +2203,6 @@ void DirectXAssignmentFinalApp::BuildTreeSpritesGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
 	geo->VertexByteStride = sizeof(TreeSpriteVertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
@@ -1429,112 +2213,210 @@ void DirectXAssignmentFinalApp::BuildTreeSpritesGeometry()
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
 
-	geo->DrawArgs["points"] = submesh;
+	// Each point expands into a billboard of its Size, so grow the box of the
+	// points by half the largest sprite.
+	BoundingBox::CreateFromPoints(submesh.Bounds, vertices.size(), &vertices[0].Pos, sizeof(TreeSpriteVertex));
+	submesh.Bounds.Extents.x += 10.0f;
+	submesh.Bounds.Extents.y += 10.0f;
+	submesh.Bounds.Extents.z += 10.0f;
+
+	geo->DrawArgs.Add("points", submesh);
+
+	mGeometries.Add("treeSpritesGeo", std::move(geo));
+}
+
+void DirectXAssignmentFinalApp::UploadStaticGeometry()
+{
+	// Every mesh built so far goes into one buffer, filled from one staging range with
+	// one copy and one barrier.  The CPU copies are the source; they last until
+	// DropCpuCopies, long after Write.
+	struct MeshRanges
+	{
+		MeshGeometry* Geo;
+		uint32_t Vertices;
+		uint32_t Indices;
+	};
+
+	GeometryUploadBatcher batcher;
+	std::vector<MeshRanges> meshes;
+	for(auto& geo : mGeometries)
+	{
+		MeshRanges mesh = { geo.get(), UINT32_MAX, UINT32_MAX };
+
+		// A mesh without a CPU copy of its vertices, like the waves, writes them itself.
+		if(geo->VertexBufferCPU != nullptr)
+			mesh.Vertices = batcher.Add(geo->VertexBufferCPU->GetBufferPointer(), geo->VertexBufferByteSize);
+		if(geo->IndexBufferCPU != nullptr)
+			mesh.Indices = batcher.Add(geo->IndexBufferCPU->GetBufferPointer(), geo->IndexBufferByteSize);
+		meshes.push_back(mesh);
+	}
+
+	if(batcher.TotalBytes() == 0)
+		return;
+
+	// Never freed, so the allocation is not kept.
+	mBufferHeaps->CreateResource(CD3DX12_RESOURCE_DESC::Buffer(batcher.TotalBytes()),
+		D3D12_RESOURCE_STATE_COPY_DEST, mStaticGeometry);
+
+	UploadArena::Region staging = mLoadUploads->Allocate(batcher.TotalBytes(), batcher.MaxAlignment());
+	batcher.Write(staging.Data);
 
-	mGeometries["treeSpritesGeo"] = std::move(geo);
+	mCommandList->CopyBufferRegion(mStaticGeometry.Get(), 0, staging.Resource, staging.Offset, batcher.TotalBytes());
+	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mStaticGeometry.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+
+	for(const MeshRanges& mesh : meshes)
+	{
+		if(mesh.Vertices != UINT32_MAX)
+		{
+			mesh.Geo->VertexBufferGPU = mStaticGeometry;
+			mesh.Geo->VertexBufferOffset = batcher.Offset(mesh.Vertices);
+		}
+		if(mesh.Indices != UINT32_MAX)
+		{
+			mesh.Geo->IndexBufferGPU = mStaticGeometry;
+			mesh.Geo->IndexBufferOffset = batcher.Offset(mesh.Indices);
+		}
+	}
 }
 
 void DirectXAssignmentFinalApp::BuildPSOs()
 {
-    D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
+	mPipelines.SetRootSignature(mRootSignature.Get());
+	uint16_t stdInputLayout = mPipelines.AddInputLayout(mStdInputLayout);
+	uint16_t treeSpriteInputLayout = mPipelines.AddInputLayout(mTreeSpriteInputLayout);
 
 	//
 	// PSO for opaque objects.
 	//
-    ZeroMemory(&opaquePsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
-	opaquePsoDesc.InputLayout = { mStdInputLayout.data(), (UINT)mStdInputLayout.size() };
-	opaquePsoDesc.pRootSignature = mRootSignature.Get();
-	opaquePsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["standardVS"]->GetBufferPointer()),
-		mShaders["standardVS"]->GetBufferSize()
-	};
-	opaquePsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["opaquePS"]->GetBufferPointer()),
-		mShaders["opaquePS"]->GetBufferSize()
-	};
-	opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-	opaquePsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-	opaquePsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-	opaquePsoDesc.SampleMask = UINT_MAX;
-	opaquePsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-	opaquePsoDesc.NumRenderTargets = 1;
-	opaquePsoDesc.RTVFormats[0] = mBackBufferFormat;
-	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
-	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
-	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-    ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	PipelineStateKey opaque;
+	opaque.InputLayout = stdInputLayout;
+	opaque.VS = mPipelines.AddShader(mShaders.Get("standardVS").Get());
+	opaque.PS = mPipelines.AddShader(mShaders.Get("opaquePS").Get());
+	opaque.RTVFormat = (uint16_t)mBackBufferFormat;
+	opaque.DSVFormat = (uint16_t)mDepthStencilFormat;
+	opaque.SampleCount = m4xMsaaState ? 4 : 1;
+	opaque.SampleQuality = m4xMsaaState ? (uint16_t)(m4xMsaaQuality - 1) : 0;
 
 	//
 	// PSO for transparent objects
 	//
-
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC transparentPsoDesc = opaquePsoDesc;
-
-	D3D12_RENDER_TARGET_BLEND_DESC transparencyBlendDesc;
-	transparencyBlendDesc.BlendEnable = true;
-	transparencyBlendDesc.LogicOpEnable = false;
-	transparencyBlendDesc.SrcBlend = D3D12_BLEND_SRC_ALPHA;
-	transparencyBlendDesc.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
-	transparencyBlendDesc.BlendOp = D3D12_BLEND_OP_ADD;
-	transparencyBlendDesc.SrcBlendAlpha = D3D12_BLEND_ONE;
-	transparencyBlendDesc.DestBlendAlpha = D3D12_BLEND_ZERO;
-	transparencyBlendDesc.BlendOpAlpha = D3D12_BLEND_OP_ADD;
-	transparencyBlendDesc.LogicOp = D3D12_LOGIC_OP_NOOP;
-	transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
-
-	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
+	PipelineStateKey transparent = opaque;
+	transparent.Blend = PsoBlend::AlphaBlend;
 
 	//
 	// PSO for alpha tested objects
 	//
-
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC alphaTestedPsoDesc = opaquePsoDesc;
-	alphaTestedPsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["alphaTestedPS"]->GetBufferPointer()),
-		mShaders["alphaTestedPS"]->GetBufferSize()
-	};
-	alphaTestedPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&alphaTestedPsoDesc, IID_PPV_ARGS(&mPSOs["alphaTested"])));
+	PipelineStateKey alphaTested = opaque;
+	alphaTested.PS = mPipelines.AddShader(mShaders.Get("alphaTestedPS").Get());
+	alphaTested.CullMode = (uint8_t)D3D12_CULL_MODE_NONE;
 
 	//
 	// PSO for tree sprites
 	//
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC treeSpritePsoDesc = opaquePsoDesc;
-	treeSpritePsoDesc.VS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["treeSpriteVS"]->GetBufferPointer()),
-		mShaders["treeSpriteVS"]->GetBufferSize()
-	};
-	treeSpritePsoDesc.GS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["treeSpriteGS"]->GetBufferPointer()),
-		mShaders["treeSpriteGS"]->GetBufferSize()
-	};
-	treeSpritePsoDesc.PS =
-	{
-		reinterpret_cast<BYTE*>(mShaders["treeSpritePS"]->GetBufferPointer()),
-		mShaders["treeSpritePS"]->GetBufferSize()
-	};
-	treeSpritePsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT;
-	treeSpritePsoDesc.InputLayout = { mTreeSpriteInputLayout.data(), (UINT)mTreeSpriteInputLayout.size() };
-	treeSpritePsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	PipelineStateKey treeSprites = opaque;
+	treeSprites.VS = mPipelines.AddShader(mShaders.Get("treeSpriteVS").Get());
+	treeSprites.GS = mPipelines.AddShader(mShaders.Get("treeSpriteGS").Get());
+	treeSprites.PS = mPipelines.AddShader(mShaders.Get("treeSpritePS").Get());
+	treeSprites.Topology = (uint8_t)D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT;
+	treeSprites.InputLayout = treeSpriteInputLayout;
+	treeSprites.CullMode = (uint8_t)D3D12_CULL_MODE_NONE;
+
+	mLayerPsoHandles[(int)RenderLayer::Opaque] = mPipelines.Register(opaque);
+	mLayerPsoHandles[(int)RenderLayer::Transparent] = mPipelines.Register(transparent);
+	mLayerPsoHandles[(int)RenderLayer::AlphaTested] = mPipelines.Register(alphaTested);
+	mLayerPsoHandles[(int)RenderLayer::AlphaTestedTreeSprites] = mPipelines.Register(treeSprites);
+
+	// The pipelines are created on worker threads while the geometry is built;
+	// Initialize waits for them before the first frame.
+	mPipelines.CreateAsync(md3dDevice.Get(), L"ShaderCache\\Pipelines.bin");
+}
+
+void DirectXAssignmentFinalApp::FinishPSOs()
+{
+	mPipelines.Wait();
+
+	for(int i = 0; i < (int)RenderLayer::Count; ++i)
+		mLayerPSOs[i] = mPipelines.Get(mLayerPsoHandles[i]);
 
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&treeSpritePsoDesc, IID_PPV_ARGS(&mPSOs["treeSprites"])));
+	std::string summary = "Pipelines: " + std::to_string(mPipelines.LoadedCount()) + " from library, " +
+		std::to_string(mPipelines.CreatedCount()) + " created in " + std::to_string(mPipelines.CreateMs()) + " ms\n";
+	OutputDebugStringA(summary.c_str());
 }
 
 void DirectXAssignmentFinalApp::BuildFrameResources()
 {
+	// Every view gets its own pass constants, instance range and worker lists.
+	const UINT viewCount = (UINT)mViews.size();
+
     for(int i = 0; i < gNumFrameResources; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount()));
+            viewCount, viewCount * (UINT)mAllRitems.size(), mMaterials.Count(),
+            mWaves->VertexCount(), viewCount * mDrawWorkerCount, MaxLocalLights));
     }
 }
 
+void DirectXAssignmentFinalApp::TrackLoadedResources(UINT64 uploadFence)
+{
+	// The upload pages are handed over as soon as their copies are submitted.
+	mLoadUploads->ReleaseAfter(mResources, uploadFence);
+
+	// The meshes share one buffer; the waves' vertices are in the frame resources.
+	mResources.Track(MemoryCategory::Geometry, ResourceBytes(mStaticGeometry.Get()));
+
+	for(auto& geo : mGeometries)
+	{
+		if(geo->VertexBufferCPU != nullptr)
+			mResources.Track(MemoryCategory::MeshCpuCopies, geo->VertexBufferCPU->GetBufferSize());
+		if(geo->IndexBufferCPU != nullptr)
+			mResources.Track(MemoryCategory::MeshCpuCopies, geo->IndexBufferCPU->GetBufferSize());
+	}
+
+	// The streamed textures are tracked as they arrive; only the placeholder is loaded.
+	Texture* placeholder = mTextures[mPlaceholderTexture].get();
+	mResources.Track(MemoryCategory::Textures, ResourceBytes(placeholder->Resource.Get()));
+
+	for(auto& frame : mFrameResources)
+	{
+		ID3D12Resource* buffers[] =
+		{
+			frame->PassCB->Resource(), frame->MaterialBuffer->Resource(), frame->InstanceBuffer->Resource(),
+			frame->LocalLights->Resource(), frame->ClusterRanges->Resource(),
+			frame->ClusterLightIndices->Resource(), frame->WavesVB->Resource()
+		};
+		for(ID3D12Resource* buffer : buffers)
+			mResources.Track(MemoryCategory::FrameResources, ResourceBytes(buffer));
+	}
+
+	mResources.Track(MemoryCategory::TextureStaging, ResourceBytes(mTextureStaging.Get()));
+}
+
+void DirectXAssignmentFinalApp::DropCpuCopies()
+{
+	for(auto& geo : mGeometries)
+	{
+		if(geo->KeepCpuCopies)
+			continue;
+
+		if(geo->VertexBufferCPU != nullptr)
+			mResources.Untrack(MemoryCategory::MeshCpuCopies, geo->VertexBufferCPU->GetBufferSize());
+		if(geo->IndexBufferCPU != nullptr)
+			mResources.Untrack(MemoryCategory::MeshCpuCopies, geo->IndexBufferCPU->GetBufferSize());
+		geo->DisposeCpuCopies();
+	}
+}
+
+UINT64 DirectXAssignmentFinalApp::ResourceBytes(ID3D12Resource* resource)const
+{
+	if(resource == nullptr)
+		return 0;
+
+	// What the resource takes in its heap, alignment and padding included.
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	return md3dDevice->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
 void DirectXAssignmentFinalApp::BuildMaterials()
 {
 	int cbIndex = 8;
@@ -1569,7 +2451,7 @@ void DirectXAssignmentFinalApp::BuildMaterials()
 	auto treeSprites = std::make_unique<Material>();
 	treeSprites->Name = "treeSprites";
 	treeSprites->MatCBIndex = 3;
-	treeSprites->DiffuseSrvHeapIndex = 8;
+	treeSprites->DiffuseSrvHeapIndex = 9;
 	treeSprites->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	treeSprites->FresnelR0 = XMFLOAT3(0.01f, 0.01f, 0.01f);
 
@@ -1630,18 +2512,40 @@ void DirectXAssignmentFinalApp::BuildMaterials()
 	stonestep->Roughness = 0.01f;
 
 	
-	mMaterials["grass"] = std::move(grass);
-	mMaterials["water"] = std::move(water);
-	mMaterials["wirefence"] = std::move(wirefence);
-	mMaterials["treeSprites"] = std::move(treeSprites);
-	mMaterials["bricks"] = std::move(bricks);
-	mMaterials["ice"] = std::move(ice);
-	mMaterials["stone"] = std::move(stone);
-	mMaterials["pyramid"] = std::move(pyramid);
-	mMaterials["sunMat"] = std::move(sunMat);
-	mMaterials["mossy"] = std::move(mossy);
-	mMaterials["stonestep"] = std::move(stonestep);
+	mMaterials.Add("grass", std::move(grass));
+	mWaterMaterial = mMaterials.Add("water", std::move(water));
+	mMaterials.Add("wirefence", std::move(wirefence));
+	mMaterials.Add("treeSprites", std::move(treeSprites));
+	mMaterials.Add("bricks", std::move(bricks));
+	mMaterials.Add("ice", std::move(ice));
+	mMaterials.Add("stone", std::move(stone));
+	mMaterials.Add("pyramid", std::move(pyramid));
+	mMaterials.Add("sunMat", std::move(sunMat));
+	mMaterials.Add("mossy", std::move(mossy));
+	mMaterials.Add("stonestep", std::move(stonestep));
+
+	// Until its texture streams in, a material samples the placeholder.  Its slice is
+	// the one it keeps once the texture, or the array it was packed into, arrives; on
+	// the placeholder's single slice it clamps to that.
+	mMaterialTextures.assign(mMaterials.Count(), -1);
+	for(auto& mat : mMaterials)
+	{
+		const TextureSlice& slice = mTextureSlices[mat->DiffuseSrvHeapIndex];
+		mat->DiffuseSrvHeapIndex = slice.Texture;
+		mat->DiffuseSlice = slice.Slice;
 
+		for(size_t i = 0; i < mStreamedTextures.size(); ++i)
+		{
+			StreamedTextureState& state = mStreamedTextures[i];
+			if(mat->DiffuseSrvHeapIndex == (int)state.Id.Index)
+			{
+				state.Materials.push_back(mat.get());
+				mMaterialTextures[mat->MatCBIndex] = (int)i;
+				mat->DiffuseSrvHeapIndex = mPlaceholderTexture.Index;
+				break;
+			}
+		}
+	}
 }
 
 void DirectXAssignmentFinalApp::BuildRenderItems()
@@ -1655,12 +2559,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
     wavesRitem->World = MathHelper::Identity4x4();
 	XMStoreFloat4x4(&wavesRitem->TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
 	wavesRitem->ObjCBIndex = 0;
-	wavesRitem->Mat = mMaterials["water"].get();
-	wavesRitem->Geo = mGeometries["waterGeo"].get();
+	wavesRitem->Mat = mMaterials.Get("water").get();
+	wavesRitem->Geo = mGeometries.Get("waterGeo").get();
 	wavesRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	wavesRitem->IndexCount = wavesRitem->Geo->DrawArgs["grid"].IndexCount;
-	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	wavesRitem->IndexCount = wavesRitem->Geo->DrawArgs.Get("grid").IndexCount;
+	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs.Get("grid").StartIndexLocation;
+	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs.Get("grid").BaseVertexLocation;
+	wavesRitem->LocalBounds = wavesRitem->Geo->DrawArgs.Get("grid").Bounds;
 
 	//Just the waves.
     mWavesRitem = wavesRitem.get();
@@ -1671,36 +2576,39 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
     gridRitem->World = MathHelper::Identity4x4();
 	XMStoreFloat4x4(&gridRitem->TexTransform, XMMatrixScaling(5.0f, 5.0f, 1.0f));
 	gridRitem->ObjCBIndex = 1;
-	gridRitem->Mat = mMaterials["grass"].get();
-	gridRitem->Geo = mGeometries["landGeo"].get();
+	gridRitem->Mat = mMaterials.Get("grass").get();
+	gridRitem->Geo = mGeometries.Get("landGeo").get();
 	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-    gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-    gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-    gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    gridRitem->IndexCount = gridRitem->Geo->DrawArgs.Get("grid").IndexCount;
+    gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs.Get("grid").StartIndexLocation;
+    gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs.Get("grid").BaseVertexLocation;
+    gridRitem->LocalBounds = gridRitem->Geo->DrawArgs.Get("grid").Bounds;
 
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
 	
 	auto boxRitem = std::make_unique<RenderItem>();
 	XMStoreFloat4x4(&boxRitem->World, XMMatrixTranslation(3.0f, 2.0f, -9.0f));
 	boxRitem->ObjCBIndex = 2;
-	boxRitem->Mat = mMaterials["wirefence"].get();
-	boxRitem->Geo = mGeometries["shapeGeo"].get();
+	boxRitem->Mat = mMaterials.Get("wirefence").get();
+	boxRitem->Geo = mGeometries.Get("shapeGeo").get();
 	boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->IndexCount = boxRitem->Geo->DrawArgs.Get("box").IndexCount;
+	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs.Get("box").StartIndexLocation;
+	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	boxRitem->LocalBounds = boxRitem->Geo->DrawArgs.Get("box").Bounds;
 
 	mRitemLayer[(int)RenderLayer::AlphaTested].push_back(boxRitem.get());
 	
 	auto treeSpritesRitem = std::make_unique<RenderItem>();
 	treeSpritesRitem->World = MathHelper::Identity4x4();
 	treeSpritesRitem->ObjCBIndex = 3;
-	treeSpritesRitem->Mat = mMaterials["treeSprites"].get();
-	treeSpritesRitem->Geo = mGeometries["treeSpritesGeo"].get();
+	treeSpritesRitem->Mat = mMaterials.Get("treeSprites").get();
+	treeSpritesRitem->Geo = mGeometries.Get("treeSpritesGeo").get();
 	treeSpritesRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_POINTLIST;
-	treeSpritesRitem->IndexCount = treeSpritesRitem->Geo->DrawArgs["points"].IndexCount;
-	treeSpritesRitem->StartIndexLocation = treeSpritesRitem->Geo->DrawArgs["points"].StartIndexLocation;
-	treeSpritesRitem->BaseVertexLocation = treeSpritesRitem->Geo->DrawArgs["points"].BaseVertexLocation;
+	treeSpritesRitem->IndexCount = treeSpritesRitem->Geo->DrawArgs.Get("points").IndexCount;
+	treeSpritesRitem->StartIndexLocation = treeSpritesRitem->Geo->DrawArgs.Get("points").StartIndexLocation;
+	treeSpritesRitem->BaseVertexLocation = treeSpritesRitem->Geo->DrawArgs.Get("points").BaseVertexLocation;
+	treeSpritesRitem->LocalBounds = treeSpritesRitem->Geo->DrawArgs.Get("points").Bounds;
 
 	mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites].push_back(treeSpritesRitem.get());
 	
@@ -1713,12 +2621,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&basePillar->World, XMMatrixScaling(4.0f, 6.0f, 4.0f) * XMMatrixTranslation(0.0f, yLevel + 5.0f, 0.0f));
 	XMStoreFloat4x4(&basePillar->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	basePillar->ObjCBIndex = 4;
-	basePillar->Mat = mMaterials["stone"].get();
-	basePillar->Geo = mGeometries["shapeGeo"].get();
+	basePillar->Mat = mMaterials.Get("stone").get();
+	basePillar->Geo = mGeometries.Get("shapeGeo").get();
 	basePillar->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	basePillar->IndexCount = basePillar->Geo->DrawArgs["cylinder"].IndexCount;
-	basePillar->StartIndexLocation = basePillar->Geo->DrawArgs["cylinder"].StartIndexLocation;
-	basePillar->BaseVertexLocation = basePillar->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+	basePillar->IndexCount = basePillar->Geo->DrawArgs.Get("cylinder").IndexCount;
+	basePillar->StartIndexLocation = basePillar->Geo->DrawArgs.Get("cylinder").StartIndexLocation;
+	basePillar->BaseVertexLocation = basePillar->Geo->DrawArgs.Get("cylinder").BaseVertexLocation;
+	basePillar->LocalBounds = basePillar->Geo->DrawArgs.Get("cylinder").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(basePillar.get());
 	mAllRitems.push_back(std::move(basePillar));
 	
@@ -1726,12 +2635,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	gridRitem3->World = MathHelper::Identity4x4();
 	XMStoreFloat4x4(&gridRitem3->TexTransform, XMMatrixScaling(8.0f, 8.0f, 1.0f) * XMMatrixTranslation(0.0f, yLevel + 0.0f, 0.0f));
 	gridRitem3->ObjCBIndex = 5;
-	gridRitem3->Mat = mMaterials["stone"].get();
-	gridRitem3->Geo = mGeometries["shapeGeo"].get();
+	gridRitem3->Mat = mMaterials.Get("stone").get();
+	gridRitem3->Geo = mGeometries.Get("shapeGeo").get();
 	gridRitem3->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	gridRitem3->IndexCount = gridRitem3->Geo->DrawArgs["grid"].IndexCount;
-	gridRitem3->StartIndexLocation = gridRitem3->Geo->DrawArgs["grid"].StartIndexLocation;
-	gridRitem3->BaseVertexLocation = gridRitem3->Geo->DrawArgs["grid"].BaseVertexLocation;
+	gridRitem3->IndexCount = gridRitem3->Geo->DrawArgs.Get("grid").IndexCount;
+	gridRitem3->StartIndexLocation = gridRitem3->Geo->DrawArgs.Get("grid").StartIndexLocation;
+	gridRitem3->BaseVertexLocation = gridRitem3->Geo->DrawArgs.Get("grid").BaseVertexLocation;
+	gridRitem3->LocalBounds = gridRitem3->Geo->DrawArgs.Get("grid").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem3.get());
 	mAllRitems.push_back(std::move(gridRitem3));
 	
@@ -1739,12 +2649,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&diamondRitem->World, XMMatrixScaling(5.0f, 5.0f, 5.0f) * XMMatrixRotationX(5.1) * XMMatrixTranslation(-0.7f, yLevel + 15.9f, -0.6f));
 	XMStoreFloat4x4(&diamondRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	diamondRitem->ObjCBIndex = 6;
-	diamondRitem->Mat = mMaterials["ice"].get();
-	diamondRitem->Geo = mGeometries["shapeGeo"].get();
+	diamondRitem->Mat = mMaterials.Get("ice").get();
+	diamondRitem->Geo = mGeometries.Get("shapeGeo").get();
 	diamondRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	diamondRitem->IndexCount = diamondRitem->Geo->DrawArgs["diamond"].IndexCount;
-	diamondRitem->StartIndexLocation = diamondRitem->Geo->DrawArgs["diamond"].StartIndexLocation;
-	diamondRitem->BaseVertexLocation = diamondRitem->Geo->DrawArgs["diamond"].BaseVertexLocation;
+	diamondRitem->IndexCount = diamondRitem->Geo->DrawArgs.Get("diamond").IndexCount;
+	diamondRitem->StartIndexLocation = diamondRitem->Geo->DrawArgs.Get("diamond").StartIndexLocation;
+	diamondRitem->BaseVertexLocation = diamondRitem->Geo->DrawArgs.Get("diamond").BaseVertexLocation;
+	diamondRitem->LocalBounds = diamondRitem->Geo->DrawArgs.Get("diamond").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(diamondRitem.get());
 	mAllRitems.push_back(std::move(diamondRitem));
 	
@@ -1752,12 +2663,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&diamond1Ritem->World, XMMatrixScaling(5.0f, 5.0f, 5.0f) * XMMatrixRotationX(5.1) * XMMatrixTranslation(0.7f, yLevel + 15.9f, -0.6f));
 	XMStoreFloat4x4(&diamond1Ritem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	diamond1Ritem->ObjCBIndex = 7;
-	diamond1Ritem->Mat = mMaterials["ice"].get();
-	diamond1Ritem->Geo = mGeometries["shapeGeo"].get();
+	diamond1Ritem->Mat = mMaterials.Get("ice").get();
+	diamond1Ritem->Geo = mGeometries.Get("shapeGeo").get();
 	diamond1Ritem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	diamond1Ritem->IndexCount = diamond1Ritem->Geo->DrawArgs["diamond"].IndexCount;
-	diamond1Ritem->StartIndexLocation = diamond1Ritem->Geo->DrawArgs["diamond"].StartIndexLocation;
-	diamond1Ritem->BaseVertexLocation = diamond1Ritem->Geo->DrawArgs["diamond"].BaseVertexLocation;
+	diamond1Ritem->IndexCount = diamond1Ritem->Geo->DrawArgs.Get("diamond").IndexCount;
+	diamond1Ritem->StartIndexLocation = diamond1Ritem->Geo->DrawArgs.Get("diamond").StartIndexLocation;
+	diamond1Ritem->BaseVertexLocation = diamond1Ritem->Geo->DrawArgs.Get("diamond").BaseVertexLocation;
+	diamond1Ritem->LocalBounds = diamond1Ritem->Geo->DrawArgs.Get("diamond").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(diamond1Ritem.get());
 	mAllRitems.push_back(std::move(diamond1Ritem));
 	
@@ -1765,12 +2677,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&pyramidRitem->World, XMMatrixScaling(4.0f, 4.0f, 4.0f)* XMMatrixTranslation(15.0f, yLevel + 18.0f, -15.0f));
 	XMStoreFloat4x4(&pyramidRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	pyramidRitem->ObjCBIndex = 8;
-	pyramidRitem->Mat = mMaterials["bricks"].get();
-	pyramidRitem->Geo = mGeometries["shapeGeo"].get();
+	pyramidRitem->Mat = mMaterials.Get("bricks").get();
+	pyramidRitem->Geo = mGeometries.Get("shapeGeo").get();
 	pyramidRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	pyramidRitem->IndexCount = pyramidRitem->Geo->DrawArgs["pyramid"].IndexCount;
-	pyramidRitem->StartIndexLocation = pyramidRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
-	pyramidRitem->BaseVertexLocation = pyramidRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
+	pyramidRitem->IndexCount = pyramidRitem->Geo->DrawArgs.Get("pyramid").IndexCount;
+	pyramidRitem->StartIndexLocation = pyramidRitem->Geo->DrawArgs.Get("pyramid").StartIndexLocation;
+	pyramidRitem->BaseVertexLocation = pyramidRitem->Geo->DrawArgs.Get("pyramid").BaseVertexLocation;
+	pyramidRitem->LocalBounds = pyramidRitem->Geo->DrawArgs.Get("pyramid").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(pyramidRitem.get());
 	mAllRitems.push_back(std::move(pyramidRitem));
 
@@ -1778,12 +2691,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&rhomboRitem->World, XMMatrixScaling(1.0f, 1.0f, 1.0f)* XMMatrixTranslation(6.7f, yLevel + 8.0f, -17.0f));
 	XMStoreFloat4x4(&rhomboRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	rhomboRitem->ObjCBIndex = 9;
-	rhomboRitem->Mat = mMaterials["pyramid"].get();
-	rhomboRitem->Geo = mGeometries["shapeGeo"].get();
+	rhomboRitem->Mat = mMaterials.Get("pyramid").get();
+	rhomboRitem->Geo = mGeometries.Get("shapeGeo").get();
 	rhomboRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	rhomboRitem->IndexCount = rhomboRitem->Geo->DrawArgs["rhombo"].IndexCount;
-	rhomboRitem->StartIndexLocation = rhomboRitem->Geo->DrawArgs["rhombo"].StartIndexLocation;
-	rhomboRitem->BaseVertexLocation = rhomboRitem->Geo->DrawArgs["rhombo"].BaseVertexLocation;
+	rhomboRitem->IndexCount = rhomboRitem->Geo->DrawArgs.Get("rhombo").IndexCount;
+	rhomboRitem->StartIndexLocation = rhomboRitem->Geo->DrawArgs.Get("rhombo").StartIndexLocation;
+	rhomboRitem->BaseVertexLocation = rhomboRitem->Geo->DrawArgs.Get("rhombo").BaseVertexLocation;
+	rhomboRitem->LocalBounds = rhomboRitem->Geo->DrawArgs.Get("rhombo").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(rhomboRitem.get());
 	mAllRitems.push_back(std::move(rhomboRitem));
 
@@ -1791,12 +2705,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&sphereRitem->World, XMMatrixScaling(3.0f, 3.0f, 3.0f) * XMMatrixTranslation(-20.7f, yLevel + 40.0f, 35.0f));
 	XMStoreFloat4x4(&sphereRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	sphereRitem->ObjCBIndex = 10;
-	sphereRitem->Mat = mMaterials["sunMat"].get();//sol
-	sphereRitem->Geo = mGeometries["shapeGeo"].get();
+	sphereRitem->Mat = mMaterials.Get("sunMat").get();//sol
+	sphereRitem->Geo = mGeometries.Get("shapeGeo").get();
 	sphereRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	sphereRitem->IndexCount = sphereRitem->Geo->DrawArgs["sphere"].IndexCount;
-	sphereRitem->StartIndexLocation = sphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
-	sphereRitem->BaseVertexLocation = sphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	sphereRitem->IndexCount = sphereRitem->Geo->DrawArgs.Get("sphere").IndexCount;
+	sphereRitem->StartIndexLocation = sphereRitem->Geo->DrawArgs.Get("sphere").StartIndexLocation;
+	sphereRitem->BaseVertexLocation = sphereRitem->Geo->DrawArgs.Get("sphere").BaseVertexLocation;
+	sphereRitem->LocalBounds = sphereRitem->Geo->DrawArgs.Get("sphere").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(sphereRitem.get());
 	mAllRitems.push_back(std::move(sphereRitem));
 
@@ -1804,12 +2719,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&hexagonRitem->World, XMMatrixScaling(3.0f, 0.1f, 3.0f)* XMMatrixTranslation(0.0f, yLevel, -5.0f));
 	XMStoreFloat4x4(&hexagonRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	hexagonRitem->ObjCBIndex = 11;
-	hexagonRitem->Mat = mMaterials["mossy"].get();
-	hexagonRitem->Geo = mGeometries["shapeGeo"].get();
+	hexagonRitem->Mat = mMaterials.Get("mossy").get();
+	hexagonRitem->Geo = mGeometries.Get("shapeGeo").get();
 	hexagonRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	hexagonRitem->IndexCount = hexagonRitem->Geo->DrawArgs["hexagon"].IndexCount;
-	hexagonRitem->StartIndexLocation = hexagonRitem->Geo->DrawArgs["hexagon"].StartIndexLocation;
-	hexagonRitem->BaseVertexLocation = hexagonRitem->Geo->DrawArgs["hexagon"].BaseVertexLocation;
+	hexagonRitem->IndexCount = hexagonRitem->Geo->DrawArgs.Get("hexagon").IndexCount;
+	hexagonRitem->StartIndexLocation = hexagonRitem->Geo->DrawArgs.Get("hexagon").StartIndexLocation;
+	hexagonRitem->BaseVertexLocation = hexagonRitem->Geo->DrawArgs.Get("hexagon").BaseVertexLocation;
+	hexagonRitem->LocalBounds = hexagonRitem->Geo->DrawArgs.Get("hexagon").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(hexagonRitem.get());
 	mAllRitems.push_back(std::move(hexagonRitem));
 
@@ -1817,12 +2733,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&triangleEqRitem->World, XMMatrixScaling(2.0f, 2.0f, 15.0f)* XMMatrixTranslation(-15.0f, yLevel + 16.0f, -0.0f));
 	XMStoreFloat4x4(&triangleEqRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	triangleEqRitem->ObjCBIndex = 12;
-	triangleEqRitem->Mat = mMaterials["bricks"].get();
-	triangleEqRitem->Geo = mGeometries["shapeGeo"].get();
+	triangleEqRitem->Mat = mMaterials.Get("bricks").get();
+	triangleEqRitem->Geo = mGeometries.Get("shapeGeo").get();
 	triangleEqRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	triangleEqRitem->IndexCount = triangleEqRitem->Geo->DrawArgs["triangleEq"].IndexCount;
-	triangleEqRitem->StartIndexLocation = triangleEqRitem->Geo->DrawArgs["triangleEq"].StartIndexLocation;
-	triangleEqRitem->BaseVertexLocation = triangleEqRitem->Geo->DrawArgs["triangleEq"].BaseVertexLocation;
+	triangleEqRitem->IndexCount = triangleEqRitem->Geo->DrawArgs.Get("triangleEq").IndexCount;
+	triangleEqRitem->StartIndexLocation = triangleEqRitem->Geo->DrawArgs.Get("triangleEq").StartIndexLocation;
+	triangleEqRitem->BaseVertexLocation = triangleEqRitem->Geo->DrawArgs.Get("triangleEq").BaseVertexLocation;
+	triangleEqRitem->LocalBounds = triangleEqRitem->Geo->DrawArgs.Get("triangleEq").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(triangleEqRitem.get());
 	mAllRitems.push_back(std::move(triangleEqRitem));
 
@@ -1830,12 +2747,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&triangleRectSqrRitem->World, XMMatrixScaling(2.5f, 2.5f, 2.5f)* XMMatrixTranslation(12.0f, yLevel + 13.5f, -15.0f));
 	XMStoreFloat4x4(&triangleRectSqrRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	triangleRectSqrRitem->ObjCBIndex = 13; 
-	triangleRectSqrRitem->Mat = mMaterials["bricks"].get();
-	triangleRectSqrRitem->Geo = mGeometries["shapeGeo"].get();
+	triangleRectSqrRitem->Mat = mMaterials.Get("bricks").get();
+	triangleRectSqrRitem->Geo = mGeometries.Get("shapeGeo").get();
 	triangleRectSqrRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	triangleRectSqrRitem->IndexCount = triangleRectSqrRitem->Geo->DrawArgs["triangleRectSqr"].IndexCount;
-	triangleRectSqrRitem->StartIndexLocation = triangleRectSqrRitem->Geo->DrawArgs["triangleRectSqr"].StartIndexLocation;
-	triangleRectSqrRitem->BaseVertexLocation = triangleRectSqrRitem->Geo->DrawArgs["triangleRectSqr"].BaseVertexLocation;
+	triangleRectSqrRitem->IndexCount = triangleRectSqrRitem->Geo->DrawArgs.Get("triangleRectSqr").IndexCount;
+	triangleRectSqrRitem->StartIndexLocation = triangleRectSqrRitem->Geo->DrawArgs.Get("triangleRectSqr").StartIndexLocation;
+	triangleRectSqrRitem->BaseVertexLocation = triangleRectSqrRitem->Geo->DrawArgs.Get("triangleRectSqr").BaseVertexLocation;
+	triangleRectSqrRitem->LocalBounds = triangleRectSqrRitem->Geo->DrawArgs.Get("triangleRectSqr").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(triangleRectSqrRitem.get());
 	mAllRitems.push_back(std::move(triangleRectSqrRitem));
 
@@ -1843,12 +2761,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&leftCastleWall->World, XMMatrixScaling(2.0f, 30.0f, 20.0f)*XMMatrixTranslation(-15.0f, yLevel + 7.5f, 0.0f));
 	XMStoreFloat4x4(&leftCastleWall->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	leftCastleWall->ObjCBIndex = 14;
-	leftCastleWall->Mat = mMaterials["stone"].get();
-	leftCastleWall->Geo = mGeometries["shapeGeo"].get();
+	leftCastleWall->Mat = mMaterials.Get("stone").get();
+	leftCastleWall->Geo = mGeometries.Get("shapeGeo").get();
 	leftCastleWall->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	leftCastleWall->IndexCount = leftCastleWall->Geo->DrawArgs["box"].IndexCount;
-	leftCastleWall->StartIndexLocation = leftCastleWall->Geo->DrawArgs["box"].StartIndexLocation;
-	leftCastleWall->BaseVertexLocation = leftCastleWall->Geo->DrawArgs["box"].BaseVertexLocation;
+	leftCastleWall->IndexCount = leftCastleWall->Geo->DrawArgs.Get("box").IndexCount;
+	leftCastleWall->StartIndexLocation = leftCastleWall->Geo->DrawArgs.Get("box").StartIndexLocation;
+	leftCastleWall->BaseVertexLocation = leftCastleWall->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	leftCastleWall->LocalBounds = leftCastleWall->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(leftCastleWall.get());
 	mAllRitems.push_back(std::move(leftCastleWall));
 
@@ -1856,12 +2775,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&rightCastleWall->World, XMMatrixScaling(2.0f, 30.0f, 20.0f)*XMMatrixTranslation(15.0f, yLevel + 7.5f, 0.0f));
 	XMStoreFloat4x4(&rightCastleWall->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	rightCastleWall->ObjCBIndex = 15;
-	rightCastleWall->Mat = mMaterials["stone"].get();
-	rightCastleWall->Geo = mGeometries["shapeGeo"].get();
+	rightCastleWall->Mat = mMaterials.Get("stone").get();
+	rightCastleWall->Geo = mGeometries.Get("shapeGeo").get();
 	rightCastleWall->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	rightCastleWall->IndexCount = rightCastleWall->Geo->DrawArgs["box"].IndexCount;
-	rightCastleWall->StartIndexLocation = rightCastleWall->Geo->DrawArgs["box"].StartIndexLocation;
-	rightCastleWall->BaseVertexLocation = rightCastleWall->Geo->DrawArgs["box"].BaseVertexLocation;
+	rightCastleWall->IndexCount = rightCastleWall->Geo->DrawArgs.Get("box").IndexCount;
+	rightCastleWall->StartIndexLocation = rightCastleWall->Geo->DrawArgs.Get("box").StartIndexLocation;
+	rightCastleWall->BaseVertexLocation = rightCastleWall->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	rightCastleWall->LocalBounds = rightCastleWall->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(rightCastleWall.get());
 	mAllRitems.push_back(std::move(rightCastleWall));
 
@@ -1869,12 +2789,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&backCastleWall->World, XMMatrixScaling(22.0f, 24.0f, 2.0f)*XMMatrixTranslation(0.0f, yLevel + 6.0f, 15.0f));
 	XMStoreFloat4x4(&backCastleWall->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	backCastleWall->ObjCBIndex = 16;
-	backCastleWall->Mat = mMaterials["stone"].get();
-	backCastleWall->Geo = mGeometries["shapeGeo"].get();
+	backCastleWall->Mat = mMaterials.Get("stone").get();
+	backCastleWall->Geo = mGeometries.Get("shapeGeo").get();
 	backCastleWall->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	backCastleWall->IndexCount = backCastleWall->Geo->DrawArgs["box"].IndexCount;
-	backCastleWall->StartIndexLocation = backCastleWall->Geo->DrawArgs["box"].StartIndexLocation;
-	backCastleWall->BaseVertexLocation = backCastleWall->Geo->DrawArgs["box"].BaseVertexLocation;
+	backCastleWall->IndexCount = backCastleWall->Geo->DrawArgs.Get("box").IndexCount;
+	backCastleWall->StartIndexLocation = backCastleWall->Geo->DrawArgs.Get("box").StartIndexLocation;
+	backCastleWall->BaseVertexLocation = backCastleWall->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	backCastleWall->LocalBounds = backCastleWall->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(backCastleWall.get());
 	mAllRitems.push_back(std::move(backCastleWall));
 
@@ -1882,12 +2803,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&frontLeftCastleWall->World, XMMatrixScaling(7.0f, 24.0f, 2.0f)*XMMatrixTranslation(-10.0f, yLevel + 6.0f, -15.0f));
 	XMStoreFloat4x4(&frontLeftCastleWall->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	frontLeftCastleWall->ObjCBIndex = 17;
-	frontLeftCastleWall->Mat = mMaterials["stone"].get();
-	frontLeftCastleWall->Geo = mGeometries["shapeGeo"].get();
+	frontLeftCastleWall->Mat = mMaterials.Get("stone").get();
+	frontLeftCastleWall->Geo = mGeometries.Get("shapeGeo").get();
 	frontLeftCastleWall->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	frontLeftCastleWall->IndexCount = frontLeftCastleWall->Geo->DrawArgs["box"].IndexCount;
-	frontLeftCastleWall->StartIndexLocation = frontLeftCastleWall->Geo->DrawArgs["box"].StartIndexLocation;
-	frontLeftCastleWall->BaseVertexLocation = frontLeftCastleWall->Geo->DrawArgs["box"].BaseVertexLocation;
+	frontLeftCastleWall->IndexCount = frontLeftCastleWall->Geo->DrawArgs.Get("box").IndexCount;
+	frontLeftCastleWall->StartIndexLocation = frontLeftCastleWall->Geo->DrawArgs.Get("box").StartIndexLocation;
+	frontLeftCastleWall->BaseVertexLocation = frontLeftCastleWall->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	frontLeftCastleWall->LocalBounds = frontLeftCastleWall->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(frontLeftCastleWall.get());
 	mAllRitems.push_back(std::move(frontLeftCastleWall));
 
@@ -1895,12 +2817,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&frontRightCastleWall->World, XMMatrixScaling(7.0f, 24.0f, 2.0f)*XMMatrixTranslation(10.0f, yLevel + 6.0f, -15.0f));
 	XMStoreFloat4x4(&frontRightCastleWall->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	frontRightCastleWall->ObjCBIndex = 18;
-	frontRightCastleWall->Mat = mMaterials["stone"].get();
-	frontRightCastleWall->Geo = mGeometries["shapeGeo"].get();
+	frontRightCastleWall->Mat = mMaterials.Get("stone").get();
+	frontRightCastleWall->Geo = mGeometries.Get("shapeGeo").get();
 	frontRightCastleWall->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	frontRightCastleWall->IndexCount = frontRightCastleWall->Geo->DrawArgs["box"].IndexCount;
-	frontRightCastleWall->StartIndexLocation = frontRightCastleWall->Geo->DrawArgs["box"].StartIndexLocation;
-	frontRightCastleWall->BaseVertexLocation = frontRightCastleWall->Geo->DrawArgs["box"].BaseVertexLocation;
+	frontRightCastleWall->IndexCount = frontRightCastleWall->Geo->DrawArgs.Get("box").IndexCount;
+	frontRightCastleWall->StartIndexLocation = frontRightCastleWall->Geo->DrawArgs.Get("box").StartIndexLocation;
+	frontRightCastleWall->BaseVertexLocation = frontRightCastleWall->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	frontRightCastleWall->LocalBounds = frontRightCastleWall->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(frontRightCastleWall.get());
 	mAllRitems.push_back(std::move(frontRightCastleWall));
 
@@ -1908,12 +2831,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&frontRightCastlePillar->World, XMMatrixScaling(2.0f, 40.0f, 2.0f)*XMMatrixTranslation(15.1f, yLevel + 8.5f, -15.1f));
 	XMStoreFloat4x4(&frontRightCastlePillar->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	frontRightCastlePillar->ObjCBIndex = 19;
-	frontRightCastlePillar->Mat = mMaterials["stone"].get();
-	frontRightCastlePillar->Geo = mGeometries["shapeGeo"].get();
+	frontRightCastlePillar->Mat = mMaterials.Get("stone").get();
+	frontRightCastlePillar->Geo = mGeometries.Get("shapeGeo").get();
 	frontRightCastlePillar->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	frontRightCastlePillar->IndexCount = frontRightCastlePillar->Geo->DrawArgs["box"].IndexCount;
-	frontRightCastlePillar->StartIndexLocation = frontRightCastlePillar->Geo->DrawArgs["box"].StartIndexLocation;
-	frontRightCastlePillar->BaseVertexLocation = frontRightCastlePillar->Geo->DrawArgs["box"].BaseVertexLocation;
+	frontRightCastlePillar->IndexCount = frontRightCastlePillar->Geo->DrawArgs.Get("box").IndexCount;
+	frontRightCastlePillar->StartIndexLocation = frontRightCastlePillar->Geo->DrawArgs.Get("box").StartIndexLocation;
+	frontRightCastlePillar->BaseVertexLocation = frontRightCastlePillar->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	frontRightCastlePillar->LocalBounds = frontRightCastlePillar->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(frontRightCastlePillar.get());
 	mAllRitems.push_back(std::move(frontRightCastlePillar));
 
@@ -1921,12 +2845,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&frontLeftCastlePillar->World, XMMatrixScaling(2.0f, 40.0f, 2.0f)*XMMatrixTranslation(-15.1f, yLevel + 8.5f, -15.1f));
 	XMStoreFloat4x4(&frontLeftCastlePillar->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	frontLeftCastlePillar->ObjCBIndex = 20;
-	frontLeftCastlePillar->Mat = mMaterials["stone"].get();
-	frontLeftCastlePillar->Geo = mGeometries["shapeGeo"].get();
+	frontLeftCastlePillar->Mat = mMaterials.Get("stone").get();
+	frontLeftCastlePillar->Geo = mGeometries.Get("shapeGeo").get();
 	frontLeftCastlePillar->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	frontLeftCastlePillar->IndexCount = frontLeftCastlePillar->Geo->DrawArgs["box"].IndexCount;
-	frontLeftCastlePillar->StartIndexLocation = frontLeftCastlePillar->Geo->DrawArgs["box"].StartIndexLocation;
-	frontLeftCastlePillar->BaseVertexLocation = frontLeftCastlePillar->Geo->DrawArgs["box"].BaseVertexLocation;
+	frontLeftCastlePillar->IndexCount = frontLeftCastlePillar->Geo->DrawArgs.Get("box").IndexCount;
+	frontLeftCastlePillar->StartIndexLocation = frontLeftCastlePillar->Geo->DrawArgs.Get("box").StartIndexLocation;
+	frontLeftCastlePillar->BaseVertexLocation = frontLeftCastlePillar->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	frontLeftCastlePillar->LocalBounds = frontLeftCastlePillar->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(frontLeftCastlePillar.get());
 	mAllRitems.push_back(std::move(frontLeftCastlePillar));
 
@@ -1935,12 +2860,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&backLeftCastlePillar->World, XMMatrixScaling(2.0f, 40.0f, 2.0f)*XMMatrixTranslation(-15.0f, yLevel + 8.5f, 15.0f));
 	XMStoreFloat4x4(&backLeftCastlePillar->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	backLeftCastlePillar->ObjCBIndex = 21;
-	backLeftCastlePillar->Mat = mMaterials["stone"].get();
-	backLeftCastlePillar->Geo = mGeometries["shapeGeo"].get();
+	backLeftCastlePillar->Mat = mMaterials.Get("stone").get();
+	backLeftCastlePillar->Geo = mGeometries.Get("shapeGeo").get();
 	backLeftCastlePillar->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	backLeftCastlePillar->IndexCount = backLeftCastlePillar->Geo->DrawArgs["box"].IndexCount;
-	backLeftCastlePillar->StartIndexLocation = backLeftCastlePillar->Geo->DrawArgs["box"].StartIndexLocation;
-	backLeftCastlePillar->BaseVertexLocation = backLeftCastlePillar->Geo->DrawArgs["box"].BaseVertexLocation;
+	backLeftCastlePillar->IndexCount = backLeftCastlePillar->Geo->DrawArgs.Get("box").IndexCount;
+	backLeftCastlePillar->StartIndexLocation = backLeftCastlePillar->Geo->DrawArgs.Get("box").StartIndexLocation;
+	backLeftCastlePillar->BaseVertexLocation = backLeftCastlePillar->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	backLeftCastlePillar->LocalBounds = backLeftCastlePillar->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(backLeftCastlePillar.get());
 	mAllRitems.push_back(std::move(backLeftCastlePillar));
 
@@ -1949,12 +2875,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&backRightCastlePillar->World, XMMatrixScaling(2.0f, 40.0f, 2.0f)*XMMatrixTranslation(15.0f, yLevel + 8.5f, 15.0f));
 	XMStoreFloat4x4(&backRightCastlePillar->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	backRightCastlePillar->ObjCBIndex = 22;
-	backRightCastlePillar->Mat = mMaterials["stone"].get();
-	backRightCastlePillar->Geo = mGeometries["shapeGeo"].get();
+	backRightCastlePillar->Mat = mMaterials.Get("stone").get();
+	backRightCastlePillar->Geo = mGeometries.Get("shapeGeo").get();
 	backRightCastlePillar->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	backRightCastlePillar->IndexCount = backRightCastlePillar->Geo->DrawArgs["box"].IndexCount;
-	backRightCastlePillar->StartIndexLocation = backRightCastlePillar->Geo->DrawArgs["box"].StartIndexLocation;
-	backRightCastlePillar->BaseVertexLocation = backRightCastlePillar->Geo->DrawArgs["box"].BaseVertexLocation;
+	backRightCastlePillar->IndexCount = backRightCastlePillar->Geo->DrawArgs.Get("box").IndexCount;
+	backRightCastlePillar->StartIndexLocation = backRightCastlePillar->Geo->DrawArgs.Get("box").StartIndexLocation;
+	backRightCastlePillar->BaseVertexLocation = backRightCastlePillar->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	backRightCastlePillar->LocalBounds = backRightCastlePillar->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(backRightCastlePillar.get());
 	mAllRitems.push_back(std::move(backRightCastlePillar));
 
@@ -1963,12 +2890,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&frontCastleWallUp->World, XMMatrixScaling(22.0f, 8.0f, 1.5f)*XMMatrixTranslation(0.0f, yLevel + 9.0f, -15.0f));
 	XMStoreFloat4x4(&frontCastleWallUp->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	frontCastleWallUp->ObjCBIndex = 23;
-	frontCastleWallUp->Mat = mMaterials["stone"].get();
-	frontCastleWallUp->Geo = mGeometries["shapeGeo"].get();
+	frontCastleWallUp->Mat = mMaterials.Get("stone").get();
+	frontCastleWallUp->Geo = mGeometries.Get("shapeGeo").get();
 	frontCastleWallUp->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	frontCastleWallUp->IndexCount = frontCastleWallUp->Geo->DrawArgs["box"].IndexCount;
-	frontCastleWallUp->StartIndexLocation = frontCastleWallUp->Geo->DrawArgs["box"].StartIndexLocation;
-	frontCastleWallUp->BaseVertexLocation = frontCastleWallUp->Geo->DrawArgs["box"].BaseVertexLocation;
+	frontCastleWallUp->IndexCount = frontCastleWallUp->Geo->DrawArgs.Get("box").IndexCount;
+	frontCastleWallUp->StartIndexLocation = frontCastleWallUp->Geo->DrawArgs.Get("box").StartIndexLocation;
+	frontCastleWallUp->BaseVertexLocation = frontCastleWallUp->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	frontCastleWallUp->LocalBounds = frontCastleWallUp->Geo->DrawArgs.Get("box").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(frontCastleWallUp.get());
 	mAllRitems.push_back(std::move(frontCastleWallUp));
 
@@ -1976,12 +2904,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&triangleRectSqrBack->World, XMMatrixScaling(2.5f, 2.5f, 2.5f)* XMMatrixTranslation(12.0f, yLevel + 13.5f, 15.0f));
 	XMStoreFloat4x4(&triangleRectSqrBack->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	triangleRectSqrBack->ObjCBIndex = 24;
-	triangleRectSqrBack->Mat = mMaterials["bricks"].get();
-	triangleRectSqrBack->Geo = mGeometries["shapeGeo"].get();
+	triangleRectSqrBack->Mat = mMaterials.Get("bricks").get();
+	triangleRectSqrBack->Geo = mGeometries.Get("shapeGeo").get();
 	triangleRectSqrBack->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	triangleRectSqrBack->IndexCount = triangleRectSqrBack->Geo->DrawArgs["triangleRectSqr"].IndexCount;
-	triangleRectSqrBack->StartIndexLocation = triangleRectSqrBack->Geo->DrawArgs["triangleRectSqr"].StartIndexLocation;
-	triangleRectSqrBack->BaseVertexLocation = triangleRectSqrBack->Geo->DrawArgs["triangleRectSqr"].BaseVertexLocation;
+	triangleRectSqrBack->IndexCount = triangleRectSqrBack->Geo->DrawArgs.Get("triangleRectSqr").IndexCount;
+	triangleRectSqrBack->StartIndexLocation = triangleRectSqrBack->Geo->DrawArgs.Get("triangleRectSqr").StartIndexLocation;
+	triangleRectSqrBack->BaseVertexLocation = triangleRectSqrBack->Geo->DrawArgs.Get("triangleRectSqr").BaseVertexLocation;
+	triangleRectSqrBack->LocalBounds = triangleRectSqrBack->Geo->DrawArgs.Get("triangleRectSqr").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(triangleRectSqrBack.get());
 	mAllRitems.push_back(std::move(triangleRectSqrBack));
 
@@ -1989,12 +2918,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&triangleRectSqrBackLeft->World, XMMatrixScaling(2.5f, 2.5f, 2.5f) * XMMatrixRotationY(3.12) * XMMatrixTranslation(-12.0f, yLevel + 13.5f, 15.0f));
 	XMStoreFloat4x4(&triangleRectSqrBackLeft->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	triangleRectSqrBackLeft->ObjCBIndex = 25;
-	triangleRectSqrBackLeft->Mat = mMaterials["bricks"].get();
-	triangleRectSqrBackLeft->Geo = mGeometries["shapeGeo"].get();
+	triangleRectSqrBackLeft->Mat = mMaterials.Get("bricks").get();
+	triangleRectSqrBackLeft->Geo = mGeometries.Get("shapeGeo").get();
 	triangleRectSqrBackLeft->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	triangleRectSqrBackLeft->IndexCount = triangleRectSqrBackLeft->Geo->DrawArgs["triangleRectSqr"].IndexCount;
-	triangleRectSqrBackLeft->StartIndexLocation = triangleRectSqrBackLeft->Geo->DrawArgs["triangleRectSqr"].StartIndexLocation;
-	triangleRectSqrBackLeft->BaseVertexLocation = triangleRectSqrBackLeft->Geo->DrawArgs["triangleRectSqr"].BaseVertexLocation;
+	triangleRectSqrBackLeft->IndexCount = triangleRectSqrBackLeft->Geo->DrawArgs.Get("triangleRectSqr").IndexCount;
+	triangleRectSqrBackLeft->StartIndexLocation = triangleRectSqrBackLeft->Geo->DrawArgs.Get("triangleRectSqr").StartIndexLocation;
+	triangleRectSqrBackLeft->BaseVertexLocation = triangleRectSqrBackLeft->Geo->DrawArgs.Get("triangleRectSqr").BaseVertexLocation;
+	triangleRectSqrBackLeft->LocalBounds = triangleRectSqrBackLeft->Geo->DrawArgs.Get("triangleRectSqr").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(triangleRectSqrBackLeft.get());
 	mAllRitems.push_back(std::move(triangleRectSqrBackLeft));
 
@@ -2002,12 +2932,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&triangleRectSqrFrontLeft->World, XMMatrixScaling(2.5f, 2.5f, 2.5f) * XMMatrixRotationY(3.12)* XMMatrixTranslation(-12.0f, yLevel + 13.5f, -15.0f));
 	XMStoreFloat4x4(&triangleRectSqrFrontLeft->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	triangleRectSqrFrontLeft->ObjCBIndex = 26;
-	triangleRectSqrFrontLeft->Mat = mMaterials["bricks"].get();
-	triangleRectSqrFrontLeft->Geo = mGeometries["shapeGeo"].get();
+	triangleRectSqrFrontLeft->Mat = mMaterials.Get("bricks").get();
+	triangleRectSqrFrontLeft->Geo = mGeometries.Get("shapeGeo").get();
 	triangleRectSqrFrontLeft->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	triangleRectSqrFrontLeft->IndexCount = triangleRectSqrFrontLeft->Geo->DrawArgs["triangleRectSqr"].IndexCount;
-	triangleRectSqrFrontLeft->StartIndexLocation = triangleRectSqrFrontLeft->Geo->DrawArgs["triangleRectSqr"].StartIndexLocation;
-	triangleRectSqrFrontLeft->BaseVertexLocation = triangleRectSqrFrontLeft->Geo->DrawArgs["triangleRectSqr"].BaseVertexLocation;
+	triangleRectSqrFrontLeft->IndexCount = triangleRectSqrFrontLeft->Geo->DrawArgs.Get("triangleRectSqr").IndexCount;
+	triangleRectSqrFrontLeft->StartIndexLocation = triangleRectSqrFrontLeft->Geo->DrawArgs.Get("triangleRectSqr").StartIndexLocation;
+	triangleRectSqrFrontLeft->BaseVertexLocation = triangleRectSqrFrontLeft->Geo->DrawArgs.Get("triangleRectSqr").BaseVertexLocation;
+	triangleRectSqrFrontLeft->LocalBounds = triangleRectSqrFrontLeft->Geo->DrawArgs.Get("triangleRectSqr").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(triangleRectSqrFrontLeft.get());
 	mAllRitems.push_back(std::move(triangleRectSqrFrontLeft));
 
@@ -2015,12 +2946,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&triangleright->World, XMMatrixScaling(2.0f, 2.0f, 15.0f)* XMMatrixTranslation(15.0f, yLevel + 16.0f, -0.0f));
 	XMStoreFloat4x4(&triangleright->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	triangleright->ObjCBIndex = 27;
-	triangleright->Mat = mMaterials["bricks"].get();
-	triangleright->Geo = mGeometries["shapeGeo"].get();
+	triangleright->Mat = mMaterials.Get("bricks").get();
+	triangleright->Geo = mGeometries.Get("shapeGeo").get();
 	triangleright->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	triangleright->IndexCount = triangleright->Geo->DrawArgs["triangleEq"].IndexCount;
-	triangleright->StartIndexLocation = triangleright->Geo->DrawArgs["triangleEq"].StartIndexLocation;
-	triangleright->BaseVertexLocation = triangleright->Geo->DrawArgs["triangleEq"].BaseVertexLocation;
+	triangleright->IndexCount = triangleright->Geo->DrawArgs.Get("triangleEq").IndexCount;
+	triangleright->StartIndexLocation = triangleright->Geo->DrawArgs.Get("triangleEq").StartIndexLocation;
+	triangleright->BaseVertexLocation = triangleright->Geo->DrawArgs.Get("triangleEq").BaseVertexLocation;
+	triangleright->LocalBounds = triangleright->Geo->DrawArgs.Get("triangleEq").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(triangleright.get());
 	mAllRitems.push_back(std::move(triangleright));
 
@@ -2028,12 +2960,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&pyramidFrontLeft->World, XMMatrixScaling(4.0f, 4.0f, 4.0f)* XMMatrixTranslation(-15.0f, yLevel + 18.0f, -15.0f));
 	XMStoreFloat4x4(&pyramidFrontLeft->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	pyramidFrontLeft->ObjCBIndex = 28;
-	pyramidFrontLeft->Mat = mMaterials["bricks"].get();
-	pyramidFrontLeft->Geo = mGeometries["shapeGeo"].get();
+	pyramidFrontLeft->Mat = mMaterials.Get("bricks").get();
+	pyramidFrontLeft->Geo = mGeometries.Get("shapeGeo").get();
 	pyramidFrontLeft->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	pyramidFrontLeft->IndexCount = pyramidFrontLeft->Geo->DrawArgs["pyramid"].IndexCount;
-	pyramidFrontLeft->StartIndexLocation = pyramidFrontLeft->Geo->DrawArgs["pyramid"].StartIndexLocation;
-	pyramidFrontLeft->BaseVertexLocation = pyramidFrontLeft->Geo->DrawArgs["pyramid"].BaseVertexLocation;
+	pyramidFrontLeft->IndexCount = pyramidFrontLeft->Geo->DrawArgs.Get("pyramid").IndexCount;
+	pyramidFrontLeft->StartIndexLocation = pyramidFrontLeft->Geo->DrawArgs.Get("pyramid").StartIndexLocation;
+	pyramidFrontLeft->BaseVertexLocation = pyramidFrontLeft->Geo->DrawArgs.Get("pyramid").BaseVertexLocation;
+	pyramidFrontLeft->LocalBounds = pyramidFrontLeft->Geo->DrawArgs.Get("pyramid").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(pyramidFrontLeft.get());
 	mAllRitems.push_back(std::move(pyramidFrontLeft));
 
@@ -2041,12 +2974,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&pyramidBackLeft->World, XMMatrixScaling(4.0f, 4.0f, 4.0f)* XMMatrixTranslation(-15.0f, yLevel + 18.0f, 15.0f));
 	XMStoreFloat4x4(&pyramidBackLeft->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	pyramidBackLeft->ObjCBIndex = 29;
-	pyramidBackLeft->Mat = mMaterials["bricks"].get();
-	pyramidBackLeft->Geo = mGeometries["shapeGeo"].get();
+	pyramidBackLeft->Mat = mMaterials.Get("bricks").get();
+	pyramidBackLeft->Geo = mGeometries.Get("shapeGeo").get();
 	pyramidBackLeft->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	pyramidBackLeft->IndexCount = pyramidBackLeft->Geo->DrawArgs["pyramid"].IndexCount;
-	pyramidBackLeft->StartIndexLocation = pyramidBackLeft->Geo->DrawArgs["pyramid"].StartIndexLocation;
-	pyramidBackLeft->BaseVertexLocation = pyramidBackLeft->Geo->DrawArgs["pyramid"].BaseVertexLocation;
+	pyramidBackLeft->IndexCount = pyramidBackLeft->Geo->DrawArgs.Get("pyramid").IndexCount;
+	pyramidBackLeft->StartIndexLocation = pyramidBackLeft->Geo->DrawArgs.Get("pyramid").StartIndexLocation;
+	pyramidBackLeft->BaseVertexLocation = pyramidBackLeft->Geo->DrawArgs.Get("pyramid").BaseVertexLocation;
+	pyramidBackLeft->LocalBounds = pyramidBackLeft->Geo->DrawArgs.Get("pyramid").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(pyramidBackLeft.get());
 	mAllRitems.push_back(std::move(pyramidBackLeft));
 
@@ -2054,12 +2988,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&pyramidBackRight->World, XMMatrixScaling(4.0f, 4.0f, 4.0f)* XMMatrixTranslation(15.0f, yLevel + 18.0f, 15.0f));
 	XMStoreFloat4x4(&pyramidBackRight->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	pyramidBackRight->ObjCBIndex = 30;
-	pyramidBackRight->Mat = mMaterials["bricks"].get();
-	pyramidBackRight->Geo = mGeometries["shapeGeo"].get();
+	pyramidBackRight->Mat = mMaterials.Get("bricks").get();
+	pyramidBackRight->Geo = mGeometries.Get("shapeGeo").get();
 	pyramidBackRight->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	pyramidBackRight->IndexCount = pyramidBackRight->Geo->DrawArgs["pyramid"].IndexCount;
-	pyramidBackRight->StartIndexLocation = pyramidBackRight->Geo->DrawArgs["pyramid"].StartIndexLocation;
-	pyramidBackRight->BaseVertexLocation = pyramidBackRight->Geo->DrawArgs["pyramid"].BaseVertexLocation;
+	pyramidBackRight->IndexCount = pyramidBackRight->Geo->DrawArgs.Get("pyramid").IndexCount;
+	pyramidBackRight->StartIndexLocation = pyramidBackRight->Geo->DrawArgs.Get("pyramid").StartIndexLocation;
+	pyramidBackRight->BaseVertexLocation = pyramidBackRight->Geo->DrawArgs.Get("pyramid").BaseVertexLocation;
+	pyramidBackRight->LocalBounds = pyramidBackRight->Geo->DrawArgs.Get("pyramid").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(pyramidBackRight.get());
 	mAllRitems.push_back(std::move(pyramidBackRight));
 
@@ -2067,12 +3002,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&rhomboLitem->World, XMMatrixScaling(1.0f, 1.0f, 1.0f)* XMMatrixTranslation(-6.7f, yLevel + 8.0f, -17.0f));
 	XMStoreFloat4x4(&rhomboLitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	rhomboLitem->ObjCBIndex = 31;
-	rhomboLitem->Mat = mMaterials["pyramid"].get();//888
-	rhomboLitem->Geo = mGeometries["shapeGeo"].get();
+	rhomboLitem->Mat = mMaterials.Get("pyramid").get();//888
+	rhomboLitem->Geo = mGeometries.Get("shapeGeo").get();
 	rhomboLitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	rhomboLitem->IndexCount = rhomboLitem->Geo->DrawArgs["rhombo"].IndexCount;
-	rhomboLitem->StartIndexLocation = rhomboLitem->Geo->DrawArgs["rhombo"].StartIndexLocation;
-	rhomboLitem->BaseVertexLocation = rhomboLitem->Geo->DrawArgs["rhombo"].BaseVertexLocation;
+	rhomboLitem->IndexCount = rhomboLitem->Geo->DrawArgs.Get("rhombo").IndexCount;
+	rhomboLitem->StartIndexLocation = rhomboLitem->Geo->DrawArgs.Get("rhombo").StartIndexLocation;
+	rhomboLitem->BaseVertexLocation = rhomboLitem->Geo->DrawArgs.Get("rhombo").BaseVertexLocation;
+	rhomboLitem->LocalBounds = rhomboLitem->Geo->DrawArgs.Get("rhombo").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(rhomboLitem.get());
 	mAllRitems.push_back(std::move(rhomboLitem));
 
@@ -2080,12 +3016,13 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&prismRitem->World, XMMatrixScaling(0.1f, 0.2f, 0.1f)* XMMatrixTranslation(0.0f, yLevel + 20.0f, 0.0f));
 	XMStoreFloat4x4(&prismRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	prismRitem->ObjCBIndex = 32;
-	prismRitem->Mat = mMaterials["pyramid"].get();
-	prismRitem->Geo = mGeometries["shapeGeo"].get();
+	prismRitem->Mat = mMaterials.Get("pyramid").get();
+	prismRitem->Geo = mGeometries.Get("shapeGeo").get();
 	prismRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	prismRitem->IndexCount = prismRitem->Geo->DrawArgs["prism"].IndexCount;
-	prismRitem->StartIndexLocation = prismRitem->Geo->DrawArgs["prism"].StartIndexLocation;
-	prismRitem->BaseVertexLocation = prismRitem->Geo->DrawArgs["prism"].BaseVertexLocation;
+	prismRitem->IndexCount = prismRitem->Geo->DrawArgs.Get("prism").IndexCount;
+	prismRitem->StartIndexLocation = prismRitem->Geo->DrawArgs.Get("prism").StartIndexLocation;
+	prismRitem->BaseVertexLocation = prismRitem->Geo->DrawArgs.Get("prism").BaseVertexLocation;
+	prismRitem->LocalBounds = prismRitem->Geo->DrawArgs.Get("prism").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(prismRitem.get());
 	mAllRitems.push_back(std::move(prismRitem));
 	
@@ -2094,46 +3031,196 @@ void DirectXAssignmentFinalApp::BuildRenderItems()
 	XMStoreFloat4x4(&skullRitem->World, XMMatrixScaling(0.5f, 0.5f, 0.5f)*XMMatrixTranslation(0.0f, yLevel + 14.0f, 0.0f));
 	skullRitem->TexTransform = MathHelper::Identity4x4();
 	skullRitem->ObjCBIndex = 33;
-	skullRitem->Mat = mMaterials["stone"].get();
-	skullRitem->Geo = mGeometries["skullGeo"].get();
+	skullRitem->Mat = mMaterials.Get("stone").get();
+	skullRitem->Geo = mGeometries.Get("skullGeo").get();
 	skullRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
-	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["box"].StartIndexLocation;
-	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	skullRitem->IndexCount = skullRitem->Geo->DrawArgs.Get("skull").IndexCount;
+	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs.Get("box").StartIndexLocation;
+	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs.Get("box").BaseVertexLocation;
+	skullRitem->LocalBounds = skullRitem->Geo->DrawArgs.Get("skull").Bounds;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(skullRitem.get());
 	mAllRitems.push_back(std::move(skullRitem));
-    
+
+	for(int i = 0; i < (int)RenderLayer::Count; ++i)
+	{
+		for(auto ri : mRitemLayer[i])
+			ri->Layer = (RenderLayer)i;
+	}
+
+	// None of the items move after creation, so the world bounds and the hierarchy
+	// over them only need building once.  Moving items would call SceneBVH::Refit.
+	std::vector<BoundingBox> itemBounds;
+	for(auto& ri : mAllRitems)
+	{
+		ri->UpdateWorldBounds();
+		itemBounds.push_back(ri->Bounds);
+	}
+
+	mSceneBVH.Build(itemBounds);
 }
 
-void DirectXAssignmentFinalApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void DirectXAssignmentFinalApp::BuildSceneLights()
 {
-    UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-    UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+	mMainPassCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
 
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-	auto matCB = mCurrFrameResource->MaterialCB->Resource();
+	//inner castle light
+	Light inner;
+	inner.Direction = { 0.57735f, -0.57735f, 0.57735f };
+	inner.Strength = { 0.6f, 0.6f, 0.6f };
+	mLightManager.Create(LightType::Directional, inner);
 
-    // For each render item...
-    for(size_t i = 0; i < ritems.size(); ++i)
-    {
-        auto ri = ritems[i];
+	//Directional Light
+	Light key;
+	key.Direction = { -0.57735f, -0.57735f, 0.57735f };
+	key.Strength = { 0.3f, 0.3f, 0.3f };
+	mLightManager.Create(LightType::Directional, key);
 
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-        cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+	//Directional Light  Red
+	Light red;
+	red.Direction = { 0.0f, -0.707f, -0.707f };
+	red.Strength = { 1.0f, -0.5f, -0.55f };
+	mLightManager.Create(LightType::Directional, red);
 
-		CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+	// Point and spot lights are not part of cbPass; they are binned into each view's
+	// clusters by UpdateLightClusters.  UpdateSceneLights picks all of them up.
+	//Point light //blue Skull
+	Light skull;
+	skull.Position = { 0.0f, 29.5f, -2.0f };
+	skull.FalloffStart = 0.0f;
+	skull.Strength = { 0.0f, 0.0f, 4.0f };
+	skull.FalloffEnd = 10.f;
+	mLightManager.Create(LightType::Point, skull);
 
-        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
-		D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex*matCBByteSize;
+	//Point light Sun
+	Light sun;
+	sun.Position = { -20.7f, 50.0f, 30.0 };
+	sun.FalloffStart = 0.0f;
+	sun.Strength = { 0.93f*2.f, 0.99f*2.f, 4.f };
+	sun.FalloffEnd = 10.f;
+	mLightManager.Create(LightType::Point, sun);
 
-		cmdList->SetGraphicsRootDescriptorTable(0, tex);
-        cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
-        cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+	////Spot light On Left Tower Front
+	Light leftFront;
+	leftFront.FalloffStart = 0.0f;
+	leftFront.Strength = { 2.0f, 2.0f, 2.0f };
+	leftFront.FalloffEnd = 10.f;
+	leftFront.Direction = { -26.0f, 0.0f, -75.0f };
+	leftFront.SpotPower = 0.8f;
+	leftFront.Position = { -3.f, 17.0f, -17.f };
+	mLightManager.Create(LightType::Spot, leftFront);
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
-    }
+	////Spot light On right Tower 
+	Light right;
+	right.FalloffStart = 0.0f;
+	right.Strength = { 1.3f, 1.3f, 1.3f };
+	right.FalloffEnd = 10.f;
+	right.Direction = { 15.0f, 0.0f, -17.0f };
+	right.SpotPower = 1.0f;
+	right.Position = { 7.0f, 17.0f, 0.f };
+	mLightManager.Create(LightType::Spot, right);
+
+	////Spot light On Left Tower
+	Light left;
+	left.FalloffStart = 0.0f;
+	left.Strength = { 1.3f, 1.3f, 1.3f };
+	left.FalloffEnd = 10.f;
+	left.Direction = { -15.0f, 0.0f, -17.0f };
+	left.SpotPower = 1.0f;
+	left.Position = { -7.0f, 17.0f, 0.f };
+	mLightManager.Create(LightType::Spot, left);
+}
+
+void DirectXAssignmentFinalApp::BuildRenderViews()
+{
+	auto mainView = std::make_unique<RenderView>();
+	mainView->Name = "main";
+	mainView->Cam.SetPosition(0.0f, 22.0f, -60.0f);
+	mViews.push_back(std::move(mainView));
+
+	if(mSplitScreen)
+	{
+		mViews[0]->ScreenRect = XMFLOAT4(0.0f, 0.0f, 0.5f, 1.0f);
+
+		auto overhead = std::make_unique<RenderView>();
+		overhead->Name = "overhead";
+		overhead->ScreenRect = XMFLOAT4(0.5f, 0.0f, 0.5f, 1.0f);
+		overhead->Cam.LookAt(XMFLOAT3(0.0f, 120.0f, -120.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f));
+		mViews.push_back(std::move(overhead));
+	}
+
+	for(size_t v = 0; v < mViews.size(); ++v)
+	{
+		RenderView& view = *mViews[v];
+		view.PassIndex = (UINT)v;
+		view.InstanceBase = (UINT)(v * mAllRitems.size());
+
+		// Fresh pass buffers hold nothing yet, so every block needs a first upload.
+		for(int i = 0; i < (int)PassBlock::Count; ++i)
+			view.PassBlockDirty[i] = gNumFrameResources;
+
+		view.Resize(mClientWidth, mClientHeight);
+		view.Cam.UpdateViewMatrix();
+	}
+}
+
+void DirectXAssignmentFinalApp::SetDrawState(ID3D12GraphicsCommandList* cmdList, const RenderView& view)
+{
+	// Command lists do not inherit state from each other, so every worker list
+	// binds the targets, heaps, root signature and pass constants itself.
+    cmdList->RSSetViewports(1, &view.Viewport);
+    cmdList->RSSetScissorRects(1, &view.ScissorRect);
+
+    cmdList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	cmdList->SetGraphicsRootSignature(mRootSignature.Get());
+
+	// The draws only change the material index; see RecordDrawBatches.
+	cmdList->SetGraphicsRootDescriptorTable(0, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	cmdList->SetGraphicsRootShaderResourceView(3, mCurrFrameResource->MaterialBuffer->Resource()->GetGPUVirtualAddress());
+
+	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
+	auto passCB = mCurrFrameResource->PassCB->Resource();
+	cmdList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress() + view.PassIndex*passCBByteSize);
+
+	auto ranges = mCurrFrameResource->ClusterRanges->Resource();
+	auto indices = mCurrFrameResource->ClusterLightIndices->Resource();
+	cmdList->SetGraphicsRootShaderResourceView(4, mCurrFrameResource->LocalLights->Resource()->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootShaderResourceView(5, ranges->GetGPUVirtualAddress() +
+		(UINT64)view.PassIndex * LightClusterer::ClusterCount * sizeof(ClusterRange));
+	cmdList->SetGraphicsRootShaderResourceView(6, indices->GetGPUVirtualAddress() +
+		(UINT64)view.PassIndex * LightClusterer::MaxLightIndices * sizeof(UINT));
+}
+
+void DirectXAssignmentFinalApp::DrawRenderItems(RenderView& view, UINT firstWorkerList)
+{
+	DrawBindings bindings;
+	for(int i = 0; i < (int)RenderLayer::Count; ++i)
+		bindings.LayerPSOs[i] = mLayerPSOs[i];
+
+	bindings.InstanceBufferAddress = mCurrFrameResource->InstanceBuffer->Resource()->GetGPUVirtualAddress() +
+		(UINT64)view.InstanceBase * sizeof(InstanceData);
+	bindings.InstanceByteSize = sizeof(InstanceData);
+
+	// Each chunk is replayed into its worker's command list on the thread that recorded it.
+	view.StateChanges = view.Recorder.Record(view.Sorter.GetSortedBatches(), bindings, mDrawWorkerCount,
+		[this, &view, firstWorkerList](UINT chunk, const CommandRecorder& recorder)
+	{
+		auto alloc = mCurrFrameResource->WorkerCmdListAllocs[firstWorkerList + chunk];
+		auto cmdList = mCurrFrameResource->WorkerCmdLists[firstWorkerList + chunk];
+
+		ThrowIfFailed(alloc->Reset());
+		ThrowIfFailed(cmdList->Reset(alloc.Get(), nullptr));
+
+		SetDrawState(cmdList.Get(), view);
+
+		D3D12CommandBackend backend(cmdList.Get());
+		recorder.Replay(backend);
+
+		ThrowIfFailed(cmdList->Close());
+	});
 }
 
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> DirectXAssignmentFinalApp::GetStaticSamplers()
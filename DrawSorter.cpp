@@ -0,0 +1,136 @@
+//***************************************************************************************
+// DrawSorter.cpp
+//***************************************************************************************
+
+#include "DrawSorter.h"
+#include <cfloat>
+
+using namespace DirectX;
+
+static_assert(DrawSorter::LayerBits + DrawSorter::GeometryBits + DrawSorter::MaterialBits +
+	DrawSorter::DepthBits <= 64, "Sort key fields do not fit in 64 bits.");
+
+namespace
+{
+	// Position of each layer in the frame: opaque geometry first, blended geometry last.
+	const UINT LayerOrder[(int)RenderLayer::Count] =
+	{
+		0, // Opaque
+		3, // Transparent
+		1, // AlphaTested
+		2, // AlphaTestedTreeSprites
+	};
+
+	uint64_t Field(UINT value, UINT bits)
+	{
+		return (uint64_t)(value & ((1u << bits) - 1));
+	}
+}
+
+uint64_t DrawSorter::MakeKey(RenderLayer layer, UINT geometryId, UINT materialId, UINT depth)
+{
+	const UINT depthMax = (1u << DepthBits) - 1;
+
+	uint64_t key = Field(LayerOrder[(int)layer], LayerBits) << (64 - LayerBits);
+
+	if(layer == RenderLayer::Transparent)
+	{
+		// Blending needs the farthest surfaces first, so depth outranks state.
+		key |= Field(depthMax - depth, DepthBits) << (64 - LayerBits - DepthBits);
+		key |= Field(geometryId, GeometryBits) << MaterialBits;
+		key |= Field(materialId, MaterialBits);
+	}
+	else
+	{
+		// Group by state, then draw nearer batches first to make early-z reject more.
+		key |= Field(geometryId, GeometryBits) << (64 - LayerBits - GeometryBits);
+		key |= Field(materialId, MaterialBits) << (64 - LayerBits - GeometryBits - MaterialBits);
+		key |= Field(depth, DepthBits);
+	}
+
+	return key;
+}
+
+UINT DrawSorter::GeometryId(const MeshGeometry* geo)
+{
+	auto it = mGeometryIds.find(geo);
+	if(it != mGeometryIds.end())
+		return it->second;
+
+	UINT id = (UINT)mGeometryIds.size();
+	assert(id < (1u << GeometryBits));
+	mGeometryIds.emplace(geo, id);
+	return id;
+}
+
+void DrawSorter::Sort(const InstanceBatcher& batcher, FXMMATRIX view, float farZ)
+{
+	const float depthScale = ((1u << DepthBits) - 1) / farZ;
+	const auto& instances = batcher.GetInstances();
+
+	// View space z of a point is the dot product with the third column of the view matrix.
+	XMMATRIX viewT = XMMatrixTranspose(view);
+	XMVECTOR depthRow = viewT.r[2];
+
+	mEntries.clear();
+	mBatches.clear();
+
+	for(int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		for(const DrawBatch& batch : batcher.GetBatches((RenderLayer)layer))
+		{
+			// A batch is as near as its nearest instance.
+			float nearest = FLT_MAX;
+			for(UINT i = 0; i < batch.InstanceCount; ++i)
+			{
+				XMVECTOR center = XMVectorSetW(XMLoadFloat3(&instances[batch.FirstInstance + i]->Bounds.Center), 1.0f);
+				nearest = std::min<float>(nearest, XMVectorGetX(XMVector4Dot(center, depthRow)));
+			}
+
+			float scaled = std::min<float>(std::max<float>(nearest * depthScale, 0.0f), (float)((1u << DepthBits) - 1));
+
+			Entry e;
+			e.Key = MakeKey(batch.Layer, GeometryId(batch.Geo), (UINT)batch.Mat->MatCBIndex, (UINT)scaled);
+			e.Batch = (UINT)mBatches.size();
+			mEntries.push_back(e);
+			mBatches.push_back(&batch);
+		}
+	}
+
+	RadixSort();
+
+	mSorted.clear();
+	for(const Entry& e : mEntries)
+		mSorted.push_back(*mBatches[e.Batch]);
+}
+
+void DrawSorter::RadixSort()
+{
+	// Least significant digit first, one byte per pass.  Each pass is stable, so the
+	// result is ordered by the whole key.
+	mScratch.resize(mEntries.size());
+
+	for(UINT shift = 0; shift < 64; shift += 8)
+	{
+		UINT counts[256] = {};
+		for(const Entry& e : mEntries)
+			counts[(e.Key >> shift) & 0xff]++;
+
+		// Every key has the same byte here, so this pass would not move anything.
+		if(counts[(mEntries.empty() ? 0 : (mEntries[0].Key >> shift) & 0xff)] == mEntries.size())
+			continue;
+
+		UINT offsets[256];
+		UINT sum = 0;
+		for(int i = 0; i < 256; ++i)
+		{
+			offsets[i] = sum;
+			sum += counts[i];
+		}
+
+		for(const Entry& e : mEntries)
+			mScratch[offsets[(e.Key >> shift) & 0xff]++] = e;
+
+		mEntries.swap(mScratch);
+	}
+}
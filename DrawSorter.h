@@ -0,0 +1,53 @@
+//***************************************************************************************
+// DrawSorter.h
+//
+// Orders the frame's draw batches by a 64-bit sort key so that batches sharing state end
+// up next to each other and submission can skip redundant state changes.  From the most
+// to the least significant bits a key holds:
+//
+//   opaque layers:  layer | geometry | material | depth (front-to-back)
+//   transparent:    layer | depth (back-to-front) | geometry | material
+//
+// The layer picks the PSO, so it also serves as the PSO field.  Keys are sorted with an
+// LSD radix sort every frame.
+//***************************************************************************************
+
+#pragma once
+
+#include "InstanceBatcher.h"
+
+class DrawSorter
+{
+public:
+	static const UINT LayerBits = 4;
+	static const UINT GeometryBits = 10;
+	static const UINT MaterialBits = 14;
+	static const UINT DepthBits = 24;
+
+	// Rebuilds the sorted batch list.  Depths are the view space z of the instance
+	// bounds, scaled by farZ into DepthBits of precision.
+	void Sort(const InstanceBatcher& batcher, DirectX::FXMMATRIX view, float farZ);
+
+	// Every layer's batches, in submission order.
+	const std::vector<DrawBatch>& GetSortedBatches()const { return mSorted; }
+
+	static uint64_t MakeKey(RenderLayer layer, UINT geometryId, UINT materialId, UINT depth);
+
+private:
+	struct Entry
+	{
+		uint64_t Key;
+		UINT Batch;
+	};
+
+	UINT GeometryId(const MeshGeometry* geo);
+	void RadixSort();
+
+	std::vector<Entry> mEntries;
+	std::vector<Entry> mScratch;
+	std::vector<const DrawBatch*> mBatches;
+	std::vector<DrawBatch> mSorted;
+
+	// Small stable ids for the key's geometry field, assigned on first use.
+	std::unordered_map<const MeshGeometry*, UINT> mGeometryIds;
+};
@@ -0,0 +1,85 @@
+//***************************************************************************************
+// DrawSubmission.cpp
+//***************************************************************************************
+
+#include "DrawSubmission.h"
+
+namespace
+{
+	// Synthetic geometry in headless runs has no GPU buffers; record a null location
+	// so the packet stream still has the shape it would have on a device.
+	D3D12_VERTEX_BUFFER_VIEW VertexView(const MeshGeometry* geo)
+	{
+		if(geo->VertexBufferGPU != nullptr)
+			return geo->VertexBufferView();
+
+		D3D12_VERTEX_BUFFER_VIEW vbv = { 0, geo->VertexBufferByteSize, geo->VertexByteStride };
+		return vbv;
+	}
+
+	D3D12_INDEX_BUFFER_VIEW IndexView(const MeshGeometry* geo)
+	{
+		if(geo->IndexBufferGPU != nullptr)
+			return geo->IndexBufferView();
+
+		D3D12_INDEX_BUFFER_VIEW ibv = { 0, geo->IndexBufferByteSize, geo->IndexFormat };
+		return ibv;
+	}
+}
+
+UINT RecordDrawBatches(CommandRecorder& recorder, const DrawBatch* batches, size_t count, const DrawBindings& bindings)
+{
+	ID3D12PipelineState* currPSO = bindings.InitialPSO;
+	const MeshGeometry* currGeo = nullptr;
+	const Material* currMat = nullptr;
+	D3D12_PRIMITIVE_TOPOLOGY currTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+	UINT stateChanges = 0;
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		const DrawBatch& batch = batches[i];
+
+		ID3D12PipelineState* pso = bindings.LayerPSOs[(int)batch.Layer];
+		if(pso != currPSO)
+		{
+			recorder.SetPipelineState(pso);
+			currPSO = pso;
+			stateChanges++;
+		}
+
+		if(batch.Geo != currGeo)
+		{
+			recorder.IASetVertexBuffer(VertexView(batch.Geo));
+			recorder.IASetIndexBuffer(IndexView(batch.Geo));
+			currGeo = batch.Geo;
+			stateChanges += 2;
+		}
+
+		if(batch.PrimitiveType != currTopology)
+		{
+			recorder.IASetPrimitiveTopology(batch.PrimitiveType);
+			currTopology = batch.PrimitiveType;
+			stateChanges++;
+		}
+
+		// The texture table and the material buffer are bound once per command list;
+		// the shaders find the material, and through it the textures, by this index.
+		if(batch.Mat != currMat)
+		{
+			recorder.SetGraphicsRoot32BitConstant(7, (UINT)batch.Mat->MatCBIndex, 0);
+			currMat = batch.Mat;
+			stateChanges++;
+		}
+
+		// SV_InstanceID does not include StartInstanceLocation, so point the root
+		// SRV at the batch's first instance instead.  This differs for every batch.
+		recorder.SetGraphicsRootShaderResourceView(1,
+			bindings.InstanceBufferAddress + (UINT64)batch.FirstInstance * bindings.InstanceByteSize);
+		stateChanges++;
+
+		recorder.DrawIndexedInstanced(batch.IndexCount, batch.InstanceCount, batch.StartIndexLocation, batch.BaseVertexLocation, 0);
+	}
+
+	return stateChanges;
+}
@@ -0,0 +1,40 @@
+//***************************************************************************************
+// DrawSubmission.h
+//
+// Turns a sorted list of draw batches into recorded commands, setting each piece of state
+// only when it differs from the previous batch.  Shared by the app's Draw and by
+// HeadlessBench, so the benchmark measures the same code path the app runs.
+//***************************************************************************************
+
+#pragma once
+
+#include "CommandRecorder.h"
+#include "InstanceBatcher.h"
+
+// Where the batches' resources live.  Root parameter slots match the app's root
+// signature: 1 instance SRV and 7 material index are set per batch; 0 texture table,
+// 2 pass CBV and 3 material buffer are bound once per command list by the caller.
+struct DrawBindings
+{
+	// PSO of each render layer, indexed by RenderLayer.
+	ID3D12PipelineState* LayerPSOs[(int)RenderLayer::Count] = {};
+
+	// PSO the command list currently has bound (the one it was reset with).
+	ID3D12PipelineState* InitialPSO = nullptr;
+
+	D3D12_GPU_VIRTUAL_ADDRESS InstanceBufferAddress = 0;
+	UINT InstanceByteSize = 0;
+};
+
+// Root parameters of the app's root signature.
+const UINT RootParameterCount = 8;
+
+// Records count batches in order and returns the number of state changes it issued.
+// Nothing but bindings.InitialPSO and the per command list parameters are assumed to
+// be bound beforehand.
+UINT RecordDrawBatches(CommandRecorder& recorder, const DrawBatch* batches, size_t count, const DrawBindings& bindings);
+
+inline UINT RecordDrawBatches(CommandRecorder& recorder, const std::vector<DrawBatch>& batches, const DrawBindings& bindings)
+{
+	return RecordDrawBatches(recorder, batches.data(), batches.size(), bindings);
+}
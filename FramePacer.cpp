@@ -0,0 +1,129 @@
+//***************************************************************************************
+// FramePacer.cpp
+//***************************************************************************************
+
+#include "FramePacer.h"
+#include <algorithm>
+#include <cassert>
+
+FramePacer::FramePacer(int depth)
+	: mSlotFences(std::max<int>(depth, 1), 0)
+{
+}
+
+int FramePacer::BeginFrame(FenceSource& fence)
+{
+	mCurrSlot = (mCurrSlot + 1) % Depth();
+
+	// A zero fence means the slot has not been submitted yet.
+	double waitMs = 0.0;
+	uint64_t slotFence = mSlotFences[mCurrSlot];
+	if(slotFence != 0 && fence.GetCompletedValue() < slotFence)
+	{
+		waitMs = fence.WaitForValue(slotFence);
+		mWaits++;
+	}
+
+	mLastWaitMs = waitMs;
+	mTotalWaitMs += waitMs;
+	mFrames++;
+
+	mWindow[mWindowNext] = waitMs;
+	mWindowNext = (mWindowNext + 1) % WindowSize;
+	if(mWindowCount < WindowSize)
+		mWindowCount++;
+
+	return mCurrSlot;
+}
+
+void FramePacer::EndFrame(uint64_t fenceValue)
+{
+	assert(mCurrSlot >= 0);
+	mSlotFences[mCurrSlot] = fenceValue;
+}
+
+double FramePacer::AverageWaitMs()const
+{
+	if(mWindowCount == 0)
+		return 0.0;
+
+	double sum = 0.0;
+	for(int i = 0; i < mWindowCount; ++i)
+		sum += mWindow[i];
+
+	return sum / mWindowCount;
+}
+
+double FramePacer::MaxWaitMs()const
+{
+	double maxWait = 0.0;
+	for(int i = 0; i < mWindowCount; ++i)
+		maxWait = std::max<double>(maxWait, mWindow[i]);
+
+	return maxWait;
+}
+
+double FramePacer::WaitedFraction()const
+{
+	if(mWindowCount == 0)
+		return 0.0;
+
+	int waited = 0;
+	for(int i = 0; i < mWindowCount; ++i)
+	{
+		if(mWindow[i] > 0.0)
+			waited++;
+	}
+
+	return (double)waited / mWindowCount;
+}
+
+double SimulatedFence::Submit(uint64_t value, double gpuMs)
+{
+	assert(mWork.empty() || value > mWork.back().Value);
+
+	// The GPU starts on the work once it is submitted and the previous work is done.
+	double start = std::max<double>(mNowMs, mGpuFreeMs);
+	mGpuFreeMs = start + gpuMs;
+
+	Work work = { value, mGpuFreeMs };
+	mWork.push_back(work);
+
+	return mGpuFreeMs;
+}
+
+uint64_t SimulatedFence::GetCompletedValue()
+{
+	uint64_t completed = 0;
+	for(const Work& work : mWork)
+	{
+		if(work.CompleteMs > mNowMs)
+			break;
+		completed = work.Value;
+	}
+
+	// Forget completed work, keeping the newest so its value is still reported.
+	auto firstPending = std::find_if(mWork.begin(), mWork.end(),
+		[this](const Work& w) { return w.CompleteMs > mNowMs; });
+	if(firstPending != mWork.begin())
+		mWork.erase(mWork.begin(), firstPending - 1);
+
+	return completed;
+}
+
+double SimulatedFence::WaitForValue(uint64_t value)
+{
+	for(const Work& work : mWork)
+	{
+		if(work.Value >= value)
+		{
+			double waited = std::max<double>(work.CompleteMs - mNowMs, 0.0);
+			mNowMs += waited;
+			return waited;
+		}
+	}
+
+	// Never submitted: a real fence would block forever.
+	assert(false && "Waiting on a fence value that was never submitted.");
+	return 0.0;
+}
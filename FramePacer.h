@@ -0,0 +1,101 @@
+//***************************************************************************************
+// FramePacer.h
+//
+// Cycles through a ring of frame resources and makes the CPU wait when it is about to
+// reuse a slot the GPU has not finished with.  The ring depth is a runtime setting, and
+// the time spent waiting is kept as pacing telemetry.
+//
+// The pacer only talks to the GPU through FenceSource, so it is plain C++: the app plugs
+// in a D3D12 fence (see D3D12FenceSource.h) and SimulatedFence stands in for a GPU when
+// the pacing logic is exercised headless.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class FenceSource
+{
+public:
+	virtual ~FenceSource() = default;
+
+	virtual uint64_t GetCompletedValue() = 0;
+
+	// Blocks until value has completed.  Returns the milliseconds spent blocked.
+	virtual double WaitForValue(uint64_t value) = 0;
+};
+
+class FramePacer
+{
+public:
+	// Frames over which the averages below are taken.
+	static const int WindowSize = 120;
+
+	explicit FramePacer(int depth);
+
+	int Depth()const { return (int)mSlotFences.size(); }
+
+	// Moves to the next slot of the ring and waits until the GPU is done with its
+	// previous use.  Returns the slot index.
+	int BeginFrame(FenceSource& fence);
+
+	// Records the fence value that signals the end of the current slot's GPU work.
+	void EndFrame(uint64_t fenceValue);
+
+	int CurrentSlot()const { return mCurrSlot; }
+
+	// Telemetry over the last WindowSize frames.
+	double LastWaitMs()const { return mLastWaitMs; }
+	double AverageWaitMs()const;
+	double MaxWaitMs()const;
+	double WaitedFraction()const;
+
+	// Totals since construction.
+	uint64_t FrameCount()const { return mFrames; }
+	uint64_t WaitCount()const { return mWaits; }
+	double TotalWaitMs()const { return mTotalWaitMs; }
+
+private:
+	std::vector<uint64_t> mSlotFences;
+	int mCurrSlot = -1;
+
+	double mWindow[WindowSize] = {};
+	int mWindowCount = 0;
+	int mWindowNext = 0;
+
+	double mLastWaitMs = 0.0;
+	double mTotalWaitMs = 0.0;
+	uint64_t mFrames = 0;
+	uint64_t mWaits = 0;
+};
+
+// A GPU stand-in with its own clock.  Submitted work completes in order, each piece
+// taking a fixed time after the previous one finishes.  The CPU side advances the clock
+// with Advance for its own work; waiting jumps the clock to the completion time.
+class SimulatedFence : public FenceSource
+{
+public:
+	// Queues GPU work signalling value on completion; values must increase.
+	// Returns the time at which the work will complete.
+	double Submit(uint64_t value, double gpuMs);
+
+	// Moves the clock forward by CPU work that does not wait on the GPU.
+	void Advance(double cpuMs) { mNowMs += cpuMs; }
+
+	double NowMs()const { return mNowMs; }
+
+	virtual uint64_t GetCompletedValue()override;
+	virtual double WaitForValue(uint64_t value)override;
+
+private:
+	struct Work
+	{
+		uint64_t Value;
+		double CompleteMs;
+	};
+
+	std::vector<Work> mWork;
+	double mNowMs = 0.0;
+	double mGpuFreeMs = 0.0;
+};
@@ -1,15 +1,43 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT maxInstanceCount, UINT materialCount, UINT waveVertCount,
+    UINT drawWorkerCount, UINT maxLocalLights)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
 
+	WorkerCmdListAllocs.resize(drawWorkerCount);
+	WorkerCmdLists.resize(drawWorkerCount);
+	for(UINT i = 0; i < drawWorkerCount; ++i)
+	{
+		ThrowIfFailed(device->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(WorkerCmdListAllocs[i].GetAddressOf())));
+
+		ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			WorkerCmdListAllocs[i].Get(), nullptr, IID_PPV_ARGS(WorkerCmdLists[i].GetAddressOf())));
+
+		// Lists are created in the recording state; close them so Draw can Reset them.
+		ThrowIfFailed(WorkerCmdLists[i]->Close());
+	}
+
+	ThrowIfFailed(device->CreateCommandAllocator(
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		IID_PPV_ARGS(EndCmdListAlloc.GetAddressOf())));
+
+	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+		EndCmdListAlloc.Get(), nullptr, IID_PPV_ARGS(EndCmdList.GetAddressOf())));
+	ThrowIfFailed(EndCmdList->Close());
+
   //  FrameCB = std::make_unique<UploadBuffer<FrameConstants>>(device, 1, true);
     PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
-    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    MaterialBuffer = std::make_unique<UploadBuffer<MaterialData>>(device, materialCount, false);
+    InstanceBuffer = std::make_unique<UploadBuffer<InstanceData>>(device, maxInstanceCount, false);
+
+    LocalLights = std::make_unique<UploadBuffer<Light>>(device, std::max<UINT>(maxLocalLights, 1), false);
+    ClusterRanges = std::make_unique<UploadBuffer<ClusterRange>>(device, passCount * LightClusterer::ClusterCount, false);
+    ClusterLightIndices = std::make_unique<UploadBuffer<UINT>>(device, passCount * LightClusterer::MaxLightIndices, false);
 
     WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
 }
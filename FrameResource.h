@@ -3,13 +3,34 @@
 #include "Common/d3dUtil.h"
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
+#include "LightClusterer.h"
+#include <cstddef>
 
-struct ObjectConstants
+// Per-instance data read by the vertex shader through SV_InstanceID.
+struct InstanceData
 {
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 };
 
+// A material as the shaders read it from the material buffer, at the index a draw
+// passes as a root constant.  The layout matches MaterialData in the shaders.
+struct MaterialData
+{
+	DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+	float Roughness = 0.25f;
+
+	// Used in texture mapping.
+	DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// Slot of the diffuse texture in the texture table, and its array slice.
+	UINT DiffuseMapIndex = 0;
+	UINT DiffuseSlice = 0;
+	UINT MaterialPad0;
+	UINT MaterialPad1;
+};
+
 struct PassConstants
 {
     DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
@@ -41,6 +62,36 @@ struct PassConstants
     Light Lights[MaxLights];
 };
 
+// PassConstants split by how often each part changes.  Each block is recomputed and
+// uploaded only when its inputs change: View when the camera or window does, Time
+// every running frame, Scene when the lights or fog are edited.
+enum class PassBlock : int
+{
+	View = 0,
+	Time,
+	Scene,
+	Count
+};
+
+struct PassBlockRange
+{
+	UINT Offset;
+	UINT Size;
+};
+
+inline PassBlockRange GetPassBlockRange(PassBlock block)
+{
+	const UINT timeBegin = (UINT)offsetof(PassConstants, TotalTime);
+	const UINT sceneBegin = (UINT)offsetof(PassConstants, AmbientLight);
+
+	switch(block)
+	{
+	case PassBlock::View: return { 0, timeBegin };
+	case PassBlock::Time: return { timeBegin, sceneBegin - timeBegin };
+	default:              return { sceneBegin, (UINT)sizeof(PassConstants) - sceneBegin };
+	}
+}
+
 struct Vertex
 {
     DirectX::XMFLOAT3 Pos;
@@ -54,7 +105,8 @@ struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT maxInstanceCount, UINT materialCount, UINT waveVertCount,
+        UINT drawWorkerCount, UINT maxLocalLights);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -63,18 +115,31 @@ public:
     // So each frame needs their own allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
+    // One allocator and command list per draw recording worker, so the workers never
+    // share an allocator.  Created closed.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> WorkerCmdListAllocs;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> WorkerCmdLists;
+
+    // Runs after the workers' lists to transition the back buffer for present.
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> EndCmdListAlloc;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> EndCmdList;
+
     // We cannot update a cbuffer until the GPU is done processing the commands
     // that reference it.  So each frame needs their own cbuffers.
    // std::unique_ptr<UploadBuffer<FrameConstants>> FrameCB = nullptr;
     std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
-    std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+    std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
+
+    // Instance data of the items drawn this frame, written batch by batch.
+    std::unique_ptr<UploadBuffer<InstanceData>> InstanceBuffer = nullptr;
+
+    // Point and spot lights, and per pass the clusters' ranges into its light index
+    // list (LightClusterer::ClusterCount ranges and MaxLightIndices indices per pass).
+    std::unique_ptr<UploadBuffer<Light>> LocalLights = nullptr;
+    std::unique_ptr<UploadBuffer<ClusterRange>> ClusterRanges = nullptr;
+    std::unique_ptr<UploadBuffer<UINT>> ClusterLightIndices = nullptr;
 
     // We cannot update a dynamic vertex buffer until the GPU is done processing
     // the commands that reference it.  So each frame needs their own.
     std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
-
-    // Fence value to mark commands up to this fence point.  This lets us
-    // check if these frame resources are still in use by the GPU.
-    UINT64 Fence = 0;
 };
\ No newline at end of file
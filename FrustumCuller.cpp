@@ -0,0 +1,159 @@
+//***************************************************************************************
+// FrustumCuller.cpp
+//***************************************************************************************
+
+#include "FrustumCuller.h"
+#include <ppl.h>
+
+using namespace DirectX;
+
+void FrustumCuller::SetFrustum(FXMMATRIX view, CXMMATRIX proj)
+{
+	// With row vectors clip = p*M, so each clip plane is a sum of columns of M
+	// (Gribb/Hartmann).  Transpose so the columns can be read as rows.
+	XMMATRIX m = XMMatrixTranspose(XMMatrixMultiply(view, proj));
+
+	XMVECTOR planes[6] =
+	{
+		XMVectorAdd(m.r[3], m.r[0]),      // left
+		XMVectorSubtract(m.r[3], m.r[0]), // right
+		XMVectorAdd(m.r[3], m.r[1]),      // bottom
+		XMVectorSubtract(m.r[3], m.r[1]), // top
+		m.r[2],                           // near (D3D clip space z >= 0)
+		XMVectorSubtract(m.r[3], m.r[2])  // far
+	};
+
+	for(int i = 0; i < 6; ++i)
+		XMStoreFloat4(&mPlanes[i], XMPlaneNormalize(planes[i]));
+}
+
+ContainmentType FrustumCuller::Classify(const BoundingBox& box)const
+{
+	XMVECTOR center = XMLoadFloat3(&box.Center);
+	XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+	bool straddles = false;
+	for(int p = 0; p < 6; ++p)
+	{
+		XMVECTOR plane = XMLoadFloat4(&mPlanes[p]);
+		float dist = XMVectorGetX(XMPlaneDotCoord(plane, center));
+		float radius = XMVectorGetX(XMVector3Dot(extents, XMVectorAbs(plane)));
+
+		if(dist + radius < 0.0f)
+			return DISJOINT;
+
+		if(dist - radius < 0.0f)
+			straddles = true;
+	}
+
+	return straddles ? INTERSECTS : CONTAINS;
+}
+
+UINT FrustumCuller::TestBoxes4(const BoundingBox* const boxes[4], UINT count)const
+{
+	assert(count > 0 && count <= 4);
+
+	// Gather the boxes in SoA form: one register per component, one lane per box.
+	// Unused lanes repeat the last box; they are masked off below.
+	XMFLOAT4A cx, cy, cz, ex, ey, ez;
+	for(UINT i = 0; i < 4; ++i)
+	{
+		const BoundingBox* b = boxes[i < count ? i : count - 1];
+		(&cx.x)[i] = b->Center.x;
+		(&cy.x)[i] = b->Center.y;
+		(&cz.x)[i] = b->Center.z;
+		(&ex.x)[i] = b->Extents.x;
+		(&ey.x)[i] = b->Extents.y;
+		(&ez.x)[i] = b->Extents.z;
+	}
+
+	XMVECTOR centerX = XMLoadFloat4A(&cx);
+	XMVECTOR centerY = XMLoadFloat4A(&cy);
+	XMVECTOR centerZ = XMLoadFloat4A(&cz);
+	XMVECTOR extentX = XMLoadFloat4A(&ex);
+	XMVECTOR extentY = XMLoadFloat4A(&ey);
+	XMVECTOR extentZ = XMLoadFloat4A(&ez);
+
+	XMVECTOR outside = XMVectorFalseInt();
+	for(int p = 0; p < 6; ++p)
+	{
+		XMVECTOR plane = XMLoadFloat4(&mPlanes[p]);
+		XMVECTOR a = XMVectorSplatX(plane);
+		XMVECTOR b = XMVectorSplatY(plane);
+		XMVECTOR c = XMVectorSplatZ(plane);
+		XMVECTOR d = XMVectorSplatW(plane);
+
+		// Signed distance from each box center to the plane.
+		XMVECTOR dist = XMVectorMultiplyAdd(centerZ, c,
+			XMVectorMultiplyAdd(centerY, b, XMVectorMultiplyAdd(centerX, a, d)));
+
+		// Extents of each box projected onto the plane normal.
+		XMVECTOR radius = XMVectorMultiplyAdd(extentZ, XMVectorAbs(c),
+			XMVectorMultiplyAdd(extentY, XMVectorAbs(b), XMVectorMultiply(extentX, XMVectorAbs(a))));
+
+		// A box is outside if it lies entirely behind any one plane.
+		outside = XMVectorOrInt(outside, XMVectorLess(XMVectorAdd(dist, radius), XMVectorZero()));
+	}
+
+	uint32_t outsideMask[4];
+	XMStoreInt4(outsideMask, outside);
+
+	UINT visibleMask = 0;
+	for(UINT i = 0; i < count; ++i)
+	{
+		if(outsideMask[i] == 0)
+			visibleMask |= 1u << i;
+	}
+
+	return visibleMask;
+}
+
+CullStats FrustumCuller::Cull(const std::vector<RenderItem*>& ritems, std::vector<RenderItem*>& visible)const
+{
+	CullStats stats;
+
+	for(size_t i = 0; i < ritems.size(); i += 4)
+	{
+		UINT count = (UINT)std::min<size_t>(4, ritems.size() - i);
+
+		const BoundingBox* boxes[4];
+		for(UINT j = 0; j < count; ++j)
+			boxes[j] = &ritems[i + j]->Bounds;
+
+		UINT mask = TestBoxes4(boxes, count);
+		for(UINT j = 0; j < count; ++j)
+		{
+			if(mask & (1u << j))
+			{
+				visible.push_back(ritems[i + j]);
+				stats.Visible++;
+			}
+			else
+			{
+				stats.Culled++;
+			}
+		}
+	}
+
+	return stats;
+}
+
+CullStats FrustumCuller::CullLayers(const LayerList& layers, LayerList& visible)const
+{
+	CullStats layerStats[(int)RenderLayer::Count];
+
+	concurrency::parallel_for(0, (int)RenderLayer::Count, [&](int i)
+	{
+		visible[i].clear();
+		layerStats[i] = Cull(layers[i], visible[i]);
+	});
+
+	CullStats stats;
+	for(int i = 0; i < (int)RenderLayer::Count; ++i)
+	{
+		stats.Visible += layerStats[i].Visible;
+		stats.Culled += layerStats[i].Culled;
+	}
+
+	return stats;
+}
@@ -0,0 +1,47 @@
+//***************************************************************************************
+// FrustumCuller.h
+//
+// Tests the world space bounds of render items against the camera frustum so that only
+// the items that can be seen are submitted for drawing.  The boxes are tested four at
+// a time with SIMD, and the render layers are culled in parallel.
+//***************************************************************************************
+
+#pragma once
+
+#include "RenderItem.h"
+
+struct CullStats
+{
+	UINT Visible = 0;
+	UINT Culled = 0;
+};
+
+class FrustumCuller
+{
+public:
+	using LayerList = std::vector<RenderItem*>[(int)RenderLayer::Count];
+
+	// Extracts the six world space planes of the frustum described by view*proj.
+	// The planes point inward, so a point p is inside when dot(plane, p) >= 0.
+	void SetFrustum(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj);
+
+	const DirectX::XMFLOAT4* GetPlanes()const { return mPlanes; }
+
+	// Tests ritems against the frustum and appends the visible ones to visible.
+	CullStats Cull(const std::vector<RenderItem*>& ritems, std::vector<RenderItem*>& visible)const;
+
+	// Culls every layer in parallel.  visible[i] is cleared and refilled from layers[i].
+	CullStats CullLayers(const LayerList& layers, LayerList& visible)const;
+
+	// Classifies a single box as outside (DISJOINT), straddling (INTERSECTS) or
+	// fully inside (CONTAINS) the frustum.  Used for hierarchy nodes, where a
+	// CONTAINS result lets the whole subtree skip further tests.
+	DirectX::ContainmentType Classify(const DirectX::BoundingBox& box)const;
+
+	// Tests up to four boxes at once.  Returns a bit mask with bit i set when
+	// boxes[i] intersects the frustum.
+	UINT TestBoxes4(const DirectX::BoundingBox* const boxes[4], UINT count)const;
+
+private:
+	DirectX::XMFLOAT4 mPlanes[6];
+};
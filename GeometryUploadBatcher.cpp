@@ -0,0 +1,43 @@
+//***************************************************************************************
+// GeometryUploadBatcher.cpp
+//***************************************************************************************
+
+#include "GeometryUploadBatcher.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+uint32_t GeometryUploadBatcher::Add(const void* data, uint64_t bytes, uint64_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	Range range;
+	range.Data = data;
+	range.Offset = (mTotalBytes + alignment - 1) & ~(alignment - 1);
+	range.Bytes = bytes;
+	mRanges.push_back(range);
+
+	mTotalBytes = range.Offset + bytes;
+	mMaxAlignment = std::max<uint64_t>(mMaxAlignment, alignment);
+	return (uint32_t)mRanges.size() - 1;
+}
+
+void GeometryUploadBatcher::Write(uint8_t* destination)const
+{
+	// Ranges are laid out in the order they were added, so one pass fills the buffer.
+	uint64_t written = 0;
+	for(const Range& range : mRanges)
+	{
+		memset(destination + written, 0, (size_t)(range.Offset - written));
+		if(range.Bytes > 0)
+			memcpy(destination + range.Offset, range.Data, (size_t)range.Bytes);
+		written = range.Offset + range.Bytes;
+	}
+}
+
+void GeometryUploadBatcher::Clear()
+{
+	mRanges.clear();
+	mTotalBytes = 0;
+	mMaxAlignment = 1;
+}
@@ -0,0 +1,64 @@
+//***************************************************************************************
+// GeometryUploadBatcher.h
+//
+// Packs the vertex and index data of every mesh built in one load phase into a single
+// buffer, so the phase needs one default buffer, one staging range, one copy and one
+// barrier rather than a buffer, an upload buffer, a copy and two barriers per vertex or
+// index buffer.  Each mesh then reads its part of the shared buffer through the offsets
+// in its MeshGeometry.
+//
+// Nothing here touches a device: the app records the copy, and HeadlessBench
+// -benchgeometry checks the packing.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class GeometryUploadBatcher
+{
+public:
+	// Enough for any vertex or index format.
+	static const uint64_t DefaultAlignment = 16;
+
+	GeometryUploadBatcher() = default;
+	GeometryUploadBatcher(const GeometryUploadBatcher& rhs) = delete;
+	GeometryUploadBatcher& operator=(const GeometryUploadBatcher& rhs) = delete;
+
+	// Places bytes of data after the ranges added before, at a multiple of alignment, a
+	// power of two.  Only the pointer is kept: data must stay valid until Write.  Returns
+	// the range's index.
+	uint32_t Add(const void* data, uint64_t bytes, uint64_t alignment = DefaultAlignment);
+
+	// Where the range starts in the packed buffer.
+	uint64_t Offset(uint32_t range)const { return mRanges[range].Offset; }
+	uint64_t Bytes(uint32_t range)const { return mRanges[range].Bytes; }
+
+	uint32_t RangeCount()const { return (uint32_t)mRanges.size(); }
+
+	// Size of the packed buffer: the end of the last range.
+	uint64_t TotalBytes()const { return mTotalBytes; }
+
+	// Largest alignment any range asked for, for the staging range the packed bytes are
+	// written to.
+	uint64_t MaxAlignment()const { return mMaxAlignment; }
+
+	// Writes the packed buffer, TotalBytes long, to destination.  The gaps left to align
+	// the ranges are zeroed.
+	void Write(uint8_t* destination)const;
+
+	void Clear();
+
+private:
+	struct Range
+	{
+		const void* Data;
+		uint64_t Offset;
+		uint64_t Bytes;
+	};
+
+	std::vector<Range> mRanges;
+	uint64_t mTotalBytes = 0;
+	uint64_t mMaxAlignment = 1;
+};
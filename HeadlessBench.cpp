@@ -0,0 +1,466 @@
+//***************************************************************************************
+// HeadlessBench.cpp
+//
+// -benchsubmit and -benchbindless, which record draws, and the command line that picks
+// the reports.  The other reports are in the HeadlessBench*.cpp file of their subsystem.
+//***************************************************************************************
+
+#include "HeadlessBench.h"
+#include "BenchReport.h"
+#include "DrawSorter.h"
+#include "ParallelDrawRecorder.h"
+#include "BindlessTable.h"
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Stand-in PSOs.  The validating backend only compares the pointers, never calls them.
+	char gFakePSOs[(int)RenderLayer::Count];
+
+	ID3D12PipelineState* FakePSO(RenderLayer layer)
+	{
+		return reinterpret_cast<ID3D12PipelineState*>(&gFakePSOs[(int)layer]);
+	}
+
+	// A report a -bench flag asks for, run with the options the command line set.
+	struct BenchMode
+	{
+		const char* Flag;
+		std::string (*Run)(const BenchConfig& config, UINT& errors);
+	};
+}
+
+HeadlessBench::HeadlessBench(const BenchConfig& config)
+	: mConfig(config)
+{
+	BuildScene();
+}
+
+void HeadlessBench::BuildScene()
+{
+	std::mt19937 rng(mConfig.Seed);
+	std::uniform_real_distribution<float> position(-0.5f*mConfig.WorldSize, 0.5f*mConfig.WorldSize);
+	std::uniform_real_distribution<float> scale(0.5f, 4.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// Geometry only needs the sizes that go into buffer views; there are no GPU buffers.
+	for(UINT g = 0; g < mConfig.GeometryCount; ++g)
+	{
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->Name = "benchGeo" + std::to_string(g);
+		geo->VertexByteStride = 32;
+		geo->VertexBufferByteSize = 32 * 24 * mConfig.SubmeshesPerGeometry;
+		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+		geo->IndexBufferByteSize = 2 * 36 * mConfig.SubmeshesPerGeometry;
+
+		for(UINT s = 0; s < mConfig.SubmeshesPerGeometry; ++s)
+		{
+			SubmeshGeometry submesh;
+			submesh.IndexCount = 36;
+			submesh.StartIndexLocation = 36 * s;
+			submesh.BaseVertexLocation = 24 * s;
+			submesh.Bounds = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+			geo->DrawArgs.Add("submesh" + std::to_string(s), submesh);
+		}
+
+		mGeometries.push_back(std::move(geo));
+	}
+
+	for(UINT m = 0; m < mConfig.MaterialCount; ++m)
+	{
+		auto mat = std::make_unique<Material>();
+		mat->Name = "benchMat" + std::to_string(m);
+		mat->MatCBIndex = m;
+		mat->DiffuseSrvHeapIndex = m % 9;
+		mMaterials.push_back(std::move(mat));
+	}
+
+	for(UINT i = 0; i < mConfig.ItemCount; ++i)
+	{
+		auto ri = std::make_unique<RenderItem>();
+		ri->ObjCBIndex = i;
+
+		float s = scale(rng);
+		XMStoreFloat4x4(&ri->World, XMMatrixScaling(s, s, s) *
+			XMMatrixTranslation(position(rng), 0.1f*position(rng), position(rng)));
+
+		ri->Geo = mGeometries[rng() % mGeometries.size()].get();
+		ri->Mat = mMaterials[rng() % mMaterials.size()].get();
+
+		const SubmeshGeometry& submesh = ri->Geo->DrawArgs[SubmeshId(rng() % mConfig.SubmeshesPerGeometry)];
+		ri->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		ri->IndexCount = submesh.IndexCount;
+		ri->StartIndexLocation = submesh.StartIndexLocation;
+		ri->BaseVertexLocation = submesh.BaseVertexLocation;
+		ri->LocalBounds = submesh.Bounds;
+		ri->UpdateWorldBounds();
+
+		// Roughly the mix of the app's scene: mostly opaque, some cut-out and blended.
+		float r = unit(rng);
+		ri->Layer = r < 0.7f ? RenderLayer::Opaque :
+			(r < 0.85f ? RenderLayer::AlphaTested : RenderLayer::Transparent);
+
+		mRitemLayer[(int)ri->Layer].push_back(ri.get());
+		mAllRitems.push_back(std::move(ri));
+	}
+}
+
+BenchResult HeadlessBench::Run()
+{
+	BenchResult result;
+
+	FrustumCuller culler;
+	FrustumCuller::LayerList visible;
+	InstanceBatcher batcher;
+	DrawSorter sorter;
+	CommandRecorder recorder;
+	ValidatingCommandBackend backend(RootParameterCount);
+	ParallelDrawRecorder parallelRecorder;
+	ValidatingCommandBackend chunkBackend(RootParameterCount);
+
+	// The backend starts with no PSO bound, as a reset command list does, so the
+	// recording has to set the first one itself.
+	DrawBindings bindings;
+	for(int i = 0; i < (int)RenderLayer::Count; ++i)
+		bindings.LayerPSOs[i] = FakePSO((RenderLayer)i);
+	bindings.InitialPSO = nullptr;
+	bindings.InstanceBufferAddress = 0x100000;
+	bindings.InstanceByteSize = sizeof(XMFLOAT4X4) * 2;
+
+	const float farZ = mConfig.WorldSize;
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 16.0f / 9.0f, 1.0f, farZ);
+
+	double totalDraws = 0.0;
+	double submitMs = 0.0;
+
+	for(UINT frame = 0; frame < mConfig.FrameCount; ++frame)
+	{
+		// Orbit the scene so the visible set and depth order change every frame.
+		float angle = MathHelper::Pi * 2.0f * frame / mConfig.FrameCount;
+		float radius = 0.3f*mConfig.WorldSize;
+		XMVECTOR eye = XMVectorSet(radius*cosf(angle), 20.0f, radius*sinf(angle), 1.0f);
+		XMMATRIX view = XMMatrixLookAtLH(eye, XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+		auto t0 = BenchClock::now();
+		culler.SetFrustum(view, proj);
+		CullStats cullStats = culler.CullLayers(mRitemLayer, visible);
+
+		auto t1 = BenchClock::now();
+		batcher.Build(visible);
+
+		auto t2 = BenchClock::now();
+		sorter.Sort(batcher, view, farZ);
+
+		auto t3 = BenchClock::now();
+		recorder.Reset();
+		UINT stateChanges = RecordDrawBatches(recorder, sorter.GetSortedBatches(), bindings);
+
+		auto t4 = BenchClock::now();
+		backend.Reset();
+		recorder.Replay(backend);
+
+		auto t5 = BenchClock::now();
+
+		result.CullMs += ElapsedMs(t0, t1);
+		result.BatchMs += ElapsedMs(t1, t2);
+		result.SortMs += ElapsedMs(t2, t3);
+		result.RecordMs += ElapsedMs(t3, t4);
+		result.ReplayMs += ElapsedMs(t4, t5);
+		submitMs += ElapsedMs(t3, t5);
+
+		UINT draws = backend.Count(CommandType::DrawIndexedInstanced);
+		totalDraws += draws;
+
+		result.Visible += cullStats.Visible;
+		result.Draws += draws;
+		result.StateChanges += stateChanges;
+		result.Commands += recorder.CommandCount();
+		result.Bytes += (double)recorder.ByteSize();
+		result.Redundant += backend.RedundantCount();
+
+		if(backend.ErrorCount() > 0 && result.Errors == 0)
+			result.FirstError = backend.FirstError();
+		result.Errors += backend.ErrorCount();
+
+		if(mConfig.WorkerCount > 1)
+		{
+			auto t6 = BenchClock::now();
+			parallelRecorder.Record(sorter.GetSortedBatches(), bindings, mConfig.WorkerCount);
+			auto t7 = BenchClock::now();
+
+			result.ParallelRecordMs += ElapsedMs(t6, t7);
+			result.Chunks += parallelRecorder.ChunkCount();
+
+			// Replay the chunks in submission order, each as its own command list.
+			chunkBackend.Reset();
+			for(UINT i = 0; i < parallelRecorder.ChunkCount(); ++i)
+			{
+				chunkBackend.ResetState();
+				parallelRecorder.GetRecorder(i).Replay(chunkBackend);
+			}
+
+			if(chunkBackend.ErrorCount() > 0 && result.Errors == 0)
+				result.FirstError = chunkBackend.FirstError();
+			result.Errors += chunkBackend.ErrorCount();
+
+			if(chunkBackend.DrawHash() != backend.DrawHash())
+			{
+				if(result.Errors == 0)
+					result.FirstError = "Chunked recording draws differently from the serial one.";
+				result.Errors++;
+			}
+		}
+	}
+
+	const double frames = std::max<double>(mConfig.FrameCount, 1.0);
+	result.CullMs /= frames;
+	result.BatchMs /= frames;
+	result.SortMs /= frames;
+	result.RecordMs /= frames;
+	result.ReplayMs /= frames;
+	result.ParallelRecordMs /= frames;
+	result.Visible /= frames;
+	result.Draws /= frames;
+	result.StateChanges /= frames;
+	result.Commands /= frames;
+	result.Bytes /= frames;
+	result.Redundant /= frames;
+	result.Chunks /= frames;
+	result.NsPerDraw = totalDraws > 0.0 ? submitMs * 1.0e6 / totalDraws : 0.0;
+
+	return result;
+}
+
+std::string HeadlessBench::Report(const BenchConfig& config, const BenchResult& result)
+{
+	BenchReport report("benchsubmit");
+	report.Line("items", "%u, %u geometries, %u materials, %u frames",
+		config.ItemCount, config.GeometryCount, config.MaterialCount, config.FrameCount);
+	report.Line("per frame", "visible %.1f  draws %.1f  state changes %.1f  commands %.1f  bytes %.0f  redundant %.1f",
+		result.Visible, result.Draws, result.StateChanges, result.Commands, result.Bytes, result.Redundant);
+	report.Line("ms/frame", "cull %.3f  batch %.3f  sort %.3f  record %.3f  replay %.3f",
+		result.CullMs, result.BatchMs, result.SortMs, result.RecordMs, result.ReplayMs);
+	report.Line("ns/draw", "%.1f recording and replaying", result.NsPerDraw);
+	report.Line("parallel", "%u workers, %.1f chunks, %.3f ms/frame", config.WorkerCount, result.Chunks, result.ParallelRecordMs);
+	report.Line("validation", "%u errors%s%s", result.Errors, result.Errors > 0 ? ", first: " : "", result.FirstError.c_str());
+	return report.Text();
+}
+
+std::string HeadlessBench::BindlessReport(UINT frameCount, UINT& errors)
+{
+	BenchReport report("benchbindless");
+
+	// Slots come out lowest first, and a freed slot only comes back once its fence has.
+	{
+		BindlessTable table(8);
+		for(UINT i = 0; i < 8; ++i)
+		{
+			if(table.Allocate() != i)
+				report.Fail();
+		}
+		if(table.Allocate() != BindlessTable::InvalidSlot || table.AllocatedCount() != 8)
+			report.Fail();
+
+		table.Free(3, 5);
+		table.Free(1, 2);
+		if(table.Allocate() != BindlessTable::InvalidSlot || table.PendingCount() != 2 || table.IsAllocated(3))
+			report.Fail();
+
+		if(table.Retire(1) != 0 || table.Retire(2) != 1 || table.Allocate() != 1)
+			report.Fail();
+
+		if(table.Retire(5) != 1 || table.Allocate() != 3 || table.HighWater() != 8 || table.PendingCount() != 0)
+			report.Fail();
+	}
+
+	// Textures reloaded at random over frameCount frames with three frames in flight.
+	// No slot may be handed out while a frame that can sample it is still running.
+	{
+		const UINT capacity = 64;
+		const UINT64 framesInFlight = 3;
+		BindlessTable table(capacity);
+		std::vector<UINT> held;
+		std::vector<UINT64> lastUse(capacity, 0);
+		std::mt19937 rng(1);
+
+		for(UINT i = 0; i < capacity / 2; ++i)
+			held.push_back(table.Allocate());
+
+		for(UINT64 frame = framesInFlight + 1; frame < frameCount + framesInFlight + 1; ++frame)
+		{
+			UINT64 completed = frame - framesInFlight;
+			table.Retire(completed);
+
+			for(UINT reloads = rng() % 4; reloads > 0; --reloads)
+			{
+				UINT slot = table.Allocate();
+				if(slot == BindlessTable::InvalidSlot)
+					break;
+
+				if(lastUse[slot] > completed)
+					report.Fail();
+
+				size_t victim = rng() % held.size();
+				lastUse[held[victim]] = frame;
+				table.Free(held[victim], frame);
+				held[victim] = slot;
+			}
+
+			if(table.AllocatedCount() != held.size())
+				report.Fail();
+		}
+	}
+
+	// A scene's batches with many materials: no descriptor table or material CBV is set
+	// per draw, only the material index when it changes.  Nothing is bound when the
+	// backend is reset, so the recording sets the first PSO itself.
+	DrawBindings bindings;
+	for(int i = 0; i < (int)RenderLayer::Count; ++i)
+		bindings.LayerPSOs[i] = FakePSO((RenderLayer)i);
+	bindings.InitialPSO = nullptr;
+	bindings.InstanceBufferAddress = 0x100000;
+	bindings.InstanceByteSize = sizeof(XMFLOAT4X4) * 2;
+
+	const UINT materialCount = 64;
+	const UINT batchCount = 20000;
+	MeshGeometry geo;
+	geo.VertexByteStride = 32;
+	std::vector<Material> materials(materialCount);
+	for(UINT m = 0; m < materialCount; ++m)
+		materials[m].MatCBIndex = m;
+
+	std::vector<DrawBatch> batches(batchCount);
+	for(UINT b = 0; b < batchCount; ++b)
+	{
+		batches[b].Geo = &geo;
+		batches[b].Mat = &materials[(b / 4) % materialCount];
+		batches[b].IndexCount = 36;
+		batches[b].FirstInstance = b;
+		batches[b].InstanceCount = 1;
+	}
+
+	CommandRecorder recorder;
+	ValidatingCommandBackend backend(RootParameterCount);
+	double recordMs = 0.0;
+	const UINT passes = std::max<UINT>(frameCount / 10, 1);
+	for(UINT pass = 0; pass < passes; ++pass)
+	{
+		auto t0 = BenchClock::now();
+		recorder.Reset();
+		RecordDrawBatches(recorder, batches, bindings);
+		backend.Reset();
+		recorder.Replay(backend);
+		recordMs += ElapsedMs(t0, BenchClock::now());
+	}
+
+	if(backend.Count(CommandType::SetRootDescriptorTable) != 0 ||
+	   backend.Count(CommandType::SetRootConstantBufferView) != 0 ||
+	   backend.Count(CommandType::SetRoot32BitConstant) != batchCount / 4 ||
+	   backend.Count(CommandType::DrawIndexedInstanced) != batchCount ||
+	   backend.ErrorCount() != 0)
+		report.Fail();
+
+	double drawsPerMs = recordMs > 0.0 ? (double)batchCount * passes / recordMs : 0.0;
+
+	report.Line("draws", "%u, %u materials", batchCount, materialCount);
+	report.Line("state set", "%u tables, %u material CBVs, %u material indices",
+		backend.Count(CommandType::SetRootDescriptorTable), backend.Count(CommandType::SetRootConstantBufferView),
+		backend.Count(CommandType::SetRoot32BitConstant));
+	report.Line("record+replay", "%.0f draws/ms", drawsPerMs);
+	return report.Finish(errors);
+}
+
+bool HeadlessBench::RunFromCommandLine(const char* cmdLine, int& exitCode)
+{
+	if(cmdLine == nullptr)
+		return false;
+
+	// Every report, in the order they run whatever the order of the flags.
+	static const BenchMode modes[] =
+	{
+		{ "-benchsubmit", [](const BenchConfig& config, UINT& errors)
+			{
+				HeadlessBench bench(config);
+				BenchResult result = bench.Run();
+				errors += result.Errors;
+				return Report(config, result);
+			} },
+		{ "-benchpacing", [](const BenchConfig& config, UINT&) { return PacingReport(config.CpuMs, config.GpuMs, config.FrameCount); } },
+		{ "-benchgraph", [](const BenchConfig& config, UINT&) { return GraphReport(config.FrameCount); } },
+		{ "-benchlights", [](const BenchConfig& config, UINT& errors) { return LightReport(config.LightCount, config.FrameCount, errors); } },
+		{ "-benchshaders", [](const BenchConfig&, UINT& errors) { return ShaderCacheReport(errors); } },
+		{ "-benchpsos", [](const BenchConfig& config, UINT& errors) { return PipelineReport(config.FrameCount, errors); } },
+		{ "-benchdds", [](const BenchConfig& config, UINT& errors) { return DdsReport(config.FrameCount, errors); } },
+		{ "-benchstream", [](const BenchConfig& config, UINT& errors) { return StreamingReport(config.FrameCount, errors); } },
+		{ "-benchmips", [](const BenchConfig& config, UINT& errors) { return MipResidencyReport(config.FrameCount, errors); } },
+		{ "-benchlifetime", [](const BenchConfig&, UINT& errors) { return LifetimeReport(errors); } },
+		{ "-benchpack", [](const BenchConfig&, UINT& errors) { return PackReport(errors); } },
+		{ "-benchbindless", [](const BenchConfig& config, UINT& errors) { return BindlessReport(config.FrameCount, errors); } },
+		{ "-benchbc", [](const BenchConfig&, UINT& errors) { return BlockCompressReport(errors); } },
+		{ "-benchindex", [](const BenchConfig& config, UINT& errors) { return IndexReport(config.FrameCount, errors); } },
+		{ "-benchheap", [](const BenchConfig& config, UINT& errors) { return HeapReport(config.FrameCount, errors); } },
+		{ "-benchgeometry", [](const BenchConfig&, UINT& errors) { return GeometryUploadReport(errors); } },
+	};
+	const size_t modeCount = sizeof(modes) / sizeof(modes[0]);
+
+	BenchConfig config;
+	bool selected[modeCount] = {};
+	bool any = false;
+
+	std::istringstream args(cmdLine);
+	std::string arg;
+	while(args >> arg)
+	{
+		if(arg == "-benchitems")
+			args >> config.ItemCount;
+		else if(arg == "-benchframes")
+			args >> config.FrameCount;
+		else if(arg == "-benchworkers")
+			args >> config.WorkerCount;
+		else if(arg == "-benchcpums")
+			args >> config.CpuMs;
+		else if(arg == "-benchgpums")
+			args >> config.GpuMs;
+		else if(arg == "-benchlights")
+			args >> config.LightCount;
+
+		for(size_t m = 0; m < modeCount; ++m)
+		{
+			if(arg == modes[m].Flag)
+			{
+				selected[m] = true;
+				any = true;
+			}
+		}
+	}
+
+	if(!any)
+		return false;
+
+	std::string report;
+	UINT errors = 0;
+	for(size_t m = 0; m < modeCount; ++m)
+	{
+		if(selected[m])
+			report += modes[m].Run(config, errors);
+	}
+
+	// The app has no console of its own; write to the one that launched it, if any,
+	// so CI can capture the report, and to the debugger.
+	if(AttachConsole(ATTACH_PARENT_PROCESS))
+	{
+		FILE* out = nullptr;
+		if(freopen_s(&out, "CONOUT$", "w", stdout) == 0)
+		{
+			fputs(report.c_str(), stdout);
+			fflush(stdout);
+		}
+	}
+	OutputDebugStringA(report.c_str());
+
+	exitCode = errors == 0 ? 0 : 1;
+	return true;
+}
@@ -0,0 +1,199 @@
+//***************************************************************************************
+// HeadlessBench.h
+//
+// Measures the CPU cost of draw submission without a GPU.  A synthetic scene of render
+// items is pushed through the same culling, batching, sorting and recording code the app
+// uses, and the recorded commands are replayed into a ValidatingCommandBackend.
+//
+// Run with:  DirectXAssignmentFinal.exe -benchsubmit [-benchitems N] [-benchframes N]
+//                                       [-benchworkers N]
+//            DirectXAssignmentFinal.exe -benchpacing [-benchcpums X] [-benchgpums Y]
+//            DirectXAssignmentFinal.exe -benchgraph [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchlights N [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchshaders
+//            DirectXAssignmentFinal.exe -benchpsos [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchdds [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchstream [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchmips [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchlifetime
+//            DirectXAssignmentFinal.exe -benchpack
+//            DirectXAssignmentFinal.exe -benchbindless [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchbc
+//            DirectXAssignmentFinal.exe -benchindex [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchheap [-benchframes N]
+//            DirectXAssignmentFinal.exe -benchgeometry
+//
+// Several flags may be given at once.  Each report is in the HeadlessBench*.cpp file of
+// its subsystem and is written with BenchReport; the exit code is 1 when any check
+// failed.
+//***************************************************************************************
+
+#pragma once
+
+#include "FrustumCuller.h"
+
+struct BenchConfig
+{
+	UINT ItemCount = 20000;
+	UINT GeometryCount = 32;
+	UINT SubmeshesPerGeometry = 4;
+	UINT MaterialCount = 64;
+	UINT FrameCount = 200;
+	float WorldSize = 500.0f;
+	UINT Seed = 1;
+
+	// When above 1, the batches are also recorded in up to this many chunks in parallel
+	// and checked against the serial recording.
+	UINT WorkerCount = 1;
+
+	// -benchlights and -benchpacing only.
+	UINT LightCount = 1000;
+	double CpuMs = 4.0;
+	double GpuMs = 10.0;
+};
+
+struct BenchResult
+{
+	// Average milliseconds per frame spent in each stage.
+	double CullMs = 0.0;
+	double BatchMs = 0.0;
+	double SortMs = 0.0;
+	double RecordMs = 0.0;
+	double ReplayMs = 0.0;
+	double ParallelRecordMs = 0.0;
+
+	// Averages per frame.
+	double Visible = 0.0;
+	double Draws = 0.0;
+	double StateChanges = 0.0;
+	double Commands = 0.0;
+	double Bytes = 0.0;
+	double Redundant = 0.0;
+	double Chunks = 0.0;
+
+	// Record plus replay time divided by the draws issued.
+	double NsPerDraw = 0.0;
+
+	UINT Errors = 0;
+	std::string FirstError;
+};
+
+class HeadlessBench
+{
+public:
+	explicit HeadlessBench(const BenchConfig& config);
+
+	BenchResult Run();
+
+	static std::string Report(const BenchConfig& config, const BenchResult& result);
+
+	// Runs FramePacer against a SimulatedFence for ring depths 1 to 4, with and
+	// without low-latency mode, and reports frame time, CPU wait and the latency
+	// from input sampling to the GPU finishing that frame.
+	static std::string PacingReport(double cpuMs, double gpuMs, UINT frameCount);
+
+	// Runs the app's frame task graph with stub stages that busy-wait for typical
+	// stage times, and reports wall time against serial time and the critical path.
+	static std::string GraphReport(UINT frameCount);
+
+	// Creates lightCount random point lights in a LightManager, moves a few of them each
+	// frame and bins the ones its grid finds in the frustum of an orbiting camera into
+	// the clusters.  Reports the grid, query and binning times.  The last frame is
+	// checked against brute force: the grid must not miss a light in the frustum, and
+	// each cluster must hold every light touching it, or the MaxLightsPerCluster most
+	// influential of them.  Failures are counted in errors.
+	static std::string LightReport(UINT lightCount, UINT frameCount, UINT& errors);
+
+	// Drives ShaderCache over generated sources in a temporary directory with a stand-in
+	// compiler: a cold build, a warm build, and a build after an included file changed.
+	// Checks the hit and compile counts and that cached bytecode comes back unchanged.
+	static std::string ShaderCacheReport(UINT& errors);
+
+	// Registers every combination of a few shaders, blend, cull and topology states
+	// with PipelineRegistry, without a device.  Checks that equal states share a handle,
+	// that distinct states get distinct stable hashes, and that the hashes do not depend
+	// on registration order.  Reports the cost of a handle lookup against the string
+	// keyed map the app used before.
+	static std::string PipelineReport(UINT frameCount, UINT& errors);
+
+	// Loads every Textures\*.dds both ways: read into a heap buffer, and memory-mapped
+	// and parsed in place.  Each path copies its subresources into a staging buffer, as
+	// UpdateSubresources would into the upload heap, and the two must match.  Also
+	// checks GetSurfaceInfo against hand-worked block and pitch sizes.
+	static std::string DdsReport(UINT frameCount, UINT& errors);
+
+	// Streams every Textures\*.dds, and one missing file, through TextureStreamer with
+	// the app's staging size and per-frame budget, retiring staging space against a
+	// SimulatedFence.  Every staged row must match the file and sit where its footprint
+	// says; the missing file must come back failed.  Reports the time the main thread
+	// spends against loading the same files serially, and the frames until all are
+	// resident, which must be within frameCount.
+	static std::string StreamingReport(UINT frameCount, UINT& errors);
+
+	// Checks TextureResidency on scripted cases: DemandedMip against worked ratios, the
+	// least recently used texture giving way, and a lowered budget holding.  Then flies
+	// a camera over a field of items with 256 textures, under a budget of a quarter of
+	// their mips, checking every frame that the budget holds and the bytes add up.
+	// Reports the share of demanded mips resident and the bytes moved.
+	static std::string MipResidencyReport(UINT frameCount, UINT& errors);
+
+	// Checks ResourceTracker with stand-in objects: bytes per category add up, objects
+	// handed over out of fence order are released exactly when their fence completes,
+	// and the report names every category.  Then tracks the app's load of the generated
+	// meshes and reports the bytes held after loading with and without the upload page
+	// and CPU copies released.
+	static std::string LifetimeReport(UINT& errors);
+
+	// Packs random rectangles with SkylinePacker, checking that none leaves the page or
+	// overlaps another's padding, and reports the occupancy.  Groups generated DDS files
+	// with ArrayGroups and reads a PackArray result back slice by slice.
+	static std::string PackReport(UINT& errors);
+
+	// Checks BindlessTable's slot order and fenced reuse on a scripted case, then
+	// reloads textures at random for frameCount frames with three in flight, checking
+	// that no slot is reused while a running frame can sample it.  Records batches of
+	// many materials and checks that only the material index changes between draws.
+	// Reports the draws recorded and replayed per millisecond.
+	static std::string BindlessReport(UINT frameCount, UINT& errors);
+
+	// Encodes generated images with BlockCompress, checking that the SSE2 and scalar
+	// paths give the same blocks, that flat and two-valued blocks come back exact and
+	// that smooth images decode within a PSNR bound.  Checks the gamma correct and
+	// normal map mip filters on worked texels and reads WriteDDS files back through
+	// ParseHeader.  Reports the encode rate of each path.
+	static std::string BlockCompressReport(UINT& errors);
+
+	// Indexes every Textures\*.dds and reads the index back.  Each entry must agree with
+	// ParseHeader and GetSubresources on the file: every slice's mips where the index
+	// puts them, the mips a streamed first chain skips and the bytes the residency is
+	// given.  Every single bit flip and truncation of the index must be rejected.
+	// Reports the time to read the index against opening and parsing every file.
+	static std::string IndexReport(UINT frameCount, UINT& errors);
+
+	// Checks HeapAllocator's alignment, merging and fenced frees on a scripted case,
+	// then allocates and frees at random, checking that no two ranges overlap and that
+	// an allocation only fails when no free range could hold it.  Streams textures in
+	// and out of a heap for frameCount frames and reports the time per operation, the
+	// fragmentation left and the bytes placement saves against committed resources.
+	static std::string HeapReport(UINT frameCount, UINT& errors);
+
+	// Packs random ranges at random alignments with GeometryUploadBatcher, checking that
+	// each comes back from Write where Offset says, with the gaps zeroed and nothing
+	// written past the end.  Batches the app's generated meshes and reports the
+	// resources, copies, barriers and bytes against a buffer pair per mesh.
+	static std::string GeometryUploadReport(UINT& errors);
+
+	// Runs the benchmark if the command line asks for it.  Returns false, leaving
+	// exitCode alone, when the app should start normally.
+	static bool RunFromCommandLine(const char* cmdLine, int& exitCode);
+
+private:
+	void BuildScene();
+
+	BenchConfig mConfig;
+
+	std::vector<std::unique_ptr<MeshGeometry>> mGeometries;
+	std::vector<std::unique_ptr<Material>> mMaterials;
+	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
+	FrustumCuller::LayerList mRitemLayer;
+};
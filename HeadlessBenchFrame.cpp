@@ -0,0 +1,108 @@
+//***************************************************************************************
+// HeadlessBenchFrame.cpp
+//
+// -benchpacing and -benchgraph: the frame's pacing against the GPU and its task graph.
+//***************************************************************************************
+
+#include "HeadlessBench.h"
+#include "BenchReport.h"
+#include "FramePacer.h"
+#include "TaskGraph.h"
+#include <cstdio>
+
+namespace
+{
+	// Stand-in for a stage's work that keeps the worker busy, as real work would.
+	void Spin(double ms)
+	{
+		BenchClock::time_point start = BenchClock::now();
+		while(ElapsedMs(start, BenchClock::now()) < ms)
+		{
+		}
+	}
+}
+
+std::string HeadlessBench::PacingReport(double cpuMs, double gpuMs, UINT frameCount)
+{
+	BenchReport report("benchpacing");
+	report.Line("frames", "%u, cpu %.2f ms, gpu %.2f ms", frameCount, cpuMs, gpuMs);
+
+	for(int depth = 1; depth <= 4; ++depth)
+	{
+		for(int lowLatency = 0; lowLatency < 2; ++lowLatency)
+		{
+			FramePacer pacer(depth);
+			SimulatedFence fence;
+
+			double latencySum = 0.0;
+			uint64_t fenceValue = 0;
+			for(UINT frame = 0; frame < frameCount; ++frame)
+			{
+				// Same order as DirectXAssignmentFinalApp::Update.
+				if(lowLatency)
+					pacer.BeginFrame(fence);
+
+				double inputMs = fence.NowMs();
+
+				if(!lowLatency)
+					pacer.BeginFrame(fence);
+
+				fence.Advance(cpuMs);
+				double completeMs = fence.Submit(++fenceValue, gpuMs);
+				pacer.EndFrame(fenceValue);
+
+				latencySum += completeMs - inputMs;
+			}
+
+			double frames = std::max<double>(frameCount, 1.0);
+			char label[32];
+			snprintf(label, sizeof(label), "ring %d", depth);
+			report.Line(label, "%-11s frame %.2f ms  cpu wait %.2f ms (%3.0f%% of frames)  input latency %.2f ms",
+				lowLatency ? "low-latency" : "default", fence.NowMs() / frames,
+				pacer.TotalWaitMs() / frames, 100.0 * pacer.WaitCount() / frames, latencySum / frames);
+		}
+	}
+
+	return report.Text();
+}
+
+std::string HeadlessBench::GraphReport(UINT frameCount)
+{
+	// Same stages and dependencies as DirectXAssignmentFinalApp::BuildUpdateGraph, plus
+	// Draw's recording and the wave step it overlaps with.
+	TaskGraph graph;
+	auto cull = graph.Add("cull", []() { Spin(1.0); });
+	auto animate = graph.Add("animateMaterials", []() { Spin(0.05); });
+	auto instanceData = graph.Add("instanceData", []() { Spin(0.8); }, { cull });
+	auto materialCBs = graph.Add("materialCBs", []() { Spin(0.1); }, { animate });
+	auto passCB = graph.Add("passCB", []() { Spin(0.2); });
+	auto waves = graph.Add("waves", []() { Spin(0.5); });
+	auto lightClusters = graph.Add("lightClusters", []() { Spin(0.3); }, { cull });
+	graph.Add("record", []() { Spin(2.0); }, { instanceData, materialCBs, passCB, waves, lightClusters });
+	graph.Add("wavesStep", []() { Spin(1.5); }, { waves });
+
+	double wall = 0.0;
+	double serial = 0.0;
+	double critical = 0.0;
+	std::vector<TaskGraph::TaskId> path;
+
+	for(UINT frame = 0; frame < frameCount; ++frame)
+	{
+		graph.Run();
+		wall += graph.WallMs();
+		serial += graph.SerialMs();
+		critical += graph.CriticalPathMs(&path);
+	}
+
+	double frames = std::max<double>(frameCount, 1.0);
+
+	std::string names;
+	for(size_t i = 0; i < path.size(); ++i)
+		names += (i == 0 ? "" : " -> ") + graph.GetName(path[i]);
+
+	BenchReport report("benchgraph");
+	report.Line("tasks", "%u, %u frames", (UINT)graph.TaskCount(), frameCount);
+	report.Line("ms/frame", "wall %.3f  serial %.3f  critical path %.3f", wall / frames, serial / frames, critical / frames);
+	report.Line("critical path", "%s", names.c_str());
+	return report.Text();
+}
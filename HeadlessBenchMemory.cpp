@@ -0,0 +1,525 @@
+//***************************************************************************************
+// HeadlessBenchMemory.cpp
+//
+// -benchlifetime, -benchheap and -benchgeometry: what the app's memory is held for, how
+// it is placed in heaps and how the static meshes are uploaded.
+//***************************************************************************************
+
+#include "HeadlessBench.h"
+#include "BenchReport.h"
+#include "Common/GeometryGenerator.h"
+#include "ResourceTracker.h"
+#include "HeapAllocator.h"
+#include "GeometryUploadBatcher.h"
+#include <random>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Stand-in for a GPU resource that records when its last reference goes.
+	class FakeResource : public IUnknown
+	{
+	public:
+		explicit FakeResource(bool& released) : mReleased(released) { mReleased = false; }
+
+		virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** object)override
+		{
+			*object = nullptr;
+			return E_NOINTERFACE;
+		}
+		virtual ULONG STDMETHODCALLTYPE AddRef()override { return ++mRefs; }
+		virtual ULONG STDMETHODCALLTYPE Release()override
+		{
+			ULONG refs = --mRefs;
+			if(refs == 0)
+			{
+				mReleased = true;
+				delete this;
+			}
+			return refs;
+		}
+
+	private:
+		ULONG mRefs = 1;
+		bool& mReleased;
+	};
+}
+
+std::string HeadlessBench::LifetimeReport(UINT& errors)
+{
+	BenchReport report("benchlifetime");
+	ResourceTracker tracker;
+
+	tracker.Track(MemoryCategory::Geometry, 1000);
+	tracker.Track(MemoryCategory::UploadHeaps, 600);
+	tracker.Untrack(MemoryCategory::Geometry, 400);
+	if(tracker.Bytes(MemoryCategory::Geometry) != 600 || tracker.TotalBytes() != 1200)
+		report.Fail();
+
+	// Handed over out of fence order, as a reload can be behind a later upload.
+	bool released[3] = {};
+	UINT64 fences[3] = { 5, 3, 7 };
+	for(int i = 0; i < 3; ++i)
+	{
+		ComPtr<IUnknown> object;
+		object.Attach(new FakeResource(released[i]));
+		tracker.Track(MemoryCategory::UploadHeaps, 100);
+		tracker.ReleaseAfter(fences[i], object, MemoryCategory::UploadHeaps, 100);
+	}
+	tracker.ReleaseAfter(1, nullptr, MemoryCategory::UploadHeaps, 0);
+
+	// The tracker holds the only references now.
+	if(released[0] || released[1] || released[2] || tracker.PendingCount() != 3)
+		report.Fail();
+
+	UINT64 freed = tracker.Retire(4);
+	if(freed != 100 || !released[1] || released[0] || released[2] || tracker.Bytes(MemoryCategory::UploadHeaps) != 800)
+		report.Fail();
+
+	freed = tracker.Retire(7);
+	if(freed != 200 || !released[0] || !released[2] || tracker.PendingCount() != 0 ||
+	   tracker.Bytes(MemoryCategory::UploadHeaps) != 600)
+		report.Fail();
+
+	std::string table = tracker.Report();
+	for(int c = 0; c < (int)MemoryCategory::Count; ++c)
+	{
+		if(table.find(ResourceTracker::CategoryName((MemoryCategory)c)) == std::string::npos)
+			report.Fail();
+	}
+
+	// The app's load of the generated meshes, as -benchgeometry packs them: one static
+	// buffer, one upload page for its copy, and the CPU copies it was filled from.
+	// Before the upload heaps and CPU copies were released they stayed as long as the
+	// app did, so the bytes held at the peak of loading were held for good.
+	GeometryGenerator geoGen;
+	std::vector<GeometryGenerator::MeshData> meshes;
+	meshes.push_back(geoGen.CreateGrid(600.0f, 600.0f, 50, 50));
+	meshes.push_back(geoGen.CreateGrid(100.0f, 100.0f, 60, 40));
+	meshes.push_back(geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3));
+	meshes.push_back(geoGen.CreateSphere(0.5f, 20, 20));
+	meshes.push_back(geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20));
+	meshes.push_back(geoGen.CreateGeosphere(0.5f, 3));
+
+	const UINT64 vertexBytes = 32;
+	const UINT64 resourceAlignment = 64 * 1024;
+	const UINT64 uploadPageSize = 4 * 1024 * 1024;
+
+	ResourceTracker load;
+	UINT64 cpuBytes = 0;
+	GeometryUploadBatcher batcher;
+	for(auto& mesh : meshes)
+	{
+		UINT64 vertices = mesh.Vertices.size() * vertexBytes;
+		UINT64 indices = mesh.GetIndices16().size() * sizeof(uint16_t);
+		batcher.Add(nullptr, vertices);
+		batcher.Add(nullptr, indices);
+		load.Track(MemoryCategory::MeshCpuCopies, vertices + indices);
+		cpuBytes += vertices + indices;
+	}
+
+	UINT64 uploadBytes = std::max<UINT64>(uploadPageSize, batcher.TotalBytes());
+	load.Track(MemoryCategory::Geometry, (batcher.TotalBytes() + resourceAlignment - 1) / resourceAlignment * resourceAlignment);
+	load.Track(MemoryCategory::UploadHeaps, uploadBytes);
+
+	bool pageReleased = false;
+	ComPtr<IUnknown> page;
+	page.Attach(new FakeResource(pageReleased));
+	load.ReleaseAfter(1, std::move(page), MemoryCategory::UploadHeaps, uploadBytes);
+
+	std::string loaded = load.Report();
+	UINT64 peakBytes = load.TotalBytes();
+
+	// DropCpuCopies, then the retire once the load fence completes.
+	load.Untrack(MemoryCategory::MeshCpuCopies, cpuBytes);
+	load.Retire(1);
+	UINT64 releasedBytes = load.TotalBytes();
+	if(!pageReleased || load.PendingCount() != 0 || releasedBytes != load.Bytes(MemoryCategory::Geometry))
+		report.Fail();
+
+	const double mb = 1024.0 * 1024.0;
+	report.Line("meshes", "%u, generated", (UINT)meshes.size());
+	report.Line("peak", "%.2f MB while loading", peakBytes / mb);
+	report.Line("kept", "%.2f MB held after loading without early release", peakBytes / mb);
+	report.Line("released", "%.2f MB held after loading, %.2f MB saved", releasedBytes / mb, (peakBytes - releasedBytes) / mb);
+	report.Append("  after loading:\n" + loaded);
+	report.Append("  once the load-time copies are released:\n" + load.Report());
+	return report.Finish(errors);
+}
+
+std::string HeadlessBench::HeapReport(UINT frameCount, UINT& errors)
+{
+	BenchReport report("benchheap");
+
+	// The space skipped to align stays free for a smaller range, neighbours merge when
+	// given back, and a fenced free waits for its fence.
+	{
+		HeapAllocator heap(1024 * 1024);
+		HeapAllocator::Allocation a = heap.Allocate(1000);
+		HeapAllocator::Allocation b = heap.Allocate(4096, 4096);
+		if(a.Offset != 0 || b.Offset != 4096 || heap.FreeRangeCount() != 2)
+			report.Fail();
+
+		HeapAllocator::Allocation c = heap.Allocate(3000);
+		if(c.Offset != 1000 || heap.UsedBytes() != 8096 || heap.FreeRangeCount() != 2)
+			report.Fail();
+
+		heap.Free(b, 2);
+		if(heap.Retire(1) != 0 || heap.PendingCount() != 1 || heap.UsedBytes() != 8096)
+			report.Fail();
+		if(heap.Retire(2) != 1 || heap.UsedBytes() != 4000 || heap.FreeRangeCount() != 1)
+			report.Fail();
+
+		heap.Free(a);
+		heap.Free(c);
+		if(heap.FreeRangeCount() != 1 || heap.LargestFreeRange() != heap.Capacity() || heap.AllocationCount() != 0)
+			report.Fail();
+
+		HeapAllocator::Allocation all = heap.Allocate(heap.Capacity());
+		if(all.Offset != 0 || heap.Allocate(1).IsValid() || heap.FreeRangeCount() != 0)
+			report.Fail();
+		heap.Free(all);
+
+		if(!heap.CheckConsistency() || heap.HighWater() != heap.Capacity())
+			report.Fail();
+	}
+
+	// Random sizes and alignments given back at random, half of them behind a fence.
+	// Every range must be aligned, inside the heap and clear of the others, live or
+	// pending, and an allocation may only fail if no free range could be aligned.
+	{
+		const uint64_t capacity = 16 * 1024 * 1024;
+		HeapAllocator heap(capacity);
+		std::vector<HeapAllocator::Allocation> held;
+		std::vector<std::pair<HeapAllocator::Allocation, uint64_t>> pending;
+		std::mt19937 rng(7);
+
+		auto checkRanges = [&]()
+		{
+			std::vector<HeapAllocator::Allocation> ranges = held;
+			for(auto& p : pending)
+				ranges.push_back(p.first);
+			std::sort(ranges.begin(), ranges.end(),
+				[](const HeapAllocator::Allocation& x, const HeapAllocator::Allocation& y) { return x.Offset < y.Offset; });
+			for(size_t i = 1; i < ranges.size(); ++i)
+			{
+				if(ranges[i - 1].Offset + ranges[i - 1].Size > ranges[i].Offset)
+					report.Fail();
+			}
+			if(!heap.CheckConsistency())
+				report.Fail();
+		};
+
+		const UINT steps = 20000;
+		for(UINT step = 0; step < steps; ++step)
+		{
+			uint64_t completed = step / 8;
+			heap.Retire(completed);
+			pending.erase(std::remove_if(pending.begin(), pending.end(),
+				[completed](const std::pair<HeapAllocator::Allocation, uint64_t>& p) { return p.second <= completed; }),
+				pending.end());
+
+			if(held.empty() || rng() % 100 < 55)
+			{
+				uint64_t size = 1 + rng() % (rng() % 8 == 0 ? 1024 * 1024 : 16 * 1024);
+				uint64_t alignment = 1ull << (rng() % 17);
+				HeapAllocator::Allocation allocation = heap.Allocate(size, alignment);
+				if(allocation.IsValid())
+				{
+					if(allocation.Offset % alignment != 0 || allocation.Offset + size > capacity || allocation.Size != size)
+						report.Fail();
+					held.push_back(allocation);
+				}
+				else if(heap.LargestFreeRange() >= size + alignment - 1)
+				{
+					report.Fail();
+				}
+			}
+			else
+			{
+				size_t victim = rng() % held.size();
+				if(rng() % 2 == 0)
+				{
+					heap.Free(held[victim], completed + 2);
+					pending.push_back({ held[victim], completed + 2 });
+				}
+				else
+				{
+					heap.Free(held[victim]);
+				}
+				held[victim] = held.back();
+				held.pop_back();
+			}
+
+			if(step % 500 == 0)
+				checkRanges();
+		}
+		checkRanges();
+
+		heap.Retire(UINT64_MAX);
+		for(const HeapAllocator::Allocation& allocation : held)
+			heap.Free(allocation);
+		if(heap.UsedBytes() != 0 || heap.FreeRangeCount() != 1 || heap.PendingCount() != 0 || !heap.CheckConsistency())
+			report.Fail();
+	}
+
+	// Texture streaming for frameCount frames: 256 BC1 and BC3 textures in a 32 MB heap,
+	// a few reloaded each frame with more or fewer mips, each old chain freed three
+	// frames on, as the app does.  Sizes and alignments follow the placement rules: the
+	// 4 KB alignment for chains up to 64 KB, 64 KB above, which is what every committed
+	// resource takes.
+	const uint64_t heapSize = 32 * 1024 * 1024;
+	const uint64_t smallAlignment = 4 * 1024;
+	const uint64_t largeAlignment = 64 * 1024;
+	const UINT textureCount = 256;
+	const uint64_t framesInFlight = 3;
+
+	struct Chain
+	{
+		UINT Width;
+		UINT BlockBytes;
+		uint64_t Bytes;
+		HeapAllocator::Allocation Range;
+	};
+
+	auto chainBytes = [](UINT width, UINT blockBytes, UINT skip)
+	{
+		uint64_t bytes = 0;
+		for(UINT w = width >> skip; w > 0; w >>= 1)
+		{
+			uint64_t blocks = std::max<UINT>(w / 4, 1);
+			bytes += blocks * blocks * blockBytes;
+		}
+		return bytes;
+	};
+	auto placedAlignment = [=](uint64_t bytes) { return bytes <= largeAlignment ? smallAlignment : largeAlignment; };
+	auto alignUp = [](uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; };
+
+	HeapAllocator heap(heapSize);
+	std::mt19937 rng(3);
+	std::vector<Chain> chains(textureCount);
+	UINT allocations = 0;
+	UINT frees = 0;
+	UINT outOfBytes = 0;
+	UINT outOfRanges = 0;
+	double allocateMs = 0.0;
+	double freeMs = 0.0;
+
+	// Returns false, leaving the chain as it was, if the heap has no room.
+	auto load = [&](Chain& chain, UINT skip, uint64_t fenceValue)
+	{
+		uint64_t bytes = chainBytes(chain.Width, chain.BlockBytes, skip);
+		uint64_t alignment = placedAlignment(bytes);
+		uint64_t size = alignUp(bytes, alignment);
+
+		auto t0 = BenchClock::now();
+		HeapAllocator::Allocation range = heap.Allocate(size, alignment);
+		allocateMs += ElapsedMs(t0, BenchClock::now());
+		allocations++;
+
+		if(!range.IsValid())
+		{
+			if(heap.FreeBytes() >= size)
+				outOfRanges++;
+			else
+				outOfBytes++;
+			return false;
+		}
+
+		if(chain.Range.IsValid())
+		{
+			auto t1 = BenchClock::now();
+			heap.Free(chain.Range, fenceValue);
+			freeMs += ElapsedMs(t1, BenchClock::now());
+			frees++;
+		}
+		chain.Bytes = bytes;
+		chain.Range = range;
+		return true;
+	};
+
+	// Every texture starts with its 64 texel tail.
+	for(Chain& chain : chains)
+	{
+		chain.Width = 64u << (rng() % 6);
+		chain.BlockBytes = rng() % 2 == 0 ? 8 : 16;
+		UINT skip = 0;
+		while((chain.Width >> skip) > 64)
+			skip++;
+		load(chain, skip, 0);
+	}
+
+	uint64_t peakUsed = 0;
+	for(uint64_t frame = framesInFlight + 1; frame < frameCount + framesInFlight + 1; ++frame)
+	{
+		auto t0 = BenchClock::now();
+		heap.Retire(frame - framesInFlight);
+		freeMs += ElapsedMs(t0, BenchClock::now());
+
+		for(UINT reloads = 1 + rng() % 6; reloads > 0; --reloads)
+		{
+			Chain& chain = chains[rng() % textureCount];
+			UINT mipCount = 1;
+			while((chain.Width >> mipCount) > 0)
+				mipCount++;
+			load(chain, rng() % (mipCount - 4), frame);
+		}
+		peakUsed = std::max<uint64_t>(peakUsed, heap.UsedBytes());
+	}
+	heap.Retire(UINT64_MAX);
+
+	// What the resident chains take placed, and would take committed.
+	uint64_t liveBytes = 0;
+	uint64_t placedBytes = 0;
+	uint64_t committedBytes = 0;
+	for(const Chain& chain : chains)
+	{
+		if(!chain.Range.IsValid())
+			continue;
+		liveBytes += chain.Bytes;
+		placedBytes += chain.Range.Size;
+		committedBytes += alignUp(chain.Bytes, largeAlignment);
+	}
+
+	if(!heap.CheckConsistency() || heap.UsedBytes() != placedBytes)
+		report.Fail();
+
+	double freeBytes = (double)heap.FreeBytes();
+	double fragmentation = freeBytes > 0.0 ? 1.0 - heap.LargestFreeRange() / freeBytes : 0.0;
+	const double mb = 1024.0 * 1024.0;
+
+	report.Line("streaming", "%u textures over %u frames in a %.0f MB heap", textureCount, frameCount, heapSize / mb);
+	report.Line("operations", "%u allocations at %.0f ns, %u frees at %.0f ns",
+		allocations, allocations > 0 ? allocateMs * 1.0e6 / allocations : 0.0,
+		frees, frees > 0 ? freeMs * 1.0e6 / frees : 0.0);
+	report.Line("resident", "%.2f MB of mips, %.2f MB placed, %.2f MB committed (%.0f%% alignment waste saved)",
+		liveBytes / mb, placedBytes / mb, committedBytes / mb,
+		committedBytes > liveBytes ? 100.0 * (committedBytes - placedBytes) / (committedBytes - liveBytes) : 0.0);
+	report.Line("heap", "peak %.2f MB used, %u free ranges, %.1f%% fragmented",
+		peakUsed / mb, heap.FreeRangeCount(), 100.0 * fragmentation);
+	report.Line("no room", "%u out of bytes, %u with the bytes free but no range", outOfBytes, outOfRanges);
+	return report.Finish(errors);
+}
+
+std::string HeadlessBench::GeometryUploadReport(UINT& errors)
+{
+	BenchReport report("benchgeometry");
+
+	// Random ranges, empty ones included, at random alignments: each must be aligned,
+	// follow the one before, and come back intact from Write with the gaps zeroed and
+	// nothing written past TotalBytes.
+	{
+		std::mt19937 rng(5);
+		for(UINT trial = 0; trial < 50; ++trial)
+		{
+			std::vector<std::vector<uint8_t>> sources(1 + rng() % 40);
+			std::vector<uint64_t> alignments;
+			GeometryUploadBatcher batcher;
+			for(auto& source : sources)
+			{
+				source.resize(rng() % 4 == 0 ? 0 : 1 + rng() % 5000);
+				for(uint8_t& b : source)
+					b = (uint8_t)(1 + rng() % 255);
+				alignments.push_back(1ull << (rng() % 9));
+				batcher.Add(source.data(), source.size(), alignments.back());
+			}
+
+			const size_t guard = 64;
+			std::vector<uint8_t> packed((size_t)batcher.TotalBytes() + guard, 0xCD);
+			batcher.Write(packed.data());
+
+			uint64_t end = 0;
+			for(uint32_t r = 0; r < batcher.RangeCount(); ++r)
+			{
+				uint64_t offset = batcher.Offset(r);
+				if(offset < end || offset % alignments[r] != 0 || offset - end >= alignments[r] ||
+				   batcher.Bytes(r) != sources[r].size() ||
+				   !std::equal(sources[r].begin(), sources[r].end(), packed.begin() + (size_t)offset))
+					report.Fail();
+
+				for(uint64_t gap = end; gap < offset; ++gap)
+				{
+					if(packed[(size_t)gap] != 0)
+						report.Fail();
+				}
+				end = offset + batcher.Bytes(r);
+			}
+
+			if(end != batcher.TotalBytes() ||
+			   std::any_of(packed.end() - guard, packed.end(), [](uint8_t b) { return b != 0xCD; }))
+				report.Fail();
+		}
+
+		GeometryUploadBatcher batcher;
+		uint8_t bytes[3] = { 1, 2, 3 };
+		batcher.Add(bytes, 3, 1);
+		if(batcher.Add(bytes, 3, 256) != 1 || batcher.Offset(1) != 256 || batcher.TotalBytes() != 259 ||
+		   batcher.MaxAlignment() != 256)
+			report.Fail();
+		batcher.Clear();
+		if(batcher.RangeCount() != 0 || batcher.TotalBytes() != 0 || batcher.Add(bytes, 3) != 0 || batcher.Offset(0) != 0)
+			report.Fail();
+	}
+
+	// The app's generated meshes, as 32 byte vertices and 16 bit indices, batched against
+	// a default buffer and an upload buffer each, every one rounded to the 64 KB a
+	// committed resource takes.
+	GeometryGenerator geoGen;
+	std::vector<GeometryGenerator::MeshData> meshes;
+	meshes.push_back(geoGen.CreateGrid(600.0f, 600.0f, 50, 50));
+	meshes.push_back(geoGen.CreateGrid(100.0f, 100.0f, 60, 40));
+	meshes.push_back(geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3));
+	meshes.push_back(geoGen.CreateSphere(0.5f, 20, 20));
+	meshes.push_back(geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20));
+	meshes.push_back(geoGen.CreateGeosphere(0.5f, 3));
+
+	const uint64_t vertexBytes = 32;
+	const uint64_t resourceAlignment = 64 * 1024;
+	auto alignUp = [](uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; };
+
+	std::vector<std::vector<uint8_t>> vertexData;
+	std::vector<std::vector<uint16_t>> indexData;
+	uint64_t separateBytes = 0;
+	for(auto& mesh : meshes)
+	{
+		vertexData.push_back(std::vector<uint8_t>(mesh.Vertices.size() * vertexBytes, 1));
+		indexData.push_back(mesh.GetIndices16());
+		separateBytes += 2 * alignUp(vertexData.back().size(), resourceAlignment);
+		separateBytes += 2 * alignUp(indexData.back().size() * sizeof(uint16_t), resourceAlignment);
+	}
+
+	const UINT passes = 100;
+	GeometryUploadBatcher batcher;
+	std::vector<uint8_t> staging;
+	auto t0 = BenchClock::now();
+	for(UINT pass = 0; pass < passes; ++pass)
+	{
+		batcher.Clear();
+		for(size_t m = 0; m < meshes.size(); ++m)
+		{
+			batcher.Add(vertexData[m].data(), vertexData[m].size());
+			batcher.Add(indexData[m].data(), indexData[m].size() * sizeof(uint16_t));
+		}
+		staging.resize((size_t)batcher.TotalBytes());
+		batcher.Write(staging.data());
+	}
+	double packMs = ElapsedMs(t0, BenchClock::now()) / passes;
+
+	for(size_t m = 0; m < meshes.size(); ++m)
+	{
+		const uint8_t* indices = staging.data() + batcher.Offset(2 * (uint32_t)m + 1);
+		if(memcmp(indices, indexData[m].data(), indexData[m].size() * sizeof(uint16_t)) != 0)
+			report.Fail();
+	}
+
+	uint64_t batchedBytes = 2 * alignUp(batcher.TotalBytes(), resourceAlignment);
+	UINT buffers = batcher.RangeCount();
+
+	const double mb = 1024.0 * 1024.0;
+	report.Line("meshes", "%u, %u vertex and index buffers, %.2f MB", (UINT)meshes.size(), buffers, batcher.TotalBytes() / mb);
+	report.Line("separate", "%u resources, %u copies, %u barriers, %.2f MB", 2 * buffers, buffers, 2 * buffers, separateBytes / mb);
+	report.Line("batched", "2 resources, 1 copy, 1 barrier, %.2f MB", batchedBytes / mb);
+	report.Line("pack+write", "%.3f ms", packMs);
+	return report.Finish(errors);
+}
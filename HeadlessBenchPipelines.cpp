@@ -0,0 +1,241 @@
+//***************************************************************************************
+// HeadlessBenchPipelines.cpp
+//
+// -benchshaders and -benchpsos: the shader cache and the pipeline registry, with
+// stand-ins for the compiler and the device.
+//***************************************************************************************
+
+#include "HeadlessBench.h"
+#include "BenchReport.h"
+#include "ShaderCache.h"
+#include "PipelineRegistry.h"
+#include <atomic>
+
+using Microsoft::WRL::ComPtr;
+
+std::string HeadlessBench::ShaderCacheReport(UINT& errors)
+{
+	wchar_t tempPath[MAX_PATH];
+	GetTempPathW(MAX_PATH, tempPath);
+	// Per process, so blobs left by an earlier run cannot turn the cold build warm.
+	std::wstring dir = std::wstring(tempPath) + L"DirectXAssignmentFinalShaderBench" +
+		std::to_wstring(GetCurrentProcessId()) + L"\\";
+	std::wstring cacheDir = dir + L"Cache\\";
+	CreateDirectoryW(dir.c_str(), nullptr);
+
+	auto writeFile = [](const std::wstring& path, const std::string& text)
+	{
+		std::ofstream fout(path, std::ios::binary);
+		fout << text;
+	};
+
+	std::wstring mainFile = dir + L"Main.hlsl";
+	std::wstring utilFile = dir + L"Util.hlsl";
+	writeFile(mainFile, "#include \"Util.hlsl\"\nfloat4 PS() : SV_Target { return Shade(); }\n");
+	writeFile(utilFile, "float4 Shade() { return 1.0f; }\n");
+
+	// Stands in for D3DCompile: the "bytecode" spells out what was compiled.
+	std::atomic<UINT> compiles(0);
+	auto compile = [&compiles](const ShaderPermutation& permutation)
+	{
+		std::string text = permutation.EntryPoint + "/" + permutation.Target;
+		for(const auto& define : permutation.Defines)
+			text += "/" + define.first + "=" + define.second;
+
+		ComPtr<ID3DBlob> blob;
+		ThrowIfFailed(D3DCreateBlob(text.size(), blob.GetAddressOf()));
+		memcpy(blob->GetBufferPointer(), text.data(), text.size());
+		compiles++;
+		return blob;
+	};
+
+	const D3D_SHADER_MACRO fog[] = { "FOG", "1", NULL, NULL };
+	const D3D_SHADER_MACRO fogAlpha[] = { "FOG", "1", "ALPHA_TEST", "1", NULL, NULL };
+	const D3D_SHADER_MACRO shadow[] = { "SHADOW", "1", NULL, NULL };
+
+	auto fill = [&](ShaderCache& cache)
+	{
+		cache.Add("vs", mainFile, nullptr, "VS", "vs_5_0");
+		cache.Add("ps", mainFile, nullptr, "PS", "ps_5_0");
+		cache.Add("fogPS", mainFile, fog, "PS", "ps_5_0");
+		cache.Add("fogAlphaPS", mainFile, fogAlpha, "PS", "ps_5_0");
+	};
+
+	BenchReport report("benchshaders");
+
+	ShaderCache cold(cacheDir, compile);
+	fill(cold);
+	cold.Build();
+	UINT coldCompiles = compiles.exchange(0);
+	if(cold.MissCount() != 4 || coldCompiles != 4)
+		report.Fail();
+
+	// Every permutation differs in something, so no two may share a key.
+	std::vector<uint64_t> keys;
+	for(const ShaderPermutation& permutation : cold.GetPermutations())
+		keys.push_back(permutation.Key);
+	std::sort(keys.begin(), keys.end());
+	if(std::unique(keys.begin(), keys.end()) != keys.end())
+		report.Fail();
+
+	ShaderCache warm(cacheDir, compile);
+	fill(warm);
+	warm.Build();
+	UINT warmCompiles = compiles.exchange(0);
+	if(warm.HitCount() != 4 || warmCompiles != 0)
+		report.Fail();
+
+	for(const ShaderPermutation& permutation : warm.GetPermutations())
+	{
+		ComPtr<ID3DBlob> a = cold.Get(permutation.Name);
+		ComPtr<ID3DBlob> b = warm.Get(permutation.Name);
+		if(a == nullptr || b == nullptr || a->GetBufferSize() != b->GetBufferSize() ||
+		   memcmp(a->GetBufferPointer(), b->GetBufferPointer(), a->GetBufferSize()) != 0)
+			report.Fail();
+	}
+
+	// Editing only the included file must still invalidate every permutation.
+	writeFile(utilFile, "float4 Shade() { return 0.5f; }\n");
+	ShaderCache edited(cacheDir, compile);
+	fill(edited);
+	edited.Build();
+	UINT editedCompiles = compiles.exchange(0);
+	if(edited.MissCount() != 4 || editedCompiles != 4)
+		report.Fail();
+
+	// One permutation under two names is compiled and written once, and both names get
+	// its blob.
+	ShaderCache shared(cacheDir, compile);
+	shared.Add("shadowPS", mainFile, shadow, "PS", "ps_5_0");
+	shared.Add("shadowAlphaPS", mainFile, shadow, "PS", "ps_5_0");
+	shared.Build();
+	UINT sharedCompiles = compiles.exchange(0);
+	if(shared.MissCount() != 2 || sharedCompiles != 1 || shared.Get("shadowPS") == nullptr ||
+	   shared.Get("shadowPS") != shared.Get("shadowAlphaPS"))
+		report.Fail();
+
+	for(const ShaderCache* cache : { &cold, &edited, &shared })
+	{
+		for(const ShaderPermutation& permutation : cache->GetPermutations())
+			DeleteFileW(cache->BlobPath(permutation.Key).c_str());
+	}
+	RemoveDirectoryW(cacheDir.c_str());
+	DeleteFileW(mainFile.c_str());
+	DeleteFileW(utilFile.c_str());
+	RemoveDirectoryW(dir.c_str());
+
+	report.Line("permutations", "4");
+	report.Line("cold", "%u compiled in %.3f ms", coldCompiles, cold.BuildMs());
+	report.Line("warm", "%u cached in %.3f ms", warm.HitCount(), warm.BuildMs());
+	report.Line("include edited", "%u compiled", editedCompiles);
+	report.Line("shared key", "2 names, %u compiled", sharedCompiles);
+	return report.Finish(errors);
+}
+
+std::string HeadlessBench::PipelineReport(UINT frameCount, UINT& errors)
+{
+	// Stand-in bytecode; only its contents are hashed.
+	auto makeBlob = [](const std::string& text)
+	{
+		ComPtr<ID3DBlob> blob;
+		ThrowIfFailed(D3DCreateBlob(text.size(), blob.GetAddressOf()));
+		memcpy(blob->GetBufferPointer(), text.data(), text.size());
+		return blob;
+	};
+
+	std::vector<ComPtr<ID3DBlob>> vertexShaders = { makeBlob("vs0"), makeBlob("vs1"), makeBlob("vs2") };
+	std::vector<ComPtr<ID3DBlob>> pixelShaders = { makeBlob("ps0"), makeBlob("ps1"), makeBlob("ps2"), makeBlob("ps3") };
+
+	const std::vector<D3D12_INPUT_ELEMENT_DESC> layout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+
+	// Every combination of states; reversed registers its shaders in the opposite order.
+	auto registerAll = [&](PipelineRegistry& registry, bool reversed, std::vector<PsoHandle>& handles)
+	{
+		registry.AddInputLayout(layout);
+		for(size_t i = 0; i < vertexShaders.size() + pixelShaders.size(); ++i)
+		{
+			size_t j = reversed ? vertexShaders.size() + pixelShaders.size() - 1 - i : i;
+			registry.AddShader(j < vertexShaders.size() ? vertexShaders[j].Get() : pixelShaders[j - vertexShaders.size()].Get());
+		}
+
+		const UINT combinations = (UINT)(vertexShaders.size() * pixelShaders.size()) * 2 * 3 * 3;
+		for(UINT c = 0; c < combinations; ++c)
+		{
+			UINT i = c;
+			PipelineStateKey key;
+			key.VS = registry.AddShader(vertexShaders[i % vertexShaders.size()].Get());
+			i /= (UINT)vertexShaders.size();
+			key.PS = registry.AddShader(pixelShaders[i % pixelShaders.size()].Get());
+			i /= (UINT)pixelShaders.size();
+			key.Blend = (PsoBlend)(i % 2);
+			i /= 2;
+			key.CullMode = (uint8_t)(D3D12_CULL_MODE_NONE + i % 3);
+			i /= 3;
+			key.Topology = (uint8_t)(D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT + i % 3);
+			handles.push_back(registry.Register(key));
+		}
+	};
+
+	PipelineRegistry registry;
+	PipelineRegistry reversedRegistry;
+	std::vector<PsoHandle> handles;
+	std::vector<PsoHandle> reversedHandles;
+
+	BenchClock::time_point start = BenchClock::now();
+	registerAll(registry, false, handles);
+	double registerMs = ElapsedMs(start, BenchClock::now());
+	registerAll(reversedRegistry, true, reversedHandles);
+
+	BenchReport report("benchpsos");
+
+	// Registering again must hand back the same handles.
+	std::vector<PsoHandle> again;
+	registerAll(registry, false, again);
+	if(again != handles || registry.Count() != (UINT)handles.size())
+		report.Fail();
+
+	std::vector<uint64_t> hashes;
+	for(PsoHandle h = 0; h < registry.Count(); ++h)
+	{
+		const PipelineStateKey& key = registry.GetKey(h);
+		if(registry.Find(key) != h)
+			report.Fail();
+
+		hashes.push_back(registry.StableHash(key));
+		if(registry.StableHash(key) != reversedRegistry.StableHash(reversedRegistry.GetKey(reversedHandles[h])))
+			report.Fail();
+	}
+
+	std::sort(hashes.begin(), hashes.end());
+	if(std::unique(hashes.begin(), hashes.end()) != hashes.end())
+		report.Fail();
+
+	// Per-frame lookup: the handle array against a string keyed map.
+	std::unordered_map<std::string, PsoHandle> byName;
+	for(PsoHandle h = 0; h < registry.Count(); ++h)
+		byName["pso" + std::to_string(h)] = h;
+
+	const UINT lookups = std::max<UINT>(frameCount, 1) * (UINT)RenderLayer::Count;
+	std::vector<std::string> names;
+	for(UINT i = 0; i < lookups; ++i)
+		names.push_back("pso" + std::to_string(i % registry.Count()));
+
+	volatile UINT sink = 0;
+	start = BenchClock::now();
+	for(UINT i = 0; i < lookups; ++i)
+		sink += byName[names[i]];
+	double stringMs = ElapsedMs(start, BenchClock::now());
+
+	std::vector<PsoHandle> layerHandles(handles.begin(), handles.begin() + (int)RenderLayer::Count);
+	start = BenchClock::now();
+	for(UINT i = 0; i < lookups; ++i)
+		sink += registry.GetKey(layerHandles[i % layerHandles.size()]).Topology;
+	double handleMs = ElapsedMs(start, BenchClock::now());
+
+	report.Line("pipelines", "%u, registered in %.3f ms", registry.Count(), registerMs);
+	report.Line("lookups", "%u: string map %.3f ms, handle %.3f ms", lookups, stringMs, handleMs);
+	return report.Finish(errors);
+}
@@ -0,0 +1,162 @@
+//***************************************************************************************
+// HeadlessBenchScene.cpp
+//
+// -benchlights: the light grid and clusters, checked against brute force.
+//***************************************************************************************
+
+#include "HeadlessBench.h"
+#include "BenchReport.h"
+#include "LightClusterer.h"
+#include "LightManager.h"
+#include <random>
+
+using namespace DirectX;
+
+std::string HeadlessBench::LightReport(UINT lightCount, UINT frameCount, UINT& errors)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> height(0.0f, 40.0f);
+	std::uniform_real_distribution<float> range(2.0f, 12.0f);
+	std::uniform_real_distribution<float> strength(0.2f, 2.0f);
+
+	LightManager manager(lightCount);
+	std::vector<LightHandle> handles;
+	for(UINT i = 0; i < lightCount; ++i)
+	{
+		Light light;
+		light.Position = XMFLOAT3(position(rng), height(rng), position(rng));
+		light.FalloffStart = 0.0f;
+		light.FalloffEnd = range(rng);
+		light.Strength = XMFLOAT3(strength(rng), strength(rng), strength(rng));
+		handles.push_back(manager.Create(LightType::Point, light));
+	}
+
+	const float fovY = 0.25f*MathHelper::Pi;
+	const float aspect = 16.0f / 9.0f;
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(fovY, aspect, 1.0f, 1000.0f);
+
+	LightClusterer clusters;
+	clusters.SetProjection(fovY, aspect, 1.0f, 1000.0f);
+
+	FrustumCuller frustum;
+	std::vector<UINT> candidates;
+
+	double gridMs = 0.0;
+	double queryMs = 0.0;
+	double buildMs = 0.0;
+	double candidateCount = 0.0;
+	double refs = 0.0;
+	XMFLOAT4X4 view;
+	for(UINT frame = 0; frame < frameCount; ++frame)
+	{
+		// A handful of lights wander each frame, which makes the grid rebuild.
+		for(UINT i = 0; i < lightCount / 100 + 1 && i < lightCount; ++i)
+		{
+			LightHandle handle = handles[rng() % lightCount];
+			manager.Move(handle, XMFLOAT3(position(rng), height(rng), position(rng)));
+		}
+
+		float angle = 2.0f*MathHelper::Pi*frame / std::max<UINT>(frameCount, 1);
+		XMVECTOR eye = XMVectorSet(120.0f*cosf(angle), 40.0f, 120.0f*sinf(angle), 1.0f);
+		XMMATRIX viewMatrix = XMMatrixLookAtLH(eye, XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMStoreFloat4x4(&view, viewMatrix);
+		frustum.SetFrustum(viewMatrix, proj);
+
+		BenchClock::time_point start = BenchClock::now();
+		manager.UpdateGrid();
+		BenchClock::time_point gridDone = BenchClock::now();
+
+		candidates.clear();
+		manager.QueryFrustum(frustum, candidates);
+		BenchClock::time_point queryDone = BenchClock::now();
+
+		clusters.Build(manager.GetLocalLights(), candidates, view);
+		BenchClock::time_point buildDone = BenchClock::now();
+
+		gridMs += ElapsedMs(start, gridDone);
+		queryMs += ElapsedMs(gridDone, queryDone);
+		buildMs += ElapsedMs(queryDone, buildDone);
+		candidateCount += (double)candidates.size();
+		refs += (double)clusters.GetLightIndices().size();
+	}
+
+	const std::vector<Light>& lights = manager.GetLocalLights();
+
+	// The grid may return extra lights but must not miss one that reaches the frustum.
+	UINT missed = 0;
+	const XMFLOAT4* planes = frustum.GetPlanes();
+	for(UINT i = 0; i < lightCount; ++i)
+	{
+		bool inside = true;
+		for(int p = 0; p < 6; ++p)
+		{
+			const XMFLOAT3& c = lights[i].Position;
+			if(planes[p].x*c.x + planes[p].y*c.y + planes[p].z*c.z + planes[p].w < -lights[i].FalloffEnd)
+				inside = false;
+		}
+
+		if(inside && !std::binary_search(candidates.begin(), candidates.end(), i))
+			missed++;
+	}
+
+	// Reference: every candidate against every cluster, in the last frame's view.  Build
+	// only bins the candidates, so the reference does too: a light outside the frustum
+	// can still touch the box of an edge cluster, and whether the grid returned it is
+	// up to the grid, which the check above covers.  The centers are transformed with
+	// the same arithmetic as Build, so lights grazing a cluster are not reported as
+	// mismatches because of rounding.
+	std::vector<XMFLOAT3> centersV(lightCount);
+	for(UINT i = 0; i < lightCount; ++i)
+	{
+		const XMFLOAT3& p = lights[i].Position;
+		centersV[i].x = p.x*view(0, 0) + p.y*view(1, 0) + p.z*view(2, 0) + view(3, 0);
+		centersV[i].y = p.x*view(0, 1) + p.y*view(1, 1) + p.z*view(2, 1) + view(3, 1);
+		centersV[i].z = p.x*view(0, 2) + p.y*view(1, 2) + p.z*view(2, 2) + view(3, 2);
+	}
+
+	UINT mismatches = 0;
+	UINT cappedClusters = 0;
+	UINT maxPerCluster = 0;
+	std::vector<UINT> expected;
+	for(UINT c = 0; c < LightClusterer::ClusterCount; ++c)
+	{
+		expected.clear();
+		for(UINT i : candidates)
+		{
+			if(clusters.SphereTouchesCluster(centersV[i], lights[i].FalloffEnd, c))
+				expected.push_back(i);
+		}
+
+		const ClusterRange& r = clusters.GetRanges()[c];
+		const UINT* found = clusters.GetLightIndices().data() + r.Offset;
+		if(expected.size() <= LightClusterer::MaxLightsPerCluster)
+		{
+			if(r.Count != expected.size() || !std::equal(expected.begin(), expected.end(), found))
+				mismatches++;
+		}
+		else
+		{
+			// Overfull: a full list, drawn from the lights that touch the cluster.
+			cappedClusters++;
+			if(r.Count != LightClusterer::MaxLightsPerCluster ||
+			   !std::includes(expected.begin(), expected.end(), found, found + r.Count))
+				mismatches++;
+		}
+
+		maxPerCluster = std::max<UINT>(maxPerCluster, r.Count);
+	}
+	BenchReport report("benchlights");
+	report.Fail(missed + mismatches + clusters.DroppedCount());
+
+	double frames = std::max<double>(frameCount, 1.0);
+	report.Line("lights", "%u in %u clusters, %u grid cells, %u frames", lightCount, LightClusterer::ClusterCount,
+		manager.CellCount(), frameCount);
+	report.Line("ms/frame", "grid %.3f  query %.3f  build %.3f", gridMs / frames, queryMs / frames, buildMs / frames);
+	report.Line("per frame", "%.0f candidates, %.0f light refs", candidateCount / frames, refs / frames);
+	report.Line("per cluster", "at most %u, %u clusters capped", maxPerCluster, cappedClusters);
+	report.Line("missed", "%u by the grid", missed);
+	report.Line("dropped", "%u", clusters.DroppedCount());
+	report.Line("mismatched", "%u clusters", mismatches);
+	return report.Finish(errors);
+}
@@ -0,0 +1,956 @@
+//***************************************************************************************
+// HeadlessBenchTextures.cpp
+//
+// -benchdds, -benchstream, -benchmips, -benchpack, -benchbc and -benchindex: loading,
+// streaming, residency, packing, compression and indexing of the app's textures.
+//***************************************************************************************
+
+#include "HeadlessBench.h"
+#include "BenchReport.h"
+#include "Common/DDSFile.h"
+#include "FramePacer.h"
+#include "TextureStreamer.h"
+#include "TextureResidency.h"
+#include "TexturePacker.h"
+#include "BlockCompress.h"
+#include "AssetIndex.h"
+#include <cmath>
+#include <iterator>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Every Textures\*.dds under the working directory.
+	std::vector<std::wstring> TextureFiles()
+	{
+		std::vector<std::wstring> files;
+		WIN32_FIND_DATAW found;
+		HANDLE find = FindFirstFileW(L"Textures\\*.dds", &found);
+		if(find != INVALID_HANDLE_VALUE)
+		{
+			do
+				files.push_back(std::wstring(L"Textures\\") + found.cFileName);
+			while(FindNextFileW(find, &found));
+			FindClose(find);
+		}
+		return files;
+	}
+}
+
+std::string HeadlessBench::DdsReport(UINT frameCount, UINT& errors)
+{
+	std::vector<std::wstring> files = TextureFiles();
+
+	// Stands in for the upload heap: both paths end by copying every subresource here.
+	auto upload = [](const uint8_t* data, size_t size, std::vector<uint8_t>& staging)
+	{
+		staging.clear();
+		DDS::Image image;
+		DDS::SubresourceLayout layout;
+		if(DDS::ParseHeader(data, size, image) != DDS::Status::Ok ||
+		   DDS::GetSubresources(image, 0, layout) != DDS::Status::Ok)
+			return false;
+
+		for(const DDS::Subresource& subresource : layout.Subresources)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(subresource.Data);
+			staging.insert(staging.end(), bytes, bytes + subresource.SlicePitch);
+		}
+		return true;
+	};
+
+	BenchReport report("benchdds");
+	UINT64 fileBytes = 0;
+	double readMs = 0.0;
+	double mappedMs = 0.0;
+	std::vector<uint8_t> readStaging;
+	std::vector<uint8_t> mappedStaging;
+
+	const UINT passes = std::max<UINT>(frameCount / 20, 1);
+	for(UINT pass = 0; pass < passes; ++pass)
+	{
+		for(const std::wstring& file : files)
+		{
+			// The old path: the whole file read into a heap buffer first.
+			BenchClock::time_point start = BenchClock::now();
+			std::ifstream fin(file, std::ios::binary);
+			std::vector<uint8_t> data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+			bool readOk = upload(data.data(), data.size(), readStaging);
+			readMs += ElapsedMs(start, BenchClock::now());
+
+			start = BenchClock::now();
+			DDS::MappedFile mapped;
+			bool mappedOk = mapped.Open(file.c_str()) && upload(mapped.Data(), mapped.Size(), mappedStaging);
+			mappedMs += ElapsedMs(start, BenchClock::now());
+
+			if(!readOk || !mappedOk || readStaging != mappedStaging)
+				report.Fail();
+
+			if(pass == 0)
+				fileBytes += data.size();
+		}
+	}
+
+	// Layouts worked out by hand.
+	size_t numBytes = 0, rowBytes = 0, numRows = 0;
+	DDS::GetSurfaceInfo(4, 4, DXGI_FORMAT_BC1_UNORM, &numBytes, &rowBytes, &numRows);
+	if(numBytes != 8 || rowBytes != 8 || numRows != 1)
+		report.Fail();
+	DDS::GetSurfaceInfo(5, 5, DXGI_FORMAT_BC3_UNORM, &numBytes, &rowBytes, &numRows);
+	if(numBytes != 64 || rowBytes != 32 || numRows != 2)
+		report.Fail();
+	DDS::GetSurfaceInfo(3, 2, DXGI_FORMAT_R8G8B8A8_UNORM, &numBytes, &rowBytes, &numRows);
+	if(numBytes != 24 || rowBytes != 12 || numRows != 2)
+		report.Fail();
+
+	if(files.empty())
+		report.Fail();
+
+	report.Line("files", "%u, %llu bytes, %u passes", (UINT)files.size(), (unsigned long long)fileBytes, passes);
+	report.Line("read", "%.3f ms", readMs / passes);
+	report.Line("mapped", "%.3f ms, %.1f MB not copied into heap buffers", mappedMs / passes, fileBytes / (1024.0 * 1024.0));
+	return report.Finish(errors);
+}
+
+std::string HeadlessBench::StreamingReport(UINT frameCount, UINT& errors)
+{
+	std::vector<std::wstring> files = TextureFiles();
+
+	// A file that cannot be opened must come back failed, not stall the queue.
+	files.push_back(L"Textures\\missing.dds");
+
+	// The same sizes the app uses.
+	const uint64_t stagingSize = 8 * 1024 * 1024;
+	const uint64_t frameBudget = 4 * 1024 * 1024;
+	const double cpuMs = 4.0;
+	const double gpuMs = 6.0;
+
+	BenchReport report("benchstream");
+
+	// The serial path the app used before: every file read and parsed on the calling
+	// thread before the first frame.
+	BenchClock::time_point start = BenchClock::now();
+	UINT64 fileBytes = 0;
+	for(const std::wstring& file : files)
+	{
+		std::ifstream fin(file, std::ios::binary);
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+		DDS::Image image;
+		DDS::SubresourceLayout layout;
+		if(DDS::ParseHeader(data.data(), data.size(), image) == DDS::Status::Ok)
+			DDS::GetSubresources(image, 0, layout);
+		fileBytes += data.size();
+	}
+	double serialMs = ElapsedMs(start, BenchClock::now());
+
+	std::vector<uint8_t> staging((size_t)stagingSize);
+	SimulatedFence fence;
+	uint64_t fenceValue = 0;
+	UINT frames = 0;
+	UINT failed = 0;
+	uint64_t highWater = 0;
+	double pumpMs = 0.0;
+	double checkMs = 0.0;
+
+	// staging outlives the streamer.
+	start = BenchClock::now();
+	TextureStreamer streamer(staging.data(), stagingSize);
+	for(const std::wstring& file : files)
+		streamer.Request(file);
+	double requestMs = ElapsedMs(start, BenchClock::now());
+
+	// Checks each staged texture against the file read the plain way.
+	auto verify = [&](const StreamedTexture& texture)
+	{
+		if(texture.Status != DDS::Status::Ok)
+		{
+			failed++;
+			return;
+		}
+
+		std::ifstream fin(files[texture.Request], std::ios::binary);
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+		DDS::Image image;
+		DDS::SubresourceLayout layout;
+		if(DDS::ParseHeader(data.data(), data.size(), image) != DDS::Status::Ok ||
+		   DDS::GetSubresources(image, 0, layout) != DDS::Status::Ok ||
+		   layout.Subresources.size() != texture.Subresources.size())
+		{
+			report.Fail();
+			return;
+		}
+
+		for(size_t s = 0; s < layout.Subresources.size(); ++s)
+		{
+			const DDS::Subresource& source = layout.Subresources[s];
+			const StagedSubresource& footprint = texture.Subresources[s];
+			size_t numRows = source.SlicePitch / source.RowPitch;
+			if(footprint.Offset % TextureStreamer::PlacementAlignment != 0 ||
+			   footprint.RowPitch % TextureStreamer::PitchAlignment != 0 ||
+			   footprint.Offset + (uint64_t)footprint.RowPitch * numRows * footprint.Depth > stagingSize)
+			{
+				report.Fail();
+				return;
+			}
+
+			for(size_t row = 0; row < numRows * footprint.Depth; ++row)
+			{
+				if(memcmp(staging.data() + footprint.Offset + row * footprint.RowPitch,
+					static_cast<const uint8_t*>(source.Data) + row * source.RowPitch, source.RowPitch) != 0)
+				{
+					report.Fail();
+					return;
+				}
+			}
+		}
+	};
+
+	// The check's time is taken out of the pump time.
+	auto check = [&](const StreamedTexture& texture)
+	{
+		BenchClock::time_point checkStart = BenchClock::now();
+		verify(texture);
+		checkMs += ElapsedMs(checkStart, BenchClock::now());
+	};
+
+	// The workers' wall time, against the serial load above.
+	streamer.WaitForLoads();
+	double loadWallMs = ElapsedMs(start, BenchClock::now());
+
+	// Staging is spread over frames by the budget and the fence.
+	while(frames < frameCount && !streamer.IsIdle())
+	{
+		fence.Advance(cpuMs);
+
+		BenchClock::time_point pumpStart = BenchClock::now();
+		streamer.Pump(fence.GetCompletedValue(), fenceValue + 1, frameBudget, check);
+		pumpMs += ElapsedMs(pumpStart, BenchClock::now());
+
+		highWater = std::max<uint64_t>(highWater, streamer.GetRing().UsedBytes());
+		fence.Submit(++fenceValue, gpuMs);
+		frames++;
+	}
+
+	if(!streamer.IsIdle())
+		report.Fail();
+	if(failed != 1 || streamer.FailedCount() != 1)
+		report.Fail();
+
+	report.Line("files", "%u, %llu bytes", (UINT)files.size(), (unsigned long long)fileBytes);
+	report.Line("serial load", "%.3f ms", serialMs);
+	report.Line("streamed", "request %.3f ms, workers done after %.3f ms (%.3f ms summed)",
+		requestMs, loadWallMs, streamer.LoadMs());
+	report.Line("resident", "all after %u frames, pump %.3f ms/frame", frames, (pumpMs - checkMs) / std::max<UINT>(frames, 1));
+	report.Line("staged", "%.1f MB, ring high water %.1f of %.1f MB", streamer.BytesStaged() / (1024.0 * 1024.0),
+		highWater / (1024.0 * 1024.0), stagingSize / (1024.0 * 1024.0));
+	return report.Finish(errors);
+}
+
+std::string HeadlessBench::MipResidencyReport(UINT frameCount, UINT& errors)
+{
+	BenchReport report("benchmips");
+
+	// Mip sizes of a square BC1 texture: half a byte per texel, 4x4 blocks at least.
+	auto bc1Mips = [](UINT size)
+	{
+		std::vector<uint64_t> mips;
+		for(UINT s = size; ; s /= 2)
+		{
+			UINT blocks = std::max<UINT>(s / 4, 1);
+			mips.push_back((uint64_t)blocks * blocks * 8);
+			if(s == 1)
+				break;
+		}
+		return mips;
+	};
+	const UINT tailSize = 64;
+	auto tailMip = [tailSize](UINT size)
+	{
+		UINT mip = 0;
+		while((size >> mip) > tailSize)
+			mip++;
+		return mip;
+	};
+
+	// Mips for texel to pixel ratios, worked out by hand.
+	if(TextureResidency::DemandedMip(1024.0f, 1024.0f, 11) != 0 ||
+	   TextureResidency::DemandedMip(1024.0f, 256.0f, 11) != 2 ||
+	   TextureResidency::DemandedMip(1024.0f, 300.0f, 11) != 1 ||
+	   TextureResidency::DemandedMip(1024.0f, 0.5f, 11) != 10 ||
+	   TextureResidency::DemandedMip(1024.0f, 0.0f, 11) != 10)
+		report.Fail();
+
+	// Room for the tails and two full chains: the least recently used gives way.
+	{
+		std::vector<uint64_t> mips = bc1Mips(1024);
+		TextureResidency scripted(0);
+		UINT a = scripted.Add(mips, tailMip(1024));
+		UINT b = scripted.Add(mips, tailMip(1024));
+		UINT c = scripted.Add(mips, tailMip(1024));
+		scripted.SetBudget(scripted.TailBytes() + 2 * (scripted.ChainBytes(a, 0) - scripted.ChainBytes(a, tailMip(1024))));
+
+		scripted.Demand(a, 0);
+		scripted.Update(1);
+		scripted.Demand(b, 0);
+		scripted.Update(2);
+		scripted.Demand(c, 0);
+		scripted.Update(3);
+		if(scripted.ResidentMip(a) != tailMip(1024) || scripted.ResidentMip(b) != 0 || scripted.ResidentMip(c) != 0)
+			report.Fail();
+
+		// Demanded this frame, so b is not dropped for a.
+		scripted.Demand(a, 0);
+		scripted.Demand(b, 0);
+		scripted.Update(4);
+		if(scripted.ResidentMip(a) != 0 || scripted.ResidentMip(b) != 0 || scripted.ResidentMip(c) != tailMip(1024))
+			report.Fail();
+
+		// A lower budget takes the finest mips even of what is in use.
+		scripted.SetBudget(scripted.TailBytes() + mips[0]);
+		scripted.Demand(a, 0);
+		scripted.Demand(b, 0);
+		scripted.Update(5);
+		if(scripted.UsedBytes() > scripted.Budget())
+			report.Fail();
+	}
+
+	// A camera circles over a field of textured items, each asking for its mip by
+	// distance, under a budget of a quarter of all the mips.
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> radius(1.0f, 20.0f);
+	std::uniform_real_distribution<float> tiling(1.0f, 8.0f);
+	const UINT sizes[] = { 256, 512, 1024, 2048 };
+
+	const UINT textureCount = 256;
+	std::vector<UINT> textureSizes;
+	TextureResidency residency(0);
+	uint64_t allBytes = 0;
+	for(UINT t = 0; t < textureCount; ++t)
+	{
+		UINT size = sizes[rng() % 4];
+		textureSizes.push_back(size);
+		UINT index = residency.Add(bc1Mips(size), tailMip(size));
+		allBytes += residency.ChainBytes(index, 0);
+	}
+	residency.SetBudget(allBytes / 4);
+
+	struct Item
+	{
+		XMFLOAT3 Center;
+		float Radius;
+		float Tiling;
+		UINT Texture;
+	};
+	std::vector<Item> items(4096);
+	for(Item& item : items)
+	{
+		item.Center = XMFLOAT3(position(rng), 0.0f, position(rng));
+		item.Radius = radius(rng);
+		item.Tiling = tiling(rng);
+		item.Texture = (UINT)(rng() % textureCount);
+	}
+
+	const float fovY = 0.25f * XM_PI;
+	const float pixelsPerUnit = 1080.0f / (2.0f * tanf(0.5f * fovY));
+	const float viewDistance = 400.0f;
+
+	UINT64 demands = 0;
+	UINT64 hits = 0;
+	uint64_t peakBytes = 0;
+	double updateMs = 0.0;
+	std::vector<UINT> demanded(textureCount);
+	for(UINT frame = 1; frame <= frameCount; ++frame)
+	{
+		float angle = 0.01f * frame;
+		XMVECTOR eye = XMVectorSet(300.0f * cosf(angle), 20.0f, 300.0f * sinf(angle), 0.0f);
+		XMVECTOR forward = XMVector3Normalize(XMVectorSet(-sinf(angle), 0.0f, cosf(angle), 0.0f));
+
+		std::fill(demanded.begin(), demanded.end(), UINT_MAX);
+		for(const Item& item : items)
+		{
+			XMVECTOR toItem = XMLoadFloat3(&item.Center) - eye;
+			float distance = XMVectorGetX(XMVector3Length(toItem));
+			if(distance > viewDistance || XMVectorGetX(XMVector3Dot(toItem, forward)) < 0.5f * distance)
+				continue;
+
+			distance = std::max<float>(distance - item.Radius, 1.0f);
+			float pixelsAcross = 2.0f * item.Radius / distance * pixelsPerUnit;
+			UINT mip = TextureResidency::DemandedMip(textureSizes[item.Texture] * item.Tiling, pixelsAcross,
+				residency.MipCount(item.Texture));
+			residency.Demand(item.Texture, mip);
+			demanded[item.Texture] = std::min<UINT>(demanded[item.Texture], mip);
+		}
+
+		BenchClock::time_point start = BenchClock::now();
+		residency.Update(frame);
+		updateMs += ElapsedMs(start, BenchClock::now());
+
+		uint64_t used = 0;
+		for(UINT t = 0; t < textureCount; ++t)
+		{
+			used += residency.ChainBytes(t, residency.ResidentMip(t));
+			if(demanded[t] == UINT_MAX)
+				continue;
+
+			demands++;
+			if(residency.ResidentMip(t) <= std::min<UINT>(demanded[t], tailMip(textureSizes[t])))
+				hits++;
+		}
+
+		// The books must balance, and the tails fit, so the budget must hold.
+		if(used != residency.UsedBytes() || used > residency.Budget())
+			report.Fail();
+		peakBytes = std::max<uint64_t>(peakBytes, used);
+	}
+
+	const double mb = 1024.0 * 1024.0;
+	report.Line("textures", "%u, %u items, %u frames", textureCount, (UINT)items.size(), frameCount);
+	report.Line("bytes", "all mips %.1f MB, budget %.1f MB, tails %.1f MB, peak %.1f MB",
+		allBytes / mb, residency.Budget() / mb, residency.TailBytes() / mb, peakBytes / mb);
+	report.Line("demands met", "%.1f%%", demands > 0 ? 100.0 * hits / demands : 100.0);
+	report.Line("moved", "loaded %.1f MB, evicted %.1f MB", residency.BytesLoaded() / mb, residency.BytesEvicted() / mb);
+	report.Line("update", "%.4f ms/frame", updateMs / std::max<UINT>(frameCount, 1));
+	return report.Finish(errors);
+}
+
+std::string HeadlessBench::PackReport(UINT& errors)
+{
+	BenchReport report("benchpack");
+
+	// A legacy DDS file of a BC1 or BC3 texture, its blocks filled from seed.
+	auto makeDds = [](bool bc3, UINT width, UINT height, UINT mipCount, UINT seed)
+	{
+		DDS_HEADER header = {};
+		header.size = sizeof(DDS_HEADER);
+		header.flags = DDS_WIDTH | DDS_HEIGHT;
+		header.width = width;
+		header.height = height;
+		header.mipMapCount = mipCount;
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		header.ddspf.flags = DDS_FOURCC;
+		header.ddspf.fourCC = bc3 ? MAKEFOURCC('D', 'X', 'T', '5') : MAKEFOURCC('D', 'X', 'T', '1');
+
+		size_t bitSize = 0;
+		for(UINT m = 0; m < mipCount; ++m)
+		{
+			size_t numBytes = 0;
+			DDS::GetSurfaceInfo(std::max<UINT>(width >> m, 1), std::max<UINT>(height >> m, 1),
+				bc3 ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM, &numBytes, nullptr, nullptr);
+			bitSize += numBytes;
+		}
+
+		std::vector<uint8_t> file(sizeof(uint32_t) + sizeof(header) + bitSize);
+		memcpy(file.data(), &DDS_MAGIC, sizeof(uint32_t));
+		memcpy(file.data() + sizeof(uint32_t), &header, sizeof(header));
+		for(size_t i = sizeof(uint32_t) + sizeof(header); i < file.size(); ++i)
+			file[i] = (uint8_t)(i * 31 + seed * 101);
+		return file;
+	};
+
+	// Four quarters fill a page exactly, and a fifth does not fit.
+	{
+		SkylinePacker quarters(1024, 1024);
+		UINT x = 0;
+		UINT y = 0;
+		UINT placed = 0;
+		for(int i = 0; i < 4; ++i)
+			placed += quarters.Insert(512, 512, x, y) ? 1 : 0;
+		if(placed != 4 || quarters.Occupancy() != 1.0 || quarters.Insert(4, 4, x, y))
+			report.Fail();
+	}
+
+	// Rectangles of random sizes, tallest first, into a BC page with 2 texels of padding.
+	// None may leave the page, sit off the block grid or overlap another's padding.
+	const UINT pageSize = 1024;
+	const UINT padding = 2;
+	SkylinePacker packer(pageSize, pageSize, 4, padding);
+
+	struct Rect
+	{
+		UINT X, Y, Width, Height;
+	};
+	std::vector<Rect> rects(400);
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<UINT> size(4, 128);
+	for(Rect& r : rects)
+	{
+		r.Width = size(rng);
+		r.Height = size(rng);
+	}
+	std::sort(rects.begin(), rects.end(), [](const Rect& a, const Rect& b) { return a.Height > b.Height; });
+
+	auto t0 = BenchClock::now();
+	std::vector<Rect> placed;
+	for(Rect& r : rects)
+	{
+		if(packer.Insert(r.Width, r.Height, r.X, r.Y))
+			placed.push_back(r);
+	}
+	auto t1 = BenchClock::now();
+
+	for(size_t i = 0; i < placed.size(); ++i)
+	{
+		const Rect& a = placed[i];
+		if(a.X % 4 != 0 || a.Y % 4 != 0 || a.X + a.Width > pageSize || a.Y + a.Height > pageSize)
+			report.Fail();
+
+		for(size_t j = i + 1; j < placed.size(); ++j)
+		{
+			const Rect& b = placed[j];
+			if(a.X < b.X + b.Width + padding && b.X < a.X + a.Width + padding &&
+			   a.Y < b.Y + b.Height + padding && b.Y < a.Y + a.Height + padding)
+				report.Fail();
+		}
+	}
+
+	// Sorted by height, skyline packing wastes little more than the padding.
+	if(packer.Occupancy() < 0.8)
+		report.Fail();
+
+	// The corner texel of a rectangle maps to its corner on the page.
+	TexturePacker::AtlasRect atlas = TexturePacker::AtlasTransform(256, 512, 256, 128, 1024, 1024);
+	if(atlas.OffsetU != 0.25f || atlas.OffsetV != 0.5f ||
+	   atlas.OffsetU + atlas.ScaleU != 0.5f || atlas.OffsetV + atlas.ScaleV != 0.625f)
+		report.Fail();
+
+	// Only the BC1 64x64 textures with seven mips can share an array.
+	std::vector<std::vector<uint8_t>> files;
+	files.push_back(makeDds(false, 64, 64, 7, 0));
+	files.push_back(makeDds(true, 64, 64, 7, 1));
+	files.push_back(makeDds(false, 64, 64, 7, 2));
+	files.push_back(makeDds(false, 32, 32, 6, 3));
+	files.push_back(makeDds(false, 64, 64, 1, 4));
+	files.push_back(makeDds(false, 64, 64, 7, 5));
+
+	std::vector<DDS::Image> images(files.size());
+	for(size_t i = 0; i < files.size(); ++i)
+	{
+		if(DDS::ParseHeader(files[i].data(), files[i].size(), images[i]) != DDS::Status::Ok)
+			report.Fail();
+	}
+
+	std::vector<std::vector<uint32_t>> groups = TexturePacker::ArrayGroups(images);
+	if(groups.size() != 1 || groups[0] != std::vector<uint32_t>{ 0, 2, 5 })
+	{
+		report.Fail();
+	}
+	else
+	{
+		// Packed and read back, every slice's mips must come out as they went in.
+		std::vector<DDS::Image> slices;
+		for(uint32_t i : groups[0])
+			slices.push_back(images[i]);
+
+		std::vector<uint8_t> packed;
+		DDS::Image array;
+		DDS::SubresourceLayout layout;
+		if(TexturePacker::PackArray(slices, packed) != DDS::Status::Ok ||
+		   DDS::ParseHeader(packed.data(), packed.size(), array) != DDS::Status::Ok ||
+		   DDS::GetSubresources(array, 0, layout) != DDS::Status::Ok ||
+		   array.ArraySize != 3 || array.MipCount != 7 || array.Format != DXGI_FORMAT_BC1_UNORM ||
+		   layout.Subresources.size() != 3 * 7)
+		{
+			report.Fail();
+		}
+		else
+		{
+			for(size_t s = 0; s < slices.size(); ++s)
+			{
+				DDS::SubresourceLayout source;
+				DDS::GetSubresources(slices[s], 0, source);
+				for(size_t m = 0; m < source.Subresources.size(); ++m)
+				{
+					const DDS::Subresource& a = source.Subresources[m];
+					const DDS::Subresource& b = layout.Subresources[s * 7 + m];
+					if(a.SlicePitch != b.SlicePitch || memcmp(a.Data, b.Data, a.SlicePitch) != 0)
+						report.Fail();
+				}
+			}
+		}
+
+		// Mixed layouts cannot share an array.
+		slices.push_back(images[1]);
+		if(TexturePacker::PackArray(slices, packed) != DDS::Status::NotSupported)
+			report.Fail();
+	}
+
+	report.Line("skyline", "%zu of %zu rects on %ux%u, occupancy %.1f%%, %.3f ms",
+		placed.size(), rects.size(), pageSize, pageSize, 100.0 * packer.Occupancy(), ElapsedMs(t0, t1));
+	report.Line("array groups", "%zu", groups.size());
+	return report.Finish(errors);
+}
+
+std::string HeadlessBench::BlockCompressReport(UINT& errors)
+{
+	BenchReport report("benchbc");
+
+	// Smooth colour ramps with a little noise, as photographs and painted textures are,
+	// and a hard edged alpha, as the tree sprites have.
+	auto makeImage = [](uint32_t width, uint32_t height, uint32_t seed)
+	{
+		BlockCompress::Surface surface;
+		surface.Width = width;
+		surface.Height = height;
+		surface.Texels.resize((size_t)width * height * 4);
+
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<int> noise(-3, 3);
+		for(uint32_t y = 0; y < height; ++y)
+		{
+			for(uint32_t x = 0; x < width; ++x)
+			{
+				uint8_t* texel = surface.Texels.data() + 4 * ((size_t)y * width + x);
+				texel[0] = (uint8_t)std::min<int>(std::max<int>(x * 255 / width + noise(rng), 0), 255);
+				texel[1] = (uint8_t)std::min<int>(std::max<int>(y * 255 / height + noise(rng), 0), 255);
+				texel[2] = (uint8_t)std::min<int>(std::max<int>((x + y) * 127 / (width + height) + 64 + noise(rng), 0), 255);
+				texel[3] = (x / 8 + y / 8) % 3 == 0 ? 0 : 255;
+			}
+		}
+		return surface;
+	};
+
+	auto psnr = [](const BlockCompress::Surface& a, const BlockCompress::Surface& b, int firstChannel, int channelCount)
+	{
+		double sum = 0.0;
+		for(size_t t = 0; t < a.Texels.size(); t += 4)
+		{
+			for(int i = firstChannel; i < firstChannel + channelCount; ++i)
+			{
+				double d = (double)a.Texels[t + i] - b.Texels[t + i];
+				sum += d * d;
+			}
+		}
+
+		double mse = sum / (a.Texels.size() / 4 * channelCount);
+		return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+	};
+
+	auto compress = [](const BlockCompress::Surface& surface, BlockCompress::Format format)
+	{
+		std::vector<uint8_t> mip(BlockCompress::MipBytes(format, surface.Width, surface.Height));
+		BlockCompress::CompressRows(surface, format, 0, (surface.Height + 3) / 4, mip.data());
+		return mip;
+	};
+
+	// A flat block of a colour 565 holds exactly, and BC4 blocks of one or two values.
+	{
+		uint8_t rgba[64];
+		for(int t = 0; t < 16; ++t)
+		{
+			rgba[4 * t + 0] = 255;
+			rgba[4 * t + 1] = 130;
+			rgba[4 * t + 2] = 0;
+			rgba[4 * t + 3] = 255;
+		}
+
+		uint8_t block[8];
+		uint8_t decoded[64];
+		BlockCompress::EncodeBC1(rgba, block);
+		BlockCompress::DecodeBC1(block, decoded);
+		if(memcmp(rgba, decoded, sizeof(rgba)) != 0)
+			report.Fail();
+
+		uint8_t values[16];
+		uint8_t decodedValues[16];
+		for(int t = 0; t < 16; ++t)
+			values[t] = t % 3 == 0 ? 17 : 200;
+		BlockCompress::EncodeBC4(values, block);
+		BlockCompress::DecodeBC4(block, decodedValues);
+		if(memcmp(values, decodedValues, sizeof(values)) != 0)
+			report.Fail();
+
+		memset(values, 99, sizeof(values));
+		BlockCompress::EncodeBC4(values, block);
+		BlockCompress::DecodeBC4(block, decodedValues);
+		if(memcmp(values, decodedValues, sizeof(values)) != 0)
+			report.Fail();
+	}
+
+	// Both paths must pick the same indices, so the blocks match byte for byte.  Sizes
+	// off the block grid exercise the edge repeat.
+	const BlockCompress::Format formats[] =
+	{
+		BlockCompress::Format::BC1, BlockCompress::Format::BC3, BlockCompress::Format::BC4, BlockCompress::Format::BC5
+	};
+	const char* formatNames[] = { "BC1", "BC3", "BC4", "BC5" };
+
+	BlockCompress::Surface image = makeImage(512, 512, 1);
+	BlockCompress::Surface odd = makeImage(37, 21, 2);
+
+	double simdMs[4] = {};
+	double scalarMs[4] = {};
+	double quality[4] = {};
+	for(int f = 0; f < 4; ++f)
+	{
+		BlockCompress::UseSimd(true);
+		auto t0 = BenchClock::now();
+		std::vector<uint8_t> simd = compress(image, formats[f]);
+		auto t1 = BenchClock::now();
+		std::vector<uint8_t> simdOdd = compress(odd, formats[f]);
+
+		BlockCompress::UseSimd(false);
+		auto t2 = BenchClock::now();
+		std::vector<uint8_t> scalar = compress(image, formats[f]);
+		auto t3 = BenchClock::now();
+		std::vector<uint8_t> scalarOdd = compress(odd, formats[f]);
+
+		simdMs[f] = ElapsedMs(t0, t1);
+		scalarMs[f] = ElapsedMs(t2, t3);
+		if(simd != scalar || simdOdd != scalarOdd)
+			report.Fail();
+
+		// BC4 and BC5 keep one and two channels at twice BC1's bits per channel.
+		BlockCompress::Surface decoded;
+		BlockCompress::Decompress(simd.data(), image.Width, image.Height, formats[f], decoded);
+		if(formats[f] == BlockCompress::Format::BC1)
+			quality[f] = psnr(image, decoded, 0, 3);
+		else if(formats[f] == BlockCompress::Format::BC3)
+			quality[f] = std::min<double>(psnr(image, decoded, 0, 3), psnr(image, decoded, 3, 1));
+		else
+			quality[f] = psnr(image, decoded, 0, formats[f] == BlockCompress::Format::BC4 ? 1 : 2);
+
+		double bound = formats[f] == BlockCompress::Format::BC1 || formats[f] == BlockCompress::Format::BC3 ? 32.0 : 40.0;
+		if(quality[f] < bound)
+			report.Fail();
+	}
+	BlockCompress::UseSimd(true);
+
+	// Black and gamma encoded 128 average to 92 in linear light, but 64 as stored data.
+	// Two normals tilted apart average to one of unit length.
+	{
+		BlockCompress::Surface checker;
+		checker.Width = 2;
+		checker.Height = 2;
+		checker.Texels = { 0, 0, 0, 255,  128, 128, 128, 255,  128, 128, 128, 255,  0, 0, 0, 255 };
+
+		BlockCompress::Surface srgb = BlockCompress::DownsampleBox(checker, BlockCompress::MipFilter::Srgb);
+		BlockCompress::Surface linear = BlockCompress::DownsampleBox(checker, BlockCompress::MipFilter::Linear);
+		if(srgb.Width != 1 || srgb.Height != 1 || srgb.Texels[0] != 92 || srgb.Texels[3] != 255 || linear.Texels[0] != 64)
+			report.Fail();
+
+		BlockCompress::Surface normals;
+		normals.Width = 2;
+		normals.Height = 1;
+		normals.Texels = { 218, 128, 218, 255,  38, 128, 218, 255 };
+
+		BlockCompress::Surface normal = BlockCompress::DownsampleBox(normals, BlockCompress::MipFilter::NormalMap);
+		if(normal.Texels[0] < 127 || normal.Texels[0] > 128 || normal.Texels[2] != 255)
+			report.Fail();
+	}
+
+	// A full chain written out must parse back to the format and mips it was given.
+	// sRGB BC1 needs the DX10 header; the others keep their legacy FOURCC.
+	uint32_t mipCount = BlockCompress::MipCount(odd.Width, odd.Height);
+	if(mipCount != 6)
+		report.Fail();
+
+	for(int f = 0; f < 4; ++f)
+	{
+		for(int srgb = 0; srgb < 2; ++srgb)
+		{
+			std::vector<std::vector<uint8_t>> mips;
+			BlockCompress::Surface surface = odd;
+			for(uint32_t m = 0; m < mipCount; ++m)
+			{
+				if(m > 0)
+					surface = BlockCompress::DownsampleBox(surface, BlockCompress::MipFilter::Srgb);
+				mips.push_back(compress(surface, formats[f]));
+			}
+
+			std::vector<uint8_t> file = BlockCompress::WriteDDS(formats[f], srgb != 0, odd.Width, odd.Height, mips);
+
+			DDS::Image parsed;
+			DDS::SubresourceLayout layout;
+			if(DDS::ParseHeader(file.data(), file.size(), parsed) != DDS::Status::Ok ||
+			   DDS::GetSubresources(parsed, 0, layout) != DDS::Status::Ok ||
+			   parsed.Format != BlockCompress::DxgiFormat(formats[f], srgb != 0) ||
+			   parsed.Width != odd.Width || parsed.Height != odd.Height || parsed.MipCount != mipCount ||
+			   layout.Subresources.size() != mipCount)
+			{
+				report.Fail();
+				continue;
+			}
+
+			for(uint32_t m = 0; m < mipCount; ++m)
+			{
+				const DDS::Subresource& sub = layout.Subresources[m];
+				if(sub.SlicePitch != mips[m].size() || memcmp(sub.Data, mips[m].data(), sub.SlicePitch) != 0)
+					report.Fail();
+			}
+		}
+	}
+
+	double megatexels = (double)image.Width * image.Height / 1e6;
+
+	for(int f = 0; f < 4; ++f)
+	{
+		report.Line(formatNames[f], "%.1f dB, %.1f Mtexels/s SSE2, %.1f scalar", quality[f],
+			simdMs[f] > 0.0 ? megatexels * 1000.0 / simdMs[f] : 0.0,
+			scalarMs[f] > 0.0 ? megatexels * 1000.0 / scalarMs[f] : 0.0);
+	}
+	report.Line("simd", "%s", BlockCompress::SimdAvailable() ? "SSE2" : "none, both paths scalar");
+	return report.Finish(errors);
+}
+
+std::string HeadlessBench::IndexReport(UINT frameCount, UINT& errors)
+{
+	std::vector<std::wstring> files = TextureFiles();
+
+	BenchReport report("benchindex");
+
+	// Indexed from the files as Tools/AssetIndexer.cpp does it.
+	std::vector<AssetIndex::Entry> entries;
+	std::vector<std::wstring> indexedFiles;
+	for(const std::wstring& file : files)
+	{
+		DDS::MappedFile mapped;
+		AssetIndex::Entry entry;
+		std::string name(file.size(), ' ');
+		for(size_t c = 0; c < file.size(); ++c)
+			name[c] = file[c] == L'\\' ? '/' : (char)file[c];
+
+		if(!mapped.Open(file.c_str()) ||
+		   AssetIndex::Describe(name, mapped.Data(), mapped.Size(), entry) != DDS::Status::Ok)
+		{
+			report.Fail();
+			continue;
+		}
+		entries.push_back(entry);
+		indexedFiles.push_back(file);
+	}
+
+	std::vector<uint8_t> bytes = AssetIndex::Write(entries);
+	AssetIndex index;
+	if(!index.Read(bytes.data(), bytes.size()) || index.Entries().size() != entries.size())
+		report.Fail();
+
+	for(size_t i = 0; i < indexedFiles.size() && i < index.Entries().size(); ++i)
+	{
+		const AssetIndex::Entry& entry = index.Entries()[i];
+		if(index.Find(entries[i].Name) != &entry)
+			report.Fail();
+
+		DDS::MappedFile mapped;
+		DDS::Image image;
+		DDS::SubresourceLayout layout;
+		if(!mapped.Open(indexedFiles[i].c_str()) ||
+		   DDS::ParseHeader(mapped.Data(), mapped.Size(), image) != DDS::Status::Ok ||
+		   DDS::GetSubresources(image, 0, layout) != DDS::Status::Ok)
+		{
+			report.Fail();
+			continue;
+		}
+
+		if(entry.FileSize != mapped.Size() || entry.ContentHash != AssetIndex::Hash(mapped.Data(), mapped.Size()) ||
+		   entry.Format != image.Format || entry.Width != image.Width || entry.Height != image.Height ||
+		   entry.Depth != image.Depth || entry.Mips.size() != image.MipCount || entry.ArraySize != image.ArraySize ||
+		   layout.Subresources.size() != image.MipCount * image.ArraySize)
+		{
+			report.Fail();
+			continue;
+		}
+
+		// Slice s of mip m starts SliceStride bytes after slice s - 1.
+		for(size_t s = 0; s < image.ArraySize; ++s)
+		{
+			for(size_t m = 0; m < image.MipCount; ++m)
+			{
+				const DDS::Subresource& sub = layout.Subresources[s * image.MipCount + m];
+				uint64_t offset = (uint64_t)((const uint8_t*)sub.Data - mapped.Data());
+				if(offset != entry.Mips[m].Offset + s * entry.SliceStride || sub.RowPitch != entry.Mips[m].RowPitch)
+					report.Fail();
+			}
+		}
+
+		// The first chain the app streams, and the bytes it hands the residency.
+		const size_t maxsizes[] = { 1, 16, 64, 256 };
+		for(size_t maxsize : maxsizes)
+		{
+			DDS::SubresourceLayout skipped;
+			DDS::GetSubresources(image, maxsize, skipped);
+			if(entry.SkipMip(maxsize) != skipped.SkipMip)
+				report.Fail();
+		}
+
+		std::vector<uint64_t> mipBytes = entry.MipBytes();
+		for(size_t m = 0; m < image.MipCount; ++m)
+		{
+			size_t numBytes = 0;
+			DDS::GetSurfaceInfo(std::max<size_t>(image.Width >> m, 1), std::max<size_t>(image.Height >> m, 1),
+				image.Format, &numBytes, nullptr, nullptr);
+			if(mipBytes[m] != (uint64_t)numBytes * std::max<size_t>(image.Depth >> m, 1) * image.ArraySize)
+				report.Fail();
+		}
+	}
+
+	// Damage anywhere must lose the whole index, never part of it.
+	UINT damages = 0;
+	UINT accepted = 0;
+	std::vector<uint8_t> damaged;
+	for(size_t i = 0; i < bytes.size(); ++i, ++damages)
+	{
+		damaged = bytes;
+		damaged[i] ^= (uint8_t)(1 << (i % 8));
+		AssetIndex read;
+		if(read.Read(damaged.data(), damaged.size()) || !read.Entries().empty())
+			accepted++;
+	}
+	for(size_t size = 0; size < bytes.size(); size += 1 + size / 8, ++damages)
+	{
+		AssetIndex read;
+		if(read.Read(bytes.data(), size))
+			accepted++;
+	}
+	report.Fail(accepted);
+
+	// What the app decides at startup, the bytes of every texture's mips, from the index
+	// already in memory or from each file's header.
+	const UINT passes = std::max<UINT>(frameCount / 20, 1);
+	double indexMs = 0.0;
+	double headersMs = 0.0;
+	uint64_t indexBytes = 0;
+	uint64_t headerBytes = 0;
+	for(UINT pass = 0; pass < passes; ++pass)
+	{
+		indexBytes = 0;
+		headerBytes = 0;
+
+		BenchClock::time_point start = BenchClock::now();
+		AssetIndex read;
+		read.Read(bytes.data(), bytes.size());
+		for(const AssetIndex::Entry& entry : read.Entries())
+		{
+			for(uint64_t mip : entry.MipBytes())
+				indexBytes += mip;
+		}
+		indexMs += ElapsedMs(start, BenchClock::now());
+
+		start = BenchClock::now();
+		for(const std::wstring& file : indexedFiles)
+		{
+			DDS::MappedFile mapped;
+			DDS::Image image;
+			DDS::SubresourceLayout layout;
+			if(!mapped.Open(file.c_str()) || DDS::ParseHeader(mapped.Data(), mapped.Size(), image) != DDS::Status::Ok ||
+			   DDS::GetSubresources(image, 0, layout) != DDS::Status::Ok)
+				continue;
+
+			for(size_t i = 0; i < layout.Subresources.size(); ++i)
+				headerBytes += layout.Subresources[i].SlicePitch * std::max<size_t>(image.Depth >> (i % image.MipCount), 1);
+		}
+		headersMs += ElapsedMs(start, BenchClock::now());
+	}
+
+	if(indexBytes != headerBytes)
+		report.Fail();
+
+	report.Line("textures", "%zu of %zu files, index %zu bytes", entries.size(), files.size(), bytes.size());
+	report.Line("damage caught", "%u of %u", damages - accepted, damages);
+	report.Line("texture bytes", "%.2f MB", indexBytes / (1024.0 * 1024.0));
+	report.Line("parse index", "%.3f ms", indexMs / passes);
+	report.Line("open headers", "%.3f ms", headersMs / passes);
+	return report.Finish(errors);
+}
@@ -0,0 +1,385 @@
+//***************************************************************************************
+// HeapAllocator.cpp
+//***************************************************************************************
+
+#include "HeapAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// Index of the highest and lowest set bits of a non-zero value.
+	uint32_t HighestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return (uint32_t)index;
+#else
+		return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+	}
+
+	uint32_t LowestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctzll(value);
+#endif
+	}
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+HeapAllocator::HeapAllocator(uint64_t capacity) :
+	mCapacity(capacity)
+{
+	assert(capacity > 0);
+
+	for(uint32_t f = 0; f < FirstLevelCount; ++f)
+	{
+		for(uint32_t s = 0; s < SecondLevelCount; ++s)
+			mFreeLists[f][s] = NoBlock;
+	}
+
+	// Block 0 always starts the heap: merging only ever removes the later of two blocks.
+	InsertFree(NewBlock(0, capacity));
+}
+
+HeapAllocator::Allocation HeapAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	size = std::max<uint64_t>(size, 1);
+
+	auto fits = [this, size, alignment](uint32_t block)
+	{
+		const Block& b = mBlocks[block];
+		return AlignUp(b.Offset, alignment) - b.Offset <= b.Size - size;
+	};
+
+	// Most blocks start aligned already; only if the one found does not is a block big
+	// enough to be aligned anywhere looked for.
+	uint32_t block = FindFree(size);
+	if(block != NoBlock && !fits(block))
+		block = size <= UINT64_MAX - (alignment - 1) ? FindFree(size + alignment - 1) : NoBlock;
+	if(block == NoBlock)
+		return Allocation();
+
+	RemoveFree(block);
+
+	// The space skipped to align stays free, ahead of the allocation.
+	uint64_t skip = AlignUp(mBlocks[block].Offset, alignment) - mBlocks[block].Offset;
+	if(skip > 0)
+	{
+		SplitFront(block, skip);
+		InsertFree(block);
+		block = mBlocks[block].Next;
+	}
+
+	if(mBlocks[block].Size > size)
+	{
+		SplitFront(block, size);
+		InsertFree(mBlocks[block].Next);
+	}
+
+	mBlocks[block].Free = false;
+	mUsedBytes += size;
+	mHighWater = std::max<uint64_t>(mHighWater, mUsedBytes);
+	mAllocationCount++;
+
+	Allocation allocation;
+	allocation.Offset = mBlocks[block].Offset;
+	allocation.Size = size;
+	allocation.Block = block;
+	return allocation;
+}
+
+void HeapAllocator::Free(const Allocation& allocation)
+{
+	assert(allocation.Block < mBlocks.size() && !mBlocks[allocation.Block].Free);
+	assert(mBlocks[allocation.Block].Offset == allocation.Offset);
+
+	mAllocationCount--;
+	Release(allocation.Block);
+}
+
+void HeapAllocator::Free(const Allocation& allocation, uint64_t fenceValue)
+{
+	assert(allocation.Block < mBlocks.size() && !mBlocks[allocation.Block].Free);
+	assert(mBlocks[allocation.Block].Offset == allocation.Offset);
+
+	mAllocationCount--;
+	mPending.push_back({ fenceValue, allocation.Block });
+}
+
+uint32_t HeapAllocator::Retire(uint64_t completedValue)
+{
+	// Freed in roughly fence order, but not strictly, so every entry is checked.
+	auto retired = std::stable_partition(mPending.begin(), mPending.end(),
+		[completedValue](const Pending& pending) { return pending.FenceValue > completedValue; });
+
+	uint32_t count = 0;
+	for(auto it = retired; it != mPending.end(); ++it)
+	{
+		Release(it->Block);
+		count++;
+	}
+	mPending.erase(retired, mPending.end());
+
+	return count;
+}
+
+uint64_t HeapAllocator::LargestFreeRange()const
+{
+	if(mFirstLevel == 0)
+		return 0;
+
+	// Blocks in the highest non-empty list are bigger than all others, but not ordered
+	// among themselves.
+	uint32_t f = HighestBit(mFirstLevel);
+	uint32_t s = HighestBit(mSecondLevel[f]);
+
+	uint64_t largest = 0;
+	for(uint32_t block = mFreeLists[f][s]; block != NoBlock; block = mBlocks[block].NextFree)
+		largest = std::max<uint64_t>(largest, mBlocks[block].Size);
+	return largest;
+}
+
+bool HeapAllocator::CheckConsistency()const
+{
+	uint64_t offset = 0;
+	uint64_t used = 0;
+	uint32_t freeCount = 0;
+	uint32_t prev = NoBlock;
+	for(uint32_t block = 0; block != NoBlock; block = mBlocks[block].Next)
+	{
+		const Block& b = mBlocks[block];
+		if(b.Offset != offset || b.Size == 0 || b.Prev != prev)
+			return false;
+
+		if(b.Free)
+		{
+			if(prev != NoBlock && mBlocks[prev].Free)
+				return false;
+
+			uint32_t f, s;
+			Classify(b.Size, f, s);
+			uint32_t listed = mFreeLists[f][s];
+			while(listed != NoBlock && listed != block)
+				listed = mBlocks[listed].NextFree;
+			if(listed == NoBlock)
+				return false;
+
+			freeCount++;
+		}
+		else
+		{
+			used += b.Size;
+		}
+
+		offset += b.Size;
+		prev = block;
+	}
+
+	if(offset != mCapacity || used != mUsedBytes || freeCount != mFreeCount)
+		return false;
+
+	// Every listed block is free, and the bitmaps mark exactly the non-empty lists.
+	uint32_t listedCount = 0;
+	for(uint32_t f = 0; f < FirstLevelCount; ++f)
+	{
+		for(uint32_t s = 0; s < SecondLevelCount; ++s)
+		{
+			bool marked = (mSecondLevel[f] & (1u << s)) != 0;
+			if(marked != (mFreeLists[f][s] != NoBlock))
+				return false;
+
+			for(uint32_t block = mFreeLists[f][s]; block != NoBlock; block = mBlocks[block].NextFree)
+			{
+				if(!mBlocks[block].Free)
+					return false;
+				listedCount++;
+			}
+		}
+
+		if(((mFirstLevel >> f) & 1) != (mSecondLevel[f] != 0 ? 1u : 0u))
+			return false;
+	}
+
+	return listedCount == mFreeCount;
+}
+
+void HeapAllocator::Classify(uint64_t size, uint32_t& first, uint32_t& second)
+{
+	// Below SecondLevelCount bytes a class holds one size or none.
+	first = HighestBit(size);
+	if(first < SecondLevelBits)
+		second = (uint32_t)(size << (SecondLevelBits - first)) & (SecondLevelCount - 1);
+	else
+		second = (uint32_t)(size >> (first - SecondLevelBits)) & (SecondLevelCount - 1);
+}
+
+uint32_t HeapAllocator::FindFree(uint64_t size)const
+{
+	// Rounded up to the next class boundary, every block of the class found is big
+	// enough, so the head of its list will do.
+	uint64_t rounded = size;
+	uint32_t f = HighestBit(size);
+	if(f >= SecondLevelBits)
+	{
+		uint64_t step = (1ull << (f - SecondLevelBits)) - 1;
+		rounded = size <= UINT64_MAX - step ? size + step : size;
+	}
+
+	uint32_t s;
+	Classify(rounded, f, s);
+
+	uint32_t secondMap = mSecondLevel[f] & (~0u << s);
+	if(secondMap == 0)
+	{
+		uint64_t firstMap = f + 1 < FirstLevelCount ? mFirstLevel & (~0ull << (f + 1)) : 0;
+		if(firstMap != 0)
+		{
+			f = LowestBit(firstMap);
+			secondMap = mSecondLevel[f];
+		}
+	}
+	if(secondMap != 0)
+		return mFreeLists[f][LowestBit(secondMap)];
+
+	// Nothing in a bigger class; a block in the size's own class may still be enough.
+	Classify(size, f, s);
+	for(uint32_t block = mFreeLists[f][s]; block != NoBlock; block = mBlocks[block].NextFree)
+	{
+		if(mBlocks[block].Size >= size)
+			return block;
+	}
+	return NoBlock;
+}
+
+void HeapAllocator::InsertFree(uint32_t block)
+{
+	uint32_t f, s;
+	Classify(mBlocks[block].Size, f, s);
+
+	Block& b = mBlocks[block];
+	b.Free = true;
+	b.PrevFree = NoBlock;
+	b.NextFree = mFreeLists[f][s];
+	if(b.NextFree != NoBlock)
+		mBlocks[b.NextFree].PrevFree = block;
+
+	mFreeLists[f][s] = block;
+	mFirstLevel |= 1ull << f;
+	mSecondLevel[f] |= 1u << s;
+	mFreeCount++;
+}
+
+void HeapAllocator::RemoveFree(uint32_t block)
+{
+	uint32_t f, s;
+	Classify(mBlocks[block].Size, f, s);
+
+	Block& b = mBlocks[block];
+	if(b.PrevFree != NoBlock)
+		mBlocks[b.PrevFree].NextFree = b.NextFree;
+	else
+		mFreeLists[f][s] = b.NextFree;
+	if(b.NextFree != NoBlock)
+		mBlocks[b.NextFree].PrevFree = b.PrevFree;
+
+	if(mFreeLists[f][s] == NoBlock)
+	{
+		mSecondLevel[f] &= ~(1u << s);
+		if(mSecondLevel[f] == 0)
+			mFirstLevel &= ~(1ull << f);
+	}
+
+	b.Free = false;
+	mFreeCount--;
+}
+
+void HeapAllocator::Release(uint32_t block)
+{
+	mUsedBytes -= mBlocks[block].Size;
+
+	uint32_t next = mBlocks[block].Next;
+	if(next != NoBlock && mBlocks[next].Free)
+	{
+		RemoveFree(next);
+		MergeNext(block);
+	}
+
+	uint32_t prev = mBlocks[block].Prev;
+	if(prev != NoBlock && mBlocks[prev].Free)
+	{
+		RemoveFree(prev);
+		MergeNext(prev);
+		block = prev;
+	}
+
+	InsertFree(block);
+}
+
+uint32_t HeapAllocator::NewBlock(uint64_t offset, uint64_t size)
+{
+	uint32_t block;
+	if(!mUnusedBlocks.empty())
+	{
+		block = mUnusedBlocks.back();
+		mUnusedBlocks.pop_back();
+	}
+	else
+	{
+		block = (uint32_t)mBlocks.size();
+		mBlocks.push_back(Block());
+	}
+
+	Block& b = mBlocks[block];
+	b.Offset = offset;
+	b.Size = size;
+	b.Prev = NoBlock;
+	b.Next = NoBlock;
+	b.PrevFree = NoBlock;
+	b.NextFree = NoBlock;
+	b.Free = false;
+	return block;
+}
+
+void HeapAllocator::SplitFront(uint32_t block, uint64_t size)
+{
+	assert(size < mBlocks[block].Size);
+
+	// NewBlock may move mBlocks, so no reference is held across it.
+	uint32_t rest = NewBlock(mBlocks[block].Offset + size, mBlocks[block].Size - size);
+	uint32_t next = mBlocks[block].Next;
+
+	mBlocks[rest].Prev = block;
+	mBlocks[rest].Next = next;
+	if(next != NoBlock)
+		mBlocks[next].Prev = rest;
+
+	mBlocks[block].Next = rest;
+	mBlocks[block].Size = size;
+}
+
+void HeapAllocator::MergeNext(uint32_t block)
+{
+	uint32_t next = mBlocks[block].Next;
+	mBlocks[block].Size += mBlocks[next].Size;
+	mBlocks[block].Next = mBlocks[next].Next;
+	if(mBlocks[block].Next != NoBlock)
+		mBlocks[mBlocks[block].Next].Prev = block;
+
+	mUnusedBlocks.push_back(next);
+}
@@ -0,0 +1,144 @@
+//***************************************************************************************
+// HeapAllocator.h
+//
+// Hands out aligned ranges of one large block of memory with a two-level segregated fit
+// (TLSF) allocator: free ranges are kept in lists by size class, and a bitmap per level
+// finds a list with a range big enough in constant time.  A range given back merges
+// with its free neighbours at once, so the free space stays in as few pieces as the
+// live ranges allow.
+//
+// The app places its static meshes and textures in large D3D12 heaps with it; see
+// ResourceHeaps.h.  Nothing here touches a device, so HeadlessBench -benchheap drives
+// the same code to check it and measure fragmentation.
+//
+// Like BindlessTable, a range the GPU may still read is given back with the fence
+// value of the last commands that use it, and only merges back once Retire sees that
+// value complete.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class HeapAllocator
+{
+public:
+	static const uint64_t InvalidOffset = UINT64_MAX;
+
+	struct Allocation
+	{
+		uint64_t Offset = InvalidOffset;
+		uint64_t Size = 0;
+
+		// The allocator's record of the range; only Free reads it.
+		uint32_t Block = UINT32_MAX;
+
+		bool IsValid()const { return Offset != InvalidOffset; }
+	};
+
+	explicit HeapAllocator(uint64_t capacity);
+	HeapAllocator(const HeapAllocator& rhs) = delete;
+	HeapAllocator& operator=(const HeapAllocator& rhs) = delete;
+
+	// Returns a range of size bytes starting at a multiple of alignment, a power of two.
+	// The space skipped to align it stays free.  Returns an invalid allocation if no free
+	// range is big enough.
+	Allocation Allocate(uint64_t size, uint64_t alignment = 1);
+
+	// Gives the range back now.
+	void Free(const Allocation& allocation);
+
+	// Gives the range back once fenceValue completes.
+	void Free(const Allocation& allocation, uint64_t fenceValue);
+
+	// Gives back the ranges whose fence value has completed.  Returns the number given
+	// back.
+	uint32_t Retire(uint64_t completedValue);
+
+	uint64_t Capacity()const { return mCapacity; }
+
+	// Bytes in allocated and pending ranges.
+	uint64_t UsedBytes()const { return mUsedBytes; }
+	uint64_t FreeBytes()const { return mCapacity - mUsedBytes; }
+	uint64_t HighWater()const { return mHighWater; }
+
+	uint32_t AllocationCount()const { return mAllocationCount; }
+	uint32_t PendingCount()const { return (uint32_t)mPending.size(); }
+	uint32_t FreeRangeCount()const { return mFreeCount; }
+
+	// The biggest single range Allocate could return, alignment aside.
+	uint64_t LargestFreeRange()const;
+
+	// Walks every range and free list.  False if the ranges do not tile the capacity in
+	// order, two free ranges touch, or a free range is missing from the list of its
+	// size class or the bitmaps disagree with the lists.
+	bool CheckConsistency()const;
+
+private:
+	// Sixteen lists per power of two, so a free range found by class is never more than
+	// one sixteenth bigger than the size asked for.
+	static const uint32_t SecondLevelBits = 4;
+	static const uint32_t SecondLevelCount = 1 << SecondLevelBits;
+	static const uint32_t FirstLevelCount = 64;
+	static const uint32_t NoBlock = UINT32_MAX;
+
+	struct Block
+	{
+		uint64_t Offset;
+		uint64_t Size;
+
+		// Neighbours in memory.
+		uint32_t Prev;
+		uint32_t Next;
+
+		// Neighbours in the free list of the block's size class, while it is free.
+		uint32_t PrevFree;
+		uint32_t NextFree;
+
+		bool Free;
+	};
+
+	struct Pending
+	{
+		uint64_t FenceValue;
+		uint32_t Block;
+	};
+
+	// The size class holding free blocks of size bytes.
+	static void Classify(uint64_t size, uint32_t& first, uint32_t& second);
+
+	// A free block of at least size bytes, or NoBlock.
+	uint32_t FindFree(uint64_t size)const;
+
+	void InsertFree(uint32_t block);
+	void RemoveFree(uint32_t block);
+	void Release(uint32_t block);
+
+	uint32_t NewBlock(uint64_t offset, uint64_t size);
+
+	// Splits size bytes off the front of block into a new free block after it.
+	void SplitFront(uint32_t block, uint64_t size);
+
+	// Merges block's next neighbour into it.
+	void MergeNext(uint32_t block);
+
+	uint64_t mCapacity;
+	uint64_t mUsedBytes = 0;
+	uint64_t mHighWater = 0;
+	uint32_t mAllocationCount = 0;
+	uint32_t mFreeCount = 0;
+
+	std::vector<Block> mBlocks;
+
+	// Indices into mBlocks of records merged away, for reuse.
+	std::vector<uint32_t> mUnusedBlocks;
+
+	// Bit f of mFirstLevel is set when any list of first level f has a block; bit s of
+	// mSecondLevel[f] when list (f, s) has one.
+	uint64_t mFirstLevel = 0;
+	uint32_t mSecondLevel[FirstLevelCount] = {};
+	uint32_t mFreeLists[FirstLevelCount][SecondLevelCount];
+
+	std::vector<Pending> mPending;
+};
@@ -0,0 +1,82 @@
+//***************************************************************************************
+// InstanceBatcher.cpp
+//***************************************************************************************
+
+#include "InstanceBatcher.h"
+
+void InstanceBatcher::Build(const LayerList& layers)
+{
+	mInstances.clear();
+
+	UINT firstInstance = 0;
+	for(int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		const auto& ritems = layers[layer];
+		auto& batches = mBatches[layer];
+		const bool mergeable = layer != (int)RenderLayer::Transparent;
+
+		batches.clear();
+		mLookup.clear();
+		mItemBatch.resize(ritems.size());
+
+		// First pass: find the batch of every item and count the instances of each batch.
+		for(size_t i = 0; i < ritems.size(); ++i)
+		{
+			const RenderItem* ri = ritems[i];
+			BatchKey key = { ri->Geo, ri->Mat, ri->IndexCount, ri->StartIndexLocation, ri->BaseVertexLocation };
+
+			// Transparent items are never merged: they have to be drawn back to front
+			// one by one, which a single instanced draw cannot do.
+			UINT batchIndex = 0;
+			auto it = mergeable ? mLookup.find(key) : mLookup.end();
+			if(it == mLookup.end())
+			{
+				batchIndex = (UINT)batches.size();
+				if(mergeable)
+					mLookup.emplace(key, batchIndex);
+
+				DrawBatch batch;
+				batch.Geo = ri->Geo;
+				batch.Mat = ri->Mat;
+				batch.Layer = (RenderLayer)layer;
+				batch.PrimitiveType = ri->PrimitiveType;
+				batch.IndexCount = ri->IndexCount;
+				batch.StartIndexLocation = ri->StartIndexLocation;
+				batch.BaseVertexLocation = ri->BaseVertexLocation;
+				batches.push_back(batch);
+			}
+			else
+			{
+				batchIndex = it->second;
+			}
+
+			batches[batchIndex].InstanceCount++;
+			mItemBatch[i] = batchIndex;
+		}
+
+		// Lay the batches out back to back in the instance buffer.
+		for(auto& batch : batches)
+		{
+			batch.FirstInstance = firstInstance;
+			firstInstance += batch.InstanceCount;
+			batch.InstanceCount = 0;
+		}
+
+		// Second pass: scatter the items into their batch's range.
+		mInstances.resize(firstInstance);
+		for(size_t i = 0; i < ritems.size(); ++i)
+		{
+			DrawBatch& batch = batches[mItemBatch[i]];
+			mInstances[batch.FirstInstance + batch.InstanceCount++] = ritems[i];
+		}
+	}
+}
+
+UINT InstanceBatcher::DrawCount()const
+{
+	UINT count = 0;
+	for(const auto& batches : mBatches)
+		count += (UINT)batches.size();
+
+	return count;
+}
@@ -0,0 +1,81 @@
+//***************************************************************************************
+// InstanceBatcher.h
+//
+// Groups the visible render items of each layer that share geometry, submesh and
+// material into one instanced draw.  The layer already decides the PSO, so items in a
+// batch can be drawn with a single DrawIndexedInstanced.  The per-instance data is laid
+// out batch by batch, so a batch's instances are contiguous in the instance buffer.
+// Transparent items are kept one per batch so they can still be depth sorted.
+//***************************************************************************************
+
+#pragma once
+
+#include "RenderItem.h"
+
+struct DrawBatch
+{
+	MeshGeometry* Geo = nullptr;
+	Material* Mat = nullptr;
+	RenderLayer Layer = RenderLayer::Opaque;
+
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+
+	// Range of this batch in InstanceBatcher::GetInstances() (and so in the instance buffer).
+	UINT FirstInstance = 0;
+	UINT InstanceCount = 0;
+};
+
+class InstanceBatcher
+{
+public:
+	using LayerList = std::vector<RenderItem*>[(int)RenderLayer::Count];
+
+	// Rebuilds the batches from this frame's visible items.
+	void Build(const LayerList& layers);
+
+	const std::vector<DrawBatch>& GetBatches(RenderLayer layer)const { return mBatches[(int)layer]; }
+
+	// Render item of every instance, in instance buffer order.
+	const std::vector<RenderItem*>& GetInstances()const { return mInstances; }
+
+	UINT DrawCount()const;
+
+private:
+	struct BatchKey
+	{
+		const MeshGeometry* Geo;
+		const Material* Mat;
+		UINT IndexCount;
+		UINT StartIndexLocation;
+		int BaseVertexLocation;
+
+		bool operator==(const BatchKey& rhs)const
+		{
+			return Geo == rhs.Geo && Mat == rhs.Mat && IndexCount == rhs.IndexCount &&
+				StartIndexLocation == rhs.StartIndexLocation && BaseVertexLocation == rhs.BaseVertexLocation;
+		}
+	};
+
+	struct BatchKeyHash
+	{
+		size_t operator()(const BatchKey& k)const
+		{
+			size_t h = std::hash<const void*>()(k.Geo);
+			h = h * 31 + std::hash<const void*>()(k.Mat);
+			h = h * 31 + k.IndexCount;
+			h = h * 31 + k.StartIndexLocation;
+			h = h * 31 + (size_t)k.BaseVertexLocation;
+			return h;
+		}
+	};
+
+	std::vector<DrawBatch> mBatches[(int)RenderLayer::Count];
+	std::vector<RenderItem*> mInstances;
+
+	// Scratch reused between frames.
+	std::unordered_map<BatchKey, UINT, BatchKeyHash> mLookup;
+	std::vector<UINT> mItemBatch;
+};
@@ -0,0 +1,249 @@
+//***************************************************************************************
+// LightClusterer.cpp
+//***************************************************************************************
+
+#include "LightClusterer.h"
+#include <algorithm>
+#include <cmath>
+#include <ppl.h>
+
+using namespace DirectX;
+
+void LightClusterer::SetProjection(float fovY, float aspect, float nearZ, float farZ)
+{
+	if(fovY == mFovY && aspect == mAspect && nearZ == mNearZ && farZ == mFarZ && !mBoxes.empty())
+		return;
+
+	mFovY = fovY;
+	mAspect = aspect;
+	mNearZ = nearZ;
+	mFarZ = farZ;
+	mTanY = tanf(0.5f*fovY);
+	mTanX = mTanY*aspect;
+
+	// A tile's sides are planes through the eye, so its extent grows with depth; the
+	// box of a cluster spans the tile at both ends of its slice.
+	mBoxes.resize(ClusterCount);
+	for(UINT z = 0; z < ClusterZ; ++z)
+	{
+		float z0 = SliceDepth(z);
+		float z1 = SliceDepth(z + 1);
+
+		for(UINT y = 0; y < ClusterY; ++y)
+		{
+			float y0 = (-1.0f + 2.0f*y / ClusterY) * mTanY;
+			float y1 = (-1.0f + 2.0f*(y + 1) / ClusterY) * mTanY;
+
+			for(UINT x = 0; x < ClusterX; ++x)
+			{
+				float x0 = (-1.0f + 2.0f*x / ClusterX) * mTanX;
+				float x1 = (-1.0f + 2.0f*(x + 1) / ClusterX) * mTanX;
+
+				Box& box = mBoxes[ClusterIndex(x, y, z)];
+				box.Min[0] = std::min<float>(x0*z0, x0*z1);
+				box.Max[0] = std::max<float>(x1*z0, x1*z1);
+				box.Min[1] = std::min<float>(y0*z0, y0*z1);
+				box.Max[1] = std::max<float>(y1*z0, y1*z1);
+				box.Min[2] = z0;
+				box.Max[2] = z1;
+			}
+		}
+	}
+}
+
+float LightClusterer::SliceDepth(UINT slice)const
+{
+	return mNearZ * powf(mFarZ / mNearZ, (float)slice / ClusterZ);
+}
+
+UINT LightClusterer::SliceOf(float depth)const
+{
+	float slice = floorf(logf(depth / mNearZ) / logf(mFarZ / mNearZ) * ClusterZ);
+	return (UINT)std::min<float>(std::max<float>(slice, 0.0f), (float)(ClusterZ - 1));
+}
+
+UINT LightClusterer::FindCluster(const XMFLOAT3& posV)const
+{
+	if(posV.z < mNearZ || posV.z >= mFarZ)
+		return ClusterCount;
+
+	float ndcX = std::min<float>(std::max<float>(posV.x / (posV.z*mTanX), -1.0f), 1.0f);
+	float ndcY = std::min<float>(std::max<float>(posV.y / (posV.z*mTanY), -1.0f), 1.0f);
+
+	UINT x = std::min<UINT>((UINT)((ndcX*0.5f + 0.5f) * ClusterX), ClusterX - 1);
+	UINT y = std::min<UINT>((UINT)((ndcY*0.5f + 0.5f) * ClusterY), ClusterY - 1);
+
+	return ClusterIndex(x, y, SliceOf(posV.z));
+}
+
+float LightClusterer::DistanceToCluster(const XMFLOAT3& posV, UINT cluster)const
+{
+	const Box& box = mBoxes[cluster];
+	const float pos[3] = { posV.x, posV.y, posV.z };
+
+	float distSq = 0.0f;
+	for(int i = 0; i < 3; ++i)
+	{
+		float d = std::max<float>(std::max<float>(box.Min[i] - pos[i], pos[i] - box.Max[i]), 0.0f);
+		distSq += d*d;
+	}
+
+	return sqrtf(distSq);
+}
+
+bool LightClusterer::SphereTouchesCluster(const XMFLOAT3& centerV, float radius, UINT cluster)const
+{
+	const Box& box = mBoxes[cluster];
+	const float center[3] = { centerV.x, centerV.y, centerV.z };
+
+	float distSq = 0.0f;
+	for(int i = 0; i < 3; ++i)
+	{
+		float d = std::max<float>(std::max<float>(box.Min[i] - center[i], center[i] - box.Max[i]), 0.0f);
+		distSq += d*d;
+	}
+
+	return distSq <= radius*radius;
+}
+
+void LightClusterer::Build(const std::vector<Light>& lights, const XMFLOAT4X4& view)
+{
+	assert(!mBoxes.empty() && "SetProjection must be called before Build.");
+
+	mSpheres.clear();
+	for(UINT i = 0; i < (UINT)lights.size(); ++i)
+		AddLight(lights[i], i, view);
+
+	BinAndFlatten(lights);
+}
+
+void LightClusterer::Build(const std::vector<Light>& lights, const std::vector<UINT>& candidates,
+	const XMFLOAT4X4& view)
+{
+	assert(!mBoxes.empty() && "SetProjection must be called before Build.");
+
+	mSpheres.clear();
+	for(UINT i : candidates)
+		AddLight(lights[i], i, view);
+
+	BinAndFlatten(lights);
+}
+
+void LightClusterer::AddLight(const Light& light, UINT index, const XMFLOAT4X4& view)
+{
+	// Move the light's range to view space and find the slices it spans.
+	const XMFLOAT3& p = light.Position;
+
+	Sphere s;
+	s.Center.x = p.x*view(0, 0) + p.y*view(1, 0) + p.z*view(2, 0) + view(3, 0);
+	s.Center.y = p.x*view(0, 1) + p.y*view(1, 1) + p.z*view(2, 1) + view(3, 1);
+	s.Center.z = p.x*view(0, 2) + p.y*view(1, 2) + p.z*view(2, 2) + view(3, 2);
+	s.Radius = light.FalloffEnd;
+	s.Light = index;
+
+	if(s.Center.z + s.Radius < mNearZ || s.Center.z - s.Radius > mFarZ)
+		return;
+
+	// Widened by a slice each way: SliceOf and the slice boxes round differently,
+	// and the exact test decides anyway.
+	s.FirstSlice = SliceOf(std::max<float>(s.Center.z - s.Radius, mNearZ));
+	s.LastSlice = SliceOf(std::min<float>(s.Center.z + s.Radius, mFarZ));
+	s.FirstSlice = s.FirstSlice > 0 ? s.FirstSlice - 1 : 0;
+	s.LastSlice = std::min<UINT>(s.LastSlice + 1, ClusterZ - 1);
+	mSpheres.push_back(s);
+}
+
+void LightClusterer::BinAndFlatten(const std::vector<Light>& lights)
+{
+	// Slices own disjoint clusters, so they are binned in parallel.
+	mClusterLights.resize(ClusterCount);
+	concurrency::parallel_for(UINT(0), ClusterZ, [this, &lights](UINT z)
+	{
+		for(UINT c = ClusterIndex(0, 0, z); c < ClusterIndex(0, 0, z + 1); ++c)
+			mClusterLights[c].clear();
+
+		// Influence of each light in an overfull cluster, paired with its sphere.
+		std::vector<std::pair<float, const Sphere*>> ranked;
+
+		for(const Sphere& s : mSpheres)
+		{
+			if(z < s.FirstSlice || z > s.LastSlice)
+				continue;
+
+			// A sphere can only touch clusters whose rows and columns it overlaps, which
+			// rules out most of the slice with ClusterX + ClusterY interval tests.
+			UINT rows[ClusterY];
+			UINT rowCount = 0;
+			for(UINT y = 0; y < ClusterY; ++y)
+			{
+				const Box& box = mBoxes[ClusterIndex(0, y, z)];
+				if(s.Center.y + s.Radius >= box.Min[1] && s.Center.y - s.Radius <= box.Max[1])
+					rows[rowCount++] = y;
+			}
+
+			UINT columns[ClusterX];
+			UINT columnCount = 0;
+			for(UINT x = 0; x < ClusterX; ++x)
+			{
+				const Box& box = mBoxes[ClusterIndex(x, 0, z)];
+				if(s.Center.x + s.Radius >= box.Min[0] && s.Center.x - s.Radius <= box.Max[0])
+					columns[columnCount++] = x;
+			}
+
+			for(UINT r = 0; r < rowCount; ++r)
+			{
+				for(UINT c = 0; c < columnCount; ++c)
+				{
+					UINT cluster = ClusterIndex(columns[c], rows[r], z);
+					if(SphereTouchesCluster(s.Center, s.Radius, cluster))
+						mClusterLights[cluster].push_back((UINT)(&s - mSpheres.data()));
+				}
+			}
+		}
+
+		// The lists hold sphere indices so far.  Keep the most influential lights of
+		// overfull clusters, then switch to light indices.
+		for(UINT c = ClusterIndex(0, 0, z); c < ClusterIndex(0, 0, z + 1); ++c)
+		{
+			std::vector<UINT>& list = mClusterLights[c];
+			if(list.size() > MaxLightsPerCluster)
+			{
+				ranked.clear();
+				for(UINT i : list)
+				{
+					const Sphere& s = mSpheres[i];
+					ranked.push_back(std::make_pair(LightInfluence(lights[s.Light], DistanceToCluster(s.Center, c)), &s));
+				}
+
+				std::partial_sort(ranked.begin(), ranked.begin() + MaxLightsPerCluster, ranked.end(),
+					[](const std::pair<float, const Sphere*>& a, const std::pair<float, const Sphere*>& b)
+				{
+					return a.first > b.first || (a.first == b.first && a.second < b.second);
+				});
+
+				list.clear();
+				for(UINT i = 0; i < MaxLightsPerCluster; ++i)
+					list.push_back((UINT)(ranked[i].second - mSpheres.data()));
+				std::sort(list.begin(), list.end());
+			}
+
+			for(UINT& i : list)
+				i = mSpheres[i].Light;
+		}
+	});
+
+	// Flatten the lists into the index array.
+	mRanges.resize(ClusterCount);
+	mIndices.clear();
+	mDropped = 0;
+	for(UINT c = 0; c < ClusterCount; ++c)
+	{
+		const std::vector<UINT>& list = mClusterLights[c];
+		UINT count = std::min<UINT>((UINT)list.size(), MaxLightIndices - (UINT)mIndices.size());
+
+		mRanges[c].Offset = (UINT)mIndices.size();
+		mRanges[c].Count = count;
+		mIndices.insert(mIndices.end(), list.begin(), list.begin() + count);
+		mDropped += (UINT)list.size() - count;
+	}
+}
@@ -0,0 +1,124 @@
+//***************************************************************************************
+// LightClusterer.h
+//
+// Bins point and spot lights into the clusters (froxels) of a view for clustered
+// forward shading.  The view frustum is cut into ClusterX x ClusterY screen tiles and
+// ClusterZ depth slices spaced exponentially between the near and far planes, and each
+// cluster gets the list of lights whose range (a sphere of radius FalloffEnd) touches
+// its view space box.  The pixel shader finds its cluster the same way and only loops
+// over that cluster's lights, so the cost per pixel follows the lights nearby rather
+// than the lights in the scene.
+//
+// Light lists are flattened into one index array; each cluster stores its offset and
+// count into it.  Clusters are indexed (z*ClusterY + y)*ClusterX + x, with tile y
+// counted from the bottom of the screen.  A cluster reached by more than
+// MaxLightsPerCluster lights keeps the ones with the most influence on it, which puts
+// a fixed bound on the work per pixel.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/d3dUtil.h"
+
+// Rough measure of how much a point or spot light can add at distance d: its
+// brightness scaled by the falloff.  Used to keep the most relevant lights when only
+// some can be shaded.
+inline float LightInfluence(const Light& light, float d)
+{
+	if(d >= light.FalloffEnd)
+		return 0.0f;
+
+	float falloff = light.FalloffEnd > light.FalloffStart ?
+		(light.FalloffEnd - d) / (light.FalloffEnd - light.FalloffStart) : 1.0f;
+	float brightness = 0.2126f*light.Strength.x + 0.7152f*light.Strength.y + 0.0722f*light.Strength.z;
+
+	return brightness * std::min<float>(falloff, 1.0f);
+}
+
+// Range of a cluster's lights in the index array.  Matches uint2 in Default.hlsl.
+struct ClusterRange
+{
+	UINT Offset = 0;
+	UINT Count = 0;
+};
+
+class LightClusterer
+{
+public:
+	static const UINT ClusterX = 16;
+	static const UINT ClusterY = 9;
+	static const UINT ClusterZ = 24;
+	static const UINT ClusterCount = ClusterX * ClusterY * ClusterZ;
+	static const UINT MaxLightsPerCluster = 32;
+
+	// Capacity of the index array.  Lights past it are dropped from their clusters
+	// and counted by DroppedCount.
+	static const UINT MaxLightIndices = ClusterCount * 32;
+
+	// Sets the projection the clusters are cut from.  Cheap when nothing changed.
+	void SetProjection(float fovY, float aspect, float nearZ, float farZ);
+
+	// Rebuilds the light lists from world space lights.  view is the world to view
+	// matrix (row vectors, as stored by XMStoreFloat4x4).
+	void Build(const std::vector<Light>& lights, const DirectX::XMFLOAT4X4& view);
+
+	// As above, but only considers lights[candidates[i]], such as the lights a spatial
+	// index found near the view.  Indices in the lists still refer to lights.
+	void Build(const std::vector<Light>& lights, const std::vector<UINT>& candidates,
+		const DirectX::XMFLOAT4X4& view);
+
+	const std::vector<ClusterRange>& GetRanges()const { return mRanges; }
+	const std::vector<UINT>& GetLightIndices()const { return mIndices; }
+	UINT DroppedCount()const { return mDropped; }
+
+	static UINT ClusterIndex(UINT x, UINT y, UINT z) { return (z * ClusterY + y) * ClusterX + x; }
+
+	// Cluster holding a view space point, found the way the pixel shader does.
+	// Returns ClusterCount for points in front of the near plane or behind the far one.
+	UINT FindCluster(const DirectX::XMFLOAT3& posV)const;
+
+	// Exact test used for binning: does the sphere touch the cluster's view space box?
+	bool SphereTouchesCluster(const DirectX::XMFLOAT3& centerV, float radius, UINT cluster)const;
+
+	// Distance from a view space point to the cluster's box; 0 inside it.
+	float DistanceToCluster(const DirectX::XMFLOAT3& posV, UINT cluster)const;
+
+private:
+	struct Box
+	{
+		float Min[3];
+		float Max[3];
+	};
+
+	// A light's range in view space, with the depth slices it spans.
+	struct Sphere
+	{
+		DirectX::XMFLOAT3 Center;
+		float Radius;
+		UINT Light;
+		UINT FirstSlice;
+		UINT LastSlice;
+	};
+
+	float SliceDepth(UINT slice)const;
+	UINT SliceOf(float depth)const;
+	void AddLight(const Light& light, UINT index, const DirectX::XMFLOAT4X4& view);
+	void BinAndFlatten(const std::vector<Light>& lights);
+
+	float mFovY = 0.0f;
+	float mAspect = 0.0f;
+	float mNearZ = 0.0f;
+	float mFarZ = 0.0f;
+
+	// Half size of the view at depth 1, so view x at depth z spans +-mTanX*z.
+	float mTanX = 0.0f;
+	float mTanY = 0.0f;
+
+	std::vector<Box> mBoxes;
+	std::vector<Sphere> mSpheres;
+	std::vector<std::vector<UINT>> mClusterLights;
+
+	std::vector<ClusterRange> mRanges;
+	std::vector<UINT> mIndices;
+	UINT mDropped = 0;
+};
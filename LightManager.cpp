@@ -0,0 +1,298 @@
+//***************************************************************************************
+// LightManager.cpp
+//***************************************************************************************
+
+#include "LightManager.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const UINT SlotBits = 20;
+	const uint32_t SlotMask = (1u << SlotBits) - 1;
+	const uint32_t GenerationMask = (1u << (32 - SlotBits)) - 1;
+
+	// Does the sphere reach the inside of every plane?
+	bool SphereInFrustum(const XMFLOAT4* planes, const XMFLOAT3& center, float radius)
+	{
+		for(int i = 0; i < 6; ++i)
+		{
+			const XMFLOAT4& p = planes[i];
+			if(p.x*center.x + p.y*center.y + p.z*center.z + p.w < -radius)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+LightManager::LightManager(UINT maxLocalLights, float cellSize) :
+	mMaxLocalLights(maxLocalLights),
+	mCellSize(cellSize)
+{
+	assert(cellSize > 0.0f);
+}
+
+LightHandle LightManager::Create(LightType type, const Light& light)
+{
+	bool directional = type == LightType::Directional;
+	if(directional ? mDirectional.size() >= MaxDirectionalLights : mLocal.size() >= mMaxLocalLights)
+		return InvalidLightHandle;
+
+	UINT slotIndex;
+	if(!mFreeSlots.empty())
+	{
+		slotIndex = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		assert(mSlots.size() <= SlotMask && "Out of light handles.");
+		slotIndex = (UINT)mSlots.size();
+		mSlots.push_back(Slot());
+	}
+
+	Slot& slot = mSlots[slotIndex];
+	slot.Type = type;
+	slot.Alive = true;
+
+	Light stored = light;
+	if(type == LightType::Point)
+		stored.SpotPower = 0.0f;
+
+	if(directional)
+	{
+		slot.Index = (UINT)mDirectional.size();
+		mDirectional.push_back(stored);
+		mDirectionalSlots.push_back(slotIndex);
+		mDirectionalVersion++;
+	}
+	else
+	{
+		slot.Index = (UINT)mLocal.size();
+		mLocal.push_back(stored);
+		mLocalSlots.push_back(slotIndex);
+		mLocalVersion++;
+		mGridDirty = true;
+	}
+
+	return (slot.Generation << SlotBits) | slotIndex;
+}
+
+void LightManager::Remove(LightHandle handle)
+{
+	Slot* slot = Resolve(handle);
+	if(slot == nullptr)
+		return;
+
+	bool directional = slot->Type == LightType::Directional;
+	std::vector<Light>& lights = directional ? mDirectional : mLocal;
+	std::vector<UINT>& owners = directional ? mDirectionalSlots : mLocalSlots;
+
+	// Fill the hole with the last light of the same kind.
+	UINT index = slot->Index;
+	lights[index] = lights.back();
+	owners[index] = owners.back();
+	mSlots[owners[index]].Index = index;
+	lights.pop_back();
+	owners.pop_back();
+
+	if(directional)
+	{
+		mDirectionalVersion++;
+	}
+	else
+	{
+		mLocalVersion++;
+		mGridDirty = true;
+	}
+
+	// Generation 0 is skipped so that no handle is ever 0.
+	slot->Alive = false;
+	slot->Generation = (slot->Generation + 1) & GenerationMask;
+	if(slot->Generation == 0)
+		slot->Generation = 1;
+
+	mFreeSlots.push_back(handle & SlotMask);
+}
+
+bool LightManager::IsValid(LightHandle handle)const
+{
+	return Resolve(handle) != nullptr;
+}
+
+LightType LightManager::GetType(LightHandle handle)const
+{
+	const Slot* slot = Resolve(handle);
+	assert(slot != nullptr && "Invalid light handle.");
+	return slot->Type;
+}
+
+const Light& LightManager::Get(LightHandle handle)const
+{
+	const Slot* slot = Resolve(handle);
+	assert(slot != nullptr && "Invalid light handle.");
+	return slot->Type == LightType::Directional ? mDirectional[slot->Index] : mLocal[slot->Index];
+}
+
+void LightManager::Set(LightHandle handle, const Light& light)
+{
+	Slot* slot = Resolve(handle);
+	assert(slot != nullptr && "Invalid light handle.");
+	if(slot == nullptr)
+		return;
+
+	if(slot->Type == LightType::Directional)
+	{
+		mDirectional[slot->Index] = light;
+		mDirectionalVersion++;
+		return;
+	}
+
+	Light& stored = mLocal[slot->Index];
+	stored = light;
+	if(slot->Type == LightType::Point)
+		stored.SpotPower = 0.0f;
+
+	mLocalVersion++;
+	mGridDirty = true;
+}
+
+void LightManager::Move(LightHandle handle, const XMFLOAT3& position)
+{
+	Slot* slot = Resolve(handle);
+	assert(slot != nullptr && "Invalid light handle.");
+	if(slot == nullptr || slot->Type == LightType::Directional)
+		return;
+
+	mLocal[slot->Index].Position = position;
+	mLocalVersion++;
+	mGridDirty = true;
+}
+
+LightManager::Slot* LightManager::Resolve(LightHandle handle)
+{
+	return const_cast<Slot*>(static_cast<const LightManager*>(this)->Resolve(handle));
+}
+
+const LightManager::Slot* LightManager::Resolve(LightHandle handle)const
+{
+	UINT slotIndex = handle & SlotMask;
+	uint32_t generation = handle >> SlotBits;
+	if(handle == InvalidLightHandle || slotIndex >= mSlots.size())
+		return nullptr;
+
+	const Slot& slot = mSlots[slotIndex];
+	return slot.Alive && slot.Generation == generation ? &slot : nullptr;
+}
+
+uint64_t LightManager::CellKey(int x, int y, int z)const
+{
+	// 21 bits per axis covers +-1M cells, far past anything the scene reaches.
+	const uint64_t mask = (1ull << 21) - 1;
+	return ((uint64_t)(x & mask) << 42) | ((uint64_t)(y & mask) << 21) | (uint64_t)(z & mask);
+}
+
+void LightManager::UpdateGrid()
+{
+	if(!mGridDirty)
+		return;
+
+	// Keep the cells' storage around; empty ones are dropped after the refill.
+	for(auto& e : mCells)
+		e.second.Lights.clear();
+	mLargeLights.clear();
+
+	const float invCellSize = 1.0f / mCellSize;
+	for(UINT i = 0; i < (UINT)mLocal.size(); ++i)
+	{
+		const Light& light = mLocal[i];
+		const XMFLOAT3& p = light.Position;
+		float r = light.FalloffEnd;
+
+		int x0 = (int)floorf((p.x - r) * invCellSize);
+		int y0 = (int)floorf((p.y - r) * invCellSize);
+		int z0 = (int)floorf((p.z - r) * invCellSize);
+		int x1 = (int)floorf((p.x + r) * invCellSize);
+		int y1 = (int)floorf((p.y + r) * invCellSize);
+		int z1 = (int)floorf((p.z + r) * invCellSize);
+
+		UINT64 cellCount = (UINT64)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+		if(cellCount > MaxCellsPerLight)
+		{
+			mLargeLights.push_back(i);
+			continue;
+		}
+
+		for(int z = z0; z <= z1; ++z)
+		{
+			for(int y = y0; y <= y1; ++y)
+			{
+				for(int x = x0; x <= x1; ++x)
+				{
+					auto result = mCells.emplace(CellKey(x, y, z), Cell());
+					Cell& cell = result.first->second;
+					if(result.second)
+					{
+						float half = 0.5f*mCellSize;
+						cell.Bounds.Center = XMFLOAT3((x + 0.5f)*mCellSize, (y + 0.5f)*mCellSize, (z + 0.5f)*mCellSize);
+						cell.Bounds.Extents = XMFLOAT3(half, half, half);
+					}
+
+					cell.Lights.push_back(i);
+				}
+			}
+		}
+	}
+
+	for(auto it = mCells.begin(); it != mCells.end();)
+	{
+		if(it->second.Lights.empty())
+			it = mCells.erase(it);
+		else
+			++it;
+	}
+
+	mGridDirty = false;
+}
+
+void LightManager::QueryFrustum(const FrustumCuller& frustum, std::vector<UINT>& lights)const
+{
+	assert(!mGridDirty && "UpdateGrid must be called after lights change.");
+
+	const XMFLOAT4* planes = frustum.GetPlanes();
+	size_t first = lights.size();
+
+	for(const auto& e : mCells)
+	{
+		const Cell& cell = e.second;
+		ContainmentType containment = frustum.Classify(cell.Bounds);
+		if(containment == DISJOINT)
+			continue;
+
+		if(containment == CONTAINS)
+		{
+			lights.insert(lights.end(), cell.Lights.begin(), cell.Lights.end());
+			continue;
+		}
+
+		for(UINT i : cell.Lights)
+		{
+			if(SphereInFrustum(planes, mLocal[i].Position, mLocal[i].FalloffEnd))
+				lights.push_back(i);
+		}
+	}
+
+	for(UINT i : mLargeLights)
+	{
+		if(SphereInFrustum(planes, mLocal[i].Position, mLocal[i].FalloffEnd))
+			lights.push_back(i);
+	}
+
+	// A light shows up once per cell it overlaps.
+	std::sort(lights.begin() + first, lights.end());
+	lights.erase(std::unique(lights.begin() + first, lights.end()), lights.end());
+}
@@ -0,0 +1,113 @@
+//***************************************************************************************
+// LightManager.h
+//
+// Owns the scene's lights.  Lights are created, changed, moved and removed at runtime
+// through handles, and stored densely by kind: directional lights go to cbPass, point
+// and spot lights ("local" lights) to the structured buffer the light clusters index.
+// Removing a light moves the last light of its kind into its place, so the dense
+// arrays never have holes.
+//
+// Local lights are also kept in a sparse uniform grid, hashed by cell coordinates, so
+// a view only has to bin the lights whose range reaches its frustum rather than all of
+// them.  Each light is entered into every cell its range (a sphere of radius
+// FalloffEnd) overlaps.  Lights wider than MaxCellsPerLight cells are kept apart and
+// tested one by one.
+//***************************************************************************************
+
+#pragma once
+
+#include "FrustumCuller.h"
+#include <unordered_map>
+
+enum class LightType : int
+{
+	Directional = 0,
+	Point,
+	Spot
+};
+
+// Identifies a light for as long as it exists.  The low 20 bits are a slot and the high
+// 12 bits count how often the slot was reused, so a stale handle is caught rather than
+// reaching the light that took its slot.  0 is never a valid handle.
+typedef uint32_t LightHandle;
+const LightHandle InvalidLightHandle = 0;
+
+class LightManager
+{
+public:
+	// Matches NUM_DIR_LIGHTS in the shaders.
+	static const UINT MaxDirectionalLights = 3;
+	static const UINT MaxCellsPerLight = 64;
+
+	LightManager(UINT maxLocalLights, float cellSize = 16.0f);
+	LightManager(const LightManager& rhs) = delete;
+	LightManager& operator=(const LightManager& rhs) = delete;
+
+	// Returns InvalidLightHandle when there is no room left for a light of this type.
+	// A point light's SpotPower is forced to 0, which is how the shaders tell it apart.
+	LightHandle Create(LightType type, const Light& light);
+	void Remove(LightHandle handle);
+
+	bool IsValid(LightHandle handle)const;
+	LightType GetType(LightHandle handle)const;
+	const Light& Get(LightHandle handle)const;
+	void Set(LightHandle handle, const Light& light);
+	void Move(LightHandle handle, const DirectX::XMFLOAT3& position);
+
+	// Dense light arrays.  Indices are only stable until the next Create or Remove.
+	const std::vector<Light>& GetDirectionalLights()const { return mDirectional; }
+	const std::vector<Light>& GetLocalLights()const { return mLocal; }
+
+	// Bumped whenever the corresponding array changes, so callers know when to upload.
+	UINT64 DirectionalVersion()const { return mDirectionalVersion; }
+	UINT64 LocalVersion()const { return mLocalVersion; }
+
+	// Brings the grid up to date with the local lights.  The grid is rebuilt from
+	// scratch when anything changed; the queries below read it and may then run
+	// concurrently.
+	void UpdateGrid();
+
+	// Appends, sorted and without repeats, the indices of the local lights whose range
+	// may reach the frustum.  Conservative: a few lights just outside may be included.
+	void QueryFrustum(const FrustumCuller& frustum, std::vector<UINT>& lights)const;
+
+	UINT CellCount()const { return (UINT)mCells.size(); }
+
+private:
+	struct Slot
+	{
+		uint32_t Generation = 1;
+		LightType Type = LightType::Point;
+		UINT Index = 0;
+		bool Alive = false;
+	};
+
+	struct Cell
+	{
+		DirectX::BoundingBox Bounds;
+		std::vector<UINT> Lights;
+	};
+
+	Slot* Resolve(LightHandle handle);
+	const Slot* Resolve(LightHandle handle)const;
+	uint64_t CellKey(int x, int y, int z)const;
+
+	std::vector<Slot> mSlots;
+	std::vector<UINT> mFreeSlots;
+
+	// Dense light arrays and the slot owning each entry.
+	std::vector<Light> mDirectional;
+	std::vector<UINT> mDirectionalSlots;
+	std::vector<Light> mLocal;
+	std::vector<UINT> mLocalSlots;
+
+	UINT64 mDirectionalVersion = 0;
+	UINT64 mLocalVersion = 0;
+
+	UINT mMaxLocalLights = 0;
+	float mCellSize = 16.0f;
+
+	std::unordered_map<uint64_t, Cell> mCells;
+	std::vector<UINT> mLargeLights;
+	bool mGridDirty = true;
+};
@@ -0,0 +1,66 @@
+//***************************************************************************************
+// ParallelDrawRecorder.cpp
+//***************************************************************************************
+
+#include "ParallelDrawRecorder.h"
+#include <ppl.h>
+
+void ParallelDrawRecorder::Split(UINT batchCount, UINT maxChunks, std::vector<DrawChunk>& chunks)
+{
+	chunks.clear();
+	if(batchCount == 0)
+		return;
+
+	UINT chunkCount = (batchCount + MinBatchesPerChunk - 1) / MinBatchesPerChunk;
+	chunkCount = std::max<UINT>(1, std::min<UINT>(chunkCount, maxChunks));
+
+	// Spread the remainder over the first chunks so sizes differ by at most one.
+	UINT size = batchCount / chunkCount;
+	UINT remainder = batchCount % chunkCount;
+
+	UINT begin = 0;
+	for(UINT i = 0; i < chunkCount; ++i)
+	{
+		DrawChunk chunk;
+		chunk.Begin = begin;
+		chunk.End = begin + size + (i < remainder ? 1 : 0);
+		chunks.push_back(chunk);
+
+		begin = chunk.End;
+	}
+
+	assert(begin == batchCount);
+}
+
+UINT ParallelDrawRecorder::Record(const std::vector<DrawBatch>& batches, const DrawBindings& bindings, UINT maxChunks,
+	const std::function<void(UINT chunk, const CommandRecorder& recorder)>& onChunk)
+{
+	Split((UINT)batches.size(), maxChunks, mChunks);
+
+	const UINT chunkCount = (UINT)mChunks.size();
+	if(mRecorders.size() < chunkCount)
+		mRecorders.resize(chunkCount);
+	mStateChanges.assign(chunkCount, 0);
+
+	// Every chunk goes to a fresh command list, so none of them inherits a PSO.
+	DrawBindings chunkBindings = bindings;
+	chunkBindings.InitialPSO = nullptr;
+
+	concurrency::parallel_for(0u, chunkCount, [&](UINT i)
+	{
+		const DrawChunk& chunk = mChunks[i];
+
+		mRecorders[i].Reset();
+		mStateChanges[i] = RecordDrawBatches(mRecorders[i], batches.data() + chunk.Begin,
+			chunk.End - chunk.Begin, chunkBindings);
+
+		if(onChunk)
+			onChunk(i, mRecorders[i]);
+	});
+
+	UINT stateChanges = 0;
+	for(UINT count : mStateChanges)
+		stateChanges += count;
+
+	return stateChanges;
+}
@@ -0,0 +1,45 @@
+//***************************************************************************************
+// ParallelDrawRecorder.h
+//
+// Splits the sorted draw batches into contiguous chunks and records the chunks
+// concurrently, each into its own CommandRecorder.  A chunk assumes nothing is bound when
+// it starts, so each one can be replayed into a separate command list; executing those
+// lists in chunk order draws exactly what one serial recording would.
+//***************************************************************************************
+
+#pragma once
+
+#include "DrawSubmission.h"
+#include <functional>
+
+struct DrawChunk
+{
+	UINT Begin = 0;
+	UINT End = 0;
+};
+
+class ParallelDrawRecorder
+{
+public:
+	// Below this many batches per chunk the cost of another command list outweighs
+	// the recording work it takes off the other workers.
+	static const UINT MinBatchesPerChunk = 32;
+
+	// Splits batchCount batches into at most maxChunks contiguous ranges of similar size.
+	static void Split(UINT batchCount, UINT maxChunks, std::vector<DrawChunk>& chunks);
+
+	// Records the chunks in parallel.  onChunk, if given, runs on the recording worker
+	// right after the chunk is recorded, so replaying into a command list is also
+	// spread across the workers.  Returns the total number of state changes.
+	UINT Record(const std::vector<DrawBatch>& batches, const DrawBindings& bindings, UINT maxChunks,
+		const std::function<void(UINT chunk, const CommandRecorder& recorder)>& onChunk = nullptr);
+
+	UINT ChunkCount()const { return (UINT)mChunks.size(); }
+	const DrawChunk& GetChunk(UINT i)const { return mChunks[i]; }
+	const CommandRecorder& GetRecorder(UINT i)const { return mRecorders[i]; }
+
+private:
+	std::vector<DrawChunk> mChunks;
+	std::vector<CommandRecorder> mRecorders;
+	std::vector<UINT> mStateChanges;
+};
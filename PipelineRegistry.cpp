@@ -0,0 +1,242 @@
+//***************************************************************************************
+// PipelineRegistry.cpp
+//***************************************************************************************
+
+#include "PipelineRegistry.h"
+#include "ShaderCache.h"
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <ppl.h>
+
+using Microsoft::WRL::ComPtr;
+
+static_assert(sizeof(PipelineStateKey) == 20, "PipelineStateKey must have no padding.");
+
+namespace
+{
+	std::wstring PipelineName(uint64_t hash)
+	{
+		wchar_t name[32];
+		swprintf_s(name, L"pso_%016llx", (unsigned long long)hash);
+		return name;
+	}
+
+	D3D12_SHADER_BYTECODE Bytecode(const std::vector<ComPtr<ID3DBlob>>& shaders, uint16_t slot)
+	{
+		if(slot == PipelineStateKey::NoShader)
+			return { nullptr, 0 };
+
+		return { reinterpret_cast<BYTE*>(shaders[slot]->GetBufferPointer()), shaders[slot]->GetBufferSize() };
+	}
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+	// Worker threads may still be creating pipelines into this object.
+	if(mCreation.valid())
+		mCreation.wait();
+}
+
+uint16_t PipelineRegistry::AddShader(ID3DBlob* bytecode)
+{
+	for(size_t i = 0; i < mShaders.size(); ++i)
+	{
+		if(mShaders[i].Get() == bytecode)
+			return (uint16_t)i;
+	}
+
+	assert(mShaders.size() < PipelineStateKey::NoShader);
+	mShaders.push_back(bytecode);
+	mShaderHashes.push_back(ShaderCache::Fnv1a(bytecode->GetBufferPointer(), bytecode->GetBufferSize()));
+	return (uint16_t)(mShaders.size() - 1);
+}
+
+uint16_t PipelineRegistry::AddInputLayout(const std::vector<D3D12_INPUT_ELEMENT_DESC>& layout)
+{
+	// The semantic name pointers differ between runs, so hash the text instead.
+	uint64_t hash = ShaderCache::FnvOffsetBasis;
+	for(const D3D12_INPUT_ELEMENT_DESC& e : layout)
+	{
+		hash = ShaderCache::Fnv1a(e.SemanticName, strlen(e.SemanticName) + 1, hash);
+		const UINT fields[6] = { e.SemanticIndex, (UINT)e.Format, e.InputSlot, e.AlignedByteOffset,
+			(UINT)e.InputSlotClass, e.InstanceDataStepRate };
+		hash = ShaderCache::Fnv1a(fields, sizeof(fields), hash);
+	}
+
+	for(size_t i = 0; i < mInputLayoutHashes.size(); ++i)
+	{
+		if(mInputLayoutHashes[i] == hash)
+			return (uint16_t)i;
+	}
+
+	mInputLayouts.push_back(layout);
+	mInputLayoutHashes.push_back(hash);
+	return (uint16_t)(mInputLayouts.size() - 1);
+}
+
+PsoHandle PipelineRegistry::Register(const PipelineStateKey& key)
+{
+	assert(!mCreation.valid() && "Pipelines must be registered before CreateAsync.");
+
+	auto it = mHandles.find(key);
+	if(it != mHandles.end())
+		return it->second;
+
+	PsoHandle handle = (PsoHandle)mKeys.size();
+	mKeys.push_back(key);
+	mHandles[key] = handle;
+	return handle;
+}
+
+PsoHandle PipelineRegistry::Find(const PipelineStateKey& key)const
+{
+	auto it = mHandles.find(key);
+	return it != mHandles.end() ? it->second : InvalidPsoHandle;
+}
+
+size_t PipelineRegistry::KeyHasher::operator()(const PipelineStateKey& key)const
+{
+	return (size_t)ShaderCache::Fnv1a(&key, sizeof(key));
+}
+
+uint64_t PipelineRegistry::StableHash(const PipelineStateKey& key)const
+{
+	// Slots depend on registration order; what they refer to does not.
+	PipelineStateKey stable = key;
+	stable.VS = stable.GS = stable.PS = PipelineStateKey::NoShader;
+	stable.InputLayout = 0;
+
+	uint64_t hash = ShaderCache::Fnv1a(&stable, sizeof(stable));
+	for(uint16_t slot : { key.VS, key.GS, key.PS })
+	{
+		uint64_t shaderHash = slot == PipelineStateKey::NoShader ? 0 : mShaderHashes[slot];
+		hash = ShaderCache::Fnv1a(&shaderHash, sizeof(shaderHash), hash);
+	}
+
+	return ShaderCache::Fnv1a(&mInputLayoutHashes[key.InputLayout], sizeof(uint64_t), hash);
+}
+
+D3D12_GRAPHICS_PIPELINE_STATE_DESC PipelineRegistry::BuildDesc(const PipelineStateKey& key)const
+{
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+	ZeroMemory(&desc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
+
+	const auto& layout = mInputLayouts[key.InputLayout];
+	desc.InputLayout = { layout.data(), (UINT)layout.size() };
+	desc.pRootSignature = mRootSignature.Get();
+	desc.VS = Bytecode(mShaders, key.VS);
+	desc.GS = Bytecode(mShaders, key.GS);
+	desc.PS = Bytecode(mShaders, key.PS);
+	desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	desc.RasterizerState.CullMode = (D3D12_CULL_MODE)key.CullMode;
+	desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	desc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	desc.SampleMask = UINT_MAX;
+	desc.PrimitiveTopologyType = (D3D12_PRIMITIVE_TOPOLOGY_TYPE)key.Topology;
+	desc.NumRenderTargets = 1;
+	desc.RTVFormats[0] = (DXGI_FORMAT)key.RTVFormat;
+	desc.SampleDesc.Count = key.SampleCount;
+	desc.SampleDesc.Quality = key.SampleQuality;
+	desc.DSVFormat = (DXGI_FORMAT)key.DSVFormat;
+
+	if(key.Blend == PsoBlend::AlphaBlend)
+	{
+		D3D12_RENDER_TARGET_BLEND_DESC transparencyBlendDesc;
+		transparencyBlendDesc.BlendEnable = true;
+		transparencyBlendDesc.LogicOpEnable = false;
+		transparencyBlendDesc.SrcBlend = D3D12_BLEND_SRC_ALPHA;
+		transparencyBlendDesc.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+		transparencyBlendDesc.BlendOp = D3D12_BLEND_OP_ADD;
+		transparencyBlendDesc.SrcBlendAlpha = D3D12_BLEND_ONE;
+		transparencyBlendDesc.DestBlendAlpha = D3D12_BLEND_ZERO;
+		transparencyBlendDesc.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+		transparencyBlendDesc.LogicOp = D3D12_LOGIC_OP_NOOP;
+		transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+
+		desc.BlendState.RenderTarget[0] = transparencyBlendDesc;
+	}
+
+	return desc;
+}
+
+void PipelineRegistry::CreateAsync(ID3D12Device* device, const std::wstring& libraryFile)
+{
+	assert(!mCreation.valid() && "CreateAsync can only be called once.");
+
+	mPipelines.resize(mKeys.size());
+	mCreation = std::async(std::launch::async, [this, device, libraryFile]() { CreateAll(device, libraryFile); });
+}
+
+void PipelineRegistry::Wait()
+{
+	if(mCreation.valid())
+		mCreation.get();
+}
+
+void PipelineRegistry::CreateAll(ID3D12Device* device, const std::wstring& libraryFile)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	// The library reads from the serialized data rather than copying it, so the data
+	// is declared first and outlives it.
+	std::vector<char> libraryData;
+	ComPtr<ID3D12Device1> device1;
+	ComPtr<ID3D12PipelineLibrary> library;
+	if(!libraryFile.empty() && SUCCEEDED(device->QueryInterface(IID_PPV_ARGS(&device1))))
+	{
+		std::ifstream fin(libraryFile, std::ios::binary);
+		libraryData.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+
+		// Fails after a driver or adapter change; everything is then created anew.
+		if(libraryData.empty() ||
+		   FAILED(device1->CreatePipelineLibrary(libraryData.data(), libraryData.size(), IID_PPV_ARGS(&library))))
+			library = nullptr;
+	}
+
+	std::vector<std::wstring> names(mKeys.size());
+	for(size_t i = 0; i < mKeys.size(); ++i)
+		names[i] = PipelineName(StableHash(mKeys[i]));
+
+	// The library synchronizes internally; it only asks that no two threads load the
+	// same pipeline at once, and names are unique here.
+	std::atomic<UINT> loaded(0);
+	concurrency::parallel_for(size_t(0), mKeys.size(), [&](size_t i)
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = BuildDesc(mKeys[i]);
+		if(library != nullptr &&
+		   SUCCEEDED(library->LoadGraphicsPipeline(names[i].c_str(), &desc, IID_PPV_ARGS(&mPipelines[i]))))
+		{
+			loaded++;
+			return;
+		}
+
+		ThrowIfFailed(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&mPipelines[i])));
+	});
+	mLoaded = loaded;
+
+	// Rewritten from scratch, which also drops pipelines that are no longer used.
+	if(device1 != nullptr && mLoaded < mPipelines.size())
+	{
+		ComPtr<ID3D12PipelineLibrary> fresh;
+		if(SUCCEEDED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&fresh))))
+		{
+			for(size_t i = 0; i < mPipelines.size(); ++i)
+				fresh->StorePipeline(names[i].c_str(), mPipelines[i].Get());
+
+			std::vector<char> data(fresh->GetSerializedSize());
+			if(!data.empty() && SUCCEEDED(fresh->Serialize(data.data(), data.size())))
+			{
+				std::wstring tempFile = libraryFile + L".tmp";
+				std::ofstream fout(tempFile, std::ios::binary);
+				fout.write(data.data(), data.size());
+				fout.close();
+				if(fout)
+					MoveFileExW(tempFile.c_str(), libraryFile.c_str(), MOVEFILE_REPLACE_EXISTING);
+			}
+		}
+	}
+
+	mCreateMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
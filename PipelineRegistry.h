@@ -0,0 +1,124 @@
+//***************************************************************************************
+// PipelineRegistry.h
+//
+// Pipeline state objects named by a small state key instead of a string.  Register
+// returns an integer handle for a key, giving the same handle for the same state, and
+// Get is a plain array lookup, so nothing is hashed once rendering starts.
+//
+// CreateAsync builds every registered pipeline on worker threads while the caller
+// keeps initializing.  Pipelines are kept in an ID3D12PipelineLibrary file between
+// runs: a pipeline found there is loaded instead of compiled by the driver, and the
+// file is rewritten whenever one was not.  Library entries are named by a hash of the
+// state and of the shader bytecode, so an edited shader never loads a stale pipeline.
+//
+// Register, Find and the hashes need no device (see HeadlessBench -benchpsos).
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/d3dUtil.h"
+#include <future>
+
+typedef UINT PsoHandle;
+const PsoHandle InvalidPsoHandle = UINT(-1);
+
+enum class PsoBlend : uint8_t
+{
+	Opaque = 0,
+	AlphaBlend
+};
+
+// Everything that varies between the app's pipelines.  Shaders and input layouts are
+// slots returned by PipelineRegistry::AddShader and AddInputLayout.  Fields are sized
+// so the struct has no padding and can be hashed and compared as bytes.
+struct PipelineStateKey
+{
+	static const uint16_t NoShader = 0xFFFF;
+
+	uint16_t VS = NoShader;
+	uint16_t GS = NoShader;
+	uint16_t PS = NoShader;
+	uint16_t InputLayout = 0;
+
+	PsoBlend Blend = PsoBlend::Opaque;
+	uint8_t CullMode = (uint8_t)D3D12_CULL_MODE_BACK;
+	uint8_t Topology = (uint8_t)D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	uint8_t SampleCount = 1;
+
+	uint16_t SampleQuality = 0;
+	uint16_t RTVFormat = (uint16_t)DXGI_FORMAT_R8G8B8A8_UNORM;
+	uint16_t DSVFormat = (uint16_t)DXGI_FORMAT_D24_UNORM_S8_UINT;
+	uint16_t Reserved = 0;
+
+	bool operator==(const PipelineStateKey& rhs)const { return memcmp(this, &rhs, sizeof(*this)) == 0; }
+};
+
+class PipelineRegistry
+{
+public:
+	PipelineRegistry() = default;
+	PipelineRegistry(const PipelineRegistry& rhs) = delete;
+	PipelineRegistry& operator=(const PipelineRegistry& rhs) = delete;
+	~PipelineRegistry();
+
+	void SetRootSignature(ID3D12RootSignature* rootSignature) { mRootSignature = rootSignature; }
+
+	// The registry keeps the blob alive.  Adding the same blob twice returns one slot.
+	uint16_t AddShader(ID3DBlob* bytecode);
+
+	// Semantic names must outlive the registry, as string literals do.  An identical
+	// layout returns the existing slot.
+	uint16_t AddInputLayout(const std::vector<D3D12_INPUT_ELEMENT_DESC>& layout);
+
+	// Returns the handle of the pipeline with this state, registering it if it is new.
+	// All pipelines must be registered before CreateAsync.
+	PsoHandle Register(const PipelineStateKey& key);
+
+	// Returns InvalidPsoHandle if no pipeline has this state.
+	PsoHandle Find(const PipelineStateKey& key)const;
+
+	const PipelineStateKey& GetKey(PsoHandle handle)const { return mKeys[handle]; }
+	UINT Count()const { return (UINT)mKeys.size(); }
+
+	// Hash that stays the same between runs for the same state and shader bytecode.
+	// Names the pipeline in the library file.
+	uint64_t StableHash(const PipelineStateKey& key)const;
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC BuildDesc(const PipelineStateKey& key)const;
+
+	// Starts creating every registered pipeline.  An empty libraryFile turns the
+	// pipeline library off.  Wait must be called before Get.
+	void CreateAsync(ID3D12Device* device, const std::wstring& libraryFile);
+
+	// Blocks until CreateAsync is done, rethrowing anything it threw.
+	void Wait();
+
+	ID3D12PipelineState* Get(PsoHandle handle)const { return mPipelines[handle].Get(); }
+
+	UINT LoadedCount()const { return mLoaded; }
+	UINT CreatedCount()const { return (UINT)mPipelines.size() - mLoaded; }
+	double CreateMs()const { return mCreateMs; }
+
+private:
+	struct KeyHasher
+	{
+		size_t operator()(const PipelineStateKey& key)const;
+	};
+
+	void CreateAll(ID3D12Device* device, const std::wstring& libraryFile);
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> mRootSignature;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3DBlob>> mShaders;
+	std::vector<uint64_t> mShaderHashes;
+	std::vector<std::vector<D3D12_INPUT_ELEMENT_DESC>> mInputLayouts;
+	std::vector<uint64_t> mInputLayoutHashes;
+
+	std::vector<PipelineStateKey> mKeys;
+	std::unordered_map<PipelineStateKey, PsoHandle, KeyHasher> mHandles;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12PipelineState>> mPipelines;
+	std::future<void> mCreation;
+	UINT mLoaded = 0;
+	double mCreateMs = 0.0;
+};
@@ -0,0 +1,65 @@
+//***************************************************************************************
+// RenderItem.h
+//
+// Lightweight structure stores parameters to draw a shape, and the render layers the
+// items are bucketed into.  Shared by the app and the scene systems (culling, sorting)
+// that operate on render items.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/d3dUtil.h"
+#include "Common/MathHelper.h"
+
+enum class RenderLayer : int
+{
+	Opaque = 0,
+	Transparent,
+	AlphaTested,
+	AlphaTestedTreeSprites,
+	Count
+};
+
+// Lightweight structure stores parameters to draw a shape.  This will
+// vary from app-to-app.
+struct RenderItem
+{
+	RenderItem() = default;
+
+    // World matrix of the shape that describes the object's local space
+    // relative to the world space, which defines the position, orientation,
+    // and scale of the object in the world.
+    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+
+	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+	// Unique index of the item.  Instance data is written per frame for the visible
+	// items only, so this no longer addresses a constant buffer slot.
+	UINT ObjCBIndex = -1;
+
+	Material* Mat = nullptr;
+	MeshGeometry* Geo = nullptr;
+
+	// Layer (and so PSO) the item is drawn with.
+	RenderLayer Layer = RenderLayer::Opaque;
+
+    // Primitive topology.
+    D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+    // DrawIndexedInstanced parameters.
+    UINT IndexCount = 0;
+    UINT StartIndexLocation = 0;
+    int BaseVertexLocation = 0;
+
+	// Bounding box of the submesh in local space, copied from SubmeshGeometry::Bounds.
+	DirectX::BoundingBox LocalBounds;
+
+	// LocalBounds transformed by World.  Used for frustum culling, so it must be
+	// refreshed (see UpdateWorldBounds) whenever World changes.
+	DirectX::BoundingBox Bounds;
+
+	void UpdateWorldBounds()
+	{
+		LocalBounds.Transform(Bounds, DirectX::XMLoadFloat4x4(&World));
+	}
+};
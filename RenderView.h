@@ -0,0 +1,77 @@
+//***************************************************************************************
+// RenderView.h
+//
+// One point of view rendered each frame: a camera, the part of the back buffer it draws
+// to and the pass constant slot its shaders read.  Each view keeps its own visible set,
+// draw batches and recorded chunks, so views never share per-frame state.  All views are
+// culled together by SceneBVH::QueryFrustums.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/Camera.h"
+#include "FrameResource.h"
+#include "FrustumCuller.h"
+#include "DrawSorter.h"
+#include "ParallelDrawRecorder.h"
+
+struct RenderView
+{
+	std::string Name;
+	Camera Cam;
+
+	// Part of the back buffer covered by the view, as fractions: left, top, width, height.
+	DirectX::XMFLOAT4 ScreenRect = { 0.0f, 0.0f, 1.0f, 1.0f };
+	D3D12_VIEWPORT Viewport = {};
+	D3D12_RECT ScissorRect = {};
+
+	// Index of the view's constants in FrameResource::PassCB.
+	UINT PassIndex = 0;
+
+	// First element of the view's instances in FrameResource::InstanceBuffer.
+	UINT InstanceBase = 0;
+
+	// Filled by culling each frame.
+	FrustumCuller Frustum;
+	std::vector<UINT> VisibleItems;
+	FrustumCuller::LayerList VisibleLayers;
+	CullStats Stats;
+
+	// Point and spot lights binned into the view's clusters, out of the candidates the
+	// light grid found in the frustum.
+	LightClusterer Clusters;
+	std::vector<UINT> LightCandidates;
+
+	InstanceBatcher Batcher;
+	DrawSorter Sorter;
+	ParallelDrawRecorder Recorder;
+	UINT StateChanges = 0;
+
+	// Only the view block of Pass is filled here; the time and scene blocks are shared
+	// by all views.  PassBlockDirty counts the frame resources still to be updated, as
+	// Material::NumFramesDirty does.
+	PassConstants Pass;
+	int PassBlockDirty[(int)PassBlock::Count] = {};
+
+	// Inputs of the view block as of its last rebuild.
+	DirectX::XMFLOAT4X4 PassViewMatrix = MathHelper::Identity4x4();
+	DirectX::XMFLOAT4X4 PassProjMatrix = MathHelper::Identity4x4();
+	int PassWidth = 0;
+	int PassHeight = 0;
+
+	// Fits the viewport to the client area and the camera lens to the viewport.
+	void Resize(int clientWidth, int clientHeight)
+	{
+		Viewport.TopLeftX = ScreenRect.x * clientWidth;
+		Viewport.TopLeftY = ScreenRect.y * clientHeight;
+		Viewport.Width = ScreenRect.z * clientWidth;
+		Viewport.Height = ScreenRect.w * clientHeight;
+		Viewport.MinDepth = 0.0f;
+		Viewport.MaxDepth = 1.0f;
+
+		ScissorRect = { (LONG)Viewport.TopLeftX, (LONG)Viewport.TopLeftY,
+			(LONG)(Viewport.TopLeftX + Viewport.Width), (LONG)(Viewport.TopLeftY + Viewport.Height) };
+
+		Cam.SetLens(0.25f*MathHelper::Pi, Viewport.Width / Viewport.Height, 1.0f, 1000.0f);
+	}
+};
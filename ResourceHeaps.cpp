@@ -0,0 +1,182 @@
+//***************************************************************************************
+// ResourceHeaps.cpp
+//***************************************************************************************
+
+#include "ResourceHeaps.h"
+#include <cstdio>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+ResourceHeapPool::ResourceHeapPool(ID3D12Device* device, D3D12_HEAP_FLAGS flags, UINT64 heapSize) :
+	mDevice(device),
+	mFlags(flags),
+	mHeapSize(AlignUp(heapSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT))
+{
+}
+
+PlacedAllocation ResourceHeapPool::CreateResource(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState,
+	ComPtr<ID3D12Resource>& resource)
+{
+	// A texture that is neither a render target nor a depth buffer may take the small
+	// alignment if it fits in 64 KB; the device says whether it does.
+	D3D12_RESOURCE_DESC placedDesc = desc;
+	placedDesc.Alignment = 0;
+	D3D12_RESOURCE_ALLOCATION_INFO info = {};
+	if(desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER &&
+	   (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) == 0)
+	{
+		placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+		info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+		if(info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+			placedDesc.Alignment = 0;
+	}
+	if(placedDesc.Alignment == 0)
+		info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+
+	PlacedAllocation allocation;
+	for(UINT h = 0; h < (UINT)mHeaps.size() && !allocation.IsValid(); ++h)
+	{
+		HeapAllocator::Allocation range = mHeaps[h].Ranges->Allocate(info.SizeInBytes, info.Alignment);
+		if(range.IsValid())
+		{
+			allocation.Heap = h;
+			allocation.Range = range;
+		}
+	}
+
+	if(!allocation.IsValid())
+	{
+		Heap heap;
+		UINT64 size = std::max<UINT64>(mHeapSize, AlignUp(info.SizeInBytes, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+		CD3DX12_HEAP_DESC heapDesc(size, D3D12_HEAP_TYPE_DEFAULT, 0, mFlags);
+		ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap.Resource)));
+		heap.Ranges = std::make_unique<HeapAllocator>(size);
+
+		allocation.Heap = (UINT)mHeaps.size();
+		allocation.Range = heap.Ranges->Allocate(info.SizeInBytes, info.Alignment);
+		assert(allocation.Range.IsValid());
+		mHeaps.push_back(std::move(heap));
+	}
+
+	ThrowIfFailed(mDevice->CreatePlacedResource(
+		mHeaps[allocation.Heap].Resource.Get(),
+		allocation.Range.Offset,
+		&placedDesc,
+		initialState,
+		nullptr,
+		IID_PPV_ARGS(&resource)));
+
+	return allocation;
+}
+
+void ResourceHeapPool::Free(const PlacedAllocation& allocation, UINT64 fenceValue)
+{
+	assert(allocation.Heap < mHeaps.size());
+	mHeaps[allocation.Heap].Ranges->Free(allocation.Range, fenceValue);
+}
+
+void ResourceHeapPool::Retire(UINT64 completedValue)
+{
+	for(Heap& heap : mHeaps)
+		heap.Ranges->Retire(completedValue);
+}
+
+UINT64 ResourceHeapPool::HeapBytes()const
+{
+	UINT64 bytes = 0;
+	for(const Heap& heap : mHeaps)
+		bytes += heap.Ranges->Capacity();
+	return bytes;
+}
+
+UINT64 ResourceHeapPool::UsedBytes()const
+{
+	UINT64 bytes = 0;
+	for(const Heap& heap : mHeaps)
+		bytes += heap.Ranges->UsedBytes();
+	return bytes;
+}
+
+std::string ResourceHeapPool::Report(const char* name)const
+{
+	UINT64 largest = 0;
+	for(const Heap& heap : mHeaps)
+		largest = std::max<UINT64>(largest, heap.Ranges->LargestFreeRange());
+
+	char line[128];
+	snprintf(line, sizeof(line), "  %-16s %8.2f MB used of %.2f MB in %u heaps, largest free %.2f MB\n", name,
+		UsedBytes() / (1024.0 * 1024.0), HeapBytes() / (1024.0 * 1024.0), HeapCount(), largest / (1024.0 * 1024.0));
+	return line;
+}
+
+UploadArena::UploadArena(ID3D12Device* device, UINT64 pageSize) :
+	mDevice(device),
+	mPageSize(pageSize)
+{
+}
+
+UploadArena::Region UploadArena::Allocate(UINT64 bytes, UINT64 alignment)
+{
+	size_t target = mPages.size() - 1;
+	if(mPages.empty() || AlignUp(mPages.back().Used, alignment) + bytes > mPages.back().Size)
+	{
+		Page page;
+		page.Size = std::max<UINT64>(mPageSize, bytes);
+		page.Used = 0;
+
+		// Persistently mapped, like the frame resources' upload buffers.
+		ThrowIfFailed(mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(page.Size),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&page.Resource)));
+		ThrowIfFailed(page.Resource->Map(0, nullptr, reinterpret_cast<void**>(&page.Data)));
+
+		// A copy too big for a page gets one to itself, and the current page keeps
+		// taking the small ones.
+		if(bytes > mPageSize && !mPages.empty())
+		{
+			mPages.insert(mPages.end() - 1, std::move(page));
+			target = mPages.size() - 2;
+		}
+		else
+		{
+			mPages.push_back(std::move(page));
+			target = mPages.size() - 1;
+		}
+	}
+
+	Page& page = mPages[target];
+	page.Used = AlignUp(page.Used, alignment);
+
+	Region region;
+	region.Resource = page.Resource.Get();
+	region.Offset = page.Used;
+	region.Data = page.Data + page.Used;
+
+	page.Used += bytes;
+	mUsedBytes += bytes;
+	return region;
+}
+
+void UploadArena::ReleaseAfter(ResourceTracker& resources, UINT64 fenceValue)
+{
+	for(Page& page : mPages)
+	{
+		resources.Track(MemoryCategory::UploadHeaps, page.Size);
+		resources.ReleaseAfter(fenceValue, page.Resource, MemoryCategory::UploadHeaps, page.Size);
+	}
+
+	mPages.clear();
+	mUsedBytes = 0;
+}
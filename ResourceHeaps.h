@@ -0,0 +1,113 @@
+//***************************************************************************************
+// ResourceHeaps.h
+//
+// Where the app's static meshes and textures live.  Rather than one committed resource,
+// with its own implicit heap, per buffer and texture, ResourceHeapPool places them in a
+// few large heaps carved up by HeapAllocator, and textures small enough take the 4 KB
+// placement alignment instead of 64 KB.  UploadArena gives the copies that fill them
+// their source space in a few shared, mapped upload buffers instead of one upload
+// buffer each.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/d3dUtil.h"
+#include "HeapAllocator.h"
+#include "ResourceTracker.h"
+
+// A placed resource's range in a ResourceHeapPool.
+struct PlacedAllocation
+{
+	UINT Heap = UINT_MAX;
+	HeapAllocator::Allocation Range;
+
+	bool IsValid()const { return Heap != UINT_MAX; }
+};
+
+class ResourceHeapPool
+{
+public:
+	// flags says which resources the heaps may hold; heaps of tier 1 hardware hold
+	// buffers or one kind of texture only.  A resource bigger than heapSize gets a heap
+	// of its own.
+	ResourceHeapPool(ID3D12Device* device, D3D12_HEAP_FLAGS flags, UINT64 heapSize);
+	ResourceHeapPool(const ResourceHeapPool& rhs) = delete;
+	ResourceHeapPool& operator=(const ResourceHeapPool& rhs) = delete;
+
+	// Places a resource described by desc in the first heap with room for it, adding a
+	// heap if none has.  desc.Alignment is ignored: the smallest the device allows is
+	// used.
+	PlacedAllocation CreateResource(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState,
+		Microsoft::WRL::ComPtr<ID3D12Resource>& resource);
+
+	// Gives the resource's range back once fenceValue completes.  The resource itself
+	// has to be released by then; ResourceTracker::ReleaseAfter with the same fence value
+	// does that.
+	void Free(const PlacedAllocation& allocation, UINT64 fenceValue);
+
+	// Gives back the ranges whose fence value has completed.
+	void Retire(UINT64 completedValue);
+
+	UINT HeapCount()const { return (UINT)mHeaps.size(); }
+	UINT64 HeapBytes()const;
+	UINT64 UsedBytes()const;
+
+	// One line: heaps, megabytes used of megabytes held, and the largest free range.
+	std::string Report(const char* name)const;
+
+private:
+	struct Heap
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Resource;
+		std::unique_ptr<HeapAllocator> Ranges;
+	};
+
+	ID3D12Device* mDevice;
+	D3D12_HEAP_FLAGS mFlags;
+	UINT64 mHeapSize;
+	std::vector<Heap> mHeaps;
+};
+
+class UploadArena
+{
+public:
+	// Copies are staged in pages of pageSize bytes; a bigger copy gets a page its size.
+	UploadArena(ID3D12Device* device, UINT64 pageSize);
+	UploadArena(const UploadArena& rhs) = delete;
+	UploadArena& operator=(const UploadArena& rhs) = delete;
+
+	struct Region
+	{
+		ID3D12Resource* Resource = nullptr;
+		UINT64 Offset = 0;
+
+		// Mapped: written by the CPU, read by the copies.
+		uint8_t* Data = nullptr;
+	};
+
+	// bytes of upload space at a multiple of alignment within its page.
+	Region Allocate(UINT64 bytes, UINT64 alignment);
+
+	// Hands the pages to resources, counted as upload heaps, to be released once
+	// fenceValue completes, and starts over with none.
+	void ReleaseAfter(ResourceTracker& resources, UINT64 fenceValue);
+
+	UINT PageCount()const { return (UINT)mPages.size(); }
+
+	// Bytes handed out since the pages were last released.
+	UINT64 UsedBytes()const { return mUsedBytes; }
+
+private:
+	struct Page
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		uint8_t* Data;
+		UINT64 Size;
+		UINT64 Used;
+	};
+
+	ID3D12Device* mDevice;
+	UINT64 mPageSize;
+	UINT64 mUsedBytes = 0;
+	std::vector<Page> mPages;
+};
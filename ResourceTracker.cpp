@@ -0,0 +1,84 @@
+//***************************************************************************************
+// ResourceTracker.cpp
+//***************************************************************************************
+
+#include "ResourceTracker.h"
+#include <cstdio>
+
+using Microsoft::WRL::ComPtr;
+
+void ResourceTracker::Track(MemoryCategory category, UINT64 bytes)
+{
+	mBytes[(int)category] += bytes;
+}
+
+void ResourceTracker::Untrack(MemoryCategory category, UINT64 bytes)
+{
+	assert(mBytes[(int)category] >= bytes);
+	mBytes[(int)category] -= bytes;
+}
+
+void ResourceTracker::ReleaseAfter(UINT64 fenceValue, ComPtr<IUnknown> object, MemoryCategory category, UINT64 bytes)
+{
+	if(object == nullptr)
+		return;
+
+	Pending pending = { fenceValue, std::move(object), category, bytes };
+	mPending.push_back(std::move(pending));
+}
+
+UINT64 ResourceTracker::Retire(UINT64 completedValue)
+{
+	UINT64 freed = 0;
+
+	// Handed over in roughly fence order, but not strictly, so every entry is checked.
+	auto retired = std::stable_partition(mPending.begin(), mPending.end(),
+		[completedValue](const Pending& pending) { return pending.FenceValue > completedValue; });
+	for(auto it = retired; it != mPending.end(); ++it)
+	{
+		Untrack(it->Category, it->Bytes);
+		freed += it->Bytes;
+	}
+	mPending.erase(retired, mPending.end());
+
+	return freed;
+}
+
+UINT64 ResourceTracker::TotalBytes()const
+{
+	UINT64 total = 0;
+	for(UINT64 bytes : mBytes)
+		total += bytes;
+	return total;
+}
+
+std::string ResourceTracker::Report()const
+{
+	std::string report;
+	char line[128];
+	for(int c = 0; c < (int)MemoryCategory::Count; ++c)
+	{
+		snprintf(line, sizeof(line), "  %-16s %8.2f MB\n", CategoryName((MemoryCategory)c), mBytes[c] / (1024.0 * 1024.0));
+		report += line;
+	}
+
+	snprintf(line, sizeof(line), "  %-16s %8.2f MB (%u awaiting release)\n", "total", TotalBytes() / (1024.0 * 1024.0),
+		PendingCount());
+	report += line;
+
+	return report;
+}
+
+const char* ResourceTracker::CategoryName(MemoryCategory category)
+{
+	switch(category)
+	{
+	case MemoryCategory::Textures: return "textures";
+	case MemoryCategory::Geometry: return "geometry";
+	case MemoryCategory::UploadHeaps: return "upload heaps";
+	case MemoryCategory::FrameResources: return "frame resources";
+	case MemoryCategory::TextureStaging: return "texture staging";
+	case MemoryCategory::MeshCpuCopies: return "mesh cpu copies";
+	default: return "?";
+	}
+}
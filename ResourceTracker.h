@@ -0,0 +1,65 @@
+//***************************************************************************************
+// ResourceTracker.h
+//
+// Keeps count of the memory the app holds, by category, and holds on to objects the GPU
+// may still be reading until the fence value of the last commands that use them
+// completes.  Upload heaps are handed over once their copy commands are recorded and
+// freed by Retire when the copies are done, so they no longer live as long as the
+// resources they filled.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/d3dUtil.h"
+
+enum class MemoryCategory : int
+{
+	Textures = 0,
+	Geometry,
+	UploadHeaps,		// Sources of copies to default heap resources.
+	FrameResources,		// Per-frame constant, instance and dynamic vertex buffers.
+	TextureStaging,
+	MeshCpuCopies,
+	Count
+};
+
+class ResourceTracker
+{
+public:
+	ResourceTracker() = default;
+	ResourceTracker(const ResourceTracker& rhs) = delete;
+	ResourceTracker& operator=(const ResourceTracker& rhs) = delete;
+
+	// Counts bytes against category from now until Untrack, or until the release of an
+	// object handed to ReleaseAfter with the same bytes.
+	void Track(MemoryCategory category, UINT64 bytes);
+	void Untrack(MemoryCategory category, UINT64 bytes);
+
+	// Keeps object alive until fenceValue completes, then releases it and untracks its
+	// bytes.  A null object is ignored.
+	void ReleaseAfter(UINT64 fenceValue, Microsoft::WRL::ComPtr<IUnknown> object, MemoryCategory category, UINT64 bytes);
+
+	// Releases the objects whose fence value has completed.  Returns the bytes freed.
+	UINT64 Retire(UINT64 completedValue);
+
+	UINT64 Bytes(MemoryCategory category)const { return mBytes[(int)category]; }
+	UINT64 TotalBytes()const;
+	UINT PendingCount()const { return (UINT)mPending.size(); }
+
+	// One line per category with its megabytes, then the total.
+	std::string Report()const;
+
+	static const char* CategoryName(MemoryCategory category);
+
+private:
+	struct Pending
+	{
+		UINT64 FenceValue;
+		Microsoft::WRL::ComPtr<IUnknown> Object;
+		MemoryCategory Category;
+		UINT64 Bytes;
+	};
+
+	UINT64 mBytes[(int)MemoryCategory::Count] = {};
+	std::vector<Pending> mPending;
+};
@@ -0,0 +1,512 @@
+//***************************************************************************************
+// SceneBVH.cpp
+//***************************************************************************************
+
+#include "SceneBVH.h"
+#include <cfloat>
+#include <numeric>
+#include <ppl.h>
+
+using namespace DirectX;
+
+static_assert(SceneBVH::MaxLeafSize <= 4, "Leaves are tested with FrustumCuller::TestBoxes4.");
+
+namespace
+{
+	// Min/max box used while building; cheaper to grow than a center/extents box.
+	struct Aabb
+	{
+		XMFLOAT3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		XMFLOAT3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const XMFLOAT3& p)
+		{
+			Min.x = std::min<float>(Min.x, p.x);
+			Min.y = std::min<float>(Min.y, p.y);
+			Min.z = std::min<float>(Min.z, p.z);
+			Max.x = std::max<float>(Max.x, p.x);
+			Max.y = std::max<float>(Max.y, p.y);
+			Max.z = std::max<float>(Max.z, p.z);
+		}
+
+		void Grow(const BoundingBox& b)
+		{
+			Grow(XMFLOAT3(b.Center.x - b.Extents.x, b.Center.y - b.Extents.y, b.Center.z - b.Extents.z));
+			Grow(XMFLOAT3(b.Center.x + b.Extents.x, b.Center.y + b.Extents.y, b.Center.z + b.Extents.z));
+		}
+
+		void Grow(const Aabb& b)
+		{
+			if(b.Min.x <= b.Max.x)
+			{
+				Grow(b.Min);
+				Grow(b.Max);
+			}
+		}
+
+		// Half the surface area; the factor of two cancels out in SAH comparisons.
+		float HalfArea()const
+		{
+			if(Min.x > Max.x)
+				return 0.0f;
+
+			float dx = Max.x - Min.x;
+			float dy = Max.y - Min.y;
+			float dz = Max.z - Min.z;
+			return dx*dy + dy*dz + dz*dx;
+		}
+
+		BoundingBox ToBox()const
+		{
+			BoundingBox b;
+			b.Center = XMFLOAT3(0.5f*(Min.x + Max.x), 0.5f*(Min.y + Max.y), 0.5f*(Min.z + Max.z));
+			b.Extents = XMFLOAT3(0.5f*(Max.x - Min.x), 0.5f*(Max.y - Min.y), 0.5f*(Max.z - Min.z));
+			return b;
+		}
+	};
+
+	const int BinCount = 16;
+}
+
+void SceneBVH::Build(const std::vector<BoundingBox>& itemBounds)
+{
+	mItemBounds = itemBounds;
+
+	mItemIndices.resize(itemBounds.size());
+	std::iota(mItemIndices.begin(), mItemIndices.end(), 0u);
+
+	mNodes.clear();
+	mNodes.reserve(2 * itemBounds.size());
+
+	if(!itemBounds.empty())
+		BuildRange(0, (UINT)itemBounds.size());
+}
+
+UINT SceneBVH::BuildRange(UINT begin, UINT end)
+{
+	UINT nodeIndex = (UINT)mNodes.size();
+	mNodes.emplace_back();
+
+	Aabb bounds;
+	Aabb centroidBounds;
+	for(UINT i = begin; i < end; ++i)
+	{
+		const BoundingBox& b = mItemBounds[mItemIndices[i]];
+		bounds.Grow(b);
+		centroidBounds.Grow(b.Center);
+	}
+
+	mNodes[nodeIndex].Bounds = bounds.ToBox();
+
+	UINT count = end - begin;
+	if(count <= MaxLeafSize)
+	{
+		mNodes[nodeIndex].Offset = begin;
+		mNodes[nodeIndex].Count = count;
+		return nodeIndex;
+	}
+
+	// Split along the axis where the centroids are spread the most.
+	float extent[3] =
+	{
+		centroidBounds.Max.x - centroidBounds.Min.x,
+		centroidBounds.Max.y - centroidBounds.Min.y,
+		centroidBounds.Max.z - centroidBounds.Min.z
+	};
+
+	int axis = 0;
+	if(extent[1] > extent[axis]) axis = 1;
+	if(extent[2] > extent[axis]) axis = 2;
+
+	// If every centroid coincides there is nothing to bin; split the range in half.
+	UINT mid = begin + count / 2;
+
+	if(extent[axis] > 0.0f)
+	{
+		const float axisMin = (&centroidBounds.Min.x)[axis];
+		const float scale = BinCount / extent[axis];
+
+		auto binOf = [&](UINT item)
+		{
+			int bin = (int)(((&mItemBounds[item].Center.x)[axis] - axisMin) * scale);
+			return std::min<int>(bin, BinCount - 1);
+		};
+
+		Aabb binBounds[BinCount];
+		UINT binCounts[BinCount] = {};
+		for(UINT i = begin; i < end; ++i)
+		{
+			int bin = binOf(mItemIndices[i]);
+			binCounts[bin]++;
+			binBounds[bin].Grow(mItemBounds[mItemIndices[i]]);
+		}
+
+		// Sweep from the right to get the area and count right of every split plane...
+		float rightArea[BinCount - 1];
+		UINT rightCount[BinCount - 1];
+		Aabb acc;
+		UINT n = 0;
+		for(int bin = BinCount - 1; bin > 0; --bin)
+		{
+			acc.Grow(binBounds[bin]);
+			n += binCounts[bin];
+			rightArea[bin - 1] = acc.HalfArea();
+			rightCount[bin - 1] = n;
+		}
+
+		// ...then from the left, picking the plane with the lowest SAH cost.
+		acc = Aabb();
+		n = 0;
+		float bestCost = FLT_MAX;
+		int bestSplit = -1;
+		for(int bin = 0; bin < BinCount - 1; ++bin)
+		{
+			acc.Grow(binBounds[bin]);
+			n += binCounts[bin];
+
+			if(n == 0 || rightCount[bin] == 0)
+				continue;
+
+			float cost = n*acc.HalfArea() + rightCount[bin]*rightArea[bin];
+			if(cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = bin;
+			}
+		}
+
+		if(bestSplit >= 0)
+		{
+			auto it = std::partition(mItemIndices.begin() + begin, mItemIndices.begin() + end,
+				[&](UINT item) { return binOf(item) <= bestSplit; });
+			mid = (UINT)(it - mItemIndices.begin());
+		}
+	}
+
+	// The first child is always the next node, so only the second is recorded.
+	BuildRange(begin, mid);
+	UINT second = BuildRange(mid, end);
+
+	mNodes[nodeIndex].Offset = second;
+	mNodes[nodeIndex].Count = 0;
+
+	return nodeIndex;
+}
+
+void SceneBVH::Refit(const std::vector<BoundingBox>& itemBounds)
+{
+	assert(itemBounds.size() == mItemBounds.size());
+	mItemBounds = itemBounds;
+
+	// Children are always stored after their parent, so a reverse walk
+	// visits every child before the node that contains it.
+	for(int i = (int)mNodes.size() - 1; i >= 0; --i)
+	{
+		Node& node = mNodes[i];
+		if(node.Count > 0)
+		{
+			Aabb bounds;
+			for(UINT k = 0; k < node.Count; ++k)
+				bounds.Grow(mItemBounds[mItemIndices[node.Offset + k]]);
+
+			node.Bounds = bounds.ToBox();
+		}
+		else
+		{
+			BoundingBox::CreateMerged(node.Bounds, mNodes[i + 1].Bounds, mNodes[node.Offset].Bounds);
+		}
+	}
+}
+
+void SceneBVH::AppendSubtree(UINT nodeIndex, std::vector<UINT>& items)const
+{
+	// Builds partition the item indices in place, so a subtree owns one contiguous
+	// range: from its leftmost leaf to the end of its rightmost leaf.
+	UINT first = nodeIndex;
+	while(mNodes[first].Count == 0)
+		first = first + 1;
+
+	UINT last = nodeIndex;
+	while(mNodes[last].Count == 0)
+		last = mNodes[last].Offset;
+
+	UINT begin = mNodes[first].Offset;
+	UINT end = mNodes[last].Offset + mNodes[last].Count;
+	items.insert(items.end(), mItemIndices.begin() + begin, mItemIndices.begin() + end);
+}
+
+UINT SceneBVH::QueryFrustum(const FrustumCuller& frustum, std::vector<UINT>& items)const
+{
+	if(mNodes.empty())
+		return 0;
+
+	UINT visited = 0;
+
+	std::vector<UINT> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while(!stack.empty())
+	{
+		UINT i = stack.back();
+		stack.pop_back();
+		++visited;
+
+		const Node& node = mNodes[i];
+		ContainmentType containment = frustum.Classify(node.Bounds);
+
+		if(containment == DISJOINT)
+			continue;
+
+		if(containment == CONTAINS)
+		{
+			AppendSubtree(i, items);
+			continue;
+		}
+
+		if(node.Count > 0)
+		{
+			const BoundingBox* boxes[4];
+			for(UINT k = 0; k < node.Count; ++k)
+				boxes[k] = &mItemBounds[mItemIndices[node.Offset + k]];
+
+			UINT mask = frustum.TestBoxes4(boxes, node.Count);
+			for(UINT k = 0; k < node.Count; ++k)
+			{
+				if(mask & (1u << k))
+					items.push_back(mItemIndices[node.Offset + k]);
+			}
+		}
+		else
+		{
+			stack.push_back(node.Offset);
+			stack.push_back(i + 1);
+		}
+	}
+
+	return visited;
+}
+
+void SceneBVH::QueryFrustums(const FrustumCuller* const* frustums, UINT viewCount, std::vector<UINT>* items)const
+{
+	assert(viewCount <= MaxQueryViews);
+
+	for(UINT v = 0; v < viewCount; ++v)
+		items[v].clear();
+
+	if(mNodes.empty() || viewCount == 0)
+		return;
+
+	// Expand the top of the tree breadth-first until there are enough subtrees to
+	// keep the workers busy.  Items found on the way go straight to the output.
+	const size_t targetTasks = 16;
+
+	std::vector<ViewWork> tasks;
+	ViewWork root = { 0, viewCount == 32 ? ~0u : (1u << viewCount) - 1 };
+	tasks.push_back(root);
+
+	size_t head = 0;
+	std::vector<ViewWork> children;
+	while(head < tasks.size() && tasks.size() - head < targetTasks)
+	{
+		children.clear();
+		VisitViews(tasks[head++], frustums, items, children);
+		tasks.insert(tasks.end(), children.begin(), children.end());
+	}
+
+	// Each subtree writes to its own lists, one per view, merged in task order below
+	// so the result does not depend on scheduling.
+	const size_t taskCount = tasks.size() - head;
+	std::vector<std::vector<UINT>> taskItems(taskCount * viewCount);
+
+	concurrency::parallel_for(size_t(0), taskCount, [&](size_t t)
+	{
+		std::vector<ViewWork> stack;
+		stack.reserve(64);
+		stack.push_back(tasks[head + t]);
+
+		while(!stack.empty())
+		{
+			ViewWork work = stack.back();
+			stack.pop_back();
+			VisitViews(work, frustums, &taskItems[t * viewCount], stack);
+		}
+	});
+
+	for(size_t t = 0; t < taskCount; ++t)
+	{
+		for(UINT v = 0; v < viewCount; ++v)
+		{
+			const std::vector<UINT>& found = taskItems[t * viewCount + v];
+			items[v].insert(items[v].end(), found.begin(), found.end());
+		}
+	}
+}
+
+void SceneBVH::VisitViews(const ViewWork& work, const FrustumCuller* const* frustums,
+	std::vector<UINT>* items, std::vector<ViewWork>& pending)const
+{
+	const Node& node = mNodes[work.Node];
+
+	UINT straddling = 0;
+	for(UINT v = 0; v < MaxQueryViews; ++v)
+	{
+		if((work.Active & (1u << v)) == 0)
+			continue;
+
+		ContainmentType containment = frustums[v]->Classify(node.Bounds);
+		if(containment == CONTAINS)
+			AppendSubtree(work.Node, items[v]);
+		else if(containment == INTERSECTS)
+			straddling |= 1u << v;
+	}
+
+	if(straddling == 0)
+		return;
+
+	if(node.Count > 0)
+	{
+		const BoundingBox* boxes[4];
+		for(UINT k = 0; k < node.Count; ++k)
+			boxes[k] = &mItemBounds[mItemIndices[node.Offset + k]];
+
+		for(UINT v = 0; v < MaxQueryViews; ++v)
+		{
+			if((straddling & (1u << v)) == 0)
+				continue;
+
+			UINT mask = frustums[v]->TestBoxes4(boxes, node.Count);
+			for(UINT k = 0; k < node.Count; ++k)
+			{
+				if(mask & (1u << k))
+					items[v].push_back(mItemIndices[node.Offset + k]);
+			}
+		}
+	}
+	else
+	{
+		ViewWork second = { node.Offset, straddling };
+		ViewWork first = { work.Node + 1, straddling };
+		pending.push_back(second);
+		pending.push_back(first);
+	}
+}
+
+UINT SceneBVH::QuerySphere(const BoundingSphere& sphere, std::vector<UINT>& items)const
+{
+	if(mNodes.empty())
+		return 0;
+
+	UINT visited = 0;
+
+	std::vector<UINT> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while(!stack.empty())
+	{
+		UINT i = stack.back();
+		stack.pop_back();
+		++visited;
+
+		const Node& node = mNodes[i];
+		ContainmentType containment = sphere.Contains(node.Bounds);
+
+		if(containment == DISJOINT)
+			continue;
+
+		if(containment == CONTAINS)
+		{
+			AppendSubtree(i, items);
+			continue;
+		}
+
+		if(node.Count > 0)
+		{
+			for(UINT k = 0; k < node.Count; ++k)
+			{
+				UINT item = mItemIndices[node.Offset + k];
+				if(sphere.Intersects(mItemBounds[item]))
+					items.push_back(item);
+			}
+		}
+		else
+		{
+			stack.push_back(node.Offset);
+			stack.push_back(i + 1);
+		}
+	}
+
+	return visited;
+}
+
+bool SceneBVH::Raycast(FXMVECTOR origin, FXMVECTOR dir, UINT& item, float& dist)const
+{
+	if(mNodes.empty())
+		return false;
+
+	bool hit = false;
+	float nearest = FLT_MAX;
+
+	std::vector<UINT> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while(!stack.empty())
+	{
+		UINT i = stack.back();
+		stack.pop_back();
+
+		// Skip nodes that are missed, or that start beyond the nearest hit so far.
+		const Node& node = mNodes[i];
+		float entry = 0.0f;
+		if(!node.Bounds.Intersects(origin, dir, entry) || entry >= nearest)
+			continue;
+
+		if(node.Count > 0)
+		{
+			for(UINT k = 0; k < node.Count; ++k)
+			{
+				UINT candidate = mItemIndices[node.Offset + k];
+
+				// The entry distance is negative when origin is inside the box; the ray
+				// starts there, so the box is hit at 0.
+				float t = 0.0f;
+				if(!mItemBounds[candidate].Intersects(origin, dir, t))
+					continue;
+
+				t = std::max<float>(t, 0.0f);
+				if(t < nearest)
+				{
+					nearest = t;
+					item = candidate;
+					hit = true;
+				}
+			}
+		}
+		else
+		{
+			// Visit the nearer child first so the far one is more likely to be rejected.
+			float firstDist = FLT_MAX;
+			float secondDist = FLT_MAX;
+			mNodes[i + 1].Bounds.Intersects(origin, dir, firstDist);
+			mNodes[node.Offset].Bounds.Intersects(origin, dir, secondDist);
+
+			if(firstDist <= secondDist)
+			{
+				stack.push_back(node.Offset);
+				stack.push_back(i + 1);
+			}
+			else
+			{
+				stack.push_back(i + 1);
+				stack.push_back(node.Offset);
+			}
+		}
+	}
+
+	if(hit)
+		dist = nearest;
+
+	return hit;
+}
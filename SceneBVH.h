@@ -0,0 +1,76 @@
+//***************************************************************************************
+// SceneBVH.h
+//
+// Bounding volume hierarchy over the world space boxes of render items.  Built with a
+// binned surface area heuristic and flattened depth-first into one node array, so a
+// node's first child is always the next node and only the second child is stored.
+// Items are referred to by their index in the array of boxes the tree was built from.
+//***************************************************************************************
+
+#pragma once
+
+#include "FrustumCuller.h"
+
+class SceneBVH
+{
+public:
+	struct Node
+	{
+		DirectX::BoundingBox Bounds;
+
+		// Leaf: first entry in the item index array.  Interior: index of the second child.
+		UINT Offset = 0;
+
+		// Number of items in a leaf; 0 marks an interior node.
+		UINT Count = 0;
+	};
+
+	static const UINT MaxLeafSize = 4;
+
+	// Builds the tree from scratch over itemBounds.
+	void Build(const std::vector<DirectX::BoundingBox>& itemBounds);
+
+	// Recomputes the node boxes bottom-up after items moved, keeping the topology.
+	// Cheaper than Build, but the tree degrades if items move far from where they were.
+	void Refit(const std::vector<DirectX::BoundingBox>& itemBounds);
+
+	// Appends the items whose boxes intersect the frustum.  Returns the number of
+	// nodes visited, which is what grows logarithmically with the item count.
+	UINT QueryFrustum(const FrustumCuller& frustum, std::vector<UINT>& items)const;
+
+	static const UINT MaxQueryViews = 32;
+
+	// Culls several views in one traversal.  Each node box is tested only against
+	// the views that still straddle it, and views that fully contain a node take its
+	// subtree untested.  The top of the tree is split into subtrees that are walked
+	// in parallel.  items[v] is cleared and refilled with what frustums[v] sees.
+	void QueryFrustums(const FrustumCuller* const* frustums, UINT viewCount, std::vector<UINT>* items)const;
+
+	// Appends the items whose boxes intersect the sphere.  Returns the number of nodes
+	// visited.
+	UINT QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<UINT>& items)const;
+
+	// Finds the nearest item box hit by the ray.  dir must be normalized.  A box that
+	// contains origin is hit at dist 0, so the item the camera is inside is picked.
+	bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, UINT& item, float& dist)const;
+
+	UINT NodeCount()const { return (UINT)mNodes.size(); }
+	UINT ItemCount()const { return (UINT)mItemBounds.size(); }
+
+private:
+	// A node still to be tested against the views whose bits are set in Active.
+	struct ViewWork
+	{
+		UINT Node;
+		UINT Active;
+	};
+
+	UINT BuildRange(UINT begin, UINT end);
+	void VisitViews(const ViewWork& work, const FrustumCuller* const* frustums,
+		std::vector<UINT>* items, std::vector<ViewWork>& pending)const;
+	void AppendSubtree(UINT nodeIndex, std::vector<UINT>& items)const;
+
+	std::vector<Node> mNodes;
+	std::vector<UINT> mItemIndices;
+	std::vector<DirectX::BoundingBox> mItemBounds;
+};
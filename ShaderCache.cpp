@@ -0,0 +1,270 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include <chrono>
+#include <iterator>
+#include <ppl.h>
+#include <unordered_map>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Bump when the blob layout or the key recipe changes, to orphan old blobs.
+	const UINT CacheFormatVersion = 1;
+
+	const uint64_t FnvPrime = 1099511628211ull;
+
+	uint64_t HashString(const std::string& s, uint64_t hash)
+	{
+		// The terminator separates neighbouring fields, so "ab"+"c" differs from "a"+"bc".
+		return ShaderCache::Fnv1a(s.c_str(), s.size() + 1, hash);
+	}
+
+	std::string ReadFile(const std::wstring& filename)
+	{
+		std::ifstream fin(filename, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+	}
+
+	// Names in the #include "..." lines of source, in order.  Angle bracket includes
+	// are skipped; the standard include handler only resolves quoted ones relative to
+	// the file.
+	std::vector<std::string> FindIncludes(const std::string& source)
+	{
+		std::vector<std::string> includes;
+
+		std::istringstream lines(source);
+		std::string line;
+		while(std::getline(lines, line))
+		{
+			size_t pos = line.find_first_not_of(" \t");
+			if(pos == std::string::npos || line.compare(pos, 8, "#include") != 0)
+				continue;
+
+			size_t open = line.find('"', pos + 8);
+			size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+			if(close != std::string::npos)
+				includes.push_back(line.substr(open + 1, close - open - 1));
+		}
+
+		return includes;
+	}
+}
+
+ShaderCache::ShaderCache(const std::wstring& cacheDir, CompileFn compile) :
+	mCacheDir(cacheDir),
+	mCompile(std::move(compile))
+{
+	if(!mCacheDir.empty() && mCacheDir.back() != L'\\' && mCacheDir.back() != L'/')
+		mCacheDir += L'\\';
+}
+
+void ShaderCache::Add(const std::string& name, const std::wstring& file, const D3D_SHADER_MACRO* defines,
+	const std::string& entryPoint, const std::string& target)
+{
+	ShaderPermutation permutation;
+	permutation.Name = name;
+	permutation.File = file;
+	permutation.EntryPoint = entryPoint;
+	permutation.Target = target;
+
+	for(const D3D_SHADER_MACRO* d = defines; d != nullptr && d->Name != nullptr; ++d)
+		permutation.Defines.push_back(std::make_pair(std::string(d->Name), std::string(d->Definition ? d->Definition : "")));
+
+	mPermutations.push_back(std::move(permutation));
+}
+
+void ShaderCache::Build()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	// Keys first, serially: permutations share source files and the hashes are memoized.
+	const UINT flags = CompileFlags();
+	for(ShaderPermutation& permutation : mPermutations)
+		permutation.Key = ComputeKey(HashSourceTree(permutation.File), permutation, flags);
+
+	if(!mCacheDir.empty())
+		CreateDirectoryW(mCacheDir.c_str(), nullptr);
+
+	// Permutations registered twice under different names share a key.  Only the
+	// first of each key is loaded or compiled, so no two workers write the same blob.
+	std::vector<size_t> firstWithKey(mPermutations.size());
+	std::vector<size_t> unique;
+	std::unordered_map<uint64_t, size_t> keyIndex;
+	for(size_t i = 0; i < mPermutations.size(); ++i)
+	{
+		auto inserted = keyIndex.emplace(mPermutations[i].Key, i);
+		firstWithKey[i] = inserted.first->second;
+		if(inserted.second)
+			unique.push_back(i);
+	}
+
+	// Loading and compiling are independent per permutation, so hits are read and
+	// misses compiled at the same time.
+	std::vector<char> hit(mPermutations.size(), 0);
+	mBlobs.assign(mPermutations.size(), nullptr);
+	concurrency::parallel_for(size_t(0), unique.size(), [&](size_t u)
+	{
+		size_t i = unique[u];
+		const ShaderPermutation& permutation = mPermutations[i];
+		if(LoadBlob(permutation.Key, mBlobs[i]))
+		{
+			hit[i] = 1;
+			return;
+		}
+
+		mBlobs[i] = mCompile(permutation);
+		StoreBlob(permutation.Key, mBlobs[i].Get());
+	});
+
+	UINT hits = 0;
+	for(size_t i = 0; i < mPermutations.size(); ++i)
+	{
+		mBlobs[i] = mBlobs[firstWithKey[i]];
+		hits += hit[firstWithKey[i]];
+	}
+
+	mHits = hits;
+	mMisses = (UINT)mPermutations.size() - mHits;
+	mBuildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+ComPtr<ID3DBlob> ShaderCache::Get(const std::string& name)const
+{
+	for(size_t i = 0; i < mPermutations.size() && i < mBlobs.size(); ++i)
+	{
+		if(mPermutations[i].Name == name)
+			return mBlobs[i];
+	}
+
+	return nullptr;
+}
+
+void ShaderCache::Export(NameTable<ComPtr<ID3DBlob>, ShaderTag>& shaders)const
+{
+	for(size_t i = 0; i < mPermutations.size() && i < mBlobs.size(); ++i)
+		shaders.Add(mPermutations[i].Name, mBlobs[i]);
+}
+
+uint64_t ShaderCache::HashSourceTree(const std::wstring& file)
+{
+	auto it = mSourceHashes.find(file);
+	if(it != mSourceHashes.end())
+		return it->second;
+
+	// Placeholder so an include cycle ends here instead of recursing forever.
+	mSourceHashes[file] = 0;
+
+	std::string source = ReadFile(file);
+	uint64_t hash = Fnv1a(source.data(), source.size());
+
+	std::wstring dir = file.substr(0, file.find_last_of(L"\\/") + 1);
+	for(const std::string& include : FindIncludes(source))
+	{
+		uint64_t includeHash = HashSourceTree(dir + AnsiToWString(include));
+		hash = HashString(include, hash);
+		hash = Fnv1a(&includeHash, sizeof(includeHash), hash);
+	}
+
+	mSourceHashes[file] = hash;
+	return hash;
+}
+
+std::wstring ShaderCache::BlobPath(uint64_t key)const
+{
+	wchar_t name[32];
+	swprintf_s(name, L"%016llx.cso", (unsigned long long)key);
+	return mCacheDir + name;
+}
+
+uint64_t ShaderCache::ComputeKey(uint64_t sourceHash, const ShaderPermutation& permutation, UINT compileFlags)
+{
+	const UINT versions[2] = { CacheFormatVersion, D3D_COMPILER_VERSION };
+
+	uint64_t hash = Fnv1a(versions, sizeof(versions));
+	hash = Fnv1a(&sourceHash, sizeof(sourceHash), hash);
+	hash = Fnv1a(&compileFlags, sizeof(compileFlags), hash);
+	hash = HashString(permutation.EntryPoint, hash);
+	hash = HashString(permutation.Target, hash);
+
+	// Define order matters to the preprocessor when a name repeats, so it is kept.
+	for(const auto& define : permutation.Defines)
+	{
+		hash = HashString(define.first, hash);
+		hash = HashString(define.second, hash);
+	}
+
+	return hash;
+}
+
+uint64_t ShaderCache::Fnv1a(const void* data, size_t size, uint64_t hash)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= FnvPrime;
+	}
+
+	return hash;
+}
+
+UINT ShaderCache::CompileFlags()
+{
+	UINT compileFlags = 0;
+#if defined(DEBUG) || defined(_DEBUG)
+	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+	return compileFlags;
+}
+
+ComPtr<ID3DBlob> ShaderCache::CompileFromFile(const ShaderPermutation& permutation)
+{
+	std::vector<D3D_SHADER_MACRO> defines;
+	for(const auto& define : permutation.Defines)
+		defines.push_back({ define.first.c_str(), define.second.c_str() });
+	defines.push_back({ nullptr, nullptr });
+
+	return d3dUtil::CompileShader(permutation.File, defines.data(), permutation.EntryPoint, permutation.Target);
+}
+
+bool ShaderCache::LoadBlob(uint64_t key, ComPtr<ID3DBlob>& blob)const
+{
+	if(mCacheDir.empty())
+		return false;
+
+	// LoadBinary expects the file to be there, so look before reading.
+	std::wstring path = BlobPath(key);
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if(!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &info) ||
+	   (info.nFileSizeHigh == 0 && info.nFileSizeLow == 0))
+		return false;
+
+	blob = d3dUtil::LoadBinary(path);
+	return blob != nullptr;
+}
+
+void ShaderCache::StoreBlob(uint64_t key, ID3DBlob* blob)const
+{
+	if(mCacheDir.empty() || blob == nullptr)
+		return;
+
+	// Written aside and renamed into place, so a crash mid-write never leaves a
+	// truncated blob under a valid key.  The temporary name is unique to the process
+	// and thread, as another instance of the app may share the cache directory.
+	std::wstring path = BlobPath(key);
+	std::wstring tempPath = path + L"." + std::to_wstring(GetCurrentProcessId()) + L"." +
+		std::to_wstring(GetCurrentThreadId()) + L".tmp";
+	{
+		std::ofstream fout(tempPath, std::ios::binary);
+		fout.write((const char*)blob->GetBufferPointer(), blob->GetBufferSize());
+		if(!fout)
+			return;
+	}
+
+	MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+}
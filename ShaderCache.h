@@ -0,0 +1,90 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Compiles each shader permutation once and keeps its bytecode on disk.  A permutation
+// is named by a 64-bit FNV-1a key over its source file, every file that file includes,
+// its defines, entry point, target and compile flags, so changing any of them gives a
+// new key and stale bytecode is never picked up.  Blobs are stored as <key>.cso in the
+// cache directory.
+//
+// Build resolves all permutations in parallel: hits are read with d3dUtil::LoadBinary,
+// misses are compiled and written back.  The compiler is passed in, which lets the key
+// and cache logic run without it (see HeadlessBench -benchshaders).
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/d3dUtil.h"
+#include <functional>
+
+struct ShaderPermutation
+{
+	std::string Name;
+	std::wstring File;
+	std::vector<std::pair<std::string, std::string>> Defines;
+	std::string EntryPoint;
+	std::string Target;
+
+	// Filled in by ShaderCache::Build.
+	uint64_t Key = 0;
+};
+
+class ShaderCache
+{
+public:
+	typedef std::function<Microsoft::WRL::ComPtr<ID3DBlob>(const ShaderPermutation&)> CompileFn;
+
+	static const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+
+	// An empty cacheDir turns the disk cache off, so every permutation is compiled.
+	explicit ShaderCache(const std::wstring& cacheDir, CompileFn compile = CompileFromFile);
+	ShaderCache(const ShaderCache& rhs) = delete;
+	ShaderCache& operator=(const ShaderCache& rhs) = delete;
+
+	// defines is a null terminated array, as for d3dUtil::CompileShader, or nullptr.
+	void Add(const std::string& name, const std::wstring& file, const D3D_SHADER_MACRO* defines,
+		const std::string& entryPoint, const std::string& target);
+
+	// Loads or compiles every permutation added so far.
+	void Build();
+
+	Microsoft::WRL::ComPtr<ID3DBlob> Get(const std::string& name)const;
+
+	// Adds every built blob to shaders under its name.
+	void Export(NameTable<Microsoft::WRL::ComPtr<ID3DBlob>, ShaderTag>& shaders)const;
+
+	const std::vector<ShaderPermutation>& GetPermutations()const { return mPermutations; }
+	UINT HitCount()const { return mHits; }
+	UINT MissCount()const { return mMisses; }
+	double BuildMs()const { return mBuildMs; }
+
+	// Hash of a file and, recursively, of the files it includes with #include "...".
+	// Paths are taken relative to the including file, as the standard include handler
+	// does.  Results are memoized for the lifetime of the cache.
+	uint64_t HashSourceTree(const std::wstring& file);
+
+	std::wstring BlobPath(uint64_t key)const;
+
+	static uint64_t ComputeKey(uint64_t sourceHash, const ShaderPermutation& permutation, UINT compileFlags);
+	static uint64_t Fnv1a(const void* data, size_t size, uint64_t hash = FnvOffsetBasis);
+
+	// Flags d3dUtil::CompileShader compiles with in this build.
+	static UINT CompileFlags();
+
+	static Microsoft::WRL::ComPtr<ID3DBlob> CompileFromFile(const ShaderPermutation& permutation);
+
+private:
+	bool LoadBlob(uint64_t key, Microsoft::WRL::ComPtr<ID3DBlob>& blob)const;
+	void StoreBlob(uint64_t key, ID3DBlob* blob)const;
+
+	std::wstring mCacheDir;
+	CompileFn mCompile;
+
+	std::vector<ShaderPermutation> mPermutations;
+	std::vector<Microsoft::WRL::ComPtr<ID3DBlob>> mBlobs;
+	std::unordered_map<std::wstring, uint64_t> mSourceHashes;
+
+	UINT mHits = 0;
+	UINT mMisses = 0;
+	double mBuildMs = 0.0;
+};
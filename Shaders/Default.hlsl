@@ -4,23 +4,44 @@
 // Default shader, currently supports lighting.
 //***************************************************************************************
 
-// Defaults for number of lights.
+// Defaults for number of lights.  Point and spot lights are not in cbPass; they
+// are read per cluster from gLocalLights instead.
 #ifndef NUM_DIR_LIGHTS
     #define NUM_DIR_LIGHTS 3
 #endif
 
 #ifndef NUM_POINT_LIGHTS
-    #define NUM_POINT_LIGHTS 2
+    #define NUM_POINT_LIGHTS 0
 #endif
 
 #ifndef NUM_SPOT_LIGHTS
-    #define NUM_SPOT_LIGHTS 3
+    #define NUM_SPOT_LIGHTS 0
+#endif
+
+// Cluster grid; the app passes LightClusterer's sizes.
+#ifndef CLUSTER_X
+    #define CLUSTER_X 16
+#endif
+
+#ifndef CLUSTER_Y
+    #define CLUSTER_Y 9
+#endif
+
+#ifndef CLUSTER_Z
+    #define CLUSTER_Z 24
 #endif
 
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
-Texture2D    gDiffuseMap : register(t0);
+// Every texture, bound once as one table; the app passes its size.  A material picks
+// its texture by DiffuseMapIndex, and the slice by DiffuseSlice when several textures
+// were packed into one array.
+#ifndef TEXTURE_SLOTS
+    #define TEXTURE_SLOTS 32
+#endif
+
+Texture2DArray gTextureMaps[TEXTURE_SLOTS] : register(t0);
 
 
 SamplerState gsamPointWrap        : register(s0);
@@ -30,13 +51,22 @@ SamplerState gsamLinearClamp      : register(s3);
 SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
+// Per-instance data, indexed with SV_InstanceID.  The root SRV is offset to the
+// first instance of each draw.
+struct InstanceData
 {
-    float4x4 gWorld;
-	float4x4 gTexTransform;
+    float4x4 World;
+	float4x4 TexTransform;
 };
 
+StructuredBuffer<InstanceData> gInstanceData : register(t0, space1);
+
+// Point and spot lights (SpotPower 0 marks a point light), and for every cluster of
+// this pass the offset and count of its entries in gClusterLightIndices.
+StructuredBuffer<Light> gLocalLights : register(t1, space1);
+StructuredBuffer<uint2> gClusterRanges : register(t2, space1);
+StructuredBuffer<uint> gClusterLightIndices : register(t3, space1);
+
 // Constant data that varies per material.
 cbuffer cbPass : register(b1)
 {
@@ -68,12 +98,25 @@ cbuffer cbPass : register(b1)
     Light gLights[MaxLights];
 };
 
-cbuffer cbMaterial : register(b2)
+struct MaterialData
+{
+	float4   DiffuseAlbedo;
+	float3   FresnelR0;
+	float    Roughness;
+	float4x4 MatTransform;
+	uint     DiffuseMapIndex;
+	uint     DiffuseSlice;
+	uint     MatPad0;
+	uint     MatPad1;
+};
+
+// Every material, indexed by the draw's gMaterialIndex.
+StructuredBuffer<MaterialData> gMaterialData : register(t4, space1);
+
+// Set per draw as a root constant.
+cbuffer cbDraw : register(b2)
 {
-	float4   gDiffuseAlbedo;
-    float3   gFresnelR0;
-    float    gRoughness;
-	float4x4 gMatTransform;
+	uint gMaterialIndex;
 };
 
 struct VertexIn
@@ -91,30 +134,53 @@ struct VertexOut
 	float2 TexC    : TEXCOORD;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
+
+	InstanceData instData = gInstanceData[instanceID];
+	float4x4 world = instData.World;
+	float4x4 texTransform = instData.TexTransform;
 	
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(vin.PosL, 1.0f), world);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(vin.NormalL, (float3x3)world);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
 	
 	// Output vertex attributes for interpolation across triangle.
-	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
-	vout.TexC = mul(texC, gMatTransform).xy;
+	MaterialData matData = gMaterialData[gMaterialIndex];
+	float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), texTransform);
+	vout.TexC = mul(texC, matData.MatTransform).xy;
 
     return vout;
 }
 
+// Finds the cluster of a world space point the way LightClusterer::FindCluster does.
+uint FindCluster(float3 posW)
+{
+    float4 posV = mul(float4(posW, 1.0f), gView);
+    float4 posH = mul(posV, gProj);
+    float2 ndc = clamp(posH.xy / posH.w, -1.0f, 1.0f);
+
+    uint x = min((uint)((ndc.x*0.5f + 0.5f) * CLUSTER_X), CLUSTER_X - 1);
+    uint y = min((uint)((ndc.y*0.5f + 0.5f) * CLUSTER_Y), CLUSTER_Y - 1);
+
+    float slice = floor(log(posV.z / gNearZ) / log(gFarZ / gNearZ) * CLUSTER_Z);
+    uint z = (uint)clamp(slice, 0.0f, CLUSTER_Z - 1);
+
+    return (z*CLUSTER_Y + y)*CLUSTER_X + x;
+}
+
 float4 PS(VertexOut pin) : SV_Target
 {
-    float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
+	MaterialData matData = gMaterialData[gMaterialIndex];
+	float3 uvw = float3(pin.TexC, matData.DiffuseSlice);
+    float4 diffuseAlbedo = gTextureMaps[matData.DiffuseMapIndex].Sample(gsamAnisotropicWrap, uvw) * matData.DiffuseAlbedo;
 	
 #ifdef ALPHA_TEST
 	// Discard pixel if texture alpha < 0.1.  We do this test as soon 
@@ -134,12 +200,20 @@ float4 PS(VertexOut pin) : SV_Target
     // Light terms.
     float4 ambient = gAmbientLight*diffuseAlbedo;
 
-    const float shininess = 1.0f - gRoughness;
-    Material mat = { diffuseAlbedo, gFresnelR0, shininess };
+    const float shininess = 1.0f - matData.Roughness;
+    Material mat = { diffuseAlbedo, matData.FresnelR0, shininess };
     float3 shadowFactor = 1.0f;
     float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
         pin.NormalW, toEyeW, shadowFactor);
 
+    // Only the lights binned into this pixel's cluster can reach it.
+    uint2 range = gClusterRanges[FindCluster(pin.PosW)];
+    for(uint i = 0; i < range.y; ++i)
+    {
+        Light L = gLocalLights[gClusterLightIndices[range.x + i]];
+        directLight.rgb += ComputeLocalLight(L, mat, pin.PosW, pin.NormalW, toEyeW);
+    }
+
     float4 litColor = ambient + directLight;
 
 #ifdef FOG
@@ -135,6 +135,17 @@ float3 ComputeSpotLight(Light L, Material mat, float3 pos, float3 normal, float3
     return BlinnPhong(lightStrength, lightVec, normal, toEye, mat);
 }
 
+//---------------------------------------------------------------------------------------
+// Evaluates a clustered light, which is a spot light unless its SpotPower is 0.
+//---------------------------------------------------------------------------------------
+float3 ComputeLocalLight(Light L, Material mat, float3 pos, float3 normal, float3 toEye)
+{
+    if(L.SpotPower > 0.0f)
+        return ComputeSpotLight(L, mat, pos, normal, toEye);
+
+    return ComputePointLight(L, mat, pos, normal, toEye);
+}
+
 float4 ComputeLighting(Light gLights[MaxLights], Material mat,
                        float3 pos, float3 normal, float3 toEye,
                        float3 shadowFactor)
@@ -18,7 +18,14 @@
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
-Texture2DArray gTreeMapArray : register(t0);
+// Every texture, bound once as one table; the app passes its size.  A material picks
+// its texture by DiffuseMapIndex, and the slice by DiffuseSlice when several textures
+// were packed into one array.
+#ifndef TEXTURE_SLOTS
+    #define TEXTURE_SLOTS 32
+#endif
+
+Texture2DArray gTextureMaps[TEXTURE_SLOTS] : register(t0);
 
 
 SamplerState gsamPointWrap        : register(s0);
@@ -28,13 +35,6 @@ SamplerState gsamLinearClamp      : register(s3);
 SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
-{
-    float4x4 gWorld;
-	float4x4 gTexTransform;
-};
-
 // Constant data that varies per material.
 cbuffer cbPass : register(b1)
 {
@@ -66,12 +66,25 @@ cbuffer cbPass : register(b1)
     Light gLights[MaxLights];
 };
 
-cbuffer cbMaterial : register(b2)
+struct MaterialData
+{
+	float4   DiffuseAlbedo;
+	float3   FresnelR0;
+	float    Roughness;
+	float4x4 MatTransform;
+	uint     DiffuseMapIndex;
+	uint     DiffuseSlice;
+	uint     MatPad0;
+	uint     MatPad1;
+};
+
+// Every material, indexed by the draw's gMaterialIndex.
+StructuredBuffer<MaterialData> gMaterialData : register(t4, space1);
+
+// Set per draw as a root constant.
+cbuffer cbDraw : register(b2)
 {
-	float4   gDiffuseAlbedo;
-    float3   gFresnelR0;
-    float    gRoughness;
-	float4x4 gMatTransform;
+	uint gMaterialIndex;
 };
  
 struct VertexIn
@@ -165,8 +178,9 @@ void GS(point VertexOut gin[1],
 
 float4 PS(GeoOut pin) : SV_Target
 {
+	MaterialData matData = gMaterialData[gMaterialIndex];
 	float3 uvw = float3(pin.TexC, pin.PrimID%3);
-    float4 diffuseAlbedo = gTreeMapArray.Sample(gsamAnisotropicWrap, uvw) * gDiffuseAlbedo;
+    float4 diffuseAlbedo = gTextureMaps[matData.DiffuseMapIndex].Sample(gsamAnisotropicWrap, uvw) * matData.DiffuseAlbedo;
 	
 #ifdef ALPHA_TEST
 	// Discard pixel if texture alpha < 0.1.  We do this test as soon 
@@ -186,8 +200,8 @@ float4 PS(GeoOut pin) : SV_Target
     // Light terms.
     float4 ambient = gAmbientLight*diffuseAlbedo;
 
-    const float shininess = 1.0f - gRoughness;
-    Material mat = { diffuseAlbedo, gFresnelR0, shininess };
+    const float shininess = 1.0f - matData.Roughness;
+    Material mat = { diffuseAlbedo, matData.FresnelR0, shininess };
     float3 shadowFactor = 1.0f;
     float4 directLight = ComputeLighting(gLights, mat, pin.PosW,
         pin.NormalW, toEyeW, shadowFactor);
@@ -0,0 +1,115 @@
+//***************************************************************************************
+// TaskGraph.cpp
+//***************************************************************************************
+
+#include "TaskGraph.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <ppl.h>
+
+TaskGraph::TaskId TaskGraph::Add(const std::string& name, std::function<void()> fn, std::initializer_list<TaskId> deps)
+{
+	TaskId id = (TaskId)mTasks.size();
+
+	Task task;
+	task.Name = name;
+	task.Fn = std::move(fn);
+	for(TaskId dep : deps)
+	{
+		assert(dep >= 0 && dep < id && "Tasks can only depend on tasks added before them.");
+		task.Deps.push_back(dep);
+		mTasks[dep].Dependents.push_back(id);
+	}
+
+	mTasks.push_back(std::move(task));
+	return id;
+}
+
+void TaskGraph::Run()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const Clock::time_point start = Clock::now();
+	auto nowMs = [start]() { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	// Dependencies still outstanding per task; a task is launched when its count drops to 0.
+	std::unique_ptr<std::atomic<int>[]> pending(new std::atomic<int>[mTasks.size()]);
+	for(size_t i = 0; i < mTasks.size(); ++i)
+		pending[i] = (int)mTasks[i].Deps.size();
+
+	concurrency::task_group group;
+
+	std::function<void(TaskId)> launch = [&](TaskId id)
+	{
+		group.run([&, id]()
+		{
+			Task& task = mTasks[id];
+			task.StartMs = nowMs();
+			task.Fn();
+			task.EndMs = nowMs();
+
+			for(TaskId dependent : task.Dependents)
+			{
+				if(--pending[dependent] == 0)
+					launch(dependent);
+			}
+		});
+	};
+
+	for(size_t i = 0; i < mTasks.size(); ++i)
+	{
+		if(mTasks[i].Deps.empty())
+			launch((TaskId)i);
+	}
+
+	group.wait();
+	mWallMs = nowMs();
+}
+
+double TaskGraph::SerialMs()const
+{
+	double total = 0.0;
+	for(TaskId i = 0; i < (TaskId)mTasks.size(); ++i)
+		total += GetDurationMs(i);
+
+	return total;
+}
+
+double TaskGraph::CriticalPathMs(std::vector<TaskId>* path)const
+{
+	if(mTasks.empty())
+		return 0.0;
+
+	// Tasks are stored in dependency order, so one forward pass finds the longest
+	// chain ending at every task.
+	std::vector<double> finish(mTasks.size(), 0.0);
+	std::vector<TaskId> previous(mTasks.size(), -1);
+
+	TaskId last = 0;
+	for(TaskId i = 0; i < (TaskId)mTasks.size(); ++i)
+	{
+		double begin = 0.0;
+		for(TaskId dep : mTasks[i].Deps)
+		{
+			if(finish[dep] > begin)
+			{
+				begin = finish[dep];
+				previous[i] = dep;
+			}
+		}
+
+		finish[i] = begin + GetDurationMs(i);
+		if(finish[i] > finish[last])
+			last = i;
+	}
+
+	if(path != nullptr)
+	{
+		path->clear();
+		for(TaskId i = last; i != -1; i = previous[i])
+			path->push_back(i);
+		std::reverse(path->begin(), path->end());
+	}
+
+	return finish[last];
+}
@@ -0,0 +1,58 @@
+//***************************************************************************************
+// TaskGraph.h
+//
+// A small graph of tasks with explicit dependencies, run on the ppl scheduler.  A task
+// starts as soon as every task it depends on has finished, so independent stages of a
+// frame run side by side.  Each run records how long every task took, from which the
+// critical path (the chain of dependent tasks that bounds the run time) is derived.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TaskGraph
+{
+public:
+	typedef int TaskId;
+
+	// Adds a task that may only start once every task in deps has finished.  Tasks
+	// can only depend on tasks added before them, which keeps the graph acyclic.
+	TaskId Add(const std::string& name, std::function<void()> fn, std::initializer_list<TaskId> deps = {});
+
+	// Runs every task once and returns when all have finished.  An exception thrown
+	// by a task is rethrown here after the others have stopped.
+	void Run();
+
+	size_t TaskCount()const { return mTasks.size(); }
+	const std::string& GetName(TaskId id)const { return mTasks[id].Name; }
+
+	// Timings of the last run, in milliseconds.
+	double GetDurationMs(TaskId id)const { return mTasks[id].EndMs - mTasks[id].StartMs; }
+	double WallMs()const { return mWallMs; }
+
+	// Sum of all task durations: the time the run would take on one thread.
+	double SerialMs()const;
+
+	// Length of the longest chain of dependent tasks, and the tasks on it in order.
+	double CriticalPathMs(std::vector<TaskId>* path = nullptr)const;
+
+private:
+	struct Task
+	{
+		std::string Name;
+		std::function<void()> Fn;
+		std::vector<TaskId> Deps;
+		std::vector<TaskId> Dependents;
+
+		double StartMs = 0.0;
+		double EndMs = 0.0;
+	};
+
+	std::vector<Task> mTasks;
+	double mWallMs = 0.0;
+};
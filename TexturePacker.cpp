@@ -0,0 +1,258 @@
+//***************************************************************************************
+// TexturePacker.cpp
+//***************************************************************************************
+
+#include "TexturePacker.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	// Header flags PackArray writes.  See DDS.h in the 'Texconv' sample.
+	const uint32_t DDSD_CAPS = 0x1;
+	const uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+	uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Bytes of one array slice: every mip, most detailed first.
+	size_t SliceBytes(const DDS::Image& image)
+	{
+		size_t bytes = 0;
+		for(size_t m = 0; m < image.MipCount; ++m)
+		{
+			size_t numBytes = 0;
+			DDS::GetSurfaceInfo(std::max<size_t>(image.Width >> m, 1), std::max<size_t>(image.Height >> m, 1),
+				image.Format, &numBytes, nullptr, nullptr);
+			bytes += numBytes;
+		}
+		return bytes;
+	}
+
+	bool CanBeSlice(const DDS::Image& image)
+	{
+		return image.Dimension == DDS::DimensionTexture2D && image.ArraySize == 1 && !image.IsCubeMap;
+	}
+
+	bool SameLayout(const DDS::Image& a, const DDS::Image& b)
+	{
+		return a.Format == b.Format && a.Width == b.Width && a.Height == b.Height && a.MipCount == b.MipCount;
+	}
+}
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height, uint32_t alignment, uint32_t padding) :
+	mWidth(width),
+	mHeight(height),
+	mAlignment(std::max<uint32_t>(alignment, 1)),
+	mPadding(padding)
+{
+	Reset();
+}
+
+void SkylinePacker::Reset()
+{
+	mSkyline.clear();
+	mSkyline.push_back({ 0, 0, mWidth });
+	mUsedArea = 0;
+}
+
+bool SkylinePacker::Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+{
+	if(width == 0 || height == 0)
+		return false;
+
+	uint32_t paddedWidth = AlignUp(width + mPadding, mAlignment);
+	uint32_t paddedHeight = AlignUp(height + mPadding, mAlignment);
+
+	size_t best = mSkyline.size();
+	uint32_t bestY = 0;
+	for(size_t i = 0; i < mSkyline.size(); ++i)
+	{
+		uint32_t top = 0;
+		if(!Fit(i, paddedWidth, paddedHeight, top))
+			continue;
+
+		// Segments run left to right, so the first of equal height is the leftmost.
+		if(best == mSkyline.size() || top < bestY)
+		{
+			best = i;
+			bestY = top;
+		}
+	}
+
+	if(best == mSkyline.size())
+		return false;
+
+	x = mSkyline[best].X;
+	y = bestY;
+	Place(best, paddedWidth, bestY + paddedHeight);
+	mUsedArea += (uint64_t)width * height;
+
+	return true;
+}
+
+bool SkylinePacker::Fit(size_t index, uint32_t width, uint32_t height, uint32_t& y)const
+{
+	if(mSkyline[index].X + width > mWidth)
+		return false;
+
+	// The rectangle rests on the highest segment under it.
+	y = 0;
+	uint32_t left = width;
+	for(size_t i = index; left > 0; ++i)
+	{
+		assert(i < mSkyline.size());
+		y = std::max<uint32_t>(y, mSkyline[i].Y);
+		if(y + height > mHeight)
+			return false;
+
+		left -= std::min<uint32_t>(left, mSkyline[i].Width);
+	}
+
+	return true;
+}
+
+void SkylinePacker::Place(size_t index, uint32_t width, uint32_t top)
+{
+	Segment placed = { mSkyline[index].X, top, width };
+	uint32_t right = placed.X + width;
+	mSkyline.insert(mSkyline.begin() + index, placed);
+
+	// Cut the segments now under the rectangle.
+	size_t next = index + 1;
+	while(next < mSkyline.size() && mSkyline[next].X < right)
+	{
+		Segment& s = mSkyline[next];
+		uint32_t covered = right - s.X;
+		if(s.Width <= covered)
+		{
+			mSkyline.erase(mSkyline.begin() + next);
+			continue;
+		}
+
+		s.X += covered;
+		s.Width -= covered;
+		break;
+	}
+
+	// Join neighbours at the same height.
+	for(size_t i = 0; i + 1 < mSkyline.size();)
+	{
+		if(mSkyline[i].Y == mSkyline[i + 1].Y)
+		{
+			mSkyline[i].Width += mSkyline[i + 1].Width;
+			mSkyline.erase(mSkyline.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+double SkylinePacker::Occupancy()const
+{
+	uint64_t area = (uint64_t)mWidth * mHeight;
+	return area == 0 ? 0.0 : (double)mUsedArea / area;
+}
+
+std::vector<std::vector<uint32_t>> TexturePacker::ArrayGroups(const std::vector<DDS::Image>& images)
+{
+	std::vector<std::vector<uint32_t>> groups;
+	std::vector<uint8_t> grouped(images.size(), 0);
+
+	for(uint32_t i = 0; i < (uint32_t)images.size(); ++i)
+	{
+		if(grouped[i] || !CanBeSlice(images[i]))
+			continue;
+
+		std::vector<uint32_t> group = { i };
+		for(uint32_t j = i + 1; j < (uint32_t)images.size(); ++j)
+		{
+			if(!grouped[j] && CanBeSlice(images[j]) && SameLayout(images[i], images[j]))
+			{
+				group.push_back(j);
+				grouped[j] = 1;
+			}
+		}
+
+		if(group.size() > 1)
+			groups.push_back(group);
+	}
+
+	return groups;
+}
+
+DDS::Status TexturePacker::PackArray(const std::vector<DDS::Image>& slices, std::vector<uint8_t>& file)
+{
+	if(slices.empty())
+		return DDS::Status::InvalidData;
+
+	const DDS::Image& first = slices[0];
+	for(const DDS::Image& slice : slices)
+	{
+		if(!CanBeSlice(slice) || !SameLayout(first, slice))
+			return DDS::Status::NotSupported;
+	}
+
+	size_t sliceBytes = SliceBytes(first);
+	for(const DDS::Image& slice : slices)
+	{
+		if(slice.BitSize < sliceBytes)
+			return DDS::Status::EndOfFile;
+	}
+
+	DDS_HEADER header = {};
+	header.size = sizeof(DDS_HEADER);
+	header.flags = DDSD_CAPS | DDS_HEIGHT | DDS_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+	header.height = (uint32_t)first.Height;
+	header.width = (uint32_t)first.Width;
+	header.depth = 1;
+	header.mipMapCount = (uint32_t)first.MipCount;
+	header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+	header.ddspf.flags = DDS_FOURCC;
+	header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+	header.caps = DDSCAPS_TEXTURE | (first.MipCount > 1 ? DDSCAPS_MIPMAP | DDSCAPS_COMPLEX : 0);
+
+	DDS_HEADER_DXT10 extension = {};
+	extension.dxgiFormat = first.Format;
+	extension.resourceDimension = DDS::DimensionTexture2D;
+	extension.arraySize = (uint32_t)slices.size();
+
+	file.resize(sizeof(uint32_t) + sizeof(header) + sizeof(extension) + sliceBytes * slices.size());
+
+	uint8_t* out = file.data();
+	memcpy(out, &DDS_MAGIC, sizeof(uint32_t));
+	out += sizeof(uint32_t);
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	memcpy(out, &extension, sizeof(extension));
+	out += sizeof(extension);
+
+	// Slice major, as GetSubresources reads them back.
+	for(const DDS::Image& slice : slices)
+	{
+		memcpy(out, slice.BitData, sliceBytes);
+		out += sliceBytes;
+	}
+
+	return DDS::Status::Ok;
+}
+
+TexturePacker::AtlasRect TexturePacker::AtlasTransform(uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+	uint32_t pageWidth, uint32_t pageHeight)
+{
+	AtlasRect rect;
+	rect.ScaleU = (float)width / pageWidth;
+	rect.ScaleV = (float)height / pageHeight;
+	rect.OffsetU = (float)x / pageWidth;
+	rect.OffsetV = (float)y / pageHeight;
+	return rect;
+}
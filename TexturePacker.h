@@ -0,0 +1,92 @@
+//***************************************************************************************
+// TexturePacker.h
+//
+// Combines small textures so the scene binds fewer descriptor tables per frame.
+// Textures of the same format, size and mip count become the slices of one
+// Texture2DArray (ArrayGroups and PackArray), which the materials share and index with
+// their DiffuseSlice.  Textures that are never tiled can instead share an atlas:
+// SkylinePacker places their rectangles and AtlasTransform gives the scale and offset
+// to fold into each material's MatTransform.
+//
+// The app packs its arrays into Textures/Packed on the first run, and again when one of
+// their members changes; the scene's textures all tile with wrap addressing, so it does
+// not use the atlas.  Nothing here touches a device: HeadlessBench -benchpack checks
+// both paths, and Tools/PackCheck.cpp checks SkylinePacker on Linux.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/DDSFile.h"
+
+// Bottom-left skyline packing into a fixed-size page.  The skyline is the top edge of
+// the packed rectangles seen from above; each rectangle goes where its top ends up
+// lowest, leftmost on ties.
+class SkylinePacker
+{
+public:
+	// Positions and padded sizes are rounded up to alignment texels, 4 for block
+	// compressed formats.  padding texels are kept free right of and below each
+	// rectangle, so filtering at its edge does not reach its neighbour.
+	SkylinePacker(uint32_t width, uint32_t height, uint32_t alignment = 1, uint32_t padding = 0);
+
+	// Places a width by height rectangle and returns its top left corner in x and y.
+	// Returns false, placing nothing, if it does not fit.
+	bool Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+	// Empties the page.
+	void Reset();
+
+	uint32_t Width()const { return mWidth; }
+	uint32_t Height()const { return mHeight; }
+
+	// Share of the page covered by the rectangles inserted, padding not counted.
+	double Occupancy()const;
+
+private:
+	struct Segment
+	{
+		uint32_t X;
+		uint32_t Y;
+		uint32_t Width;
+	};
+
+	// Top of a width by height rectangle whose left edge is at segment index, or false
+	// if it would leave the page.
+	bool Fit(size_t index, uint32_t width, uint32_t height, uint32_t& y)const;
+
+	// Raises the skyline under a rectangle placed at segment index.
+	void Place(size_t index, uint32_t width, uint32_t top);
+
+	uint32_t mWidth;
+	uint32_t mHeight;
+	uint32_t mAlignment;
+	uint32_t mPadding;
+
+	std::vector<Segment> mSkyline;
+	uint64_t mUsedArea = 0;
+};
+
+namespace TexturePacker
+{
+	// The indices of the images that can be slices of one array: single 2D textures
+	// with equal format, width, height and mip count.  Only groups of two or more are
+	// returned, each in image order, the groups in order of their first image.
+	std::vector<std::vector<uint32_t>> ArrayGroups(const std::vector<DDS::Image>& images);
+
+	// Writes a DDS file with a DX10 header to file, holding each of slices in turn as an
+	// array slice.  The slices must be one of ArrayGroups' groups.
+	DDS::Status PackArray(const std::vector<DDS::Image>& slices, std::vector<uint8_t>& file);
+
+	// Maps a texture's UVs into its rectangle on an atlas page: u * ScaleU + OffsetU.
+	// Applied after the material's own transform, and only valid for UVs in [0, 1].
+	struct AtlasRect
+	{
+		float ScaleU;
+		float ScaleV;
+		float OffsetU;
+		float OffsetV;
+	};
+
+	AtlasRect AtlasTransform(uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+		uint32_t pageWidth, uint32_t pageHeight);
+}
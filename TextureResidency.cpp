@@ -0,0 +1,167 @@
+//***************************************************************************************
+// TextureResidency.cpp
+//***************************************************************************************
+
+#include "TextureResidency.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+TextureResidency::TextureResidency(uint64_t budgetBytes) :
+	mBudget(budgetBytes)
+{
+}
+
+uint32_t TextureResidency::Add(const std::vector<uint64_t>& mipBytes, uint32_t tailMip)
+{
+	assert(!mipBytes.empty());
+
+	Texture texture;
+	texture.MipBytes = mipBytes;
+	texture.Tail = std::min<uint32_t>(tailMip, (uint32_t)mipBytes.size() - 1);
+	texture.Resident = texture.Tail;
+	texture.Wanted = texture.Tail;
+	texture.Demanded = texture.Tail;
+	mTextures.push_back(texture);
+
+	uint32_t index = (uint32_t)mTextures.size() - 1;
+	uint64_t tailBytes = ChainBytes(index, texture.Tail);
+	mTailBytes += tailBytes;
+	mUsedBytes += tailBytes;
+	mChanged.push_back(0);
+
+	return index;
+}
+
+void TextureResidency::Demand(uint32_t texture, uint32_t mip)
+{
+	Texture& t = mTextures[texture];
+	mip = std::min<uint32_t>(mip, t.Tail);
+	t.Demanded = t.DemandedThisFrame ? std::min<uint32_t>(t.Demanded, mip) : mip;
+	t.DemandedThisFrame = true;
+}
+
+uint64_t TextureResidency::ChainBytes(uint32_t texture, uint32_t mip)const
+{
+	const Texture& t = mTextures[texture];
+
+	uint64_t bytes = 0;
+	for(size_t m = mip; m < t.MipBytes.size(); ++m)
+		bytes += t.MipBytes[m];
+	return bytes;
+}
+
+uint32_t TextureResidency::Update(uint64_t frame)
+{
+	std::fill(mChanged.begin(), mChanged.end(), (uint8_t)0);
+
+	// A texture keeps what its last frame in use wanted; that is what LRU eviction may
+	// take back, oldest first.
+	for(Texture& t : mTextures)
+	{
+		if(t.DemandedThisFrame)
+		{
+			t.Wanted = t.Demanded;
+			t.LastUsed = frame;
+		}
+		else
+		{
+			t.Wanted = t.Tail;
+		}
+	}
+
+	// Over budget (it was lowered, say): drop what is not wanted first, then the finest
+	// wanted mips of the least recently used textures.
+	while(!MakeRoom(0))
+	{
+		Texture* victim = nullptr;
+		for(Texture& t : mTextures)
+		{
+			if(t.Resident < t.Tail && (victim == nullptr || t.LastUsed < victim->LastUsed))
+				victim = &t;
+		}
+
+		if(victim == nullptr)
+			break;
+
+		SetResident(*victim, victim->Resident + 1);
+	}
+
+	// Refine one mip at a time round robin, so every texture in use gets its coarse
+	// mips before any gets its finest.
+	bool refined = true;
+	while(refined)
+	{
+		refined = false;
+		for(Texture& t : mTextures)
+		{
+			if(t.Resident <= t.Wanted)
+				continue;
+
+			uint64_t bytes = t.MipBytes[t.Resident - 1];
+			if(!MakeRoom(bytes))
+				continue;
+
+			SetResident(t, t.Resident - 1);
+			refined = true;
+		}
+	}
+
+	for(Texture& t : mTextures)
+		t.DemandedThisFrame = false;
+
+	uint32_t changed = 0;
+	for(uint8_t c : mChanged)
+		changed += c;
+	return changed;
+}
+
+bool TextureResidency::MakeRoom(uint64_t bytes)
+{
+	while(mUsedBytes + bytes > mBudget)
+	{
+		// The least recently used texture holding mips it does not want.
+		Texture* victim = nullptr;
+		for(Texture& t : mTextures)
+		{
+			if(t.Resident < t.Wanted && (victim == nullptr || t.LastUsed < victim->LastUsed))
+				victim = &t;
+		}
+
+		if(victim == nullptr)
+			return false;
+
+		SetResident(*victim, victim->Wanted);
+	}
+
+	return true;
+}
+
+void TextureResidency::SetResident(Texture& texture, uint32_t mip)
+{
+	uint32_t index = (uint32_t)(&texture - mTextures.data());
+	uint64_t before = ChainBytes(index, texture.Resident);
+	uint64_t after = ChainBytes(index, mip);
+
+	if(after > before)
+		mBytesLoaded += after - before;
+	else
+		mBytesEvicted += before - after;
+
+	mUsedBytes = mUsedBytes - before + after;
+	texture.Resident = mip;
+	mChanged[index] = 1;
+}
+
+uint32_t TextureResidency::DemandedMip(float texelsAcross, float pixelsAcross, uint32_t mipCount)
+{
+	if(mipCount == 0)
+		return 0;
+	if(pixelsAcross <= 0.0f)
+		return mipCount - 1;
+	if(texelsAcross <= pixelsAcross)
+		return 0;
+
+	float lod = std::floor(std::log2(texelsAcross / pixelsAcross));
+	return std::min<uint32_t>((uint32_t)lod, mipCount - 1);
+}
@@ -0,0 +1,99 @@
+//***************************************************************************************
+// TextureResidency.h
+//
+// Decides how many mips of each streamed texture stay in video memory.  A texture's
+// smallest mips (its tail) are always resident; the larger ones are brought in as the
+// scene asks for them and dropped again, least recently used first, to stay within a
+// byte budget.
+//
+// Each frame the caller reports the mip every visible texture is sampled at (see
+// DemandedMip), then Update settles the resident mips.  Textures are refined one mip at
+// a time, round robin, so under a tight budget every texture gets its coarse mips
+// before any gets its finest.  Nothing here touches a device: the app streams in the
+// chains Update settles on, and HeadlessBench -benchmips drives the same code.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class TextureResidency
+{
+public:
+	explicit TextureResidency(uint64_t budgetBytes);
+
+	// mipBytes holds the size of each mip, all array slices together, most detailed
+	// first.  Mips from tailMip on are always resident.  Returns the texture's index,
+	// counting up from 0.  The texture starts with only its tail resident.
+	uint32_t Add(const std::vector<uint64_t>& mipBytes, uint32_t tailMip);
+
+	// Records that texture is sampled at mip this frame.  Several demands in a frame
+	// keep the most detailed.
+	void Demand(uint32_t texture, uint32_t mip);
+
+	// Settles the resident mips for this frame's demands, then clears them.  frame must
+	// increase from call to call.  Returns the number of textures whose resident mip
+	// changed.
+	uint32_t Update(uint64_t frame);
+
+	// Most detailed resident mip; the chain from here to the last mip is resident.
+	uint32_t ResidentMip(uint32_t texture)const { return mTextures[texture].Resident; }
+
+	// Most detailed mip asked for by the last frame that used the texture.
+	uint32_t WantedMip(uint32_t texture)const { return mTextures[texture].Wanted; }
+
+	uint32_t MipCount(uint32_t texture)const { return (uint32_t)mTextures[texture].MipBytes.size(); }
+	uint64_t LastUsedFrame(uint32_t texture)const { return mTextures[texture].LastUsed; }
+	uint32_t TextureCount()const { return (uint32_t)mTextures.size(); }
+
+	// The tails are never dropped, so if they alone exceed the budget, so does UsedBytes.
+	uint64_t UsedBytes()const { return mUsedBytes; }
+	uint64_t TailBytes()const { return mTailBytes; }
+	uint64_t Budget()const { return mBudget; }
+	void SetBudget(uint64_t budgetBytes) { mBudget = budgetBytes; }
+
+	// Bytes made resident and dropped since the residency was created.
+	uint64_t BytesLoaded()const { return mBytesLoaded; }
+	uint64_t BytesEvicted()const { return mBytesEvicted; }
+
+	// Bytes of the chain from mip to the last mip.
+	uint64_t ChainBytes(uint32_t texture, uint32_t mip)const;
+
+	// The mip sampled when texelsAcross texels of the most detailed mip cover
+	// pixelsAcross pixels on screen: the one with about a texel per pixel, rounded
+	// toward the more detailed.  Clamped to [0, mipCount - 1]; nothing on screen gets
+	// the last mip.
+	static uint32_t DemandedMip(float texelsAcross, float pixelsAcross, uint32_t mipCount);
+
+private:
+	struct Texture
+	{
+		std::vector<uint64_t> MipBytes;
+		uint32_t Tail = 0;
+		uint32_t Resident = 0;
+		uint32_t Wanted = 0;
+
+		// Most detailed mip demanded this frame, or Tail if none.
+		uint32_t Demanded = 0;
+		bool DemandedThisFrame = false;
+
+		uint64_t LastUsed = 0;
+	};
+
+	// Drops mips of textures holding more than they want, least recently used first,
+	// until bytes fit or nothing is left to drop.  Returns true if bytes fit.
+	bool MakeRoom(uint64_t bytes);
+
+	void SetResident(Texture& texture, uint32_t mip);
+
+	std::vector<Texture> mTextures;
+	uint64_t mBudget = 0;
+	uint64_t mUsedBytes = 0;
+	uint64_t mTailBytes = 0;
+	uint64_t mBytesLoaded = 0;
+	uint64_t mBytesEvicted = 0;
+
+	// Textures changed by the current Update.
+	std::vector<uint8_t> mChanged;
+};
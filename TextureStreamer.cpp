@@ -0,0 +1,271 @@
+//***************************************************************************************
+// TextureStreamer.cpp
+//***************************************************************************************
+
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool IsBlockCompressed(DXGI_FORMAT format)
+	{
+		return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+			(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+	}
+}
+
+StagingRing::StagingRing(uint8_t* memory, uint64_t size) :
+	mMemory(memory),
+	mSize(size)
+{
+}
+
+bool StagingRing::Allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+{
+	assert(mSize % alignment == 0);
+	if(size > mSize)
+		return false;
+
+	// Nothing is in use, so start at the front rather than lose the space to a wrap.
+	if(mHead == mTail)
+		mHead = mTail = mSubmitted = AlignUp(mHead, mSize);
+
+	// An allocation never straddles the end of the ring; it starts over at the front.
+	uint64_t start = AlignUp(mHead, alignment);
+	if(start % mSize + size > mSize)
+		start = AlignUp(start, mSize);
+
+	if(start + size - mTail > mSize)
+		return false;
+
+	mHead = start + size;
+	offset = start % mSize;
+	return true;
+}
+
+void StagingRing::Submit(uint64_t fenceValue)
+{
+	if(mHead == mSubmitted)
+		return;
+
+	Block block = { fenceValue, mHead };
+	mInFlight.push_back(block);
+	mSubmitted = mHead;
+}
+
+void StagingRing::Retire(uint64_t completedValue)
+{
+	while(!mInFlight.empty() && mInFlight.front().FenceValue <= completedValue)
+	{
+		mTail = mInFlight.front().End;
+		mInFlight.pop_front();
+	}
+}
+
+TextureStreamer::TextureStreamer(uint8_t* staging, uint64_t stagingSize, size_t maxsize) :
+	mMaxSize(maxsize),
+	mRing(staging, stagingSize),
+	mLoadUs(0)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Workers write into the jobs.
+	mWorkers.wait();
+}
+
+uint32_t TextureStreamer::Request(const Path& file)
+{
+	return Request(file, mMaxSize);
+}
+
+uint32_t TextureStreamer::Request(const Path& file, size_t maxsize)
+{
+	auto job = std::make_unique<Job>();
+	job->Request = (uint32_t)mJobs.size();
+	job->File = file;
+	job->MaxSize = maxsize;
+	job->JobState = State::Loading;
+
+	Job* loading = job.get();
+	mJobs.push_back(std::move(job));
+	mWorkers.run([this, loading]() { Load(*loading); });
+
+	return loading->Request;
+}
+
+void TextureStreamer::Load(Job& job)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	if(!job.Mapping.Open(job.File.c_str()))
+		job.Status = DDS::Status::InvalidData;
+	else
+		job.Status = DDS::ParseHeader(job.Mapping.Data(), job.Mapping.Size(), job.Image);
+
+	if(job.Status == DDS::Status::Ok)
+		job.Status = DDS::GetSubresources(job.Image, job.MaxSize, job.Layout);
+
+	// Failed files are unmapped now; loaded ones once they are staged.
+	if(job.Status != DDS::Status::Ok)
+		job.Mapping.Close();
+
+	mLoadUs += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+	job.JobState = job.Status == DDS::Status::Ok ? State::Loaded : State::Failed;
+
+	std::lock_guard<std::mutex> lock(mCompletedMutex);
+	mCompleted.push_back(job.Request);
+}
+
+void TextureStreamer::WaitForLoads()
+{
+	mWorkers.wait();
+}
+
+uint32_t TextureStreamer::Pump(uint64_t completedFence, uint64_t submitFence, uint64_t byteBudget, const UploadFn& upload)
+{
+	mRing.Retire(completedFence);
+
+	{
+		std::lock_guard<std::mutex> lock(mCompletedMutex);
+		mWaiting.insert(mWaiting.end(), mCompleted.begin(), mCompleted.end());
+		mCompleted.clear();
+	}
+
+	uint32_t handed = 0;
+	uint64_t staged = 0;
+	std::vector<StagedSubresource> footprints;
+	while(!mWaiting.empty())
+	{
+		Job& job = *mJobs[mWaiting.front()];
+
+		StreamedTexture texture;
+		texture.Request = job.Request;
+		texture.Status = job.Status;
+
+		if(job.Status == DDS::Status::Ok)
+		{
+			uint64_t size = ComputeFootprints(job.Image, job.Layout, footprints);
+			if(size > mRing.Size())
+			{
+				texture.Status = DDS::Status::NotSupported;
+			}
+			else
+			{
+				// Always take at least one texture a frame, however large, so the
+				// budget cannot stall streaming.
+				uint64_t offset = 0;
+				if((staged > 0 && staged + size > byteBudget) || !mRing.Allocate(size, PlacementAlignment, offset))
+					break;
+
+				Stage(job, offset, texture);
+				staged += size;
+			}
+		}
+
+		mWaiting.pop_front();
+		job.Mapping.Close();
+
+		if(texture.Status == DDS::Status::Ok)
+		{
+			job.JobState = State::Resident;
+			mResident++;
+		}
+		else
+		{
+			job.JobState = State::Failed;
+			mFailed++;
+		}
+
+		upload(texture);
+		handed++;
+	}
+
+	mRing.Submit(submitFence);
+	mBytesStaged += staged;
+
+	return handed;
+}
+
+uint64_t TextureStreamer::ComputeFootprints(const DDS::Image& image, const DDS::SubresourceLayout& layout,
+	std::vector<StagedSubresource>& footprints)
+{
+	footprints.clear();
+
+	// Block compressed copies are made in whole blocks, so small mips are rounded up.
+	const uint32_t blockSize = IsBlockCompressed(image.Format) ? 4 : 1;
+
+	uint64_t offset = 0;
+	for(size_t s = 0; s < layout.Subresources.size(); ++s)
+	{
+		size_t mip = s % layout.MipCount;
+		uint32_t width = (uint32_t)std::max<size_t>(layout.Width >> mip, 1);
+		uint32_t height = (uint32_t)std::max<size_t>(layout.Height >> mip, 1);
+		uint32_t depth = (uint32_t)std::max<size_t>(layout.Depth >> mip, 1);
+
+		size_t rowBytes = 0;
+		size_t numRows = 0;
+		DDS::GetSurfaceInfo(width, height, image.Format, nullptr, &rowBytes, &numRows);
+
+		StagedSubresource footprint;
+		footprint.Offset = AlignUp(offset, PlacementAlignment);
+		footprint.RowPitch = (uint32_t)AlignUp(rowBytes, PitchAlignment);
+		footprint.Width = (uint32_t)AlignUp(width, blockSize);
+		footprint.Height = (uint32_t)AlignUp(height, blockSize);
+		footprint.Depth = depth;
+		footprints.push_back(footprint);
+
+		offset = footprint.Offset + (uint64_t)footprint.RowPitch * numRows * depth;
+	}
+
+	return offset;
+}
+
+void TextureStreamer::Stage(Job& job, uint64_t base, StreamedTexture& texture)
+{
+	const DDS::Image& image = job.Image;
+	const DDS::SubresourceLayout& layout = job.Layout;
+
+	texture.Dimension = image.Dimension;
+	texture.Width = (uint32_t)layout.Width;
+	texture.Height = (uint32_t)layout.Height;
+	texture.Depth = (uint32_t)layout.Depth;
+	texture.MipCount = (uint32_t)layout.MipCount;
+	texture.ArraySize = (uint32_t)image.ArraySize;
+	texture.SkipMip = (uint32_t)layout.SkipMip;
+	texture.Format = image.Format;
+	texture.IsCubeMap = image.IsCubeMap;
+
+	ComputeFootprints(image, layout, texture.Subresources);
+
+	// The source rows are tightly packed; the staged rows are padded to RowPitch.
+	for(size_t s = 0; s < texture.Subresources.size(); ++s)
+	{
+		StagedSubresource& footprint = texture.Subresources[s];
+		const DDS::Subresource& source = layout.Subresources[s];
+		footprint.Offset += base;
+
+		size_t numRows = source.RowPitch > 0 ? source.SlicePitch / source.RowPitch : 0;
+		uint8_t* dest = mRing.Memory() + footprint.Offset;
+		const uint8_t* src = static_cast<const uint8_t*>(source.Data);
+		for(uint32_t z = 0; z < footprint.Depth; ++z)
+		{
+			for(size_t row = 0; row < numRows; ++row)
+			{
+				memcpy(dest + ((uint64_t)z * numRows + row) * footprint.RowPitch,
+					src + z * source.SlicePitch + row * source.RowPitch, source.RowPitch);
+			}
+		}
+	}
+}
@@ -0,0 +1,194 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Loads DDS textures in the background.  Request hands a file to the ppl worker pool,
+// which maps and parses it (see Common/DDSFile.h) and puts the result on a completion
+// queue.  Once a frame, Pump takes finished loads off the queue and copies their
+// subresources into a staging ring laid out as CopyTextureRegion expects, then hands
+// each texture to a callback that records the GPU copies.  Staging space is reclaimed
+// when the fence value of the frame that used it completes.
+//
+// Nothing here touches a device: the app creates the staging buffer and records the
+// copies, and HeadlessBench -benchstream drives the same code with a SimulatedFence.
+//***************************************************************************************
+
+#pragma once
+
+#include "Common/DDSFile.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <ppl.h>
+
+// A ring of upload memory shared by several frames.  Allocations are made between
+// Submit calls and stay in use until the fence value they were submitted with completes.
+class StagingRing
+{
+public:
+	// size must be a multiple of every alignment later asked of Allocate.
+	StagingRing(uint8_t* memory, uint64_t size);
+
+	// Returns false if the ring is too full; retiring older frames makes room.
+	bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+
+	// Everything allocated since the last Submit is in use until fenceValue completes.
+	void Submit(uint64_t fenceValue);
+	void Retire(uint64_t completedValue);
+
+	uint8_t* Memory()const { return mMemory; }
+	uint64_t Size()const { return mSize; }
+	uint64_t UsedBytes()const { return mHead - mTail; }
+
+private:
+	struct Block
+	{
+		uint64_t FenceValue;
+		uint64_t End;
+	};
+
+	uint8_t* mMemory = nullptr;
+	uint64_t mSize = 0;
+
+	// Offsets count up forever; the position in the ring is the offset modulo mSize.
+	uint64_t mHead = 0;
+	uint64_t mTail = 0;
+	uint64_t mSubmitted = 0;
+	std::deque<Block> mInFlight;
+};
+
+// Where one subresource sits in the staging ring: a D3D12_PLACED_SUBRESOURCE_FOOTPRINT.
+struct StagedSubresource
+{
+	uint64_t Offset = 0;
+	uint32_t RowPitch = 0;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t Depth = 0;
+};
+
+struct StreamedTexture
+{
+	uint32_t Request = 0;
+
+	// Anything but Ok means the load failed and there is nothing to upload.
+	DDS::Status Status = DDS::Status::Ok;
+
+	uint32_t Dimension = DDS::DimensionUnknown;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t Depth = 0;
+	uint32_t MipCount = 0;
+	uint32_t ArraySize = 0;
+
+	// Mips of the file dropped for the request's maxsize: mip 0 here is mip SkipMip
+	// of the file.
+	uint32_t SkipMip = 0;
+	DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+	bool IsCubeMap = false;
+
+	// In D3D12 subresource order: mips of slice 0, then of slice 1, and so on.
+	std::vector<StagedSubresource> Subresources;
+};
+
+class TextureStreamer
+{
+public:
+#ifdef _WIN32
+	typedef std::wstring Path;
+#else
+	typedef std::string Path;
+#endif
+
+	enum class State
+	{
+		Loading,	// Queued for or being read by a worker.
+		Loaded,		// Parsed and waiting for staging space.
+		Resident,	// Handed to the upload callback.
+		Failed
+	};
+
+	typedef std::function<void(const StreamedTexture&)> UploadFn;
+
+	// Row pitch and subresource placement alignment for texture copies
+	// (D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT).
+	static const uint64_t PitchAlignment = 256;
+	static const uint64_t PlacementAlignment = 512;
+
+	// staging is owned by the caller and must outlive the streamer.  Mips larger than
+	// maxsize are dropped, as with CreateDDSTextureFromFile12; 0 keeps them all.
+	TextureStreamer(uint8_t* staging, uint64_t stagingSize, size_t maxsize = 0);
+	TextureStreamer(const TextureStreamer& rhs) = delete;
+	TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+	~TextureStreamer();
+
+	// Starts loading file on a worker and returns its request number, counting up from 0.
+	// The second form drops mips larger than maxsize for this request only, so a
+	// texture can be loaded again with more or fewer of its mips.
+	uint32_t Request(const Path& file);
+	uint32_t Request(const Path& file, size_t maxsize);
+
+	// Called once a frame.  Frees the staging space of frames up to completedFence,
+	// then stages finished loads in the order they finished until byteBudget is used
+	// up or the ring is full, and calls upload for each.  Failed loads are passed to
+	// upload too, as are textures too big for the ring (with Status::NotSupported).
+	// The staging space is in use until submitFence completes.  Returns the textures
+	// handed to upload.
+	uint32_t Pump(uint64_t completedFence, uint64_t submitFence, uint64_t byteBudget, const UploadFn& upload);
+
+	// Blocks until every requested file has been read and parsed.
+	void WaitForLoads();
+
+	State GetState(uint32_t request)const { return mJobs[request]->JobState; }
+	uint32_t RequestCount()const { return (uint32_t)mJobs.size(); }
+	uint32_t ResidentCount()const { return mResident; }
+	uint32_t FailedCount()const { return mFailed; }
+	bool IsIdle()const { return mResident + mFailed == mJobs.size(); }
+
+	const StagingRing& GetRing()const { return mRing; }
+	uint64_t BytesStaged()const { return mBytesStaged; }
+
+	// Worker time spent reading and parsing, summed over all workers.
+	double LoadMs()const { return mLoadUs / 1000.0; }
+
+	// Staging layout of a parsed texture, without the copy.  Returns the bytes needed.
+	static uint64_t ComputeFootprints(const DDS::Image& image, const DDS::SubresourceLayout& layout,
+		std::vector<StagedSubresource>& footprints);
+
+private:
+	struct Job
+	{
+		uint32_t Request = 0;
+		Path File;
+		size_t MaxSize = 0;
+		std::atomic<State> JobState;
+
+		DDS::MappedFile Mapping;
+		DDS::Image Image;
+		DDS::SubresourceLayout Layout;
+		DDS::Status Status = DDS::Status::Ok;
+	};
+
+	void Load(Job& job);
+	void Stage(Job& job, uint64_t base, StreamedTexture& texture);
+
+	size_t mMaxSize = 0;
+	StagingRing mRing;
+
+	std::vector<std::unique_ptr<Job>> mJobs;
+	concurrency::task_group mWorkers;
+
+	// Requests whose load finished, in the order they finished.
+	std::mutex mCompletedMutex;
+	std::deque<uint32_t> mCompleted;
+
+	// Loads taken off mCompleted that have not been staged yet.
+	std::deque<uint32_t> mWaiting;
+
+	uint32_t mResident = 0;
+	uint32_t mFailed = 0;
+	uint64_t mBytesStaged = 0;
+	std::atomic<uint64_t> mLoadUs;
+};
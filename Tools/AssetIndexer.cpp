@@ -0,0 +1,367 @@
+//***************************************************************************************
+// AssetIndexer.cpp
+//
+// Writes the AssetIndex of the DDS files in a directory, checks an index against the
+// files it describes, or fuzzes the DDS header parser the index and the app rely on.
+//
+// Build from the repository root, with dxgiformat.h from the DirectX-Headers package;
+// the sanitizers turn an out of bounds read while fuzzing into a report:
+//
+//   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -I. -I/usr/include/directx
+//       -o assetindex Tools/AssetIndexer.cpp AssetIndex.cpp Common/DDSFile.cpp
+//
+// Run with:  assetindex [-o Textures/AssetIndex.bin] [Textures]
+//            assetindex -verify [-o Textures/AssetIndex.bin] [Textures]
+//            assetindex -fuzz N [-seed S] [Textures]
+//
+// Only the directory's own .dds files are indexed, in name order, each named by its
+// path as given, so run it from where the app runs.  Fuzzing mutates those files'
+// headers: flipped bits, fields set to edge values, DX10 extensions with random
+// contents and truncation.  Whatever ParseHeader accepts must lay out inside the file,
+// and survive being indexed and read back.
+//***************************************************************************************
+
+#include "AssetIndex.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+
+namespace
+{
+	struct SourceFile
+	{
+		std::string Name;
+		std::vector<uint8_t> Bytes;
+	};
+
+	bool ReadFile(const std::string& fileName, std::vector<uint8_t>& bytes)
+	{
+		DDS::MappedFile file;
+		if(!file.Open(fileName.c_str()))
+			return false;
+
+		bytes.assign(file.Data(), file.Data() + file.Size());
+		return true;
+	}
+
+	std::vector<SourceFile> ReadDirectory(const std::string& directory)
+	{
+		std::vector<std::string> names;
+		for(const auto& item : std::filesystem::directory_iterator(directory))
+		{
+			if(item.is_regular_file() && item.path().extension() == ".dds")
+				names.push_back(directory + "/" + item.path().filename().string());
+		}
+		std::sort(names.begin(), names.end());
+
+		std::vector<SourceFile> files;
+		for(const std::string& name : names)
+		{
+			SourceFile file;
+			file.Name = name;
+			if(ReadFile(name, file.Bytes))
+				files.push_back(std::move(file));
+			else
+				fprintf(stderr, "%s: could not read\n", name.c_str());
+		}
+		return files;
+	}
+
+	const char* StatusName(DDS::Status status)
+	{
+		switch(status)
+		{
+		case DDS::Status::Ok: return "ok";
+		case DDS::Status::InvalidData: return "invalid data";
+		case DDS::Status::NotSupported: return "not supported";
+		case DDS::Status::EndOfFile: return "end of file";
+		}
+		return "?";
+	}
+
+	int Build(const std::string& directory, const std::string& output)
+	{
+		std::vector<AssetIndex::Entry> entries;
+		for(const SourceFile& file : ReadDirectory(directory))
+		{
+			AssetIndex::Entry entry;
+			DDS::Status status = AssetIndex::Describe(file.Name, file.Bytes.data(), file.Bytes.size(), entry);
+			if(status != DDS::Status::Ok)
+			{
+				// Left out; the app parses it itself, and reports it if it must.
+				fprintf(stderr, "%s: %s, not indexed\n", file.Name.c_str(), StatusName(status));
+				continue;
+			}
+			entries.push_back(std::move(entry));
+		}
+
+		std::vector<uint8_t> index = AssetIndex::Write(entries);
+
+		FILE* out = fopen(output.c_str(), "wb");
+		if(out == nullptr || fwrite(index.data(), 1, index.size(), out) != index.size())
+		{
+			fprintf(stderr, "%s: could not write\n", output.c_str());
+			if(out != nullptr)
+				fclose(out);
+			return 1;
+		}
+		fclose(out);
+
+		printf("%s: %zu textures, %zu bytes\n", output.c_str(), entries.size(), index.size());
+		return 0;
+	}
+
+	int Verify(const std::string& directory, const std::string& indexFile)
+	{
+		std::vector<uint8_t> bytes;
+		AssetIndex index;
+		if(!ReadFile(indexFile, bytes) || !index.Read(bytes.data(), bytes.size()))
+		{
+			fprintf(stderr, "%s: not a valid index\n", indexFile.c_str());
+			return 1;
+		}
+
+		int stale = 0;
+		std::vector<SourceFile> files = ReadDirectory(directory);
+		for(const SourceFile& file : files)
+		{
+			AssetIndex::Entry fresh;
+			if(AssetIndex::Describe(file.Name, file.Bytes.data(), file.Bytes.size(), fresh) != DDS::Status::Ok)
+				continue;
+
+			const AssetIndex::Entry* entry = index.Find(file.Name);
+			if(entry == nullptr || entry->ContentHash != fresh.ContentHash || entry->FileSize != fresh.FileSize)
+			{
+				printf("%s: %s\n", file.Name.c_str(), entry == nullptr ? "not indexed" : "changed");
+				stale++;
+			}
+		}
+
+		for(const AssetIndex::Entry& entry : index.Entries())
+		{
+			bool found = std::any_of(files.begin(), files.end(), [&](const SourceFile& f) { return f.Name == entry.Name; });
+			if(!found)
+			{
+				printf("%s: indexed but missing\n", entry.Name.c_str());
+				stale++;
+			}
+		}
+
+		printf("%s: %zu textures, %d stale\n", indexFile.c_str(), index.Entries().size(), stale);
+		return stale == 0 ? 0 : 1;
+	}
+
+	// Whatever ParseHeader and GetSubresources accept must stay inside data.  Returns the
+	// number of broken promises.
+	int CheckLayout(const std::vector<uint8_t>& data, DDS::Status& status)
+	{
+		int violations = 0;
+		const uint8_t* begin = data.data();
+		const uint8_t* end = begin + data.size();
+
+		DDS::Image image;
+		status = DDS::ParseHeader(begin, data.size(), image);
+		if(status != DDS::Status::Ok)
+			return 0;
+
+		if(image.BitData < begin + sizeof(uint32_t) + sizeof(DDS_HEADER) || image.BitData + image.BitSize != end ||
+		   image.MipCount == 0 || image.ArraySize == 0)
+			violations++;
+
+		// A streamed texture's first chain is read with a small maxsize, then reloaded whole.
+		const size_t maxsizes[] = { 0, 1, 64 };
+		for(size_t maxsize : maxsizes)
+		{
+			DDS::SubresourceLayout layout;
+			if(DDS::GetSubresources(image, maxsize, layout) != DDS::Status::Ok)
+				continue;
+
+			size_t mipsKept = image.MipCount - layout.SkipMip;
+			if(layout.Subresources.size() != mipsKept * image.ArraySize)
+				violations++;
+
+			for(size_t s = 0; s < layout.Subresources.size(); ++s)
+			{
+				const DDS::Subresource& sub = layout.Subresources[s];
+				size_t depth = std::max<size_t>(layout.Depth >> (s % std::max<size_t>(mipsKept, 1)), 1);
+				const uint8_t* data = (const uint8_t*)sub.Data;
+				if(data < image.BitData || sub.SlicePitch > (size_t)(end - data) ||
+				   (sub.SlicePitch != 0 && depth > (size_t)(end - data) / sub.SlicePitch))
+					violations++;
+			}
+		}
+
+		// Anything the parser accepts with a size must index, and read back the same.
+		AssetIndex::Entry entry;
+		if(AssetIndex::Describe("fuzz", begin, data.size(), entry) == DDS::Status::Ok)
+		{
+			std::vector<uint8_t> bytes = AssetIndex::Write({ entry });
+			AssetIndex index;
+			if(!index.Read(bytes.data(), bytes.size()) || index.Entries().size() != 1 ||
+			   index.Entries()[0].MipBytes() != entry.MipBytes())
+				violations++;
+		}
+
+		return violations;
+	}
+
+	int Fuzz(const std::string& directory, uint32_t iterations, uint32_t seed)
+	{
+		std::vector<SourceFile> files = ReadDirectory(directory);
+		if(files.empty())
+		{
+			fprintf(stderr, "%s: no .dds files to start from\n", directory.c_str());
+			return 1;
+		}
+
+		const uint32_t edgeValues[] =
+		{
+			0, 1, 2, 3, 4, 6, 15, 16, 17, 2048, 2049, 16384, 16385, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF
+		};
+		const size_t headerBytes = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+
+		std::mt19937 rng(seed);
+		uint32_t counts[4] = {};
+		int violations = 0;
+		std::vector<uint8_t> data;
+		for(uint32_t i = 0; i < iterations; ++i)
+		{
+			const SourceFile& source = files[rng() % files.size()];
+
+			// A bounded prefix keeps iterations quick; shorter files are truncated anyway.
+			size_t length = std::min<size_t>(source.Bytes.size(), 4096 + headerBytes);
+			data.assign(source.Bytes.begin(), source.Bytes.begin() + length);
+			if(data.size() < headerBytes)
+				data.resize(headerBytes, 0);
+
+			uint32_t* fields = reinterpret_cast<uint32_t*>(data.data());
+			size_t fieldCount = headerBytes / sizeof(uint32_t);
+
+			int mutations = 1 + rng() % 4;
+			for(int m = 0; m < mutations; ++m)
+			{
+				switch(rng() % 4)
+				{
+				case 0:
+					data[rng() % headerBytes] ^= (uint8_t)(1 << (rng() % 8));
+					break;
+
+				case 1:
+					fields[1 + rng() % (fieldCount - 1)] = edgeValues[rng() % (sizeof(edgeValues) / sizeof(edgeValues[0]))];
+					break;
+
+				case 2:
+				{
+					// The DX10 extension, with a random format, dimension, flags and size.
+					DDS_HEADER* header = reinterpret_cast<DDS_HEADER*>(data.data() + sizeof(uint32_t));
+					DDS_HEADER_DXT10* extension = reinterpret_cast<DDS_HEADER_DXT10*>(header + 1);
+					header->ddspf.flags |= DDS_FOURCC;
+					header->ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+					extension->dxgiFormat = (DXGI_FORMAT)(rng() % 200);
+					extension->resourceDimension = rng() % 6;
+					extension->miscFlag = rng() % 2 ? 0x4 : 0;
+					extension->arraySize = edgeValues[rng() % (sizeof(edgeValues) / sizeof(edgeValues[0]))];
+					break;
+				}
+
+				case 3:
+					data.resize(rng() % (data.size() + 1));
+					break;
+				}
+
+				// Keeps fields pointing into the data after a truncation.
+				if(data.size() < headerBytes)
+					break;
+			}
+
+			// Copied to an exact size so a sanitizer sees any read past the end.
+			std::vector<uint8_t> exact(data.begin(), data.end());
+			DDS::Status status = DDS::Status::Ok;
+			int found = CheckLayout(exact, status);
+			counts[(int)status]++;
+			if(found > 0)
+			{
+				fprintf(stderr, "iteration %u from %s: %d violations\n", i, source.Name.c_str(), found);
+				violations += found;
+			}
+		}
+
+		// An index damaged anywhere must be rejected whole.
+		std::vector<AssetIndex::Entry> entries;
+		for(const SourceFile& file : files)
+		{
+			AssetIndex::Entry entry;
+			if(AssetIndex::Describe(file.Name, file.Bytes.data(), file.Bytes.size(), entry) == DDS::Status::Ok)
+				entries.push_back(entry);
+		}
+
+		std::vector<uint8_t> index = AssetIndex::Write(entries);
+		uint32_t indexAccepted = 0;
+		for(uint32_t i = 0; i < iterations / 16 && !index.empty(); ++i)
+		{
+			std::vector<uint8_t> damaged = index;
+			if(rng() % 2)
+				damaged[rng() % damaged.size()] ^= (uint8_t)(1 << (rng() % 8));
+			else
+				damaged.resize(rng() % damaged.size());
+
+			AssetIndex read;
+			if(read.Read(damaged.data(), damaged.size()))
+				indexAccepted++;
+		}
+		violations += indexAccepted;
+
+		printf("fuzz: %u headers from %zu files, seed %u\n"
+			"  ok %u, invalid data %u, not supported %u, end of file %u\n"
+			"  damaged indices accepted %u\n"
+			"  violations %d\n",
+			iterations, files.size(), seed, counts[0], counts[1], counts[2], counts[3], indexAccepted, violations);
+		return violations == 0 ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string directory = "Textures";
+	std::string output;
+	bool verify = false;
+	uint32_t fuzzIterations = 0;
+	uint32_t seed = 1;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "-o" && i + 1 < argc)
+			output = argv[++i];
+		else if(arg == "-verify")
+			verify = true;
+		else if(arg == "-fuzz" && i + 1 < argc)
+			fuzzIterations = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if(arg == "-seed" && i + 1 < argc)
+			seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if(!arg.empty() && arg[0] == '-')
+		{
+			fprintf(stderr,
+				"usage: assetindex [-o index] [directory]\n"
+				"       assetindex -verify [-o index] [directory]\n"
+				"       assetindex -fuzz N [-seed S] [directory]\n");
+			return 2;
+		}
+		else
+			directory = arg;
+	}
+
+	while(directory.size() > 1 && (directory.back() == '/' || directory.back() == '\\'))
+		directory.pop_back();
+	if(output.empty())
+		output = directory + "/AssetIndex.bin";
+
+	if(fuzzIterations > 0)
+		return Fuzz(directory, fuzzIterations, seed);
+	if(verify)
+		return Verify(directory, output);
+	return Build(directory, output);
+}
@@ -0,0 +1,286 @@
+//***************************************************************************************
+// BvhCheck.cpp
+//
+// Checks SceneBVH against brute force on synthetic scenes, and reports how the nodes a
+// query visits grow with the item count.
+//
+// SceneBVH reaches Common/d3dUtil.h through FrustumCuller.h, so this needs the Windows
+// SDK.  Build from an x64 Native Tools Command Prompt at the repository root:
+//
+//   cl /nologo /std:c++14 /EHsc /O2 /I. /Fe:bvhcheck.exe Tools\BvhCheck.cpp
+//      SceneBVH.cpp FrustumCuller.cpp
+//
+// Run with:  bvhcheck [-items N] [-seed S]
+//
+// The tree is built over 1000 random item boxes, then ten times as many, up to N
+// (100000 by default), spread at the same density, so a query of fixed size finds
+// about as many items at every count.  Every QueryFrustum, QuerySphere and Raycast
+// result must match a test of every box, QueryFrustums over 32 views must find what
+// each view finds alone, and the nodes a frustum query visits must grow less than a
+// tenth as fast as the items.  Some rays start inside an item box,
+// which must be hit at distance 0.  Exits with 1 on any failure.
+//***************************************************************************************
+
+#include "SceneBVH.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const uint32_t QueryCount = SceneBVH::MaxQueryViews;
+	const uint32_t RayCount = 256;
+
+	double ElapsedMs(Clock::time_point start, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	struct Options
+	{
+		uint32_t ItemCount = 100000;
+		uint32_t Seed = 1;
+	};
+
+	// Half the side of the square count items are spread over, for ten items per
+	// 100 square units at every count.
+	float FieldHalf(uint32_t count)
+	{
+		return 5.0f*sqrtf((float)count);
+	}
+
+	std::vector<BoundingBox> BuildBoxes(uint32_t count, std::mt19937& rng)
+	{
+		float half = FieldHalf(count);
+		std::uniform_real_distribution<float> spread(-half, half);
+		std::uniform_real_distribution<float> height(0.0f, 20.0f);
+		std::uniform_real_distribution<float> extent(0.5f, 3.0f);
+
+		std::vector<BoundingBox> boxes(count);
+		for(BoundingBox& box : boxes)
+		{
+			box.Center = XMFLOAT3(spread(rng), height(rng), spread(rng));
+			box.Extents = XMFLOAT3(extent(rng), extent(rng), extent(rng));
+		}
+		return boxes;
+	}
+
+	// The nearest box along the ray by testing every one, with a box that contains
+	// origin hit at 0 as Raycast promises.
+	bool BruteRaycast(const std::vector<BoundingBox>& boxes, FXMVECTOR origin, FXMVECTOR dir, float& dist)
+	{
+		bool hit = false;
+		dist = FLT_MAX;
+		for(const BoundingBox& box : boxes)
+		{
+			float t = 0.0f;
+			if(box.Intersects(origin, dir, t))
+			{
+				dist = std::min<float>(dist, std::max<float>(t, 0.0f));
+				hit = true;
+			}
+		}
+		return hit;
+	}
+
+	struct SizeResult
+	{
+		uint32_t Items = 0;
+		double BuildMs = 0.0;
+		double FrustumVisited = 0.0;
+		double FrustumFound = 0.0;
+		double SphereVisited = 0.0;
+		double SphereFound = 0.0;
+		double QueryUs = 0.0;
+		double BruteUs = 0.0;
+		uint32_t Failures = 0;
+	};
+
+	SizeResult CheckSize(uint32_t count, uint32_t seed)
+	{
+		SizeResult result;
+		result.Items = count;
+
+		std::mt19937 rng(seed + count);
+		std::vector<BoundingBox> boxes = BuildBoxes(count, rng);
+		float half = FieldHalf(count);
+		std::uniform_real_distribution<float> spread(-half, half);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		SceneBVH bvh;
+		Clock::time_point t0 = Clock::now();
+		bvh.Build(boxes);
+		result.BuildMs = ElapsedMs(t0, Clock::now());
+
+		if(bvh.ItemCount() != count)
+			result.Failures++;
+
+		// Cameras inside the field looking along it.
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 1.0f, 200.0f);
+		std::vector<FrustumCuller> frustums(QueryCount);
+		const FrustumCuller* frustumPtrs[QueryCount];
+		for(uint32_t q = 0; q < QueryCount; ++q)
+		{
+			XMVECTOR eye = XMVectorSet(spread(rng), 10.0f, spread(rng), 1.0f);
+			XMVECTOR look = XMVectorSet(unit(rng), 0.3f*unit(rng), unit(rng), 0.0f);
+			frustums[q].SetFrustum(XMMatrixLookToLH(eye, look, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)), proj);
+			frustumPtrs[q] = &frustums[q];
+		}
+
+		std::vector<std::vector<UINT>> inFrustum(QueryCount);
+		std::vector<UINT> expected;
+		double queryMs = 0.0;
+		double bruteMs = 0.0;
+		for(uint32_t q = 0; q < QueryCount; ++q)
+		{
+			t0 = Clock::now();
+			result.FrustumVisited += bvh.QueryFrustum(frustums[q], inFrustum[q]);
+			Clock::time_point t1 = Clock::now();
+
+			expected.clear();
+			for(uint32_t i = 0; i < count; ++i)
+			{
+				const BoundingBox* box[4] = { &boxes[i] };
+				if(frustums[q].TestBoxes4(box, 1))
+					expected.push_back(i);
+			}
+			bruteMs += ElapsedMs(t1, Clock::now());
+			queryMs += ElapsedMs(t0, t1);
+
+			std::sort(inFrustum[q].begin(), inFrustum[q].end());
+			if(inFrustum[q] != expected)
+				result.Failures++;
+			result.FrustumFound += (double)inFrustum[q].size();
+		}
+
+		// Every view in one traversal must find what each found alone.
+		std::vector<UINT> multi[QueryCount];
+		bvh.QueryFrustums(frustumPtrs, QueryCount, multi);
+		for(uint32_t q = 0; q < QueryCount; ++q)
+		{
+			std::sort(multi[q].begin(), multi[q].end());
+			if(multi[q] != inFrustum[q])
+				result.Failures++;
+		}
+
+		std::vector<UINT> found;
+		for(uint32_t q = 0; q < QueryCount; ++q)
+		{
+			BoundingSphere sphere(XMFLOAT3(spread(rng), 10.0f, spread(rng)), 30.0f);
+
+			found.clear();
+			result.SphereVisited += bvh.QuerySphere(sphere, found);
+
+			expected.clear();
+			for(uint32_t i = 0; i < count; ++i)
+			{
+				if(sphere.Intersects(boxes[i]))
+					expected.push_back(i);
+			}
+
+			std::sort(found.begin(), found.end());
+			if(found != expected)
+				result.Failures++;
+			result.SphereFound += (double)found.size();
+		}
+
+		// Rays from inside the field, mostly level; every fourth starts at the center of
+		// an item box.  Two items at the same distance may both be nearest, so the
+		// distances are compared rather than the items.
+		for(uint32_t r = 0; r < RayCount; ++r)
+		{
+			XMVECTOR origin = XMVectorSet(spread(rng), 10.0f, spread(rng), 1.0f);
+			if(r % 4 == 0)
+				origin = XMLoadFloat3(&boxes[rng() % count].Center);
+			XMVECTOR dir = XMVector3Normalize(XMVectorSet(unit(rng), 0.2f*unit(rng), unit(rng), 0.0f));
+
+			UINT item = UINT_MAX;
+			float dist = -1.0f;
+			bool hit = bvh.Raycast(origin, dir, item, dist);
+
+			float nearest = FLT_MAX;
+			bool bruteHit = BruteRaycast(boxes, origin, dir, nearest);
+
+			float t = 0.0f;
+			if(hit != bruteHit)
+				result.Failures++;
+			else if(hit && (item >= count || !boxes[item].Intersects(origin, dir, t) || dist < 0.0f ||
+				fabsf(dist - nearest) > 1e-3f))
+				result.Failures++;
+			else if(r % 4 == 0 && (!hit || dist != 0.0f))
+				result.Failures++;
+		}
+
+		result.FrustumVisited /= QueryCount;
+		result.FrustumFound /= QueryCount;
+		result.SphereVisited /= QueryCount;
+		result.SphereFound /= QueryCount;
+		result.QueryUs = 1000.0*queryMs / QueryCount;
+		result.BruteUs = 1000.0*bruteMs / QueryCount;
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "-items" && i + 1 < argc)
+			options.ItemCount = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if(arg == "-seed" && i + 1 < argc)
+			options.Seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			fprintf(stderr, "usage: bvhcheck [-items N] [-seed S]\n");
+			return 2;
+		}
+	}
+
+	if(options.ItemCount == 0)
+	{
+		fprintf(stderr, "bvhcheck: the item count must not be 0\n");
+		return 2;
+	}
+
+	std::vector<SizeResult> results;
+	uint32_t failures = 0;
+	for(uint32_t count = std::min<uint32_t>(1000, options.ItemCount); ; count = std::min(count*10, options.ItemCount))
+	{
+		SizeResult result = CheckSize(count, options.Seed);
+		printf("  items %-8u build %.2f ms  frustum %.0f nodes for %.0f items (%.2f%% of items), %.1f us, brute force %.1f us\n"
+			"  %-14s sphere %.0f nodes for %.0f items (%.2f%% of items)  %u failures\n",
+			result.Items, result.BuildMs, result.FrustumVisited, result.FrustumFound,
+			100.0*result.FrustumVisited / result.Items, result.QueryUs, result.BruteUs,
+			"", result.SphereVisited, result.SphereFound, 100.0*result.SphereVisited / result.Items, result.Failures);
+		failures += result.Failures;
+		results.push_back(result);
+
+		if(count == options.ItemCount)
+			break;
+	}
+
+	// The queries find about as many items at every count, so the nodes they visit must
+	// grow far slower than the items: less than a tenth as fast.
+	const SizeResult& first = results.front();
+	const SizeResult& last = results.back();
+	double itemGrowth = (double)last.Items / first.Items;
+	double visitedGrowth = last.FrustumVisited / std::max(first.FrustumVisited, 1.0);
+	if(results.size() > 1 && visitedGrowth*10.0 > itemGrowth)
+		failures++;
+
+	printf("  growth         %.0fx items, %.2fx frustum nodes visited\n", itemGrowth, visitedGrowth);
+	printf("  failures       %u\n", failures);
+	return failures == 0 ? 0 : 1;
+}
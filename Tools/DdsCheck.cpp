@@ -0,0 +1,130 @@
+//***************************************************************************************
+// DdsCheck.cpp
+//
+// Runs DDS::ParseHeader and DDS::GetSubresources over DDS files on Linux, the way
+// CreateDDSTextureFromFile12 does after mapping them, and checks the layout they give.
+//
+// Build from the repository root, with dxgiformat.h from the DirectX-Headers package:
+//
+//   g++ -std=c++14 -O2 -I. -I/usr/include/directx -o ddscheck Tools/DdsCheck.cpp
+//       Common/DDSFile.cpp
+//
+// Run with:  ddscheck Textures/*.dds
+//
+// For each file: the header parses; there is one subresource per mip and array slice;
+// each one lies inside the file, starts where the one before it ended and is at least
+// one row; the same bytes cut one short of the last subresource are refused; and a
+// maxsize of half the width drops the top mip.  Exits with 1 if any file fails.
+//***************************************************************************************
+
+#include "Common/DDSFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+	const char* StatusName(DDS::Status status)
+	{
+		switch(status)
+		{
+		case DDS::Status::Ok:           return "ok";
+		case DDS::Status::InvalidData:  return "invalid data";
+		case DDS::Status::NotSupported: return "not supported";
+		case DDS::Status::EndOfFile:    return "end of file";
+		}
+		return "unknown";
+	}
+
+	// Returns an empty string if the file passes, else what failed.
+	std::string CheckFile(const char* fileName, DDS::Image& image, size_t& usedBytes)
+	{
+		DDS::MappedFile file;
+		if(!file.Open(fileName))
+			return "cannot be mapped";
+
+		DDS::Status status = DDS::ParseHeader(file.Data(), file.Size(), image);
+		if(status != DDS::Status::Ok)
+			return std::string("ParseHeader: ") + StatusName(status);
+
+		DDS::SubresourceLayout layout;
+		status = DDS::GetSubresources(image, 0, layout);
+		if(status != DDS::Status::Ok)
+			return std::string("GetSubresources: ") + StatusName(status);
+
+		if(layout.Subresources.size() != image.MipCount * image.ArraySize || layout.SkipMip != 0 ||
+		   layout.Width != image.Width || layout.Height != image.Height)
+			return "layout does not match the header";
+
+		const uint8_t* expected = image.BitData;
+		const uint8_t* end = image.BitData + image.BitSize;
+		for(size_t i = 0; i < layout.Subresources.size(); ++i)
+		{
+			const DDS::Subresource& sub = layout.Subresources[i];
+			size_t depth = std::max<size_t>(image.Depth >> (i % image.MipCount), 1);
+			const uint8_t* data = (const uint8_t*)sub.Data;
+
+			if(data != expected)
+				return "subresource " + std::to_string(i) + " does not follow the one before it";
+			if(sub.RowPitch == 0 || sub.RowPitch > sub.SlicePitch)
+				return "subresource " + std::to_string(i) + " has a bad pitch";
+			if(sub.SlicePitch * depth > (size_t)(end - data))
+				return "subresource " + std::to_string(i) + " runs past the end of the file";
+
+			expected = data + sub.SlicePitch * depth;
+		}
+		usedBytes = (size_t)(expected - image.BitData);
+
+		// The same bytes, one short of the last subresource.
+		size_t headerBytes = (size_t)(image.BitData - file.Data());
+		DDS::Image cut;
+		DDS::SubresourceLayout cutLayout;
+		if(DDS::ParseHeader(file.Data(), headerBytes + usedBytes - 1, cut) == DDS::Status::Ok &&
+		   DDS::GetSubresources(cut, 0, cutLayout) == DDS::Status::Ok)
+			return "accepted with the last byte cut off";
+
+		if(image.MipCount > 1 && image.Width > 1)
+		{
+			DDS::SubresourceLayout smaller;
+			size_t maxsize = image.Width / 2;
+			if(DDS::GetSubresources(image, maxsize, smaller) != DDS::Status::Ok || smaller.SkipMip == 0 ||
+			   smaller.Width > maxsize || smaller.MipCount != image.MipCount - smaller.SkipMip)
+				return "maxsize does not drop the top mip";
+		}
+
+		return std::string();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: ddscheck file.dds [file.dds ...]\n");
+		return 2;
+	}
+
+	uint32_t failures = 0;
+	for(int i = 1; i < argc; ++i)
+	{
+		DDS::Image image;
+		size_t usedBytes = 0;
+		std::string error = CheckFile(argv[i], image, usedBytes);
+		if(!error.empty())
+		{
+			printf("  %-28s FAILED: %s\n", argv[i], error.c_str());
+			failures++;
+			continue;
+		}
+
+		printf("  %-28s %4zux%-4zu format %2d  %2zu mips  %2zu slices%s  %8zu bytes", argv[i],
+			image.Width, image.Height, (int)image.Format, image.MipCount, image.ArraySize,
+			image.IsCubeMap ? " (cube)" : "", usedBytes);
+		if(usedBytes != image.BitSize)
+			printf(", %zu trailing", image.BitSize - usedBytes);
+		printf("\n");
+	}
+
+	printf("  %d files, %u failures\n", argc - 1, failures);
+	return failures == 0 ? 0 : 1;
+}
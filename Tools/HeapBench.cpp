@@ -0,0 +1,353 @@
+//***************************************************************************************
+// HeapBench.cpp
+//
+// Runs HeapAllocator through the app's workloads on Linux, checking it as it goes, and
+// reports how fragmented the heap gets.
+//
+// Build from the repository root:
+//
+//   g++ -std=c++14 -O2 -I. -o heapbench Tools/HeapBench.cpp HeapAllocator.cpp
+//
+// Run with:  heapbench [-heap MB] [-frames N] [-fill PERCENT] [-seed S] [-check]
+//
+// meshes      Vertex and index buffers placed once, each at the 64 KB alignment every
+//             buffer takes; the bytes against one committed resource each.
+// streaming   Texture chains of 64 to 2048 texels reloaded with more or fewer mips
+//             every frame, the old chain freed three frames on.  Chains are evicted at
+//             random once the heap is PERCENT full, so what fails to fit mostly does so
+//             for want of a range, not of bytes.
+// random      Sizes from 1 byte to 1 MB at alignments up to 64 KB, freed at random, half
+//             behind a fence.
+//
+// Every range handed out is checked against the others still held; -check also walks
+// the allocator's lists after every frame.  Exits with 1 on any failure.
+//***************************************************************************************
+
+#include "HeapAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const uint64_t SmallAlignment = 4 * 1024;
+	const uint64_t LargeAlignment = 64 * 1024;
+	const uint64_t FramesInFlight = 3;
+	const double MB = 1024.0 * 1024.0;
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	struct Options
+	{
+		uint64_t HeapBytes = 64 * 1024 * 1024;
+		uint32_t FrameCount = 10000;
+		uint32_t FillPercent = 75;
+		uint32_t Seed = 1;
+		bool Check = false;
+	};
+
+	// The heap with what is held in it, timed and checked.
+	class Run
+	{
+	public:
+		Run(const char* name, const Options& options) :
+			mName(name), mOptions(options), mHeap(options.HeapBytes)
+		{
+		}
+
+		// An invalid allocation if it did not fit.
+		HeapAllocator::Allocation Allocate(uint64_t size, uint64_t alignment)
+		{
+			auto t0 = Clock::now();
+			HeapAllocator::Allocation range = mHeap.Allocate(size, alignment);
+			mAllocateNs += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+			mAllocations++;
+
+			if(!range.IsValid())
+			{
+				if(mHeap.FreeBytes() >= size)
+					mOutOfRanges++;
+				else
+					mOutOfBytes++;
+				return range;
+			}
+
+			if(range.Offset % alignment != 0 || range.Offset + size > mHeap.Capacity())
+				mFailures++;
+			return range;
+		}
+
+		void Free(const HeapAllocator::Allocation& range, uint64_t fenceValue)
+		{
+			auto t0 = Clock::now();
+			if(fenceValue == 0)
+				mHeap.Free(range);
+			else
+				mHeap.Free(range, fenceValue);
+			mFreeNs += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+			mFrees++;
+		}
+
+		// Ends a frame: retires what the GPU would be done with, and checks and samples
+		// the heap.
+		void EndFrame(uint32_t frame, const std::vector<HeapAllocator::Allocation>& held)
+		{
+			mHeap.Retire(frame > FramesInFlight ? frame - FramesInFlight : 0);
+			mPeakUsed = std::max<uint64_t>(mPeakUsed, mHeap.UsedBytes());
+
+			if(mOptions.Check || frame + 1 == mOptions.FrameCount)
+				CheckRanges(held);
+
+			uint32_t interval = std::max<uint32_t>(mOptions.FrameCount / 8, 1);
+			if((frame + 1) % interval == 0)
+			{
+				printf("  %-10s frame %6u  %8.2f MB used  %6u free ranges  largest %8.2f MB  %5.1f%% fragmented\n",
+					mName, frame + 1, mHeap.UsedBytes() / MB, mHeap.FreeRangeCount(), mHeap.LargestFreeRange() / MB,
+					Fragmentation());
+			}
+		}
+
+		// Returns the failures.
+		uint32_t Report(uint64_t heldBytes, uint64_t committedBytes)
+		{
+			printf("  %-10s %u allocations at %.0f ns, %u frees at %.0f ns\n", mName,
+				mAllocations, mAllocations > 0 ? mAllocateNs / mAllocations : 0.0,
+				mFrees, mFrees > 0 ? mFreeNs / mFrees : 0.0);
+			printf("  %-10s peak %.2f MB of %.2f MB; %u out of bytes, %u with the bytes free but no range\n", "",
+				mPeakUsed / MB, mHeap.Capacity() / MB, mOutOfBytes, mOutOfRanges);
+			if(committedBytes > 0)
+			{
+				printf("  %-10s %.2f MB held, %.2f MB placed, %.2f MB as committed resources\n", "",
+					heldBytes / MB, mHeap.UsedBytes() / MB, committedBytes / MB);
+			}
+			printf("  %-10s %u failures\n\n", "", mFailures);
+			return mFailures;
+		}
+
+		HeapAllocator& Heap() { return mHeap; }
+
+	private:
+		double Fragmentation()const
+		{
+			double freeBytes = (double)mHeap.FreeBytes();
+			return freeBytes > 0.0 ? 100.0 * (1.0 - mHeap.LargestFreeRange() / freeBytes) : 0.0;
+		}
+
+		// Ranges still held must not overlap; pending ones are left to CheckConsistency.
+		void CheckRanges(std::vector<HeapAllocator::Allocation> held)
+		{
+			held.erase(std::remove_if(held.begin(), held.end(),
+				[](const HeapAllocator::Allocation& range) { return !range.IsValid(); }), held.end());
+			std::sort(held.begin(), held.end(),
+				[](const HeapAllocator::Allocation& a, const HeapAllocator::Allocation& b) { return a.Offset < b.Offset; });
+			for(size_t i = 1; i < held.size(); ++i)
+			{
+				if(held[i - 1].Offset + held[i - 1].Size > held[i].Offset)
+					mFailures++;
+			}
+			if(!mHeap.CheckConsistency())
+				mFailures++;
+		}
+
+		const char* mName;
+		Options mOptions;
+		HeapAllocator mHeap;
+
+		uint32_t mAllocations = 0;
+		uint32_t mFrees = 0;
+		uint32_t mOutOfBytes = 0;
+		uint32_t mOutOfRanges = 0;
+		uint32_t mFailures = 0;
+		double mAllocateNs = 0.0;
+		double mFreeNs = 0.0;
+		uint64_t mPeakUsed = 0;
+	};
+
+	uint32_t Meshes(const Options& options)
+	{
+		Run run("meshes", options);
+		std::mt19937 rng(options.Seed);
+
+		// Mostly small meshes, a few big ones, until a tenth of the heap is held.
+		std::vector<HeapAllocator::Allocation> held;
+		uint64_t heldBytes = 0;
+		uint64_t committedBytes = 0;
+		while(heldBytes < options.HeapBytes / 10)
+		{
+			uint64_t bytes = 256 + rng() % (rng() % 16 == 0 ? 2 * 1024 * 1024 : 32 * 1024);
+			HeapAllocator::Allocation range = run.Allocate(AlignUp(bytes, LargeAlignment), LargeAlignment);
+			if(!range.IsValid())
+				break;
+
+			held.push_back(range);
+			heldBytes += bytes;
+			committedBytes += AlignUp(bytes, LargeAlignment);
+		}
+		run.EndFrame(options.FrameCount - 1, held);
+
+		// Placed one by one, buffers save nothing on alignment; sub-allocating within one
+		// buffer does.
+		return run.Report(heldBytes, committedBytes);
+	}
+
+	uint32_t Streaming(const Options& options)
+	{
+		struct Chain
+		{
+			uint32_t Width;
+			uint32_t BlockBytes;
+			uint64_t Bytes;
+			HeapAllocator::Allocation Range;
+		};
+
+		auto chainBytes = [](const Chain& chain, uint32_t skip)
+		{
+			uint64_t bytes = 0;
+			for(uint32_t w = chain.Width >> skip; w > 0; w >>= 1)
+			{
+				uint64_t blocks = std::max<uint32_t>(w / 4, 1);
+				bytes += blocks * blocks * chain.BlockBytes;
+			}
+			return bytes;
+		};
+
+		Run run("streaming", options);
+		std::mt19937 rng(options.Seed);
+		uint64_t budget = options.HeapBytes / 100 * options.FillPercent;
+
+		// Enough textures that their full chains would overflow the heap.
+		std::vector<Chain> chains(std::max<uint64_t>(options.HeapBytes / (256 * 1024), 16));
+		for(Chain& chain : chains)
+		{
+			chain.Width = 64u << (rng() % 6);
+			chain.BlockBytes = rng() % 2 == 0 ? 8 : 16;
+			chain.Bytes = 0;
+		}
+
+		std::vector<HeapAllocator::Allocation> held(chains.size());
+		for(uint32_t frame = 0; frame < options.FrameCount; ++frame)
+		{
+			uint64_t fenceValue = frame + 1;
+			for(uint32_t reloads = 1 + rng() % 6; reloads > 0; --reloads)
+			{
+				size_t c = rng() % chains.size();
+				Chain& chain = chains[c];
+				uint32_t mipCount = 1;
+				while((chain.Width >> mipCount) > 0)
+					mipCount++;
+
+				uint64_t bytes = chainBytes(chain, rng() % (mipCount - 4));
+				uint64_t alignment = bytes <= LargeAlignment ? SmallAlignment : LargeAlignment;
+				uint64_t size = AlignUp(bytes, alignment);
+
+				// Evicts whole chains, as the residency does when over budget.
+				for(uint32_t tries = 0; run.Heap().UsedBytes() + size > budget && tries < 16; ++tries)
+				{
+					Chain& victim = chains[rng() % chains.size()];
+					if(&victim == &chain || !victim.Range.IsValid())
+						continue;
+					run.Free(victim.Range, fenceValue);
+					victim.Range = HeapAllocator::Allocation();
+					held[&victim - chains.data()] = victim.Range;
+				}
+
+				HeapAllocator::Allocation range = run.Allocate(size, alignment);
+				if(!range.IsValid())
+					continue;
+
+				if(chain.Range.IsValid())
+					run.Free(chain.Range, fenceValue);
+				chain.Bytes = bytes;
+				chain.Range = range;
+				held[c] = range;
+			}
+			run.EndFrame(frame, held);
+		}
+
+		uint64_t heldBytes = 0;
+		uint64_t committedBytes = 0;
+		for(const Chain& chain : chains)
+		{
+			if(!chain.Range.IsValid())
+				continue;
+			heldBytes += chain.Bytes;
+			committedBytes += AlignUp(chain.Bytes, LargeAlignment);
+		}
+
+		run.Heap().Retire(UINT64_MAX);
+		return run.Report(heldBytes, committedBytes);
+	}
+
+	uint32_t Random(const Options& options)
+	{
+		Run run("random", options);
+		std::mt19937 rng(options.Seed);
+
+		std::vector<HeapAllocator::Allocation> held;
+		for(uint32_t frame = 0; frame < options.FrameCount; ++frame)
+		{
+			for(uint32_t step = 0; step < 8; ++step)
+			{
+				if(held.empty() || rng() % 100 < 55)
+				{
+					uint64_t size = 1 + rng() % (rng() % 8 == 0 ? 1024 * 1024 : 16 * 1024);
+					HeapAllocator::Allocation range = run.Allocate(size, 1ull << (rng() % 17));
+					if(range.IsValid())
+						held.push_back(range);
+				}
+				else
+				{
+					size_t victim = rng() % held.size();
+					run.Free(held[victim], rng() % 2 == 0 ? frame + 1 : 0);
+					held[victim] = held.back();
+					held.pop_back();
+				}
+			}
+			run.EndFrame(frame, held);
+		}
+
+		run.Heap().Retire(UINT64_MAX);
+		return run.Report(0, 0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "-heap" && i + 1 < argc)
+			options.HeapBytes = strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+		else if(arg == "-frames" && i + 1 < argc)
+			options.FrameCount = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if(arg == "-fill" && i + 1 < argc)
+			options.FillPercent = std::min<uint32_t>((uint32_t)strtoul(argv[++i], nullptr, 10), 100);
+		else if(arg == "-seed" && i + 1 < argc)
+			options.Seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if(arg == "-check")
+			options.Check = true;
+		else
+		{
+			fprintf(stderr, "usage: heapbench [-heap MB] [-frames N] [-fill PERCENT] [-seed S] [-check]\n");
+			return 2;
+		}
+	}
+
+	if(options.HeapBytes == 0 || options.FrameCount == 0)
+	{
+		fprintf(stderr, "heapbench: the heap and the frame count must not be 0\n");
+		return 2;
+	}
+
+	uint32_t failures = Meshes(options) + Streaming(options) + Random(options);
+	return failures == 0 ? 0 : 1;
+}
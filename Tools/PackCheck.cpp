@@ -0,0 +1,208 @@
+//***************************************************************************************
+// PackCheck.cpp
+//
+// Runs SkylinePacker over random rectangles on Linux, checking every placement, and
+// reports how much of each page it fills.
+//
+// Build from the repository root, with dxgiformat.h from the DirectX-Headers package:
+//
+//   g++ -std=c++14 -O2 -I. -I/usr/include/directx -o packcheck Tools/PackCheck.cpp
+//       TexturePacker.cpp Common/DDSFile.cpp
+//
+// Run with:  packcheck [-rects N] [-seed S]
+//
+// Each case packs N rectangles (1000 by default) into one page until it is full, with
+// and without block alignment and padding, sorted tallest first as the app would and in
+// random order.  Every rectangle placed must lie inside the page, start on the
+// alignment grid and keep its padding clear of every other rectangle, and Occupancy
+// must be the area placed over the page's.  A rectangle refused must leave Occupancy as
+// it was, sorted cases must fill at least 70% of the page, and once Reset the page must
+// take one rectangle as large as itself.  Exits with 1 on any failure.
+//***************************************************************************************
+
+#include "TexturePacker.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Options
+	{
+		uint32_t RectCount = 1000;
+		uint32_t Seed = 1;
+	};
+
+	struct Case
+	{
+		const char* Name;
+		uint32_t PageSize;
+		uint32_t Alignment;
+		uint32_t Padding;
+		uint32_t MinSize;
+		uint32_t MaxSize;
+		bool Sorted;
+	};
+
+	const Case Cases[] =
+	{
+		{ "small",         256,  1, 0,  1,  32, true  },
+		{ "small random",  256,  1, 0,  1,  32, false },
+		{ "bc",           1024,  4, 0,  4, 128, true  },
+		{ "bc padded",    1024,  4, 2,  4, 128, true  },
+		{ "bc random",    1024,  4, 2,  4, 128, false },
+		{ "odd padded",   1024,  1, 3,  1,  96, true  },
+		{ "large bc",     4096,  4, 4, 16, 256, true  },
+	};
+
+	struct Rect
+	{
+		uint32_t X, Y, Width, Height;
+	};
+
+	struct CaseResult
+	{
+		uint32_t Placed = 0;
+		uint32_t Refused = 0;
+		double Occupancy = 0.0;
+		double InsertUs = 0.0;
+		uint32_t Failures = 0;
+	};
+
+	uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	CaseResult CheckCase(const Case& c, uint32_t rectCount, uint32_t seed)
+	{
+		CaseResult result;
+
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<uint32_t> size(c.MinSize, c.MaxSize);
+		std::vector<Rect> rects(rectCount);
+		for(Rect& r : rects)
+		{
+			r.Width = size(rng);
+			r.Height = size(rng);
+		}
+		if(c.Sorted)
+			std::sort(rects.begin(), rects.end(), [](const Rect& a, const Rect& b) { return a.Height > b.Height; });
+
+		SkylinePacker packer(c.PageSize, c.PageSize, c.Alignment, c.Padding);
+		std::vector<Rect> placed;
+		uint64_t area = 0;
+
+		Clock::time_point t0 = Clock::now();
+		for(Rect& r : rects)
+		{
+			double before = packer.Occupancy();
+			if(!packer.Insert(r.Width, r.Height, r.X, r.Y))
+			{
+				result.Refused++;
+				if(packer.Occupancy() != before)
+					result.Failures++;
+				continue;
+			}
+
+			placed.push_back(r);
+			area += (uint64_t)r.Width * r.Height;
+		}
+		result.InsertUs = std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / rectCount;
+
+		// Each rectangle's padded footprint, as the packer reserves it, may not reach
+		// into another rectangle.
+		for(size_t i = 0; i < placed.size(); ++i)
+		{
+			const Rect& a = placed[i];
+			uint32_t paddedWidth = AlignUp(a.Width + c.Padding, c.Alignment);
+			uint32_t paddedHeight = AlignUp(a.Height + c.Padding, c.Alignment);
+			if(a.X % c.Alignment != 0 || a.Y % c.Alignment != 0 ||
+			   a.X + paddedWidth > c.PageSize || a.Y + paddedHeight > c.PageSize)
+				result.Failures++;
+
+			for(size_t j = i + 1; j < placed.size(); ++j)
+			{
+				const Rect& b = placed[j];
+				if(a.X < b.X + b.Width + c.Padding && b.X < a.X + a.Width + c.Padding &&
+				   a.Y < b.Y + b.Height + c.Padding && b.Y < a.Y + a.Height + c.Padding)
+					result.Failures++;
+			}
+		}
+
+		result.Placed = (uint32_t)placed.size();
+		result.Occupancy = packer.Occupancy();
+		if(result.Occupancy != (double)area / ((double)c.PageSize * c.PageSize))
+			result.Failures++;
+
+		// The case must fill its page, or the occupancy says nothing about the packer.
+		if(result.Refused == 0 || (c.Sorted && result.Occupancy < 0.7))
+			result.Failures++;
+
+		// An emptied page takes a rectangle whose padded footprint is the whole page.
+		uint32_t full = (c.PageSize - c.Padding) / c.Alignment * c.Alignment;
+		uint32_t x = 1;
+		uint32_t y = 1;
+		packer.Reset();
+		if(packer.Occupancy() != 0.0 || !packer.Insert(full, full, x, y) || x != 0 || y != 0 ||
+		   packer.Insert(1, 1, x, y))
+			result.Failures++;
+
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "-rects" && i + 1 < argc)
+			options.RectCount = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if(arg == "-seed" && i + 1 < argc)
+			options.Seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			fprintf(stderr, "usage: packcheck [-rects N] [-seed S]\n");
+			return 2;
+		}
+	}
+
+	uint32_t failures = 0;
+
+	// Four quarters fill a page exactly, a fifth does not fit, and neither does anything
+	// wider than the page.
+	{
+		SkylinePacker quarters(1024, 1024);
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t placed = 0;
+		for(int i = 0; i < 4; ++i)
+			placed += quarters.Insert(512, 512, x, y) ? 1 : 0;
+		if(placed != 4 || quarters.Occupancy() != 1.0 || quarters.Insert(4, 4, x, y))
+			failures++;
+
+		quarters.Reset();
+		if(quarters.Insert(1025, 1, x, y) || quarters.Insert(0, 4, x, y) || quarters.Occupancy() != 0.0)
+			failures++;
+	}
+	printf("  %-14s %u failures\n", "quarters", failures);
+
+	for(const Case& c : Cases)
+	{
+		CaseResult result = CheckCase(c, options.RectCount, options.Seed);
+		printf("  %-14s %4upx align %u pad %u  placed %4u refused %4u  occupancy %5.1f%%  %.2f us/insert  %u failures\n",
+			c.Name, c.PageSize, c.Alignment, c.Padding, result.Placed, result.Refused,
+			100.0 * result.Occupancy, result.InsertUs, result.Failures);
+		failures += result.Failures;
+	}
+
+	printf("  failures       %u\n", failures);
+	return failures == 0 ? 0 : 1;
+}
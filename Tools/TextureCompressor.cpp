@@ -0,0 +1,421 @@
+//***************************************************************************************
+// TextureCompressor.cpp
+//
+// Command line front end to BlockCompress for building the DDS files under Textures
+// on Linux.  Reads 24 and 32 bit BMPs and uncompressed 32 bit DDS files, builds the mip
+// chain and encodes every mip on a pool of threads.  Several inputs of one size become
+// the slices of a texture array, as Textures/treeArray2.dds is of tree0-2.bmp.
+//
+// Build from the repository root, with dxgiformat.h from the DirectX-Headers package:
+//
+//   g++ -std=c++17 -O2 -msse2 -pthread -I. -I/usr/include/directx -o texcompress
+//       Tools/TextureCompressor.cpp BlockCompress.cpp TexturePacker.cpp Common/DDSFile.cpp
+//
+// Run with:  texcompress [-f bc1|bc3|bc4|bc5] [-srgb] [-linear | -normal] [-nomips]
+//                        [-j N] [-scalar] -o out.dds in.bmp [in.bmp ...]
+//
+// The format defaults to BC1, or BC3 if any texel is not opaque.  Mips are averaged in
+// linear light unless -linear or -normal says the texels are not colour; -normal also
+// renormalizes, and suits BC5, which keeps X and Y.  -srgb marks BC1 and BC3 as sRGB,
+// which needs the DX10 header.  -scalar turns the SSE2 path off.
+//***************************************************************************************
+
+#include "BlockCompress.h"
+#include "TexturePacker.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace
+{
+	struct Options
+	{
+		BlockCompress::Format Format = BlockCompress::Format::BC1;
+		bool FormatGiven = false;
+		bool Srgb = false;
+		BlockCompress::MipFilter Filter = BlockCompress::MipFilter::Srgb;
+		bool Mips = true;
+		uint32_t Threads = 0;
+		std::string Output;
+		std::vector<std::string> Inputs;
+	};
+
+	uint32_t ReadU32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+	uint16_t ReadU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+	// The byte of texel under mask, scaled to 8 bits.  A zero mask reads as fill.
+	uint8_t Channel(uint32_t texel, uint32_t mask, uint8_t fill)
+	{
+		if(mask == 0)
+			return fill;
+
+		uint32_t shift = 0;
+		while(((mask >> shift) & 1) == 0)
+			shift++;
+
+		uint32_t max = mask >> shift;
+		return (uint8_t)(((texel & mask) >> shift) * 255 / max);
+	}
+
+	bool ReadBmp(const uint8_t* data, size_t size, BlockCompress::Surface& surface, std::string& error)
+	{
+		const size_t fileHeaderSize = 14;
+		if(size < fileHeaderSize + 40 || data[0] != 'B' || data[1] != 'M')
+		{
+			error = "not a BMP file";
+			return false;
+		}
+
+		const uint8_t* info = data + fileHeaderSize;
+		uint32_t infoSize = ReadU32(info);
+		int32_t width = (int32_t)ReadU32(info + 4);
+		int32_t height = (int32_t)ReadU32(info + 8);
+		uint16_t bitCount = ReadU16(info + 14);
+		uint32_t compression = ReadU32(info + 16);
+		uint32_t offset = ReadU32(data + 10);
+
+		// BI_RGB, or BI_BITFIELDS with the masks after a 40 byte header or inside a
+		// V4 or V5 one.
+		uint32_t masks[4] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 };
+		if(compression == 3)
+		{
+			const uint8_t* m = info + 40;
+			if(fileHeaderSize + 40 + 12 > size)
+			{
+				error = "truncated BMP masks";
+				return false;
+			}
+			for(int i = 0; i < 3; ++i)
+				masks[i] = ReadU32(m + 4 * i);
+			masks[3] = infoSize >= 56 ? ReadU32(m + 12) : 0;
+		}
+		else if(compression != 0)
+		{
+			error = "compressed BMPs are not supported";
+			return false;
+		}
+
+		if(width <= 0 || height == 0 || (bitCount != 24 && bitCount != 32))
+		{
+			error = "only 24 and 32 bit BMPs are supported";
+			return false;
+		}
+
+		// Rows are padded to four bytes and stored bottom up unless the height is negative.
+		bool bottomUp = height > 0;
+		uint32_t rows = (uint32_t)std::abs(height);
+		size_t rowBytes = ((size_t)width * bitCount / 8 + 3) & ~(size_t)3;
+		if(offset > size || rowBytes * rows > size - offset)
+		{
+			error = "truncated BMP pixels";
+			return false;
+		}
+
+		surface.Width = (uint32_t)width;
+		surface.Height = rows;
+		surface.Texels.resize((size_t)width * rows * 4);
+
+		bool anyAlpha = false;
+		for(uint32_t y = 0; y < rows; ++y)
+		{
+			const uint8_t* row = data + offset + rowBytes * (bottomUp ? rows - 1 - y : y);
+			uint8_t* out = surface.Texels.data() + (size_t)y * width * 4;
+			for(int32_t x = 0; x < width; ++x)
+			{
+				uint32_t texel = bitCount == 32 ? ReadU32(row + 4 * x) :
+					row[3 * x] | (row[3 * x + 1] << 8) | (row[3 * x + 2] << 16);
+
+				out[4 * x + 0] = Channel(texel, masks[0], 0);
+				out[4 * x + 1] = Channel(texel, masks[1], 0);
+				out[4 * x + 2] = Channel(texel, masks[2], 0);
+				out[4 * x + 3] = bitCount == 32 ? Channel(texel, masks[3], 255) : 255;
+				anyAlpha = anyAlpha || out[4 * x + 3] != 0;
+			}
+		}
+
+		// A 32 bit BI_RGB file whose alpha is all zero has no alpha, only padding.
+		if(!anyAlpha)
+		{
+			for(size_t t = 0; t < surface.Texels.size(); t += 4)
+				surface.Texels[t + 3] = 255;
+		}
+
+		return true;
+	}
+
+	bool ReadDds(const uint8_t* data, size_t size, BlockCompress::Surface& surface, std::string& error)
+	{
+		DDS::Image image;
+		if(DDS::ParseHeader(data, size, image) != DDS::Status::Ok)
+		{
+			error = "not a valid DDS file";
+			return false;
+		}
+
+		bool bgra = image.Format == DXGI_FORMAT_B8G8R8A8_UNORM || image.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+			image.Format == DXGI_FORMAT_B8G8R8X8_UNORM;
+		bool rgba = image.Format == DXGI_FORMAT_R8G8B8A8_UNORM || image.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+		if(image.Dimension != DDS::DimensionTexture2D || image.ArraySize != 1 || (!bgra && !rgba))
+		{
+			error = "only uncompressed 32 bit 2D DDS files are supported";
+			return false;
+		}
+
+		// Only the top mip; the chain is built again.
+		surface.Width = (uint32_t)image.Width;
+		surface.Height = (uint32_t)image.Height;
+		surface.Texels.assign(image.BitData, image.BitData + (size_t)surface.Width * surface.Height * 4);
+		for(size_t t = 0; t < surface.Texels.size(); t += 4)
+		{
+			if(bgra)
+				std::swap(surface.Texels[t], surface.Texels[t + 2]);
+			if(image.Format == DXGI_FORMAT_B8G8R8X8_UNORM)
+				surface.Texels[t + 3] = 255;
+		}
+
+		return true;
+	}
+
+	bool ReadImage(const std::string& fileName, BlockCompress::Surface& surface, std::string& error)
+	{
+		DDS::MappedFile file;
+		if(!file.Open(fileName.c_str()))
+		{
+			error = strerror(errno);
+			return false;
+		}
+
+		if(file.Size() >= 2 && file.Data()[0] == 'B' && file.Data()[1] == 'M')
+			return ReadBmp(file.Data(), file.Size(), surface, error);
+		return ReadDds(file.Data(), file.Size(), surface, error);
+	}
+
+	// Encodes one mip, the workers taking a few block rows at a time.
+	std::vector<uint8_t> CompressMip(const BlockCompress::Surface& surface, BlockCompress::Format format, uint32_t threadCount)
+	{
+		std::vector<uint8_t> mip(BlockCompress::MipBytes(format, surface.Width, surface.Height));
+		uint32_t blockRows = (surface.Height + 3) / 4;
+
+		const uint32_t rowsPerTake = 4;
+		std::atomic<uint32_t> nextRow(0);
+		auto work = [&]()
+		{
+			for(;;)
+			{
+				uint32_t first = nextRow.fetch_add(rowsPerTake);
+				if(first >= blockRows)
+					break;
+
+				BlockCompress::CompressRows(surface, format, first, std::min<uint32_t>(rowsPerTake, blockRows - first), mip.data());
+			}
+		};
+
+		std::vector<std::thread> workers;
+		uint32_t count = std::min<uint32_t>(threadCount, (blockRows + rowsPerTake - 1) / rowsPerTake);
+		for(uint32_t i = 1; i < count; ++i)
+			workers.emplace_back(work);
+		work();
+		for(std::thread& worker : workers)
+			worker.join();
+
+		return mip;
+	}
+
+	// Peak signal to noise ratio of the decoded top mip over the channels format keeps.
+	double Psnr(const BlockCompress::Surface& source, const std::vector<uint8_t>& mip, BlockCompress::Format format)
+	{
+		BlockCompress::Surface decoded;
+		BlockCompress::Decompress(mip.data(), source.Width, source.Height, format, decoded);
+
+		int channels[4] = { 1, 1, 1, 0 };
+		if(format == BlockCompress::Format::BC3)
+			channels[3] = 1;
+		else if(format == BlockCompress::Format::BC4)
+			channels[1] = channels[2] = 0;
+		else if(format == BlockCompress::Format::BC5)
+			channels[2] = 0;
+
+		double sum = 0.0;
+		size_t count = 0;
+		for(size_t t = 0; t < source.Texels.size(); t += 4)
+		{
+			for(int i = 0; i < 4; ++i)
+			{
+				if(!channels[i])
+					continue;
+
+				double d = (double)source.Texels[t + i] - decoded.Texels[t + i];
+				sum += d * d;
+				count++;
+			}
+		}
+
+		double mse = count > 0 ? sum / count : 0.0;
+		return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+	}
+
+	bool ParseArgs(int argc, char** argv, Options& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			if(arg == "-f" && i + 1 < argc)
+			{
+				std::string name = argv[++i];
+				options.FormatGiven = true;
+				if(name == "bc1")
+					options.Format = BlockCompress::Format::BC1;
+				else if(name == "bc3")
+					options.Format = BlockCompress::Format::BC3;
+				else if(name == "bc4")
+					options.Format = BlockCompress::Format::BC4;
+				else if(name == "bc5")
+					options.Format = BlockCompress::Format::BC5;
+				else
+					return false;
+			}
+			else if(arg == "-srgb")
+				options.Srgb = true;
+			else if(arg == "-linear")
+				options.Filter = BlockCompress::MipFilter::Linear;
+			else if(arg == "-normal")
+				options.Filter = BlockCompress::MipFilter::NormalMap;
+			else if(arg == "-nomips")
+				options.Mips = false;
+			else if(arg == "-j" && i + 1 < argc)
+				options.Threads = (uint32_t)atoi(argv[++i]);
+			else if(arg == "-scalar")
+				BlockCompress::UseSimd(false);
+			else if(arg == "-o" && i + 1 < argc)
+				options.Output = argv[++i];
+			else if(!arg.empty() && arg[0] == '-')
+				return false;
+			else
+				options.Inputs.push_back(arg);
+		}
+
+		return !options.Output.empty() && !options.Inputs.empty();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if(!ParseArgs(argc, argv, options))
+	{
+		fprintf(stderr,
+			"usage: texcompress [-f bc1|bc3|bc4|bc5] [-srgb] [-linear | -normal] [-nomips]\n"
+			"                   [-j N] [-scalar] -o out.dds in.bmp [in.bmp ...]\n");
+		return 2;
+	}
+
+	if(options.Threads == 0)
+		options.Threads = std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+
+	std::vector<BlockCompress::Surface> surfaces(options.Inputs.size());
+	for(size_t i = 0; i < options.Inputs.size(); ++i)
+	{
+		std::string error;
+		if(!ReadImage(options.Inputs[i], surfaces[i], error))
+		{
+			fprintf(stderr, "%s: %s\n", options.Inputs[i].c_str(), error.c_str());
+			return 1;
+		}
+
+		if(surfaces[i].Width != surfaces[0].Width || surfaces[i].Height != surfaces[0].Height)
+		{
+			fprintf(stderr, "%s: array slices must all be %ux%u\n", options.Inputs[i].c_str(), surfaces[0].Width, surfaces[0].Height);
+			return 1;
+		}
+	}
+
+	// BC1's four colour mode has no alpha, so anything not opaque goes to BC3.
+	if(!options.FormatGiven)
+	{
+		for(const BlockCompress::Surface& surface : surfaces)
+		{
+			for(size_t t = 3; t < surface.Texels.size(); t += 4)
+			{
+				if(surface.Texels[t] != 255)
+					options.Format = BlockCompress::Format::BC3;
+			}
+		}
+	}
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	uint32_t mipCount = options.Mips ? BlockCompress::MipCount(surfaces[0].Width, surfaces[0].Height) : 1;
+	std::vector<std::vector<uint8_t>> files;
+	double worstPsnr = 99.0;
+	size_t sourceBytes = 0;
+	for(const BlockCompress::Surface& top : surfaces)
+	{
+		std::vector<std::vector<uint8_t>> mips;
+		BlockCompress::Surface surface = top;
+		for(uint32_t m = 0; m < mipCount; ++m)
+		{
+			if(m > 0)
+				surface = BlockCompress::DownsampleBox(surface, options.Filter);
+
+			sourceBytes += surface.Texels.size();
+			mips.push_back(CompressMip(surface, options.Format, options.Threads));
+		}
+
+		worstPsnr = std::min<double>(worstPsnr, Psnr(top, mips[0], options.Format));
+		files.push_back(BlockCompress::WriteDDS(options.Format, options.Srgb, top.Width, top.Height, mips));
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	// Written the way the app reads it back, or packed into one array.
+	std::vector<uint8_t> out;
+	if(files.size() == 1)
+	{
+		out = std::move(files[0]);
+	}
+	else
+	{
+		std::vector<DDS::Image> slices(files.size());
+		for(size_t i = 0; i < files.size(); ++i)
+			DDS::ParseHeader(files[i].data(), files[i].size(), slices[i]);
+
+		if(TexturePacker::PackArray(slices, out) != DDS::Status::Ok)
+		{
+			fprintf(stderr, "could not pack the inputs into an array\n");
+			return 1;
+		}
+	}
+
+	DDS::Image check;
+	if(DDS::ParseHeader(out.data(), out.size(), check) != DDS::Status::Ok)
+	{
+		fprintf(stderr, "the file written does not parse\n");
+		return 1;
+	}
+
+	FILE* file = fopen(options.Output.c_str(), "wb");
+	if(file == nullptr || fwrite(out.data(), 1, out.size(), file) != out.size())
+	{
+		fprintf(stderr, "%s: %s\n", options.Output.c_str(), strerror(errno));
+		if(file != nullptr)
+			fclose(file);
+		return 1;
+	}
+	fclose(file);
+
+	static const char* formatNames[] = { "BC1", "BC3", "BC4", "BC5" };
+	printf("%s: %ux%u x%zu, %s%s, %u mips, %zu -> %zu bytes (%.1fx), PSNR %.2f dB, %.1f ms on %u threads%s\n",
+		options.Output.c_str(), surfaces[0].Width, surfaces[0].Height, surfaces.size(),
+		formatNames[(int)options.Format], options.Srgb ? " sRGB" : "", mipCount,
+		sourceBytes, out.size(), (double)sourceBytes / out.size(), worstPsnr,
+		std::chrono::duration<double, std::milli>(t1 - t0).count(), options.Threads,
+		BlockCompress::SimdAvailable() ? "" : ", no SSE2");
+
+	return 0;
+}